@@ -50,8 +50,8 @@ class AppDelegate: UIResponder, UIApplicationDelegate {
         tokenStream = TokenStream()
         clipboardManager = ClipboardManager()
 
-        // Setup inference engine callbacks
-        setupInferenceCallbacks()
+        // Forward inference results to the keyboard
+        forwardInferenceEvents()
 
         // Load Whisper model (async to avoid blocking launch)
         loadModelAsync()
@@ -150,27 +150,32 @@ class AppDelegate: UIResponder, UIApplicationDelegate {
         }
     }
 
-    // MARK: - Inference Callbacks
+    // MARK: - Inference Events
 
-    /// Setup callbacks for inference engine
-    private func setupInferenceCallbacks() {
-        // Token updates (streaming)
-        inferenceEngine.onTokenUpdate = { [weak self] tokenUpdate in
-            self?.tokenStream.sendTokenUpdate(tokenUpdate)
-        }
+    /// Forward the engine's results to the keyboard extension for the life of the app
+    private func forwardInferenceEvents() {
+        let events = inferenceEngine.events
+        let tokenStream = self.tokenStream!
 
-        // Final transcription result
-        inferenceEngine.onTranscriptionComplete = { [weak self] result in
-            self?.tokenStream.sendTranscriptionResult(result)
+        Task.detached(priority: .userInitiated) {
+            for await event in events {
+                switch event {
+                case .tokenUpdate(let tokenUpdate):
+                    // Token updates (streaming)
+                    tokenStream.sendTokenUpdate(tokenUpdate)
 
-            // Also copy to clipboard if setting is enabled
-            // (Could add a setting for auto-clipboard)
-        }
+                case .transcriptionComplete(let result):
+                    // Final transcription result
+                    tokenStream.sendTranscriptionResult(result)
+
+                    // Also copy to clipboard if setting is enabled
+                    // (Could add a setting for auto-clipboard)
 
-        // Errors
-        inferenceEngine.onError = { [weak self] error in
-            self?.tokenStream.sendError(error)
-            print("[App] Inference error: \(error.description)")
+                case .error(let error):
+                    tokenStream.sendError(error)
+                    print("[App] Inference error: \(error.description)")
+                }
+            }
         }
     }
 
@@ -203,8 +208,9 @@ class AppDelegate: UIResponder, UIApplicationDelegate {
     // MARK: - Cleanup
 
     /// Clean up orphaned files from previous sessions
+    /// Background work: each directory and every few files is a checkpoint where live sessions win
     private func cleanupOrphanedFiles() {
-        DispatchQueue.global(qos: .utility).async {
+        WorkScheduler.shared.background { checkpoint in
             print("[App] Cleaning up orphaned files...")
 
             let directories = [
@@ -216,29 +222,21 @@ class AppDelegate: UIResponder, UIApplicationDelegate {
             // Delete files older than 1 hour
             let cutoff = Date().addingTimeInterval(-3600)
 
-            for directory in directories.compactMap({ $0 }) {
-                do {
-                    let files = try FileManager.default.contentsOfDirectory(
-                        at: directory,
-                        includingPropertiesForKeys: [.contentModificationDateKey],
-                        options: [.skipsHiddenFiles]
-                    )
-
-                    var deletedCount = 0
-                    for file in files {
-                        if let attributes = try? FileManager.default.attributesOfItem(atPath: file.path),
-                           let modDate = attributes[.modificationDate] as? Date,
-                           modDate < cutoff {
-                            try? FileManager.default.removeItem(at: file)
-                            deletedCount += 1
-                        }
-                    }
+            for index in directories.compactMap({ AppGroups.index(for: $0) }) {
+                checkpoint()
 
-                    if deletedCount > 0 {
-                        print("[App] Cleaned up \(deletedCount) orphaned files from \(directory.lastPathComponent)")
+                var deletedCount = 0
+                for (i, file) in index.entries(olderThan: cutoff).enumerated() {
+                    if i > 0 && i % WhisperBoardConfig.Scheduler.maintenanceStepFiles == 0 {
+                        checkpoint()
+                    }
+                    if index.remove(file.name) {
+                        deletedCount += 1
                     }
-                } catch {
-                    print("[App] Failed to cleanup \(directory.lastPathComponent): \(error)")
+                }
+
+                if deletedCount > 0 {
+                    print("[App] Cleaned up \(deletedCount) orphaned files from \(index.directory.lastPathComponent)")
                 }
             }
         }
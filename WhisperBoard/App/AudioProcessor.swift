@@ -18,12 +18,19 @@ class AudioProcessor {
     private var audioMonitorTimer: Timer?
     private var lastProcessedChunkId = -1
     private var currentSessionId: String?
+    /// Change-order position of the last metadata file examined (0 = walk the whole directory)
+    private var metadataCursor: UInt64 = 0
     private let processingQueue = DispatchQueue(label: "com.whisperboard.audioprocessor", qos: .userInitiated)
 
     /// Chunk sequencing buffer for out-of-order chunks
-    private var chunkBuffer: [Int: (data: Data, metadata: AudioChunkMetadata, url: URL, pcmURL: URL)] = [:]
+    private var chunkBuffer: [Int: (samples: PCMSamples, metadata: AudioChunkMetadata, metadataName: String, pcmName: String)] = [:]
     private let maxBufferSize = 10  // Maximum chunks to buffer before dropping
 
+    /// Audio handed to the inference engine but not yet transcribed (advertised as lag)
+    private var queuedAudioMs = 0
+    /// Chunks handed to the inference engine whose credit has not been returned yet
+    private var chunksInInference = 0
+
     /// Polling interval for checking new audio chunks (in seconds)
     private let pollingInterval: TimeInterval = 0.05  // 50ms for low latency
 
@@ -51,6 +58,11 @@ class AudioProcessor {
 
         // Also monitor control signals
         monitorControlSignals()
+
+        // Let the keyboard start sending, forgetting credits a previous run never returned
+        processingQueue.async { [weak self] in
+            self?.restartFlow()
+        }
     }
 
     /// Stop monitoring for audio chunks
@@ -98,7 +110,9 @@ class AudioProcessor {
         case .start:
             currentSessionId = message.sessionId
             lastProcessedChunkId = -1
+            metadataCursor = 0  // Look at leftovers again so old sessions' files get cleaned up
             chunkBuffer.removeAll()  // Clear buffer for new session
+            SharedState.shared?.resyncFlow()
             inferenceEngine.startSession(sessionId: message.sessionId)
 
         case .stop:
@@ -111,6 +125,7 @@ class AudioProcessor {
             currentSessionId = nil
             lastProcessedChunkId = -1
             chunkBuffer.removeAll()
+            SharedState.shared?.resyncFlow()
 
         case .ping:
             // Respond with status
@@ -123,6 +138,7 @@ class AudioProcessor {
             currentSessionId = nil
             lastProcessedChunkId = -1
             chunkBuffer.removeAll()
+            SharedState.shared?.resyncFlow()
         }
     }
 
@@ -133,41 +149,29 @@ class AudioProcessor {
         processingQueue.async { [weak self] in
             guard let self = self else { return }
 
-            do {
-                // Look for audio chunk metadata files
-                guard let audioBuffersPath = AppGroups.Paths.audioBuffers else { return }
-
-                let fileManager = FileManager.default
-                let files = try fileManager.contentsOfDirectory(
-                    at: audioBuffersPath,
-                    includingPropertiesForKeys: [.contentModificationDateKey],
-                    options: [.skipsHiddenFiles]
-                )
-
-                // Find metadata files (JSON)
-                let metadataFiles = files
-                    .filter { $0.pathExtension == "json" }
-                    .sorted { url1, url2 in
-                        let date1 = (try? url1.resourceValues(forKeys: [.contentModificationDateKey]))?.contentModificationDate ?? Date.distantPast
-                        let date2 = (try? url2.resourceValues(forKeys: [.contentModificationDateKey]))?.contentModificationDate ?? Date.distantPast
-                        return date1 < date2
-                    }
+            // Look for audio chunk metadata files
+            guard let index = AppGroups.index(for: AppGroups.Paths.audioBuffers) else { return }
 
-                // Process each metadata file
-                for metadataFile in metadataFiles {
-                    try self.processAudioChunkFile(metadataFile)
-                }
+            // Metadata files (JSON) written since the last poll - served from the index without re-statting
+            let metadataFiles = index.changes(suffix: ".json", since: &self.metadataCursor)
 
-            } catch {
-                // Silently ignore errors during polling
+            // Process each metadata file
+            for metadataFile in metadataFiles {
+                do {
+                    try self.processAudioChunkFile(metadataFile.name, in: index)
+                } catch {
+                    // File might not be complete yet: retry it (and everything after it) next poll
+                    self.metadataCursor = metadataFile.sequence - 1
+                    return
+                }
             }
         }
     }
 
     /// Process a single audio chunk metadata file
-    private func processAudioChunkFile(_ metadataURL: URL) throws {
+    private func processAudioChunkFile(_ metadataName: String, in index: ContainerIndex) throws {
         // Read metadata
-        let metadataData = try Data(contentsOf: metadataURL)
+        let metadataData = try Data(contentsOf: index.url(for: metadataName))
         let chunkMessage = try metadataData.decode(as: AudioChunkMessage.self)
         let metadata = chunkMessage.metadata
 
@@ -182,11 +186,9 @@ class AudioProcessor {
         // Skip if already processed
         guard metadata.chunkId > lastProcessedChunkId else {
             // Already processed, clean up
-            try? FileManager.default.removeItem(at: metadataURL)
-            if let audioBuffersPath = AppGroups.Paths.audioBuffers {
-                let pcmURL = audioBuffersPath.appendingPathComponent(chunkMessage.pcmFileName)
-                try? FileManager.default.removeItem(at: pcmURL)
-            }
+            index.remove(metadataName)
+            index.remove(chunkMessage.pcmFileName)
+            releaseCredits(1)
             return
         }
 
@@ -194,25 +196,21 @@ class AudioProcessor {
         guard let currentSession = currentSessionId,
               currentSession == metadata.sessionId else {
             // Delete old session files
-            try? FileManager.default.removeItem(at: metadataURL)
-            if let audioBuffersPath = AppGroups.Paths.audioBuffers {
-                let pcmURL = audioBuffersPath.appendingPathComponent(chunkMessage.pcmFileName)
-                try? FileManager.default.removeItem(at: pcmURL)
-            }
+            index.remove(metadataName)
+            index.remove(chunkMessage.pcmFileName)
+            releaseCredits(1)
             return
         }
 
-        // Read PCM audio data
-        guard let audioBuffersPath = AppGroups.Paths.audioBuffers else {
-            throw AudioProcessorError.invalidPath
+        // Map PCM audio data (float32 samples are not copied until whisper.cpp reads them)
+        let pcmName = chunkMessage.pcmFileName
+        guard let samples = PCMSamples(url: index.url(for: pcmName), format: metadata.format) else {
+            throw AudioProcessorError.fileNotFound
         }
 
-        let pcmURL = audioBuffersPath.appendingPathComponent(chunkMessage.pcmFileName)
-        let audioData = try Data(contentsOf: pcmURL)
-
         // Validate audio data size
         do {
-            try validateAudioDataSize(audioData, metadata: metadata)
+            try validateAudioDataSize(samples.byteCount, metadata: metadata)
         } catch {
             Logger.error(error, context: "Invalid audio data for chunk \(metadata.chunkId)", category: "AudioProcessor")
             throw error
@@ -221,15 +219,15 @@ class AudioProcessor {
         // Check if this is the next expected chunk
         if metadata.chunkId == lastProcessedChunkId + 1 {
             // Process immediately - this is the next in sequence
-            processChunk(audioData, metadata: metadata)
+            processChunk(samples, metadata: metadata)
             lastProcessedChunkId = metadata.chunkId
 
-            // Clean up files
-            try? FileManager.default.removeItem(at: metadataURL)
-            try? FileManager.default.removeItem(at: pcmURL)
+            // Clean up files (the mapping outlives the unlink)
+            index.remove(metadataName)
+            index.remove(pcmName)
 
             // Process any buffered chunks that are now in sequence
-            processBufferedChunks()
+            processBufferedChunks(in: index)
 
         } else {
             // Out of order - buffer it
@@ -241,61 +239,98 @@ class AudioProcessor {
                 // Find and remove oldest chunk
                 if let oldestId = chunkBuffer.keys.min() {
                     if let oldChunk = chunkBuffer.removeValue(forKey: oldestId) {
-                        try? FileManager.default.removeItem(at: oldChunk.url)
-                        try? FileManager.default.removeItem(at: oldChunk.pcmURL)
+                        index.remove(oldChunk.metadataName)
+                        index.remove(oldChunk.pcmName)
+                        releaseCredits(1)
                     }
                 }
             }
 
             // Buffer this chunk
-            chunkBuffer[metadata.chunkId] = (audioData, metadata, metadataURL, pcmURL)
+            chunkBuffer[metadata.chunkId] = (samples, metadata, metadataName, pcmName)
         }
     }
 
     /// Process a chunk and send to inference engine
-    private func processChunk(_ audioData: Data, metadata: AudioChunkMetadata) {
-        print("[AudioProcessor] Processing chunk \(metadata.chunkId), \(audioData.count) bytes")
-        inferenceEngine.processAudioChunk(audioData, metadata: metadata)
+    private func processChunk(_ samples: PCMSamples, metadata: AudioChunkMetadata) {
+        print("[AudioProcessor] Processing chunk \(metadata.chunkId), \(samples.byteCount) bytes")
+
+        let durationMs = Int(metadata.duration * 1000)
+        queuedAudioMs += durationMs
+        chunksInInference += 1
+
+        // The chunk's credit goes back once inference is done with it
+        inferenceEngine.processAudioChunk(samples, metadata: metadata) { [weak self] in
+            self?.processingQueue.async {
+                guard let self = self else { return }
+                self.queuedAudioMs = max(0, self.queuedAudioMs - durationMs)
+                self.chunksInInference -= 1
+                self.releaseCredits(1)
+            }
+        }
     }
 
     /// Process any buffered chunks that are now in sequence
-    private func processBufferedChunks() {
+    private func processBufferedChunks(in index: ContainerIndex) {
         var nextChunkId = lastProcessedChunkId + 1
 
         // Keep processing chunks as long as we have the next one in sequence
         while let bufferedChunk = chunkBuffer.removeValue(forKey: nextChunkId) {
             print("[AudioProcessor] Processing buffered chunk \(nextChunkId)")
 
-            processChunk(bufferedChunk.data, metadata: bufferedChunk.metadata)
+            processChunk(bufferedChunk.samples, metadata: bufferedChunk.metadata)
             lastProcessedChunkId = nextChunkId
 
             // Clean up files
-            try? FileManager.default.removeItem(at: bufferedChunk.url)
-            try? FileManager.default.removeItem(at: bufferedChunk.pcmURL)
+            index.remove(bufferedChunk.metadataName)
+            index.remove(bufferedChunk.pcmName)
 
             nextChunkId += 1
         }
     }
 
+    // MARK: - Flow Control
+
+    /// Return credits to the keyboard for chunks that left the pipeline
+    private func releaseCredits(_ chunks: Int) {
+        SharedState.shared?.consumed(chunks: chunks, lagMs: queuedAudioMs)
+    }
+
+    /// Advertise capacity and current lag (runs with every status update)
+    private func advertiseFlow() {
+        SharedState.shared?.advertiseFlow(
+            capacity: WhisperBoardConfig.IPC.flowCapacityChunks,
+            lagMs: queuedAudioMs
+        )
+    }
+
+    /// Advertise on (re)start. Chunks still on disk or in inference keep their credits; a
+    /// crashed or killed run's others would otherwise stay in flight for good.
+    private func restartFlow() {
+        let onDisk = AppGroups.index(for: AppGroups.Paths.audioBuffers)?.entries(suffix: ".json").count ?? 0
+        SharedState.shared?.restartFlow(
+            capacity: WhisperBoardConfig.IPC.flowCapacityChunks,
+            lagMs: queuedAudioMs,
+            pendingChunks: onDisk + chunksInInference
+        )
+    }
+
     // MARK: - Status Updates
 
     /// Update app status in shared container
+    /// Background work: waits for a gap in live inference, but no longer than statusMaxDelaySeconds
     private func updateAppStatus() {
-        processingQueue.async { [weak self] in
-            guard let self = self else { return }
+        WorkScheduler.shared.background(maxDelay: WhisperBoardConfig.Scheduler.statusMaxDelaySeconds) { [weak self] _ in
+            self?.processingQueue.async { [weak self] in
+                guard let self = self else { return }
 
-            do {
-                let status = self.inferenceEngine.getStatus()
-                let statusData = try status.toJSONData()
-
-                try AppGroups.writeData(
-                    statusData,
-                    to: AppGroups.Files.statusFile,
-                    in: AppGroups.Paths.control
-                )
+                guard let sharedState = SharedState.shared else {
+                    print("[AudioProcessor] Failed to update status: shared state unavailable")
+                    return
+                }
 
-            } catch {
-                print("[AudioProcessor] Failed to update status: \(error)")
+                sharedState.publish(self.inferenceEngine.getStatus())
+                self.advertiseFlow()
             }
         }
     }
@@ -319,37 +354,15 @@ class AudioProcessor {
             // Clear chunk buffer
             self.chunkBuffer.removeAll()
 
-            // Clean up audio buffers directory
-            if let audioBuffersPath = AppGroups.Paths.audioBuffers {
-                do {
-                    let files = try FileManager.default.contentsOfDirectory(
-                        at: audioBuffersPath,
-                        includingPropertiesForKeys: nil,
-                        options: [.skipsHiddenFiles]
-                    )
+            // Clean up audio buffers and transcriptions directories
+            let directories = [
+                AppGroups.Paths.audioBuffers,
+                AppGroups.Paths.transcriptions
+            ]
 
-                    for file in files where file.lastPathComponent.contains(sessionId) {
-                        try? FileManager.default.removeItem(at: file)
-                    }
-                } catch {
-                    print("[AudioProcessor] Failed to cleanup session files: \(error)")
-                }
-            }
-
-            // Clean up transcriptions directory
-            if let transcriptionsPath = AppGroups.Paths.transcriptions {
-                do {
-                    let files = try FileManager.default.contentsOfDirectory(
-                        at: transcriptionsPath,
-                        includingPropertiesForKeys: nil,
-                        options: [.skipsHiddenFiles]
-                    )
-
-                    for file in files where file.lastPathComponent.contains(sessionId) {
-                        try? FileManager.default.removeItem(at: file)
-                    }
-                } catch {
-                    print("[AudioProcessor] Failed to cleanup transcription files: \(error)")
+            for index in directories.compactMap({ AppGroups.index(for: $0) }) {
+                for file in index.entries(containing: sessionId) {
+                    index.remove(file.name)
                 }
             }
         }
@@ -4,6 +4,11 @@
 //
 //  Core inference engine for Whisper model
 //  Handles streaming audio → mel → tokens → text pipeline
+//  Chunks run through the staged native pipeline (Native/wb_pipeline)
+//  Results come back through a per-session native channel (Native/wb_session):
+//  one task per session awaits them and publishes straight to `events`.
+//  Two-pass mode: the pipeline runs the tiny model for live text, and the main
+//  model re-decodes each stretch of speech at pauses and at the last chunk.
 //
 
 import Foundation
@@ -19,23 +24,48 @@ class InferenceEngine {
     private var currentSessionId: String?
     private var isProcessing = false
 
-    /// Callback for streaming token updates
-    var onTokenUpdate: ((TokenUpdate) -> Void)?
+    /// Token updates, final results and errors, in the order they happened
+    let events: AsyncStream<InferenceEvent>
+    private let eventContinuation: AsyncStream<InferenceEvent>.Continuation
+
+    /// Settings (read by session tasks off the inference queue, hence the lock)
+    private var _settings: WhisperBoardSettings
+    private let settingsLock = NSLock()
+    private var settings: WhisperBoardSettings {
+        settingsLock.lock()
+        defer { settingsLock.unlock() }
+        return _settings
+    }
 
-    /// Callback for final transcription result
-    var onTranscriptionComplete: ((TranscriptionResult) -> Void)?
+    /// Staged native pipeline, created for the loaded model's context (the draft model's in two-pass mode)
+    private var pipeline: OpaquePointer?
+    private var pipelineContext: UnsafeMutablePointer<whisper_context>?
 
-    /// Callback for errors
-    var onError: ((ErrorMessage) -> Void)?
+    /// Main-model second pass, present in two-pass mode
+    private var refiner: Refiner?
 
-    /// Settings
-    private var settings: WhisperBoardSettings
+    /// Native session of the current dictation, opened with its first chunk. Written on the
+    /// queue under sessionLock, so cancelSession can abort running decodes immediately.
+    private var session: TranscriptionSession?
+    private let sessionLock = NSLock()
 
     // MARK: - Initialization
 
     init(modelLoader: ModelLoader = .shared, settings: WhisperBoardSettings = .default) {
         self.modelLoader = modelLoader
-        self.settings = settings
+        self._settings = settings
+
+        var continuation: AsyncStream<InferenceEvent>.Continuation!
+        events = AsyncStream { continuation = $0 }
+        eventContinuation = continuation
+    }
+
+    deinit {
+        replaceSession(with: nil)
+        eventContinuation.finish()
+        if let pipeline = pipeline {
+            wb_pipeline_free(pipeline)
+        }
     }
 
     // MARK: - Transcription
@@ -48,11 +78,14 @@ class InferenceEngine {
 
             if self.isProcessing {
                 print("[InferenceEngine] Warning: Starting new session while processing")
-                self.cancelSession()
             }
 
+            // Chunks of the previous session still in flight complete as dropped
+            self.replaceSession(with: nil)
+
             self.currentSessionId = sessionId
             self.isProcessing = true
+            WorkScheduler.shared.beginLiveSession()
 
             print("[InferenceEngine] Started session: \(sessionId)")
         }
@@ -60,62 +93,37 @@ class InferenceEngine {
 
     /// Process audio chunk and generate transcription
     /// - Parameters:
-    ///   - audioData: PCM audio data (16-bit or float32)
+    ///   - samples: Mapped chunk samples (16-bit input already widened to float)
     ///   - metadata: Audio chunk metadata
-    func processAudioChunk(_ audioData: Data, metadata: AudioChunkMetadata) {
+    ///   - completion: Called once the chunk is transcribed or ignored (on any thread)
+    func processAudioChunk(_ samples: PCMSamples, metadata: AudioChunkMetadata, completion: (() -> Void)? = nil) {
         inferenceQueue.async { [weak self] in
-            guard let self = self else { return }
+            guard let self = self else {
+                completion?()
+                return
+            }
 
             guard self.isProcessing,
                   let sessionId = self.currentSessionId,
                   sessionId == metadata.sessionId else {
                 print("[InferenceEngine] Ignoring chunk for inactive session")
+                completion?()
                 return
             }
 
-            let startTime = Date()
+            // float32 chunks must reach whisper.cpp straight from the mapping (checked in release
+            // builds too; PCMSamplesTests covers the same path)
+            if samples.format == .float32 && samples.copies > 0 {
+                print("[InferenceEngine] Warning: float32 chunk \(metadata.chunkId) was copied \(samples.copies)x before inference")
+            }
 
             do {
-                // Convert audio data to Float array
-                let audioSamples = try self.convertToFloatSamples(audioData, format: metadata.format)
-
-                // Run Whisper inference (whisper.cpp handles mel spectrogram internally)
-                let text = try self.runWhisperInference(audioSamples)
+                let session = try self.activeSession()
 
-                // Extract tokens for streaming if needed
-                var tokens: [String] = []
-                if self.settings.streamingEnabled, let context = self.modelLoader.getContext() {
-                    tokens = self.extractTokens(from: context)
-                }
-
-                // Calculate processing time
-                let processingTimeMs = Int(Date().timeIntervalSince(startTime) * 1000)
-
-                // Send streaming update if enabled
-                if self.settings.streamingEnabled && !tokens.isEmpty {
-                    let tokenUpdate = TokenUpdate(
-                        tokens: tokens,
-                        text: text,
-                        sessionId: sessionId
-                    )
-                    self.onTokenUpdate?(tokenUpdate)
-                }
-
-                // If this is the last chunk, send final result
-                if metadata.isLastChunk {
-                    let result = TranscriptionResult(
-                        text: text,
-                        isFinal: true,
-                        sessionId: sessionId,
-                        processingTimeMs: processingTimeMs,
-                        confidence: nil
-                    )
-                    self.onTranscriptionComplete?(result)
-                    self.isProcessing = false
-                    self.currentSessionId = nil
-                }
-
-                print("[InferenceEngine] Processed chunk \(metadata.chunkId) in \(processingTimeMs)ms: \"\(text)\"")
+                // The job keeps the samples mapped until the session reports back
+                let job = PipelineJob(samples: samples, metadata: metadata, startTime: Date(), completion: completion)
+                // May block while the pipeline or the session's result channel is full
+                session.submit(samples.unsafeSpan, job: job, isLast: metadata.isLastChunk)
 
             } catch {
                 let errorMsg = ErrorMessage(
@@ -124,14 +132,91 @@ class InferenceEngine {
                     sessionId: sessionId,
                     isRecoverable: true
                 )
-                self.onError?(errorMsg)
+                self.eventContinuation.yield(.error(errorMsg))
                 print("[InferenceEngine] Error processing chunk: \(error)")
+                completion?()
             }
         }
     }
 
+    /// Handle a chunk's result (session task)
+    private func finishChunk(_ event: TranscriptionSession.Event, in session: TranscriptionSession) {
+        let job = event.job
+        defer { job.completion?() }
+
+        let metadata = job.metadata
+        let sessionId = metadata.sessionId
+
+        guard !session.isCancelled else {
+            print("[InferenceEngine] Dropped stale chunk \(metadata.chunkId)")
+            return
+        }
+
+        guard event.status != WB_PIPELINE_FAILED else {
+            let errorMsg = ErrorMessage(
+                errorType: .inferenceFailed,
+                description: InferenceError.inferenceFailed.localizedDescription,
+                sessionId: sessionId,
+                isRecoverable: true
+            )
+            eventContinuation.yield(.error(errorMsg))
+            print("[InferenceEngine] Error processing chunk \(metadata.chunkId)")
+            return
+        }
+
+        let settings = self.settings
+
+        // Apply punctuation mode if needed (silent chunks have no text)
+        let text = session.textPost.process(event.text, mode: settings.punctuationMode)
+
+        // Calculate processing time (submit → result, including time queued between stages)
+        let processingTimeMs = Int(Date().timeIntervalSince(job.startTime) * 1000)
+
+        if event.isRunaway {
+            print("[InferenceEngine] Cut repetition loop in chunk \(metadata.chunkId)")
+        }
+
+        // Send streaming update if enabled (draft text until refined in two-pass mode)
+        if settings.streamingEnabled && !event.tokens.isEmpty {
+            let tokenUpdate = TokenUpdate(
+                tokens: event.tokens,
+                text: text,
+                sessionId: sessionId,
+                isTentative: session.refinement != nil
+            )
+            eventContinuation.yield(.tokenUpdate(tokenUpdate))
+        }
+
+        if let refinement = session.refinement {
+            refine(event, draft: text, in: session, refinement: refinement)
+            print("[InferenceEngine] Drafted chunk \(metadata.chunkId) in \(processingTimeMs)ms: \"\(text)\"")
+            return
+        }
+
+        // If this is the last chunk, send final result
+        if event.isLast {
+            let result = TranscriptionResult(
+                text: text,
+                isFinal: true,
+                sessionId: sessionId,
+                processingTimeMs: processingTimeMs,
+                confidence: event.confidence
+            )
+            eventContinuation.yield(.transcriptionComplete(result))
+            sessionDidFinish(session)
+        }
+
+        print("[InferenceEngine] Processed chunk \(metadata.chunkId) in \(processingTimeMs)ms: \"\(text)\"")
+    }
+
     /// Cancel the current transcription session
     func cancelSession() {
+        // Abort running decodes now; the queue may be blocked submitting to a full pipeline
+        sessionLock.lock()
+        let session = self.session
+        sessionLock.unlock()
+        session?.cancel()
+
         inferenceQueue.async { [weak self] in
             guard let self = self else { return }
 
@@ -139,77 +224,244 @@ class InferenceEngine {
                 print("[InferenceEngine] Cancelled session: \(sessionId)")
             }
 
+            // Chunks still in flight complete as dropped; published results stay
+            self.replaceSession(with: nil)
+
             self.isProcessing = false
             self.currentSessionId = nil
         }
     }
 
-    /// Update settings
-    func updateSettings(_ newSettings: WhisperBoardSettings) {
-        inferenceQueue.async { [weak self] in
-            self?.settings = newSettings
-            print("[InferenceEngine] Settings updated")
+    // MARK: - Sessions
+
+    /// Native session for the current dictation, opened on the current pipeline (inference queue)
+    private func activeSession() throws -> TranscriptionSession {
+        let pipeline = try activePipeline()
+
+        if let session = session, session.pipeline == pipeline {
+            return session
         }
-    }
 
-    // MARK: - Audio Processing
+        guard let opened = TranscriptionSession(pipeline: pipeline, refinement: refiner.map(Refinement.init)) else {
+            throw InferenceError.inferenceFailed
+        }
+        replaceSession(with: opened)
+        consume(opened)
+        return opened
+    }
 
-    /// Convert audio data to Float samples
-    private func convertToFloatSamples(_ data: Data, format: AudioChunkMetadata.AudioFormat) throws -> [Float] {
-        switch format {
-        case .pcm16:
-            return try convertPCM16ToFloat(data)
-        case .float32:
-            return try convertDataToFloatArray(data)
+    /// Swap the native session, cancelling the old one unless it ended normally.
+    /// The old session's task drains what it has and finishes on its own.
+    /// The engine holds the live class on the shared pool from startSession until the session is let go.
+    private func replaceSession(with session: TranscriptionSession?, cancel: Bool = true) {
+        sessionLock.lock()
+        let old = self.session
+        self.session = session
+        sessionLock.unlock()
+
+        if let old = old, cancel {
+            old.cancel()
+        }
+        if session == nil && (old != nil || isProcessing) {
+            WorkScheduler.shared.endLiveSession()
         }
     }
 
-    /// Convert 16-bit PCM to Float array [-1.0, 1.0]
-    private func convertPCM16ToFloat(_ data: Data) throws -> [Float] {
-        let sampleCount = data.count / 2
-        var floatSamples = [Float](repeating: 0, count: sampleCount)
+    /// Await the session's results until it ends: one task per session, no queue hops per result
+    private func consume(_ session: TranscriptionSession) {
+        Task.detached(priority: .userInitiated) { [weak self] in
+            while let event = await session.next() {
+                guard let self = self else {
+                    if event.status != WB_PIPELINE_TENTATIVE {
+                        event.job.completion?()
+                    }
+                    continue
+                }
 
-        data.withUnsafeBytes { rawBuffer in
-            guard let int16Buffer = rawBuffer.baseAddress?.assumingMemoryBound(to: Int16.self) else {
-                return
+                if event.status == WB_PIPELINE_TENTATIVE {
+                    self.showTentative(event, in: session)
+                } else {
+                    self.finishChunk(event, in: session)
+                }
             }
+        }
+    }
 
-            for i in 0..<sampleCount {
-                floatSamples[i] = Float(int16Buffer[i]) / 32768.0
-            }
+    /// The session's final result is out: let it go unless a newer one replaced it
+    private func sessionDidFinish(_ session: TranscriptionSession) {
+        inferenceQueue.async { [weak self] in
+            guard let self = self, self.session === session else { return }
+            self.isProcessing = false
+            self.currentSessionId = nil
+            self.replaceSession(with: nil, cancel: false)
+            self.logFallbackStats()
         }
+    }
 
-        return floatSamples
+    /// Temperature retries so far (counts are per pipeline, cumulative)
+    private func logFallbackStats() {
+        guard let pipeline = pipeline else { return }
+        var stats = wb_fallback_stats()
+        wb_pipeline_fallback_stats(pipeline, &stats)
+        let buckets = withUnsafeBytes(of: stats.chunks_by_retries) { Array($0.bindMemory(to: UInt64.self)) }
+        print("[InferenceEngine] Fallback retries per chunk \(buckets), budget stops \(stats.budget_stops), deadline aborts \(stats.deadline_aborts)")
     }
 
-    /// Convert Data to Float array
-    private func convertDataToFloatArray(_ data: Data) throws -> [Float] {
-        let sampleCount = data.count / 4
-        var floatSamples = [Float](repeating: 0, count: sampleCount)
+    // MARK: - Two-Pass Refinement
 
-        data.withUnsafeBytes { rawBuffer in
-            guard let floatBuffer = rawBuffer.baseAddress?.assumingMemoryBound(to: Float.self) else {
-                return
+    /// Hand a drafted chunk to the main model (session task). A pause refines the speech before it
+    /// as tentative work; the last chunk refines the rest as live work and publishes the final result.
+    private func refine(_ event: TranscriptionSession.Event, draft: String, in session: TranscriptionSession, refinement: Refinement) {
+        let job = event.job
+        let isSilent = event.status == WB_PIPELINE_SILENT
+
+        refinement.refiner.queue.async { [weak self] in
+            guard let self = self else { return }
+
+            if !isSilent {
+                refinement.append(job, draft: draft, confidence: event.confidence)
             }
 
-            for i in 0..<sampleCount {
-                floatSamples[i] = floatBuffer[i]
+            if event.isLast {
+                self.runRefinement(refinement, in: session, priority: .live)
+                guard !session.isCancelled else { return }
+
+                let result = TranscriptionResult(
+                    text: refinement.text,
+                    isFinal: true,
+                    sessionId: job.metadata.sessionId,
+                    processingTimeMs: Int(Date().timeIntervalSince(job.startTime) * 1000),
+                    confidence: refinement.confidence
+                )
+                self.eventContinuation.yield(.transcriptionComplete(result))
+                self.sessionDidFinish(session)
+                print("[InferenceEngine] Refined session in \(result.processingTimeMs)ms: \"\(result.text)\"")
+
+            } else if (isSilent && refinement.hasPending) || refinement.pendingSeconds >= WhisperBoardConfig.Refine.maxSpanSeconds {
+                guard self.runRefinement(refinement, in: session, priority: .tentative),
+                      self.settings.streamingEnabled, !session.isCancelled else { return }
+
+                let update = TokenUpdate(tokens: [], text: refinement.text, sessionId: job.metadata.sessionId)
+                self.eventContinuation.yield(.tokenUpdate(update))
             }
         }
+    }
+
+    /// Re-decode the pending spans with the main model (refine queue). Returns false if it was
+    /// preempted or cancelled; the spans then stay pending. A failed pass keeps the draft text.
+    @discardableResult
+    private func runRefinement(_ refinement: Refinement, in session: TranscriptionSession, priority: WorkPriority) -> Bool {
+        guard refinement.hasPending else { return true }
+
+        // The draft model is sure of this speech already; a main-model pass would cost cores for the same text
+        if refinement.isDraftConfident {
+            refinement.commitDraft()
+            print("[InferenceEngine] Kept confident draft without refinement")
+            return true
+        }
+
+        let spans = refinement.pendingSpans
+        var bases = spans.map { $0.baseAddress }
+        var counts = spans.map { $0.count }
 
-        return floatSamples
+        let status = withFullParams { params -> Int32 in
+            // Only the final pass is worth a beam search; tentative ones may be redone anyway
+            if priority == .live && WhisperBoardConfig.Refine.finalBeamSize > 1 {
+                params.strategy = WHISPER_SAMPLING_BEAM_SEARCH
+                params.beam_search.beam_size = Int32(WhisperBoardConfig.Refine.finalBeamSize)
+                params.beam_search.patience = WhisperBoardConfig.Refine.beamPatience
+            }
+            return wb_refiner_run(refinement.refiner.handle, &params, &bases, &counts, Int32(spans.count), priority.native, session.token)
+        }
+
+        switch status {
+        case 0:
+            let text = refinement.textPost.process(String(cString: wb_refiner_text(refinement.refiner.handle)), mode: settings.punctuationMode)
+            refinement.commit(text, confidence: transcriptionConfidence(wb_refiner_confidence(refinement.refiner.handle)))
+            return true
+        case 1:
+            return false
+        default:
+            print("[InferenceEngine] Refinement failed, keeping draft text")
+            refinement.commitDraft()
+            return true
+        }
+    }
+
+    /// Update settings
+    func updateSettings(_ newSettings: WhisperBoardSettings) {
+        inferenceQueue.async { [weak self] in
+            guard let self = self else { return }
+
+            self.settingsLock.lock()
+            self._settings = newSettings
+            self.settingsLock.unlock()
+
+            // Applies to chunks that have not reached the infer stage yet
+            if let pipeline = self.pipeline {
+                self.withFullParams { params in
+                    wb_pipeline_set_full_params(pipeline, &params)
+                }
+                wb_pipeline_set_speculation(pipeline, self.speculativeMaxTokens)
+            }
+
+            print("[InferenceEngine] Settings updated")
+        }
     }
 
     // MARK: - Whisper Inference
 
-    /// Run Whisper inference directly on audio samples
-    /// whisper.cpp handles mel spectrogram generation internally
-    private func runWhisperInference(_ samples: [Float]) throws -> String {
+    /// Pipeline for the current model context, rebuilt if the model was reloaded
+    private func activePipeline() throws -> OpaquePointer {
         guard let context = modelLoader.getContext() else {
             throw InferenceError.modelNotLoaded
         }
+        // Two-pass mode streams with the draft model
+        let liveContext = modelLoader.getDraftContext() ?? context
+
+        if let pipeline = pipeline, pipelineContext == liveContext {
+            return pipeline
+        }
 
-        // Setup inference parameters
+        if let stale = pipeline {
+            // Its chunks complete as dropped; the session is reopened on the new pipeline
+            wb_pipeline_free(stale)
+            pipeline = nil
+            pipelineContext = nil
+        }
+
+        var pipelineParams = wb_pipeline_default_params()
+        pipelineParams.n_states = 2  // mel of the next chunk overlaps decode of this one
+        pipelineParams.mel_threads = 2
+        pipelineParams.vad_rms_threshold = WhisperBoardConfig.Inference.vadRmsThreshold
+        pipelineParams.speculative_max_tokens = speculativeMaxTokens
+        pipelineParams.speculative_window_ms = Int32(WhisperBoardConfig.Inference.speculativeWindowMs)
+        pipelineParams.deadline_ms = Int32(WhisperBoardConfig.Scheduler.liveDeadlineMs)
+        pipelineParams.on_result = wb_session_pipeline_result
+
+        let created = withFullParams { params in
+            wb_pipeline_init(liveContext, &params, pipelineParams)
+        }
+
+        guard let created = created else {
+            throw InferenceError.inferenceFailed
+        }
+
+        pipeline = created
+        pipelineContext = liveContext
+        refiner = liveContext != context ? Refiner(context: context) : nil
+        print("[InferenceEngine] Created inference pipeline\(refiner != nil ? " (two-pass)" : "")")
+
+        return created
+    }
+
+    /// Tentative text is only useful when streaming updates are shown
+    private var speculativeMaxTokens: Int32 {
+        settings.streamingEnabled ? Int32(WhisperBoardConfig.Inference.speculativeMaxTokens) : 0
+    }
+
+    /// Build whisper.cpp parameters from settings (the pipeline copies the language string)
+    private func withFullParams<R>(_ body: (inout whisper_full_params) -> R) -> R {
         var params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY)
         params.n_threads = 4
         params.translate = false
@@ -218,101 +470,334 @@ class InferenceEngine {
         params.print_special = false
         params.print_realtime = false
         params.print_timestamps = false
-        params.token_timestamps = settings.streamingEnabled
-        params.speed_up = true  // Enable speed optimization
+        params.token_timestamps = false  // needs raw samples; the pipeline decodes a precomputed mel
+        params.speed_up = false          // only applies when whisper.cpp computes the mel itself
         params.suppress_blank = true
         params.suppress_non_speech_tokens = true
+        params.detect_language = false
 
-        // Set language (nil = auto-detect)
-        if let language = settings.language {
-            params.language = language.withCString { strdup($0) }
-            params.detect_language = false
-        } else {
-            params.language = "en".withCString { strdup($0) }  // Default to English
-            params.detect_language = false
-        }
+        // Set language (nil = default to English)
+        let language = settings.language ?? "en"
 
-        // Run inference
-        var samplesCopy = samples  // Make mutable copy
-        let result = whisper_full(context, params, &samplesCopy, Int32(samples.count))
+        return language.withCString { languagePtr in
+            params.language = languagePtr
+            return body(&params)
+        }
+    }
 
-        // Free allocated language string
-        if let langPtr = params.language {
-            free(UnsafeMutableRawPointer(mutating: langPtr))
+    /// Speculative text for a chunk still in the pipeline (session task)
+    private func showTentative(_ event: TranscriptionSession.Event, in session: TranscriptionSession) {
+        let job = event.job
+        let settings = self.settings
+        guard settings.streamingEnabled, !event.tokens.isEmpty, !session.isCancelled else {
+            return
         }
 
-        if result != 0 {
-            throw InferenceError.inferenceFailed
+        // Not committed: the chunk's final text replaces it
+        let text = session.textPost.process(event.text, mode: settings.punctuationMode, commit: false)
+
+        let update = TokenUpdate(tokens: event.tokens, text: text, sessionId: job.metadata.sessionId, isTentative: true)
+        eventContinuation.yield(.tokenUpdate(update))
+
+        let latencyMs = Int(Date().timeIntervalSince(job.startTime) * 1000)
+        print("[InferenceEngine] Tentative text for chunk \(job.metadata.chunkId) after \(latencyMs)ms")
+    }
+
+    // MARK: - Status
+
+    /// Get current processing status
+    func getStatus() -> AppStatus {
+        return inferenceQueue.sync {
+            AppStatus(
+                isModelLoaded: modelLoader.isLoaded,
+                isProcessing: isProcessing,
+                currentSessionId: currentSessionId,
+                modelVariant: "small-q5_1",
+                memoryUsageMB: modelLoader.estimatedMemoryUsageMB
+            )
         }
+    }
+}
 
-        // Extract transcription text from all segments
-        var fullText = ""
-        let nSegments = whisper_full_n_segments(context)
+// MARK: - Events
 
-        for i in 0..<nSegments {
-            if let segmentText = whisper_full_get_segment_text(context, Int32(i)) {
-                let text = String(cString: segmentText)
-                fullText += text
-            }
+/// What the engine publishes on `events`
+enum InferenceEvent {
+    case tokenUpdate(TokenUpdate)
+    case transcriptionComplete(TranscriptionResult)
+    case error(ErrorMessage)
+}
+
+// MARK: - Session Plumbing
+
+/// A chunk in flight through the pipeline (retained until its result arrives)
+fileprivate final class PipelineJob {
+    let samples: PCMSamples
+    let metadata: AudioChunkMetadata
+    let startTime: Date
+    let completion: (() -> Void)?
+
+    init(samples: PCMSamples, metadata: AudioChunkMetadata, startTime: Date, completion: (() -> Void)?) {
+        self.samples = samples
+        self.metadata = metadata
+        self.startTime = startTime
+        self.completion = completion
+    }
+}
+
+/// One dictation session's native result channel (wb_session), awaited with `next()`
+fileprivate final class TranscriptionSession {
+
+    /// A result copied out of the native event
+    struct Event {
+        let status: wb_pipeline_status
+        let isLast: Bool
+        let text: String
+        let tokens: [String]
+        /// Decode was cut at a repetition loop; the text is low-confidence
+        let isRunaway: Bool
+        /// 0-1 from token probabilities; nil without text
+        let confidence: Double?
+        let job: PipelineJob
+    }
+
+    let pipeline: OpaquePointer
+    /// Main-model pass over this session's speech (two-pass mode only)
+    let refinement: Refinement?
+    /// Punctuation mode for the live chunk text, in chunk order (session task only)
+    let textPost = TextPostProcessor()
+    private let handle: OpaquePointer
+
+    init?(pipeline: OpaquePointer, refinement: Refinement?) {
+        var params = wb_session_default_params()
+        params.capacity = Int32(WhisperBoardConfig.Inference.sessionResultCapacity)
+        params.release_user_data = releasePipelineJob
+
+        guard let handle = wb_session_open(pipeline, params) else {
+            return nil
         }
+        self.pipeline = pipeline
+        self.refinement = refinement
+        self.handle = handle
+    }
 
-        // Apply punctuation mode if needed
-        fullText = applyPunctuationMode(fullText, mode: settings.punctuationMode)
+    deinit {
+        wb_session_close(handle)
+    }
 
-        return fullText.trimmingCharacters(in: .whitespaces)
+    var isCancelled: Bool {
+        wb_session_is_cancelled(handle)
     }
 
-    /// Extract tokens from whisper context (for streaming)
-    private func extractTokens(from context: UnsafeMutablePointer<whisper_context>) -> [String] {
-        var tokens: [String] = []
+    /// Cancellation token (borrowed; valid while this object lives)
+    var token: OpaquePointer? {
+        wb_session_token(handle)
+    }
+
+    /// Queue a chunk; the job is retained until its result is taken or released
+    func submit(_ span: (baseAddress: UnsafePointer<Float>?, count: Int), job: PipelineJob, isLast: Bool) {
+        wb_session_submit(handle, span.baseAddress, span.count, Unmanaged.passRetained(job).toOpaque(), isLast)
+    }
+
+    /// Any thread; chunks still in flight are dropped and the session ends once they drain
+    func cancel() {
+        wb_session_cancel(handle)
+    }
+
+    /// Next result, or nil once the session has ended. Only one caller at a time.
+    func next() async -> Event? {
+        while true {
+            var event = wb_session_event()
+            let status = wb_session_next(handle, &event)
+            if status > 0 {
+                return Event(event)
+            }
+            if status < 0 {
+                return nil
+            }
 
-        let nSegments = whisper_full_n_segments(context)
-        for i in 0..<nSegments {
-            let nTokens = whisper_full_n_tokens(context, Int32(i))
-            for j in 0..<nTokens {
-                if let tokenText = whisper_full_get_token_text(context, Int32(i), Int32(j)) {
-                    tokens.append(String(cString: tokenText))
+            await withCheckedContinuation { (continuation: CheckedContinuation<Void, Never>) in
+                let waiter = Unmanaged.passRetained(SessionWaiter(continuation)).toOpaque()
+                if !wb_session_await_next(handle, resumeSessionWaiter, waiter) {
+                    Unmanaged<SessionWaiter>.fromOpaque(waiter).takeRetainedValue().continuation.resume()
                 }
             }
         }
+    }
+}
+
+fileprivate extension TranscriptionSession.Event {
+    /// Copy out of the native event (its pointers die with the next call); takes the job's
+    /// reference unless the result is tentative, which only borrows it
+    init(_ event: wb_session_event) {
+        status = wb_pipeline_status(rawValue: UInt32(bitPattern: event.status))
+        isLast = event.is_last
+        text = event.text.map { String(cString: $0) } ?? ""
 
-        return tokens
+        var tokens: [String] = []
+        if let tokenTexts = event.tokens {
+            for i in 0..<Int(event.n_tokens) {
+                if let token = tokenTexts[i] {
+                    tokens.append(String(cString: token))
+                }
+            }
+        }
+        self.tokens = tokens
+        isRunaway = event.runaway
+        confidence = transcriptionConfidence(event.confidence)
+
+        let unmanagedJob = Unmanaged<PipelineJob>.fromOpaque(event.user_data!)
+        job = status == WB_PIPELINE_TENTATIVE ? unmanagedJob.takeUnretainedValue() : unmanagedJob.takeRetainedValue()
     }
+}
 
-    /// Apply punctuation mode to text
-    private func applyPunctuationMode(_ text: String, mode: WhisperBoardSettings.PunctuationMode) -> String {
-        switch mode {
-        case .auto:
-            return text  // Whisper handles punctuation
-        case .none:
-            return removePunctuation(text)
-        case .sentence:
-            return capitalizeSentences(removePunctuation(text))
+/// Main-model refiner (wb_refiner) and the serial queue its passes run on
+fileprivate final class Refiner {
+    let handle: OpaquePointer
+    let queue = DispatchQueue(label: "com.whisperboard.refine", qos: .userInitiated)
+
+    init?(context: UnsafeMutablePointer<whisper_context>) {
+        guard let handle = wb_refiner_create(context, 2) else {
+            return nil
         }
+        self.handle = handle
     }
 
-    private func removePunctuation(_ text: String) -> String {
-        return text.components(separatedBy: CharacterSet.punctuationCharacters).joined(separator: " ")
+    deinit {
+        wb_refiner_free(handle)
     }
+}
 
-    private func capitalizeSentences(_ text: String) -> String {
-        return text.capitalized
+/// One session's speech on its way through the second pass (touched on the refiner's queue only)
+fileprivate final class Refinement {
+    let refiner: Refiner
+    /// Punctuation mode for the refined text, pass after pass
+    let textPost = TextPostProcessor()
+
+    /// Drafted chunks since the last pass; holding the jobs keeps their samples mapped
+    private var pending: [PipelineJob] = []
+    private var pendingDrafts: [String] = []
+    private var pendingSamples = 0
+    /// Lowest draft confidence among the pending chunks (drafts without one count as 0)
+    private var pendingConfidence = 1.0
+    /// Text of each finished pass
+    private var committed: [String] = []
+    private var committedConfidence: Double?
+
+    init(refiner: Refiner) {
+        self.refiner = refiner
     }
 
-    // MARK: - Status
+    var hasPending: Bool {
+        !pending.isEmpty
+    }
 
-    /// Get current processing status
-    func getStatus() -> AppStatus {
-        return inferenceQueue.sync {
-            AppStatus(
-                isModelLoaded: modelLoader.isLoaded,
-                isProcessing: isProcessing,
-                currentSessionId: currentSessionId,
-                modelVariant: "small-q5_1",
-                memoryUsageMB: modelLoader.estimatedMemoryUsageMB
-            )
+    var pendingSeconds: Double {
+        Double(pendingSamples) / 16_000
+    }
+
+    var pendingSpans: [(baseAddress: UnsafePointer<Float>?, count: Int)] {
+        pending.map { $0.samples.unsafeSpan }
+    }
+
+    /// Every pending draft clears WhisperBoardConfig.Refine.skipConfidence
+    var isDraftConfident: Bool {
+        hasPending && pendingConfidence >= WhisperBoardConfig.Refine.skipConfidence
+    }
+
+    /// Everything refined so far
+    var text: String {
+        committed.filter { !$0.isEmpty }.joined(separator: " ")
+    }
+
+    /// Lowest confidence of the passes so far (nil while none has one)
+    var confidence: Double? {
+        committedConfidence
+    }
+
+    func append(_ job: PipelineJob, draft: String, confidence: Double?) {
+        pending.append(job)
+        pendingDrafts.append(draft)
+        pendingSamples += job.samples.count
+        pendingConfidence = min(pendingConfidence, confidence ?? 0)
+    }
+
+    /// The pending spans were refined to `text`
+    func commit(_ text: String, confidence: Double?) {
+        committed.append(text)
+        if let confidence = confidence {
+            committedConfidence = min(committedConfidence ?? 1, confidence)
         }
+        pending.removeAll()
+        pendingDrafts.removeAll()
+        pendingSamples = 0
+        pendingConfidence = 1
     }
+
+    /// The spans keep their draft text: the pass failed or was not worth running
+    func commitDraft() {
+        let drafts = pendingDrafts.filter { !$0.isEmpty }
+        commit(drafts.joined(separator: " "), confidence: drafts.isEmpty ? nil : pendingConfidence)
+    }
+}
+
+/// Native punctuation mode and whitespace clean-up (wb_text_post). Each piece continues the
+/// text committed before it, so a sentence ending in one chunk capitalises the next.
+fileprivate final class TextPostProcessor {
+    private let handle: OpaquePointer
+
+    init() {
+        handle = wb_text_post_create()
+    }
+
+    deinit {
+        wb_text_post_free(handle)
+    }
+
+    /// Cleaned `text`, trimmed; `commit` = false for text that will be replaced
+    func process(_ text: String, mode: WhisperBoardSettings.PunctuationMode, commit: Bool = true) -> String {
+        text.withCString { bytes in
+            String(cString: wb_text_post_append(handle, mode.native, bytes, strlen(bytes), commit))
+        }
+    }
+}
+
+fileprivate extension WhisperBoardSettings.PunctuationMode {
+    var native: Int32 {
+        switch self {
+        case .auto: return Int32(WB_TEXT_AUTO.rawValue)
+        case .none: return Int32(WB_TEXT_NONE.rawValue)
+        case .sentence: return Int32(WB_TEXT_SENTENCE.rawValue)
+        }
+    }
+}
+
+/// Native confidence (< 0 when there is no text) as TranscriptionResult carries it
+private func transcriptionConfidence(_ value: Float) -> Double? {
+    value >= 0 ? Double(value) : nil
+}
+
+/// Continuation parked in wb_session_await_next
+fileprivate final class SessionWaiter {
+    let continuation: CheckedContinuation<Void, Never>
+
+    init(_ continuation: CheckedContinuation<Void, Never>) {
+        self.continuation = continuation
+    }
+}
+
+/// C callback: a result (or the end) is ready for the parked `next()`
+private let resumeSessionWaiter: wb_session_wake_fn = { data in
+    guard let data = data else { return }
+    Unmanaged<SessionWaiter>.fromOpaque(data).takeRetainedValue().continuation.resume()
+}
+
+/// C callback: a chunk ended without the session task seeing it (dropped, cancelled, closed)
+private let releasePipelineJob: wb_session_release_fn = { userData in
+    guard let userData = userData else { return }
+    let job = Unmanaged<PipelineJob>.fromOpaque(userData).takeRetainedValue()
+    print("[InferenceEngine] Dropped stale chunk \(job.metadata.chunkId)")
+    job.completion?()
 }
 
 // MARK: - Errors
@@ -4,9 +4,11 @@
 //
 //  Handles loading and lifecycle management of Whisper-small Q5_1 model
 //  Implements memory-safe model warming and context reuse
+//  In two-pass mode a tiny model is loaded beside it to drive the live text
 //
 
 import Foundation
+import os
 
 /// Model loader responsible for initializing Whisper model and managing its lifecycle
 class ModelLoader {
@@ -15,8 +17,15 @@ class ModelLoader {
 
     private var whisperContext: UnsafeMutablePointer<whisper_context>?
     private var isModelLoaded = false
+
+    /// Tiny model for live text in two-pass mode (nil when single-model)
+    private var draftContext: UnsafeMutablePointer<whisper_context>?
     private let modelQueue = DispatchQueue(label: "com.whisperboard.modelloader", qos: .userInitiated)
 
+    /// Background warmups in flight (unloading cancels them and waits)
+    private var warmupToken: OpaquePointer?
+    private let warmupGroup = DispatchGroup()
+
     /// Singleton instance
     static let shared = ModelLoader()
 
@@ -24,6 +33,8 @@ class ModelLoader {
     struct ModelConfig {
         let modelPath: String
         let variant: ModelVariant
+        /// Streams live text while `variant` refines it (two-pass mode); nil = single model
+        let draftVariant: ModelVariant?
         let useGPU: Bool
         let numThreads: Int
 
@@ -31,6 +42,7 @@ class ModelLoader {
             ModelConfig(
                 modelPath: "",  // Will be set from bundle
                 variant: .smallQ5_1,
+                draftVariant: WhisperBoardConfig.Refine.enabled ? .tinyQ5 : nil,
                 useGPU: true,
                 numThreads: 4
             )
@@ -41,7 +53,7 @@ class ModelLoader {
         case smallQ5_1 = "ggml-small-q5_1"
         case smallQ4 = "ggml-small-q4_0"
         case smallQ8 = "ggml-small-q8_0"
-        case tinyQ5 = "ggml-tiny-q5_1"  // Fallback for low-memory devices
+        case tinyQ5 = "ggml-tiny-q5_1"  // Fallback for low-memory devices; live text in two-pass mode
 
         var expectedMemoryMB: Int {
             switch self {
@@ -88,15 +100,8 @@ class ModelLoader {
             print("[ModelLoader] Expected memory: \(modelConfig.variant.expectedMemoryMB) MB")
             print("[ModelLoader] Peak memory: \(modelConfig.variant.expectedPeakMemoryMB) MB")
 
-            // Initialize Whisper context with parameters
-            var contextParams = whisper_context_default_params()
-            contextParams.use_gpu = modelConfig.useGPU
-            contextParams.gpu_device = 0  // Use first GPU (Metal)
-
             // Initialize context
-            whisperContext = modelPath.withCString { pathPtr in
-                whisper_init_from_file_with_params(pathPtr, contextParams)
-            }
+            whisperContext = initContext(path: modelPath, useGPU: modelConfig.useGPU)
 
             guard let context = whisperContext else {
                 throw ModelLoaderError.modelLoadFailed("Failed to initialize Whisper context. Check model file integrity.")
@@ -111,48 +116,93 @@ class ModelLoader {
             isModelLoaded = true
             print("[ModelLoader] ✓ Model loaded successfully")
 
-            // Warm up the model with a dummy inference
-            try warmupModel()
+            // Warm up the model with a dummy inference, in the background
+            scheduleWarmup(context, numThreads: modelConfig.numThreads)
+
+            if let draftVariant = modelConfig.draftVariant {
+                loadDraftModel(draftVariant, config: modelConfig)
+            }
         }
     }
 
-    /// Warm up the model with a dummy inference to reduce cold-start latency
-    private func warmupModel() throws {
-        guard let context = whisperContext else {
-            throw ModelLoaderError.modelLoadFailed("Context not initialized")
+    /// Two-pass mode: load the tiny model too, if both fit the memory budget.
+    /// Failing here is not an error; the main model then drives the live text alone. Called on the model queue.
+    private func loadDraftModel(_ variant: ModelVariant, config: ModelConfig) {
+        let combinedPeakMB = config.variant.expectedPeakMemoryMB + variant.expectedPeakMemoryMB
+        let availableMB = Int(os_proc_available_memory() / 1024 / 1024)
+
+        guard combinedPeakMB <= WhisperBoardConfig.Refine.memoryBudgetMB,
+              availableMB >= variant.expectedPeakMemoryMB + WhisperBoardConfig.Refine.memoryHeadroomMB else {
+            print("[ModelLoader] Two-pass mode off: \(combinedPeakMB) MB peak, \(availableMB) MB available")
+            return
         }
 
-        print("[ModelLoader] Warming up model...")
-
-        // Create a silent audio buffer (1 second of silence at 16kHz)
-        let sampleRate = 16000
-        let duration = 1.0
-        let numSamples = Int(Double(sampleRate) * duration)
-        var silentBuffer = [Float](repeating: 0.0, count: numSamples)
-
-        // Get default parameters for inference
-        var params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY)
-        params.n_threads = 4
-        params.language = "en".withCString { strdup($0) }  // English
-        params.translate = false
-        params.print_progress = false
-        params.print_special = false
-        params.print_realtime = false
-        params.print_timestamps = false
-
-        // Run warmup inference
-        let result = whisper_full(context, params, &silentBuffer, Int32(numSamples))
-
-        // Free allocated language string
-        if let langPtr = params.language {
-            free(UnsafeMutableRawPointer(mutating: langPtr))
+        guard let path = try? getModelPath(for: variant),
+              let context = initContext(path: path, useGPU: config.useGPU) else {
+            print("[ModelLoader] Two-pass mode off: \(variant.rawValue) not available")
+            return
         }
 
-        if result != 0 {
-            print("[ModelLoader] ⚠️ Warmup inference returned code: \(result)")
+        draftContext = context
+        print("[ModelLoader] ✓ Draft model \(variant.rawValue) loaded for live text")
+
+        scheduleWarmup(context, numThreads: config.numThreads)
+    }
+
+    /// Create a whisper context for a model file
+    private func initContext(path: String, useGPU: Bool) -> UnsafeMutablePointer<whisper_context>? {
+        // Initialize Whisper context with parameters
+        var contextParams = whisper_context_default_params()
+        contextParams.use_gpu = useGPU
+        contextParams.gpu_device = 0  // Use first GPU (Metal)
+
+        return path.withCString { pathPtr in
+            whisper_init_from_file_with_params(pathPtr, contextParams)
         }
+    }
 
-        print("[ModelLoader] ✓ Model warmed up")
+    /// Warm up the model with a dummy inference to reduce cold-start latency
+    /// Background-class work on the shared pool (wb_pipeline_warmup): it waits for idle cores
+    /// and gives up as soon as a live session needs them, which then pays the cold start instead.
+    /// Runs off the model queue so getContext never waits for it. Called on the model queue.
+    private func scheduleWarmup(_ context: UnsafeMutablePointer<whisper_context>, numThreads: Int) {
+        if warmupToken == nil {
+            warmupToken = wb_cancel_token_create()
+        }
+        let token = wb_cancel_token_retain(warmupToken)
+        warmupGroup.enter()
+
+        // Not WorkScheduler.background: the native call polls the token while it waits its turn
+        DispatchQueue.global(qos: .utility).async { [warmupGroup] in
+            defer {
+                wb_cancel_token_release(token)
+                warmupGroup.leave()
+            }
+
+            print("[ModelLoader] Warming up model...")
+
+            var params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY)
+            params.n_threads = Int32(numThreads)
+            params.translate = false
+            params.print_progress = false
+            params.print_special = false
+            params.print_realtime = false
+            params.print_timestamps = false
+
+            let result = "en".withCString { languagePtr -> Int32 in
+                params.language = languagePtr  // copied by the native side
+                return wb_pipeline_warmup(context, &params, token)
+            }
+
+            switch result {
+            case 0:
+                print("[ModelLoader] ✓ Model warmed up")
+            case 1:
+                print("[ModelLoader] Warmup abandoned: live work needed the cores")
+            default:
+                print("[ModelLoader] ⚠️ Warmup inference failed")
+            }
+        }
     }
 
     /// Get the model file path from app bundle
@@ -184,10 +234,20 @@ class ModelLoader {
 
             print("[ModelLoader] Unloading model...")
 
+            // A warmup still running uses the context; stop it first
+            wb_cancel_token_cancel(warmupToken)
+            wb_cancel_token_release(warmupToken)
+            warmupToken = nil
+            warmupGroup.wait()
+
             // Free Whisper context
             whisper_free(context)
+            if let draft = draftContext {
+                whisper_free(draft)
+            }
 
             whisperContext = nil
+            draftContext = nil
             isModelLoaded = false
 
             print("[ModelLoader] ✓ Model unloaded")
@@ -229,6 +289,11 @@ class ModelLoader {
     func getContext() -> UnsafeMutablePointer<whisper_context>? {
         return modelQueue.sync { whisperContext }
     }
+
+    /// Tiny model context when two-pass mode is on, else nil
+    func getDraftContext() -> UnsafeMutablePointer<whisper_context>? {
+        return modelQueue.sync { draftContext }
+    }
 }
 
 // MARK: - Errors
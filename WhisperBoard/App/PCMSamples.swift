@@ -0,0 +1,65 @@
+//
+//  PCMSamples.swift
+//  WhisperBoard
+//
+//  Swift wrapper around the native chunk sample views (Native/wb_pcm_view)
+//  Replaces Data(contentsOf:) + [Float] conversion on the inference path
+//
+
+import Foundation
+
+/// Samples of one audio chunk, borrowed from the chunk file's mapping
+final class PCMSamples {
+
+    // MARK: - Properties
+
+    let format: AudioChunkMetadata.AudioFormat
+    private let handle: OpaquePointer
+
+    // MARK: - Initialization
+
+    /// Map a chunk file; the file can be deleted as soon as this returns
+    init?(url: URL, format: AudioChunkMetadata.AudioFormat) {
+        let nativeFormat: Int32
+        switch format {
+        case .float32:
+            nativeFormat = Int32(WB_PCM_FLOAT32.rawValue)
+        case .pcm16:
+            nativeFormat = Int32(WB_PCM_INT16.rawValue)
+        }
+
+        guard let handle = wb_pcm_view_open(url.path, nativeFormat) else {
+            return nil
+        }
+        self.format = format
+        self.handle = handle
+    }
+
+    deinit {
+        wb_pcm_view_close(handle)
+    }
+
+    // MARK: - Access
+
+    /// Size of the chunk file in bytes
+    var byteCount: Int {
+        wb_pcm_view_byte_count(handle)
+    }
+
+    /// Number of float samples
+    var count: Int {
+        wb_pcm_view_samples(handle).count
+    }
+
+    /// Sample buffers copied to build this view (0 for float32 chunks)
+    var copies: Int {
+        Int(wb_pcm_view_copies(handle))
+    }
+
+    /// Samples as a raw span. The mapping is fixed for the lifetime of this object,
+    /// so the pointer stays valid as long as the caller keeps the object alive.
+    var unsafeSpan: (baseAddress: UnsafePointer<Float>?, count: Int) {
+        let span = wb_pcm_view_samples(handle)
+        return (span.data, span.count)
+    }
+}
@@ -15,6 +15,9 @@ class TokenStream {
 
     private let streamQueue = DispatchQueue(label: "com.whisperboard.tokenstream", qos: .userInitiated)
 
+    /// Append-only journal for the session currently streaming
+    private var journal: JournalWriter?
+
     // MARK: - Initialization
 
     init() {
@@ -30,16 +33,11 @@ class TokenStream {
             do {
                 let updateData = try tokenUpdate.toJSONData()
 
-                // Write to transcriptions directory with timestamp
-                let fileName = "token_update_\(Int(Date().timeIntervalSince1970 * 1000)).json"
-
-                try AppGroups.writeData(
-                    updateData,
-                    to: fileName,
-                    in: AppGroups.Paths.transcriptions
-                )
+                // Append to the session journal (one write, sequence-numbered)
+                let journal = try self.journal(for: tokenUpdate.sessionId)
+                let seq = try journal.append(updateData, type: .tokenUpdate)
 
-                print("[TokenStream] Sent token update: \"\(tokenUpdate.text)\"")
+                print("[TokenStream] Sent token update #\(seq): \"\(tokenUpdate.text)\"")
 
             } catch {
                 print("[TokenStream] Failed to send token update: \(error)")
@@ -51,20 +49,18 @@ class TokenStream {
     /// - Parameter result: Transcription result to send
     func sendTranscriptionResult(_ result: TranscriptionResult) {
         streamQueue.async {
-            do {
-                let resultData = try result.toJSONData()
+            // Publish to the shared-memory slot (overwrites the previous result)
+            guard let sharedState = SharedState.shared else {
+                print("[TokenStream] Failed to send transcription result: shared state unavailable")
+                return
+            }
 
-                // Write to latest transcription file (overwrite)
-                try AppGroups.writeData(
-                    resultData,
-                    to: AppGroups.Files.latestTranscription,
-                    in: AppGroups.Paths.transcriptions
-                )
+            let generation = sharedState.publish(result)
 
-                print("[TokenStream] Sent final transcription: \"\(result.text)\" (isFinal: \(result.isFinal))")
+            print("[TokenStream] Sent final transcription #\(generation): \"\(result.text)\" (isFinal: \(result.isFinal))")
 
-            } catch {
-                print("[TokenStream] Failed to send transcription result: \(error)")
+            if result.isFinal {
+                self.finishJournal(sessionId: result.sessionId)
             }
         }
     }
@@ -91,37 +87,54 @@ class TokenStream {
         }
     }
 
+    // MARK: - Journal
+
+    /// Get (or open) the journal for a session, finishing any previous session's journal
+    private func journal(for sessionId: String) throws -> JournalWriter {
+        if let journal = journal, journal.sessionId == sessionId {
+            return journal
+        }
+
+        if let previous = journal {
+            finishJournal(sessionId: previous.sessionId)
+        }
+
+        guard let writer = JournalWriter(sessionId: sessionId) else {
+            throw AppGroupsError.writeFailed
+        }
+
+        journal = writer
+        return writer
+    }
+
+    /// Close and compact a session's journal (session end)
+    private func finishJournal(sessionId: String) {
+        if journal?.sessionId == sessionId {
+            journal = nil
+        }
+
+        let reclaimed = TokenJournal.compact(sessionId: sessionId)
+        if reclaimed > 0 {
+            print("[TokenStream] Compacted journal for \(sessionId), reclaimed \(reclaimed) bytes")
+        }
+    }
+
     // MARK: - Cleanup
 
     /// Clean up old transcription files (prevent accumulation)
+    /// Runs as background work, off the stream queue, stepping aside for live sessions
     func cleanupOldFiles() {
-        streamQueue.async {
-            do {
-                guard let transcriptionsPath = AppGroups.Paths.transcriptions else { return }
-
-                let fileManager = FileManager.default
-                let files = try fileManager.contentsOfDirectory(
-                    at: transcriptionsPath,
-                    includingPropertiesForKeys: [.contentModificationDateKey],
-                    options: [.skipsHiddenFiles]
-                )
+        WorkScheduler.shared.background { checkpoint in
+            guard let index = AppGroups.index(for: AppGroups.Paths.transcriptions) else { return }
 
-                // Delete files older than 5 minutes
-                let cutoffTime = Date().addingTimeInterval(-300)
+            // Delete files older than 5 minutes
+            let cutoffTime = Date().addingTimeInterval(-300)
 
-                for fileURL in files {
-                    guard let attributes = try? fileManager.attributesOfItem(atPath: fileURL.path),
-                          let modDate = attributes[.modificationDate] as? Date else {
-                        continue
-                    }
-
-                    if modDate < cutoffTime {
-                        try? fileManager.removeItem(at: fileURL)
-                    }
+            for (i, file) in index.entries(olderThan: cutoffTime).enumerated() {
+                if i > 0 && i % WhisperBoardConfig.Scheduler.maintenanceStepFiles == 0 {
+                    checkpoint()
                 }
-
-            } catch {
-                print("[TokenStream] Failed to cleanup old files: \(error)")
+                index.remove(file.name)
             }
         }
     }
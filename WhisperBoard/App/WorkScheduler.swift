@@ -0,0 +1,75 @@
+//
+//  WorkScheduler.swift
+//  WhisperBoard
+//
+//  Priority classes over the shared native pool (Native/wb_pool)
+//  Live dictation > tentative refinement > background maintenance. Maintenance
+//  runs as steps on a utility queue and waits at every step boundary while live
+//  or tentative work is active, so it only uses the gaps between sessions.
+//
+
+import Foundation
+
+/// Work classes, most urgent first (mirror wb_pool_priority)
+enum WorkPriority {
+    case live
+    case tentative
+    case background
+
+    var native: Int32 {
+        switch self {
+        case .live: return Int32(WB_PRIORITY_LIVE.rawValue)
+        case .tentative: return Int32(WB_PRIORITY_TENTATIVE.rawValue)
+        case .background: return Int32(WB_PRIORITY_BACKGROUND.rawValue)
+        }
+    }
+}
+
+/// Gate between live inference and background work in the main app
+final class WorkScheduler {
+
+    static let shared = WorkScheduler()
+
+    // MARK: - Properties
+
+    private let pool: OpaquePointer
+    /// Concurrent: a job parked at a checkpoint must not hold up a later job with a deadline
+    private let maintenanceQueue = DispatchQueue(label: "com.whisperboard.maintenance", qos: .utility, attributes: .concurrent)
+
+    // MARK: - Initialization
+
+    private init() {
+        pool = wb_pool_shared()
+    }
+
+    // MARK: - Live Sessions
+
+    /// Mark a dictation session as live: maintenance holds off until it ends
+    func beginLiveSession() {
+        wb_pool_enter(pool, WorkPriority.live.native)
+    }
+
+    /// Balance a beginLiveSession call
+    func endLiveSession() {
+        wb_pool_leave(pool, WorkPriority.live.native)
+    }
+
+    // MARK: - Background Work
+
+    /// Run maintenance on the utility queue.
+    /// `body` gets a checkpoint to call at each step boundary (between directories, every few
+    /// files, ...); the checkpoint blocks while live or tentative work is active. With `maxDelay`,
+    /// checkpoints stop waiting once the job is that late, for periodic work that must not starve.
+    func background(maxDelay: TimeInterval? = nil, _ body: @escaping (_ checkpoint: () -> Void) -> Void) {
+        let deadline = maxDelay.map { wb_pool_now_ns() + UInt64($0 * 1_000_000_000) } ?? 0
+
+        maintenanceQueue.async { [pool] in
+            let checkpoint = {
+                _ = wb_pool_wait_turn(pool, WorkPriority.background.native, deadline)
+            }
+
+            checkpoint()
+            body(checkpoint)
+        }
+    }
+}
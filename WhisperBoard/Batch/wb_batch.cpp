@@ -0,0 +1,790 @@
+//
+//  wb_batch.cpp
+//  WhisperBoard
+//
+//  Every worker owns a wb_pipeline (its own whisper states, mel and stage
+//  threads) on the one shared model, and a feeder thread that takes the next
+//  window from a shared cursor and submits it as a chunk. The cursor loads a
+//  file when the previous one's windows are all handed out and splits it with
+//  Native/wb_longform: a short file is one window, a long one several, so one
+//  long recording keeps every worker busy instead of one whisper_full walking
+//  it 30 s at a time. A feeder stays one window ahead of its pipeline, so the
+//  next mel overlaps the current decode without loading the whole corpus into
+//  memory. Workers lease their whisper.cpp threads from the shared wb_pool, so
+//  workers x threads never oversubscribes the cores.
+//
+//  The post thread that receives a file's last window stitches the windows'
+//  tokens and appends the result under one mutex; each is followed by a
+//  progress journal record (Native/wb_journal) holding the file's name and the
+//  output size after it. A later run trims the output back to the last
+//  recorded size (dropping anything written after it) and skips the recorded
+//  files.
+//
+
+#include "wb_batch.h"
+
+#include "wb_cancel.h"
+#include "wb_journal.h"
+#include "wb_longform.h"
+#include "wb_pcm_view.h"
+#include "wb_pipeline.h"
+#include "wb_vocab.h"
+#include "wb_wire.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int    k_sample_rate           = 16000;
+constexpr size_t k_windows_ahead         = 2;     // per worker: one decoding, one in mel
+constexpr size_t k_progress_log_interval = 100;   // files between progress lines
+constexpr int    k_stop_poll_ms          = 100;
+
+std::atomic<bool>              g_stop{false};
+std::atomic<wb_cancel_token *> g_token{nullptr};
+
+double elapsed_ms(clock_type::time_point since) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+}
+
+bool has_suffix(const std::string & name, const char * suffix) {
+    const size_t n = strlen(suffix);
+    return name.size() > n && name.compare(name.size() - n, n, suffix) == 0;
+}
+
+bool is_audio_name(const std::string & name) {
+    return has_suffix(name, ".wav") || has_suffix(name, ".pcm") || has_suffix(name, ".f32");
+}
+
+// MARK: - Audio files
+
+struct batch_file {
+    std::string path;   // as opened
+    std::string name;   // relative to its input; the result's sessionId
+};
+
+// Depth first, names sorted, so every run lists a corpus in the same order
+void collect_dir(const std::string & dir, const std::string & prefix, std::vector<batch_file> & files) {
+    DIR * d = opendir(dir.c_str());
+    if (d == nullptr) {
+        fprintf(stderr, "[Batch] Cannot read %s: %s\n", dir.c_str(), strerror(errno));
+        return;
+    }
+
+    std::vector<std::pair<std::string, bool>> entries;   // name, is directory
+    while (const dirent * entry = readdir(d)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            struct stat st;
+            if (fstatat(dirfd(d), entry->d_name, &st, 0) != 0) {
+                continue;
+            }
+            is_dir = S_ISDIR(st.st_mode);
+        }
+        entries.emplace_back(entry->d_name, is_dir);
+    }
+    closedir(d);
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto & entry : entries) {
+        if (entry.second) {
+            collect_dir(dir + "/" + entry.first, prefix + entry.first + "/", files);
+        } else if (is_audio_name(entry.first)) {
+            files.push_back({ dir + "/" + entry.first, prefix + entry.first });
+        }
+    }
+}
+
+// A file's mono 16 kHz samples: raw files straight from their mapping, WAV converted
+struct audio {
+    wb_pcm_view *      view = nullptr;
+    std::vector<float> converted;
+    const float *      data  = nullptr;
+    size_t             count = 0;
+
+    ~audio() { wb_pcm_view_close(view); }
+};
+
+uint16_t read_u16(const uint8_t * p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t read_u32(const uint8_t * p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// RIFF/WAVE with 16-bit PCM or 32-bit float samples at 16 kHz; channels are averaged.
+// Returns NULL or what is wrong with the file.
+const char * convert_wav(const uint8_t * p, size_t size, std::vector<float> & out) {
+    if (size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) {
+        return "not a RIFF/WAVE file";
+    }
+
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate   = 0;
+    const uint8_t * data     = nullptr;
+    size_t          data_len = 0;
+    for (size_t pos = 12; pos + 8 <= size;) {
+        const uint8_t * id  = p + pos;
+        const size_t    len = std::min<size_t>(read_u32(p + pos + 4), size - pos - 8);
+        pos += 8;
+        if (memcmp(id, "fmt ", 4) == 0 && len >= 16) {
+            format   = read_u16(p + pos);
+            channels = read_u16(p + pos + 2);
+            rate     = read_u32(p + pos + 4);
+            bits     = read_u16(p + pos + 14);
+            if (format == 0xFFFE && len >= 26) {
+                format = read_u16(p + pos + 24);   // WAVE_FORMAT_EXTENSIBLE: the sub-format GUID starts with it
+            }
+        } else if (memcmp(id, "data", 4) == 0) {
+            data     = p + pos;
+            data_len = len;   // streamed files may claim more than they hold
+            break;
+        }
+        pos += len + (len & 1);
+    }
+
+    if (data == nullptr || channels == 0) {
+        return "no fmt or data chunk";
+    }
+    if (rate != (uint32_t) k_sample_rate) {
+        return "sample rate is not 16 kHz";
+    }
+    const bool is_int16 = format == 1 && bits == 16;
+    const bool is_float = format == 3 && bits == 32;
+    if (!is_int16 && !is_float) {
+        return "samples are neither 16-bit PCM nor 32-bit float";
+    }
+
+    const size_t frame  = (size_t) channels * (bits / 8);
+    const size_t frames = data_len / frame;
+    out.resize(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        const uint8_t * f = data + i * frame;
+        float sum = 0.0f;
+        for (uint16_t c = 0; c < channels; ++c) {
+            if (is_int16) {
+                int16_t v;
+                memcpy(&v, f + c * 2, sizeof(v));
+                sum += (float) v / 32768.0f;
+            } else {
+                float v;
+                memcpy(&v, f + c * 4, sizeof(v));
+                sum += v;
+            }
+        }
+        out[i] = sum / (float) channels;
+    }
+    return nullptr;
+}
+
+// Returns NULL or why the file cannot be transcribed
+const char * load_audio(const batch_file & file, audio & out) {
+    if (!has_suffix(file.name, ".wav")) {
+        out.view = wb_pcm_view_open(file.path.c_str(), has_suffix(file.name, ".f32") ? WB_PCM_FLOAT32 : WB_PCM_INT16);
+        if (out.view == nullptr) {
+            return strerror(errno);
+        }
+        const wb_sample_span span = wb_pcm_view_samples(out.view);
+        out.data  = span.data;
+        out.count = span.count;
+        return out.count > 0 ? nullptr : "no samples";
+    }
+
+    const int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return strerror(errno);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return "empty file";
+    }
+    void * map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return strerror(errno);
+    }
+
+    const char * error = convert_wav(static_cast<const uint8_t *>(map), (size_t) st.st_size, out.converted);
+    munmap(map, (size_t) st.st_size);
+    if (error != nullptr) {
+        return error;
+    }
+    out.data  = out.converted.data();
+    out.count = out.converted.size();
+    return out.count > 0 ? nullptr : "no samples";
+}
+
+// MARK: - Output
+
+void append_json_string(std::string & out, const std::string & value) {
+    out += '"';
+    for (const char ch : value) {
+        const unsigned char c = (unsigned char) ch;
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+// TranscriptionResult as the app's JSONEncoder writes it (ISO 8601 dates, nil confidence left out)
+std::string result_json(const std::string & text, float confidence, const std::string & session_id, int processing_ms) {
+    char timestamp[32];
+    const time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    std::string line = "{\"text\":";
+    append_json_string(line, text);
+    line += ",\"isFinal\":true";
+    if (confidence >= 0.0f) {
+        char value[32];
+        snprintf(value, sizeof(value), ",\"confidence\":%.4f", confidence);
+        line += value;
+    }
+    line += ",\"timestamp\":\"";
+    line += timestamp;
+    line += "\",\"sessionId\":";
+    append_json_string(line, session_id);
+    line += ",\"processingTimeMs\":" + std::to_string(processing_ms) + "}\n";
+    return line;
+}
+
+int write_all(int fd, const char * data, size_t length) {
+    while (length > 0) {
+        const ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        data   += n;
+        length -= (size_t) n;
+    }
+    return 0;
+}
+
+// Progress record: output size after the file's result, then the file's name
+struct progress_head {
+    uint64_t output_bytes;
+};
+
+// MARK: - Run
+
+struct worker {
+    wb_pipeline * pipeline = nullptr;
+    size_t        queued   = 0;   // windows submitted and not yet back (run.done_mutex)
+};
+
+// One window's decode, kept until the file's last window is back
+struct window_result {
+    int                  status     = WB_PIPELINE_DROPPED;
+    std::vector<int32_t> token_ids;
+    std::vector<int64_t> token_t0;
+    float                confidence = -1.0f;
+};
+
+struct file_job {
+    const batch_file *              file = nullptr;
+    audio                           samples;
+    std::vector<wb_longform_window> windows;
+    std::vector<window_result>      results;   // each written by its window's post thread
+    std::atomic<size_t>             pending{0};   // windows not back yet
+    clock_type::time_point          submitted;
+};
+
+struct window_job {
+    std::shared_ptr<file_job> job;
+    size_t                    index = 0;
+    worker *                  owner = nullptr;
+};
+
+struct batch_run {
+    wb_batch_options        options;
+    std::string             language;
+    std::string             progress_path;
+    std::vector<batch_file> files;
+    wb_longform_params      longform;
+
+    // Shared cursor: the file whose windows are being handed out
+    std::mutex                cursor_mutex;
+    std::shared_ptr<file_job> current;
+    size_t                    next_file   = 0;
+    size_t                    next_window = 0;
+
+    whisper_context *       ctx   = nullptr;
+    wb_vocab *              vocab = nullptr;
+    wb_cancel_token *       token = nullptr;
+    std::vector<worker>     workers;
+
+    // Output and counters, written by the pipelines' post threads
+    std::mutex              output_mutex;
+    int                     output_fd    = -1;
+    uint64_t                output_bytes = 0;
+    wb_journal_writer *     progress     = nullptr;
+    bool                    write_failed = false;
+    size_t                  done_before  = 0;
+    size_t                  transcribed  = 0;
+    size_t                  failed       = 0;
+    double                  audio_seconds = 0.0;
+    double                  processing_ms = 0.0;
+
+    std::mutex              done_mutex;
+    std::condition_variable done_cv;
+    size_t                  in_flight    = 0;
+    int                     feeders_left = 0;
+
+    // Files the progress journal records as done. Drops a torn record at the journal's
+    // end, and output written after the last record; starts both over when they disagree.
+    int resume(std::unordered_set<std::string> & done) {
+        uint64_t last_output = 0;
+        off_t    journal_end = 0;
+        if (wb_journal_reader * reader = wb_journal_reader_open(progress_path.c_str())) {
+            wb_journal_record record;
+            while (wb_journal_reader_next(reader, &record) > 0) {
+                journal_end += (off_t) (WB_JOURNAL_HEADER_SIZE + record.length);
+                if (record.type != WB_JOURNAL_BATCH_PROGRESS || record.length < sizeof(progress_head)) {
+                    continue;
+                }
+                progress_head head;
+                memcpy(&head, record.payload, sizeof(head));
+                last_output = head.output_bytes;
+                done.emplace(static_cast<const char *>(record.payload) + sizeof(head), record.length - sizeof(head));
+            }
+            wb_journal_reader_close(reader);
+        }
+
+        struct stat st;
+        const bool has_output = stat(options.output_path, &st) == 0;
+        if (!done.empty() && (!has_output || (uint64_t) st.st_size < last_output)) {
+            fprintf(stderr, "[Batch] %s is shorter than its progress records; starting over\n", options.output_path);
+            done.clear();
+            last_output = 0;
+            journal_end = 0;
+        }
+        if ((has_output && truncate(options.output_path, (off_t) last_output) != 0) ||
+            (journal_end > 0 && truncate(progress_path.c_str(), journal_end) != 0) ||
+            (journal_end == 0 && unlink(progress_path.c_str()) != 0 && errno != ENOENT)) {
+            return -errno;
+        }
+        output_bytes = last_output;
+        return 0;
+    }
+
+    // The next window to decode, loading files as the current one runs out; false at the end
+    bool next_window_job(std::shared_ptr<file_job> & job, size_t & index) {
+        std::lock_guard<std::mutex> cursor(cursor_mutex);
+        while (current == nullptr || next_window == current->windows.size()) {
+            current.reset();
+            if (next_file >= files.size()) {
+                return false;
+            }
+            auto loaded = std::make_shared<file_job>();
+            loaded->file = &files[next_file++];
+            if (const char * error = load_audio(*loaded->file, loaded->samples)) {
+                fprintf(stderr, "[Batch] Skipped %s: %s\n", loaded->file->path.c_str(), error);
+                std::lock_guard<std::mutex> lock(output_mutex);
+                failed++;
+                continue;
+            }
+
+            loaded->windows.resize(wb_longform_max_windows(loaded->samples.count, &longform));
+            loaded->windows.resize(wb_longform_plan(loaded->samples.data, loaded->samples.count, &longform, loaded->windows.data()));
+            loaded->results.resize(loaded->windows.size());
+            loaded->pending.store(loaded->windows.size(), std::memory_order_relaxed);
+            loaded->submitted = clock_type::now();
+            current     = std::move(loaded);
+            next_window = 0;
+        }
+        job   = current;
+        index = next_window++;
+        return true;
+    }
+
+    void feed(worker & w) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done_cv.wait(lock, [&] { return w.queued < k_windows_ahead || g_stop.load(std::memory_order_relaxed); });
+            }
+            if (g_stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+
+            auto window = std::make_unique<window_job>();
+            window->owner = &w;
+            if (!next_window_job(window->job, window->index)) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                w.queued++;
+                in_flight++;
+            }
+            const wb_longform_window & span = window->job->windows[window->index];
+            const float * samples = window->job->samples.data + span.start;
+            wb_pipeline_submit(w.pipeline, samples, span.end - span.start, token, window.release());
+        }
+
+        std::lock_guard<std::mutex> lock(done_mutex);
+        feeders_left--;
+        done_cv.notify_all();
+    }
+
+    static void on_result(const wb_pipeline_result * result, void * data) {
+        if (result->status == WB_PIPELINE_TENTATIVE) {
+            return;
+        }
+        auto * run    = static_cast<batch_run *>(data);
+        auto * window = static_cast<window_job *>(result->user_data);
+        run->finish(window, result);
+    }
+
+    void finish(window_job * window, const wb_pipeline_result * result) {
+        file_job &      job  = *window->job;
+        window_result & slot = job.results[window->index];
+        slot.status = result->status;
+        if (result->status == WB_PIPELINE_OK) {
+            slot.token_ids.assign(result->token_ids, result->token_ids + result->n_tokens);
+            slot.token_t0.assign(result->token_t0, result->token_t0 + result->n_tokens);
+            slot.confidence = result->confidence;
+        }
+        if (job.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish_file(job);
+        }
+
+        worker * owner = window->owner;
+        delete window;
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            owner->queued--;
+            in_flight--;
+        }
+        done_cv.notify_all();
+    }
+
+    // Every window is back: stitch them, or give up on the file if any did not decode
+    void finish_file(const file_job & job) {
+        const double processing_ms = elapsed_ms(job.submitted);
+        wb_longform_stitch * stitch = wb_longform_stitch_create(vocab);
+        float confidence = -1.0f;   // the least confident window's
+
+        for (size_t i = 0; i < job.windows.size(); ++i) {
+            const window_result & result = job.results[i];
+            if (result.status == WB_PIPELINE_FAILED) {
+                fprintf(stderr, "[Batch] Failed to transcribe %s\n", job.file->path.c_str());
+                wb_longform_stitch_free(stitch);
+                std::lock_guard<std::mutex> lock(output_mutex);
+                failed++;
+                return;
+            }
+            if (result.status == WB_PIPELINE_DROPPED) {
+                // The run was stopped; the file is redone next time
+                wb_longform_stitch_free(stitch);
+                return;
+            }
+            wb_longform_stitch_add(stitch, &job.windows[i], result.token_ids.data(), result.token_t0.data(),
+                                   (int) result.token_ids.size());
+            if (result.confidence >= 0.0f && (confidence < 0.0f || result.confidence < confidence)) {
+                confidence = result.confidence;
+            }
+        }
+
+        record(job, wb_longform_stitch_text(stitch), confidence, processing_ms);
+        wb_longform_stitch_free(stitch);
+    }
+
+    void record(const file_job & job, const std::string & text, float confidence, double processing_ms) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if (write_failed) {
+            return;
+        }
+
+        int rc = 0;
+        if (options.format == WB_BATCH_WIRE) {
+            wb_wire_transcription frame = {};
+            frame.timestamp_ms       = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                           std::chrono::system_clock::now().time_since_epoch()).count();
+            frame.processing_time_ms = (int32_t) processing_ms;
+            frame.confidence         = confidence;
+            frame.is_final           = 1;
+            wb_wire_set_session_id(frame.session_id, job.file->name.c_str());
+            rc = wb_wire_send(output_fd, WB_WIRE_TRANSCRIPTION, &frame, text.data(), text.size());
+            output_bytes += WB_WIRE_HEADER_SIZE + sizeof(frame) + text.size();
+        } else {
+            const std::string line = result_json(text, confidence, job.file->name, (int) processing_ms);
+            rc = write_all(output_fd, line.data(), line.size());
+            output_bytes += line.size();
+        }
+
+        std::string payload(sizeof(progress_head), '\0');
+        const progress_head head = { output_bytes };
+        memcpy(&payload[0], &head, sizeof(head));
+        payload += job.file->name;
+        if (rc == 0) {
+            const int64_t seq = wb_journal_append(progress, WB_JOURNAL_BATCH_PROGRESS, payload.data(), payload.size());
+            rc = seq < 0 ? (int) seq : 0;
+        }
+        if (rc != 0) {
+            fprintf(stderr, "[Batch] Cannot write results: %s\n", strerror(-rc));
+            write_failed = true;
+            wb_batch_stop();
+            return;
+        }
+
+        transcribed++;
+        audio_seconds += (double) job.samples.count / k_sample_rate;
+        this->processing_ms += processing_ms;
+        if (transcribed % k_progress_log_interval == 0) {
+            fprintf(stderr, "[Batch] %zu of %zu files\n", transcribed + done_before, files.size() + done_before);
+        }
+    }
+
+    // Feed until every file is back, cancelling what is in flight once stopped
+    void wait_done() {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        while (feeders_left > 0 || in_flight > 0) {
+            done_cv.wait_for(lock, std::chrono::milliseconds(k_stop_poll_ms));
+            if (g_stop.load(std::memory_order_relaxed)) {
+                done_cv.notify_all();   // feeders waiting for room
+            }
+        }
+    }
+};
+
+whisper_full_params batch_full_params(const batch_run & run) {
+    const bool beam = run.options.beam_size > 1;
+    whisper_full_params params = whisper_full_default_params(beam ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+    params.n_threads        = run.options.threads_per_worker;
+    params.language         = run.language.c_str();
+    params.translate        = false;
+    params.single_segment   = false;
+    params.print_progress   = false;
+    params.print_special    = false;
+    params.print_realtime   = false;
+    params.print_timestamps = false;
+    params.token_timestamps = false;
+    params.suppress_blank   = true;
+    params.suppress_non_speech_tokens = true;
+    params.detect_language  = false;
+    if (beam) {
+        params.beam_search.beam_size = run.options.beam_size;
+    }
+    return params;
+}
+
+} // namespace
+
+wb_batch_options wb_batch_default_options(void) {
+    wb_batch_options options;
+    options.model_path         = nullptr;
+    options.inputs             = nullptr;
+    options.n_inputs           = 0;
+    options.output_path        = nullptr;
+    options.progress_path      = nullptr;
+    options.language           = nullptr;
+    options.format             = WB_BATCH_JSON;
+    options.workers            = 0;
+    options.threads_per_worker = 2;
+    options.beam_size          = 1;
+    options.restart            = false;
+    options.use_gpu            = false;
+    return options;
+}
+
+int wb_batch_run(const wb_batch_options * options) {
+    if (options == nullptr || options->model_path == nullptr || options->output_path == nullptr || options->n_inputs < 1) {
+        return -EINVAL;
+    }
+
+    batch_run run;
+    run.options       = *options;
+    run.language      = options->language != nullptr ? options->language : "en";
+    run.progress_path = options->progress_path != nullptr ? options->progress_path : std::string(options->output_path) + ".progress";
+
+    if (run.options.threads_per_worker < 1) {
+        run.options.threads_per_worker = 1;
+    }
+    if (run.options.workers < 1) {
+        const int cores = (int) std::thread::hardware_concurrency();
+        run.options.workers = std::max(1, cores / run.options.threads_per_worker);
+    }
+
+    for (int i = 0; i < options->n_inputs; ++i) {
+        const char * input = options->inputs[i];
+        struct stat st;
+        if (stat(input, &st) != 0) {
+            fprintf(stderr, "[Batch] Cannot read %s: %s\n", input, strerror(errno));
+        } else if (S_ISDIR(st.st_mode)) {
+            collect_dir(input, "", run.files);
+        } else {
+            run.files.push_back({ input, input });
+        }
+    }
+
+    if (options->restart) {
+        unlink(run.progress_path.c_str());
+        unlink(options->output_path);
+    }
+    std::unordered_set<std::string> done;
+    const int resumed = run.resume(done);
+    if (resumed != 0) {
+        fprintf(stderr, "[Batch] Cannot resume %s: %s\n", options->output_path, strerror(-resumed));
+        return resumed;
+    }
+    if (!done.empty()) {
+        const size_t before = run.files.size();
+        run.files.erase(std::remove_if(run.files.begin(), run.files.end(),
+                                       [&](const batch_file & file) { return done.count(file.name) > 0; }),
+                        run.files.end());
+        run.done_before = before - run.files.size();
+    }
+
+    fprintf(stderr, "[Batch] %zu files to transcribe, %zu already done\n", run.files.size(), run.done_before);
+    if (run.files.empty()) {
+        return 0;
+    }
+
+    run.output_fd = open(options->output_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    run.progress  = wb_journal_writer_open(run.progress_path.c_str());
+    if (run.output_fd < 0 || run.progress == nullptr) {
+        const int err = errno;
+        fprintf(stderr, "[Batch] Cannot open %s: %s\n", options->output_path, strerror(err));
+        if (run.output_fd >= 0) {
+            close(run.output_fd);
+        }
+        wb_journal_writer_close(run.progress);
+        return -err;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = options->use_gpu;
+    run.ctx = whisper_init_from_file_with_params(options->model_path, cparams);
+    if (run.ctx == nullptr) {
+        fprintf(stderr, "[Batch] Failed to load model: %s\n", options->model_path);
+        close(run.output_fd);
+        wb_journal_writer_close(run.progress);
+        return -ENOENT;
+    }
+
+    run.vocab    = wb_vocab_create(run.ctx);
+    run.longform = wb_longform_default_params();
+    run.token    = wb_cancel_token_create();
+    g_stop.store(false, std::memory_order_relaxed);
+    g_token.store(run.token, std::memory_order_release);
+
+    // Offline: no VAD, no speculation, and whisper's own temperature fallback without a deadline
+    const whisper_full_params full = batch_full_params(run);
+    wb_pipeline_params params = wb_pipeline_default_params();
+    params.n_states        = 2;
+    params.queue_capacity  = 2;
+    params.mel_threads     = 1;
+    params.deadline_ms     = INT_MAX;
+    params.fallback_budget = false;
+    params.on_result       = batch_run::on_result;
+    params.callback_data   = &run;
+
+    run.workers.resize((size_t) run.options.workers);
+    for (auto & w : run.workers) {
+        w.pipeline = wb_pipeline_init(run.ctx, &full, params);
+        if (w.pipeline == nullptr) {
+            fprintf(stderr, "[Batch] Cannot create a pipeline for worker %zu\n", (size_t) (&w - run.workers.data()));
+            wb_batch_stop();
+            break;
+        }
+    }
+
+    fprintf(stderr, "[Batch] Transcribing with %d workers x %d threads (%s, %s)\n",
+            run.options.workers, run.options.threads_per_worker, run.language.c_str(),
+            run.options.beam_size > 1 ? "beam search" : "greedy");
+
+    const auto start = clock_type::now();
+    std::vector<std::thread> feeders;
+    run.feeders_left = g_stop.load() ? 0 : run.options.workers;
+    if (run.feeders_left > 0) {
+        for (auto & w : run.workers) {
+            feeders.emplace_back([&run, &w] { run.feed(w); });
+        }
+    }
+    run.wait_done();
+    for (auto & thread : feeders) {
+        thread.join();
+    }
+    const double wall_s = elapsed_ms(start) / 1000.0;
+
+    for (auto & w : run.workers) {
+        if (w.pipeline != nullptr) {
+            wb_pipeline_free(w.pipeline);
+        }
+    }
+    g_token.store(nullptr, std::memory_order_release);
+    wb_cancel_token_release(run.token);
+    wb_vocab_free(run.vocab);
+    whisper_free(run.ctx);
+    close(run.output_fd);
+    wb_journal_writer_close(run.progress);
+
+    const bool stopped = g_stop.load();
+    fprintf(stderr, "[Batch] %s %zu files into %s (%zu failed, %zu done before)\n",
+            stopped ? "Stopped after" : "Transcribed", run.transcribed, options->output_path, run.failed, run.done_before);
+    if (run.transcribed > 0 && wall_s > 0.0) {
+        fprintf(stderr, "[Batch] %.2f h of audio in %.1f s: real-time factor %.4f, %.1f audio-hours per wall-hour, %.0f ms per file\n",
+                run.audio_seconds / 3600.0, wall_s, wall_s / run.audio_seconds, run.audio_seconds / wall_s,
+                run.processing_ms / (double) run.transcribed);
+    }
+    return stopped || run.failed > 0 ? 1 : 0;
+}
+
+void wb_batch_stop(void) {
+    g_stop.store(true, std::memory_order_relaxed);
+    wb_cancel_token_cancel(g_token.load(std::memory_order_acquire));
+}
@@ -0,0 +1,58 @@
+//
+//  wb_batch.h
+//  WhisperBoard
+//
+//  Offline transcription of stored audio on Linux: directories of 16 kHz WAV
+//  or raw PCM files through the same staged pipeline the app streams with,
+//  several pipelines in parallel, one window of up to 30 s per work unit (long
+//  recordings are split, see Native/wb_longform). Meant for accuracy and speed
+//  regression runs over large clip sets.
+//
+
+#ifndef wb_batch_h
+#define wb_batch_h
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum wb_batch_format {
+    WB_BATCH_JSON = 0,   // one TranscriptionResult JSON object per line (MessageTypes.swift)
+    WB_BATCH_WIRE = 1,   // WB_WIRE_TRANSCRIPTION frames (Native/wb_wire.h)
+};
+
+typedef struct wb_batch_options {
+    const char *         model_path;
+    const char * const * inputs;              // directories (walked recursively) or files
+    int                  n_inputs;
+    const char *         output_path;
+    const char *         progress_path;       // NULL = output_path + ".progress"
+    const char *         language;            // NULL = "en"
+    int                  format;              // wb_batch_format
+    int                  workers;             // pipelines, each with its own states (0 = cores / threads_per_worker)
+    int                  threads_per_worker;  // whisper.cpp threads per decode
+    int                  beam_size;           // <= 1 = greedy
+    bool                 restart;             // ignore earlier progress and start the output over
+    bool                 use_gpu;
+} wb_batch_options;
+
+wb_batch_options wb_batch_default_options(void);
+
+// Transcribe every .wav (16 kHz, 16-bit PCM or float), .pcm (raw 16 kHz mono int16) and
+// .f32 (raw 16 kHz mono float32) file under `inputs`, appending one result per file to
+// `output_path`. Each finished file is recorded in the progress journal, so a second run
+// with the same output skips it. Prints a throughput summary to stderr.
+// Returns 0 when every file is done, 1 if some failed or the run was stopped, or -errno.
+int wb_batch_run(const wb_batch_options * options);
+
+// Async-signal-safe: stop submitting files and abort the decodes in flight (they are
+// redone on the next run)
+void wb_batch_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_batch_h */
@@ -0,0 +1,119 @@
+//
+//  whisperboard_batch.cpp
+//  WhisperBoard
+//
+//  Batch CLI entry point: option parsing and signal handling around wb_batch_run
+//
+
+#include "wb_batch.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+void usage(const char * program) {
+    fprintf(stderr,
+            "usage: %s -m MODEL -o OUTPUT [-f json|wire] [-l LANG] [-w WORKERS] [-t THREADS] [--beam N]\n"
+            "          [--progress FILE] [--restart] [--gpu] INPUT...\n"
+            "  INPUT               directory (searched recursively) or file: .wav (16 kHz, 16-bit PCM or\n"
+            "                      float), .pcm (raw 16 kHz mono int16), .f32 (raw 16 kHz mono float32)\n"
+            "  -m, --model         ggml model file (e.g. ggml-small-q5_1.bin)\n"
+            "  -o, --output        results, one per file, appended across runs\n"
+            "  -f, --format        json: TranscriptionResult per line (default); wire: transcription frames\n"
+            "  -l, --language      spoken language (default en)\n"
+            "  -w, --workers       30 s windows decoded in parallel (default cores / threads)\n"
+            "  -t, --threads       whisper.cpp threads per worker (default 2)\n"
+            "      --beam          beams per decode, 1 = greedy (default 1)\n"
+            "      --progress      progress journal (default OUTPUT.progress); files it lists are skipped\n"
+            "      --restart       discard earlier progress and output\n"
+            "      --gpu           run the model on the GPU backend if available\n",
+            program);
+}
+
+void handle_signal(int) {
+    wb_batch_stop();
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    wb_batch_options options = wb_batch_default_options();
+    std::vector<const char *> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto is = [arg](const char * short_name, const char * long_name) {
+            return strcmp(arg, short_name) == 0 || strcmp(arg, long_name) == 0;
+        };
+
+        if (arg[0] != '-') {
+            inputs.push_back(arg);
+            continue;
+        }
+        if (strcmp(arg, "--gpu") == 0) {
+            options.use_gpu = true;
+            continue;
+        }
+        if (strcmp(arg, "--restart") == 0) {
+            options.restart = true;
+            continue;
+        }
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (is("-m", "--model")) {
+            options.model_path = value;
+        } else if (is("-o", "--output")) {
+            options.output_path = value;
+        } else if (is("-f", "--format")) {
+            if (strcmp(value, "json") == 0) {
+                options.format = WB_BATCH_JSON;
+            } else if (strcmp(value, "wire") == 0) {
+                options.format = WB_BATCH_WIRE;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (is("-l", "--language")) {
+            options.language = value;
+        } else if (is("-w", "--workers")) {
+            options.workers = atoi(value);
+        } else if (is("-t", "--threads")) {
+            options.threads_per_worker = atoi(value);
+        } else if (strcmp(arg, "--beam") == 0) {
+            options.beam_size = atoi(value);
+        } else if (strcmp(arg, "--progress") == 0) {
+            options.progress_path = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    if (options.model_path == nullptr || options.output_path == nullptr || inputs.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    options.inputs   = inputs.data();
+    options.n_inputs = (int) inputs.size();
+
+    struct sigaction action = {};
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    const int rc = wb_batch_run(&options);
+    return rc == 0 ? 0 : rc > 0 ? 1 : 2;
+}
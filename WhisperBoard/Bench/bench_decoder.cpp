@@ -0,0 +1,213 @@
+//
+//  bench_decoder.cpp
+//  WhisperBoard
+//
+//  Speculative decoding check and benchmark on real models: every clip is
+//  encoded once per model, then decoded with wb_decode_greedy and with
+//  wb_decode_speculative on the same states. The token sequences must match;
+//  the acceptance rate, main-model calls per token and wall times are reported.
+//  Exits with 1 on any mismatch.
+//
+
+#include "wb_decoder.h"
+#include "wb_logits.h"
+#include "wb_pcm_view.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t k_max_samples = 30 * 16000;   // one encoder window
+
+void usage(const char * program) {
+    fprintf(stderr,
+            "usage: %s -m MODEL --draft MODEL [-t THREADS] [--draft-tokens K] [-r REPEATS] CLIP...\n"
+            "  CLIP                .f32 (raw 16 kHz mono float32) or .pcm (raw 16 kHz mono int16);\n"
+            "                      the first 30 s are used\n"
+            "  -m, --model         main model (e.g. ggml-small-q5_1.bin)\n"
+            "      --draft         draft model with the same vocabulary (e.g. ggml-tiny-q5_1.bin)\n"
+            "  -t, --threads       whisper.cpp threads (default 4)\n"
+            "      --draft-tokens  tokens proposed per verification round (default 4)\n"
+            "  -r, --repeats       timed decodes per clip and method, best kept (default 3)\n",
+            program);
+}
+
+bool has_suffix(const char * name, const char * suffix) {
+    const size_t n = strlen(name), m = strlen(suffix);
+    return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+// Encoder output for `samples` in a fresh state on `ctx`
+whisper_state * encode(whisper_context * ctx, const wb_sample_span & samples, int n_threads) {
+    whisper_state * state = whisper_init_state(ctx);
+    if (state == nullptr) {
+        return nullptr;
+    }
+    const int n = (int) std::min(samples.count, k_max_samples);
+    if (whisper_pcm_to_mel_with_state(ctx, state, samples.data, n, n_threads) != 0 ||
+        whisper_encode_with_state(ctx, state, 0, n_threads) != 0) {
+        whisper_free_state(state);
+        return nullptr;
+    }
+    return state;
+}
+
+double ms_since(clock_type::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    const char * model_path = nullptr;
+    const char * draft_path = nullptr;
+    int n_threads    = 4;
+    int draft_tokens = 4;
+    int repeats      = 3;
+    std::vector<const char *> clips;
+
+    for (int i = 1; i < argc; ++i) {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto is = [arg](const char * short_name, const char * long_name) {
+            return strcmp(arg, short_name) == 0 || strcmp(arg, long_name) == 0;
+        };
+
+        if (arg[0] != '-') {
+            clips.push_back(arg);
+            continue;
+        }
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (is("-m", "--model")) {
+            model_path = value;
+        } else if (strcmp(arg, "--draft") == 0) {
+            draft_path = value;
+        } else if (is("-t", "--threads")) {
+            n_threads = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--draft-tokens") == 0) {
+            draft_tokens = std::max(1, atoi(value));
+        } else if (is("-r", "--repeats")) {
+            repeats = std::max(1, atoi(value));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+    if (model_path == nullptr || draft_path == nullptr || clips.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+    whisper_context * ctx       = whisper_init_from_file_with_params(model_path, cparams);
+    whisper_context * draft_ctx = whisper_init_from_file_with_params(draft_path, cparams);
+    if (ctx == nullptr || draft_ctx == nullptr || whisper_n_vocab(ctx) != whisper_n_vocab(draft_ctx)) {
+        fprintf(stderr, "[Bench] Models missing or with different vocabularies: %s, %s\n", model_path, draft_path);
+        whisper_free(ctx);
+        whisper_free(draft_ctx);
+        return 2;
+    }
+
+    wb_logits_mask * mask     = wb_logits_mask_create(ctx, true);
+    wb_decoder_kv *  kv       = wb_decoder_kv_create(ctx);
+    wb_decoder_kv *  draft_kv = wb_decoder_kv_create(draft_ctx);
+
+    wb_decoder_params params = wb_decoder_default_params();
+    params.n_threads = n_threads;
+    params.mask      = mask;
+    params.kv        = kv;
+
+    std::vector<int32_t> greedy(448), speculative(448);
+    wb_speculative_stats total = {};
+    long   tokens      = 0;
+    double greedy_ms   = 0.0;
+    double spec_ms     = 0.0;
+    int    mismatches  = 0;
+    int    clips_done  = 0;
+
+    for (const char * clip : clips) {
+        const int format = has_suffix(clip, ".pcm") ? WB_PCM_INT16 : WB_PCM_FLOAT32;
+        wb_pcm_view * view = wb_pcm_view_open(clip, format);
+        if (view == nullptr) {
+            fprintf(stderr, "[Bench] Skipped %s: cannot read\n", clip);
+            continue;
+        }
+        whisper_state * state       = encode(ctx, wb_pcm_view_samples(view), n_threads);
+        whisper_state * draft_state = encode(draft_ctx, wb_pcm_view_samples(view), n_threads);
+        wb_pcm_view_close(view);
+        if (state == nullptr || draft_state == nullptr) {
+            fprintf(stderr, "[Bench] Skipped %s: encoder failed\n", clip);
+            whisper_free_state(state);
+            whisper_free_state(draft_state);
+            continue;
+        }
+
+        // Each timed decode starts from an empty KV cache, as the first decode after an encode does
+        double best_greedy = 0.0, best_spec = 0.0;
+        int n_greedy = 0, n_spec = 0;
+        wb_speculative_stats stats = {};
+        for (int r = 0; r < repeats; ++r) {
+            wb_decoder_kv_reset(kv);
+            auto start = clock_type::now();
+            n_greedy = wb_decode_greedy(ctx, state, &params, greedy.data(), (int) greedy.size());
+            const double g = ms_since(start);
+
+            wb_decoder_kv_reset(kv);
+            wb_decoder_kv_reset(draft_kv);
+            start = clock_type::now();
+            n_spec = wb_decode_speculative(ctx, state, draft_ctx, draft_state, draft_kv, &params, draft_tokens,
+                                           speculative.data(), (int) speculative.size(), &stats);
+            const double s = ms_since(start);
+
+            best_greedy = r == 0 ? g : std::min(best_greedy, g);
+            best_spec   = r == 0 ? s : std::min(best_spec, s);
+        }
+        whisper_free_state(state);
+        whisper_free_state(draft_state);
+
+        const bool same = n_greedy >= 0 && n_greedy == n_spec &&
+                          std::equal(greedy.begin(), greedy.begin() + std::max(n_greedy, 0), speculative.begin());
+        if (!same) {
+            ++mismatches;
+            fprintf(stderr, "[Bench] MISMATCH %s: greedy %d tokens, speculative %d\n", clip, n_greedy, n_spec);
+        }
+
+        ++clips_done;
+        tokens    += std::max(n_greedy, 0);
+        greedy_ms += best_greedy;
+        spec_ms   += best_spec;
+        total.drafted       += stats.drafted;
+        total.accepted      += stats.accepted;
+        total.target_passes += stats.target_passes;
+        printf("%s: %d tokens, greedy %.1f ms, speculative %.1f ms, %d/%d drafts accepted%s\n", clip, n_greedy,
+               best_greedy, best_spec, stats.accepted, stats.drafted, same ? "" : ", MISMATCH");
+    }
+
+    printf("clips %d, tokens %ld, mismatches %d\n", clips_done, tokens, mismatches);
+    printf("acceptance %.1f%%, main-model calls per token %.2f\n",
+           total.drafted == 0 ? 0.0 : 100.0 * total.accepted / total.drafted,
+           tokens == 0 ? 0.0 : (double) total.target_passes / (double) tokens);
+    printf("greedy %.1f ms, speculative %.1f ms, speedup %.2fx\n", greedy_ms, spec_ms,
+           spec_ms > 0.0 ? greedy_ms / spec_ms : 0.0);
+
+    wb_decoder_kv_free(kv);
+    wb_decoder_kv_free(draft_kv);
+    wb_logits_mask_free(mask);
+    whisper_free(ctx);
+    whisper_free(draft_ctx);
+    return mismatches == 0 ? 0 : 1;
+}
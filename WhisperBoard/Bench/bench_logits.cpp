@@ -0,0 +1,260 @@
+//
+//  bench_logits.cpp
+//  WhisperBoard
+//
+//  wb_logits_top_k against the scalar path it replaces, on a real model's
+//  vocabulary and suppression mask: the reference copies the row, sets the
+//  suppressed tokens to -inf, takes the log-softmax over the whole vocabulary
+//  and then the argmax or a partial sort, as whisper.cpp's per-step processing
+//  does. Rows are synthetic logits (normal noise with a few clear leaders). Both
+//  must pick the same tokens with the same log-probabilities; the time per row
+//  of each is reported for greedy (argmax only) and beam (normalized top-k)
+//  steps. Exits with 1 on any mismatch.
+//
+
+#include "wb_logits.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr float k_neg_inf    = -std::numeric_limits<float>::infinity();
+constexpr float k_tolerance  = 1e-3f;   // the kernels' exp is a polynomial
+
+void usage(const char * program) {
+    fprintf(stderr,
+            "usage: %s -m MODEL [--rows N] [--beam K] [-r REPEATS]\n"
+            "  -m, --model     model whose vocabulary and mask are used (e.g. ggml-tiny-q5_1.bin)\n"
+            "      --rows      rows of logits per pass (default 256)\n"
+            "      --beam      tokens kept per beam step (default 5)\n"
+            "  -r, --repeats   timed passes per path and mode, best kept (default 5)\n",
+            program);
+}
+
+// Per-step scalar processing, with its buffers kept across steps as whisper.cpp's decoders do.
+// The suppressed ids are listed once up front, so the timed path only writes them.
+struct reference_path {
+    std::vector<int32_t> suppressed[2];   // later steps, first step
+    std::vector<float>   logprobs;
+    std::vector<int>     order;
+
+    reference_path(const wb_logits_mask * mask, int n_vocab) {
+        for (int id = 0; id < n_vocab; ++id) {
+            for (int first_step = 0; first_step < 2; ++first_step) {
+                if (wb_logits_suppressed(mask, id, first_step != 0)) {
+                    suppressed[first_step].push_back(id);
+                }
+            }
+        }
+    }
+
+    void top_k(const float * logits, int n_vocab, bool first_step, int k, bool normalize, wb_logits_top & top) {
+        logprobs.assign(logits, logits + n_vocab);
+        for (int32_t id : suppressed[first_step ? 1 : 0]) {
+            logprobs[(size_t) id] = k_neg_inf;
+        }
+
+        if (normalize) {
+            const float max = *std::max_element(logprobs.begin(), logprobs.end());
+            double sum = 0.0;
+            for (float v : logprobs) {
+                sum += std::exp((double) (v - max));
+            }
+            const float log_sum = max + (float) std::log(sum);
+            for (float & v : logprobs) {
+                v -= log_sum;
+            }
+        }
+
+        top.n = 0;
+        if (k == 1) {
+            int best = 0;
+            for (int id = 1; id < n_vocab; ++id) {
+                best = logprobs[(size_t) id] > logprobs[(size_t) best] ? id : best;
+            }
+            if (logprobs[(size_t) best] != k_neg_inf) {
+                top.ids[0]      = best;
+                top.logprobs[0] = normalize ? logprobs[(size_t) best] : 0.0f;
+                top.n           = 1;
+            }
+            return;
+        }
+
+        order.resize((size_t) n_vocab);
+        std::iota(order.begin(), order.end(), 0);
+        std::partial_sort(order.begin(), order.begin() + k, order.end(), [this](int a, int b) {
+            return logprobs[(size_t) a] > logprobs[(size_t) b] ||
+                   (logprobs[(size_t) a] == logprobs[(size_t) b] && a < b);
+        });
+        for (int i = 0; i < k && logprobs[(size_t) order[(size_t) i]] != k_neg_inf; ++i) {
+            top.ids[i]      = order[(size_t) i];
+            top.logprobs[i] = normalize ? logprobs[(size_t) order[(size_t) i]] : 0.0f;
+            top.n++;
+        }
+    }
+};
+
+bool same_top(const wb_logits_top & a, const wb_logits_top & b) {
+    if (a.n != b.n) {
+        return false;
+    }
+    for (int i = 0; i < a.n; ++i) {
+        if (a.ids[i] != b.ids[i] || std::fabs(a.logprobs[i] - b.logprobs[i]) > k_tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Noise around 0 with a handful of leaders per row, like a decoder that knows what comes next
+std::vector<float> make_rows(int n_rows, int n_vocab, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.0f, 2.0f);
+    std::uniform_int_distribution<int> token(0, n_vocab - 1);
+    std::uniform_real_distribution<float> lead(6.0f, 14.0f);
+
+    std::vector<float> rows((size_t) n_rows * (size_t) n_vocab);
+    for (float & v : rows) {
+        v = noise(rng);
+    }
+    for (int r = 0; r < n_rows; ++r) {
+        for (int i = 0; i < 8; ++i) {
+            rows[(size_t) r * (size_t) n_vocab + (size_t) token(rng)] += lead(rng);
+        }
+    }
+    return rows;
+}
+
+double ms_since(clock_type::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    const char * model_path = nullptr;
+    int n_rows  = 256;
+    int beam    = 5;
+    int repeats = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto is = [arg](const char * short_name, const char * long_name) {
+            return strcmp(arg, short_name) == 0 || strcmp(arg, long_name) == 0;
+        };
+
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (is("-m", "--model")) {
+            model_path = value;
+        } else if (strcmp(arg, "--rows") == 0) {
+            n_rows = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--beam") == 0) {
+            beam = std::max(2, std::min(atoi(value), WB_LOGITS_MAX_TOP));
+        } else if (is("-r", "--repeats")) {
+            repeats = std::max(1, atoi(value));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+    if (model_path == nullptr) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+    whisper_context * ctx = whisper_init_from_file_with_params(model_path, cparams);
+    if (ctx == nullptr) {
+        fprintf(stderr, "[Bench] Failed to load model: %s\n", model_path);
+        return 2;
+    }
+
+    const int n_vocab = whisper_n_vocab(ctx);
+    wb_logits_mask * mask = wb_logits_mask_create(ctx, true);
+    const std::vector<float> rows = make_rows(n_rows, n_vocab, 1234);
+
+    struct mode {
+        const char * name;
+        int          k;
+        bool         normalize;
+    };
+    const mode modes[] = { { "greedy", 1, false }, { "beam", beam, true } };
+
+    reference_path reference(mask, n_vocab);
+    wb_logits_top  fused_top, reference_top;
+    int mismatches = 0;
+
+    // Every row on both paths, first step and later ones
+    for (const mode & m : modes) {
+        for (int r = 0; r < n_rows; ++r) {
+            const float * row = rows.data() + (size_t) r * (size_t) n_vocab;
+            for (const bool first_step : { true, false }) {
+                wb_logits_top_k(mask, row, first_step, m.k, m.normalize, &fused_top);
+                reference.top_k(row, n_vocab, first_step, m.k, m.normalize, reference_top);
+                if (!same_top(fused_top, reference_top)) {
+                    ++mismatches;
+                    fprintf(stderr, "[Bench] MISMATCH %s row %d%s: best %d vs %d\n", m.name, r,
+                            first_step ? " (first step)" : "", fused_top.n > 0 ? fused_top.ids[0] : -1,
+                            reference_top.n > 0 ? reference_top.ids[0] : -1);
+                }
+            }
+        }
+    }
+
+    printf("vocabulary %d, rows %d, mismatches %d\n", n_vocab, n_rows, mismatches);
+
+    int32_t sink = 0;
+    for (const mode & m : modes) {
+        double best_fused = 0.0, best_reference = 0.0;
+        for (int pass = 0; pass < repeats; ++pass) {
+            auto start = clock_type::now();
+            for (int r = 0; r < n_rows; ++r) {
+                wb_logits_top_k(mask, rows.data() + (size_t) r * (size_t) n_vocab, false, m.k, m.normalize, &fused_top);
+                sink += fused_top.ids[0];
+            }
+            const double f = ms_since(start);
+
+            start = clock_type::now();
+            for (int r = 0; r < n_rows; ++r) {
+                reference.top_k(rows.data() + (size_t) r * (size_t) n_vocab, n_vocab, false, m.k, m.normalize,
+                                reference_top);
+                sink += reference_top.ids[0];
+            }
+            const double s = ms_since(start);
+
+            best_fused     = pass == 0 ? f : std::min(best_fused, f);
+            best_reference = pass == 0 ? s : std::min(best_reference, s);
+        }
+
+        const double fused_us     = best_fused * 1000.0 / n_rows;
+        const double reference_us = best_reference * 1000.0 / n_rows;
+        printf("%s (k %d%s): fused %.2f us/row, scalar %.2f us/row, speedup %.2fx\n", m.name, m.k,
+               m.normalize ? ", log-softmax" : "", fused_us, reference_us,
+               fused_us > 0.0 ? reference_us / fused_us : 0.0);
+    }
+    if (sink == 42) {
+        printf("\n");   // keeps the timed calls from being optimized away
+    }
+
+    wb_logits_mask_free(mask);
+    whisper_free(ctx);
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+//
+//  bench_onset.cpp
+//  WhisperBoard
+//
+//  Speech-onset speculation on a real model: every clip is submitted as one
+//  chunk to a pipeline with speculation on and to one with it off. Reports how
+//  long after submit the first text arrives (the TENTATIVE result of the onset
+//  prefix, or the real result when none came) and when the real result does,
+//  so the gain in first-text latency and the cost to the final result show side
+//  by side.
+//
+
+#include "wb_pcm_view.h"
+#include "wb_pipeline.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t k_max_samples = 30 * 16000;   // one encoder window
+
+void usage(const char * program) {
+    fprintf(stderr,
+            "usage: %s -m MODEL [-t THREADS] [--window MS] [--tokens N] [--vad RMS] [-r REPEATS] CLIP...\n"
+            "  CLIP            .f32 (raw 16 kHz mono float32) or .pcm (raw 16 kHz mono int16); the first 30 s\n"
+            "                  are one chunk, so use clips longer than the window\n"
+            "  -m, --model     model (e.g. ggml-tiny-q5_1.bin)\n"
+            "  -t, --threads   whisper.cpp threads (default 4)\n"
+            "      --window    speculative_window_ms (default 1000)\n"
+            "      --tokens    speculative_max_tokens (default 8)\n"
+            "      --vad       vad_rms_threshold, also used to find the onset (default 0.002)\n"
+            "  -r, --repeats   runs per clip and mode, best kept (default 3)\n",
+            program);
+}
+
+bool has_suffix(const char * name, const char * suffix) {
+    const size_t n = strlen(name), m = strlen(suffix);
+    return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+double ms_between(clock_type::time_point from, clock_type::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// One chunk in flight at a time: its results' arrival times
+struct chunk_timing {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    clock_type::time_point  tentative;
+    clock_type::time_point  final;
+    bool                    has_tentative = false;
+    bool                    done          = false;
+    int                     status        = WB_PIPELINE_OK;
+    std::string             tentative_text;
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        has_tentative = false;
+        done          = false;
+        tentative_text.clear();
+    }
+
+    static void on_result(const wb_pipeline_result * result, void * data) {
+        auto * timing = static_cast<chunk_timing *>(data);
+        const auto now = clock_type::now();
+        std::lock_guard<std::mutex> lock(timing->mutex);
+        if (result->status == WB_PIPELINE_TENTATIVE) {
+            timing->tentative      = now;
+            timing->has_tentative  = true;
+            timing->tentative_text = result->text;
+            return;
+        }
+        timing->final  = now;
+        timing->status = result->status;
+        timing->done   = true;
+        timing->cv.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return done; });
+    }
+};
+
+struct run_result {
+    double first_ms = 0.0;   // first text of any kind
+    double final_ms = 0.0;
+    bool   tentative = false;
+};
+
+run_result run_once(wb_pipeline * pipeline, chunk_timing & timing, const float * samples, size_t n_samples) {
+    timing.reset();
+    const auto start = clock_type::now();
+    wb_pipeline_submit(pipeline, samples, n_samples, nullptr, nullptr);
+    timing.wait();
+
+    std::lock_guard<std::mutex> lock(timing.mutex);
+    run_result r;
+    r.final_ms  = ms_between(start, timing.final);
+    r.tentative = timing.has_tentative;
+    r.first_ms  = r.tentative ? ms_between(start, timing.tentative) : r.final_ms;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    const char * model_path = nullptr;
+    int   n_threads = 4;
+    int   window_ms = 1000;
+    int   tokens    = 8;
+    float vad       = 0.002f;
+    int   repeats   = 3;
+    std::vector<const char *> clips;
+
+    for (int i = 1; i < argc; ++i) {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto is = [arg](const char * short_name, const char * long_name) {
+            return strcmp(arg, short_name) == 0 || strcmp(arg, long_name) == 0;
+        };
+
+        if (arg[0] != '-') {
+            clips.push_back(arg);
+            continue;
+        }
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (is("-m", "--model")) {
+            model_path = value;
+        } else if (is("-t", "--threads")) {
+            n_threads = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--window") == 0) {
+            window_ms = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--tokens") == 0) {
+            tokens = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--vad") == 0) {
+            vad = std::max(0.0f, (float) atof(value));
+        } else if (is("-r", "--repeats")) {
+            repeats = std::max(1, atoi(value));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+    if (model_path == nullptr || clips.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+    whisper_context * ctx = whisper_init_from_file_with_params(model_path, cparams);
+    if (ctx == nullptr) {
+        fprintf(stderr, "[Bench] Failed to load model: %s\n", model_path);
+        return 2;
+    }
+
+    whisper_full_params full = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    full.n_threads        = n_threads;
+    full.language         = "en";
+    full.no_context       = true;
+    full.print_progress   = false;
+    full.print_realtime   = false;
+    full.print_special    = false;
+    full.print_timestamps = false;
+
+    // Live settings, as the app streams; only speculation differs between the two pipelines
+    chunk_timing timing;
+    wb_pipeline_params params = wb_pipeline_default_params();
+    params.vad_rms_threshold     = vad;
+    params.speculative_window_ms = window_ms;
+    params.deadline_ms           = 60000;
+    params.on_result             = chunk_timing::on_result;
+    params.callback_data         = &timing;
+
+    params.speculative_max_tokens = tokens;
+    wb_pipeline * speculating = wb_pipeline_init(ctx, &full, params);
+    params.speculative_max_tokens = 0;
+    wb_pipeline * plain = wb_pipeline_init(ctx, &full, params);
+    if (speculating == nullptr || plain == nullptr) {
+        fprintf(stderr, "[Bench] Cannot create the pipelines\n");
+        wb_pipeline_free(speculating);
+        wb_pipeline_free(plain);
+        whisper_free(ctx);
+        return 2;
+    }
+
+    double first_spec = 0.0, final_spec = 0.0, final_plain = 0.0;
+    int    clips_done = 0, speculated = 0;
+
+    for (const char * clip : clips) {
+        const int format = has_suffix(clip, ".pcm") ? WB_PCM_INT16 : WB_PCM_FLOAT32;
+        wb_pcm_view * view = wb_pcm_view_open(clip, format);
+        if (view == nullptr) {
+            fprintf(stderr, "[Bench] Skipped %s: cannot read\n", clip);
+            continue;
+        }
+        const wb_sample_span span = wb_pcm_view_samples(view);
+        const size_t n_samples = std::min(span.count, k_max_samples);
+
+        run_result best_spec, best_plain;
+        std::string tentative_text;
+        bool failed = false;
+        for (int r = 0; r < repeats && !failed; ++r) {
+            const run_result s = run_once(speculating, timing, span.data, n_samples);
+            failed = timing.status != WB_PIPELINE_OK;
+            if (s.tentative) {
+                tentative_text = timing.tentative_text;
+            }
+            const run_result p = run_once(plain, timing, span.data, n_samples);
+            failed = failed || timing.status != WB_PIPELINE_OK;
+
+            if (r == 0 || s.first_ms < best_spec.first_ms) {
+                best_spec.first_ms  = s.first_ms;
+                best_spec.tentative = s.tentative;
+            }
+            best_spec.final_ms  = r == 0 ? s.final_ms : std::min(best_spec.final_ms, s.final_ms);
+            best_plain.final_ms = r == 0 ? p.final_ms : std::min(best_plain.final_ms, p.final_ms);
+        }
+        wb_pcm_view_close(view);
+        if (failed) {
+            fprintf(stderr, "[Bench] Skipped %s: silent or failed\n", clip);
+            continue;
+        }
+
+        ++clips_done;
+        speculated  += best_spec.tentative ? 1 : 0;
+        first_spec  += best_spec.first_ms;
+        final_spec  += best_spec.final_ms;
+        final_plain += best_plain.final_ms;
+        printf("%s: %.1f s, first text %.1f ms%s, final %.1f ms (%.1f ms without speculation)%s%s%s\n", clip,
+               (double) n_samples / 16000.0, best_spec.first_ms, best_spec.tentative ? " (tentative)" : "",
+               best_spec.final_ms, best_plain.final_ms, tentative_text.empty() ? "" : " \"",
+               tentative_text.c_str(), tentative_text.empty() ? "" : "\"");
+    }
+
+    if (clips_done > 0) {
+        printf("clips %d, speculated %d\n", clips_done, speculated);
+        printf("mean first text %.1f ms, mean final %.1f ms; without speculation %.1f ms for both\n",
+               first_spec / clips_done, final_spec / clips_done, final_plain / clips_done);
+    }
+
+    wb_pipeline_free(speculating);
+    wb_pipeline_free(plain);
+    whisper_free(ctx);
+    return clips_done > 0 ? 0 : 1;
+}
@@ -16,12 +16,46 @@ class IPCPipe {
     private let ipcQueue = DispatchQueue(label: "com.whisperboard.ipc", qos: .userInitiated)
     private var monitorTimer: Timer?
     private let pollingInterval: TimeInterval = 0.1  // 100ms for responsive updates
-    private var lastTranscriptionCheck: Date?
+    private var lastTranscriptionGeneration: UInt64 = 0
+
+    /// Streaming journal for the active session (opened once the app creates it)
+    private var journalSessionId: String?
+    private var journalReader: JournalReader?
+
+    /// Backpressure state, driven by the app's chunk credits
+    enum FlowState {
+        case normal       // every chunk is sent as captured
+        case batching     // out of credits; chunks are merged until one frees up
+        case degraded     // inference is lagging; held-back audio is sent as pcm16
+        case overloaded   // hold-back limit reached; oldest audio is being dropped
+    }
+
+    /// Audio held back while the app has no credits, sent later as one chunk
+    private var flowState: FlowState = .normal
+    private var nextChunkId = 0
+    private var pendingAudio = Data()
+    private var pendingFormat: AudioChunkMetadata.AudioFormat = .float32
+    private var pendingDuration: TimeInterval = 0
+    private var pendingMetadata: AudioChunkMetadata?
+    private var pendingIsLast = false
+
+    /// Credits and published results (App Groups unless a test supplies its own)
+    private let sharedState: SharedState?
+    /// Where chunks are written for the main app
+    private let audioBuffersDirectory: URL?
 
     /// Callbacks
     var onTranscriptionUpdate: ((TranscriptionResult) -> Void)?
     var onTokenUpdate: ((TokenUpdate) -> Void)?
     var onError: ((ErrorMessage) -> Void)?
+    var onFlowStateChange: ((FlowState) -> Void)?
+
+    // MARK: - Initialization
+
+    init(sharedState: SharedState? = SharedState.shared, audioBuffersDirectory: URL? = AppGroups.Paths.audioBuffers) {
+        self.sharedState = sharedState
+        self.audioBuffersDirectory = audioBuffersDirectory
+    }
 
     // MARK: - Sending Messages
 
@@ -31,6 +65,23 @@ class IPCPipe {
     ///   - sessionId: Session identifier
     func sendControlSignal(_ signal: ControlSignal, sessionId: String) {
         ipcQueue.async {
+            if signal == .start {
+                // Follow the new session's journal
+                self.journalSessionId = sessionId
+                self.journalReader = nil
+
+                // Chunk ids are assigned at send time so merged chunks stay contiguous
+                self.nextChunkId = 0
+                self.resetPendingAudio()
+                self.updateFlowState(.normal)
+            } else if signal == .stop {
+                // Whatever is held back goes out before the stop, credits or not, as the session's last chunk
+                if !self.pendingAudio.isEmpty {
+                    self.pendingIsLast = true
+                }
+                self.drainPendingAudio(force: true)
+            }
+
             do {
                 let controlMsg = ControlMessage(signal: signal, sessionId: sessionId)
                 let msgData = try controlMsg.toJSONData()
@@ -49,11 +100,23 @@ class IPCPipe {
         }
     }
 
-    /// Send audio chunk to main app
+    /// Queue a captured audio chunk for the main app
+    /// Sent right away while the app has credits; otherwise merged into the held-back batch
+    /// - Parameters:
+    ///   - audioData: PCM audio data
+    ///   - metadata: Audio chunk metadata (the chunk id is reassigned at send time)
+    func submitAudioChunk(_ audioData: Data, metadata: AudioChunkMetadata) {
+        ipcQueue.async {
+            self.appendPendingAudio(audioData, metadata: metadata)
+            self.drainPendingAudio(force: false)
+        }
+    }
+
+    /// Write one audio chunk to the shared container
     /// - Parameters:
     ///   - audioData: PCM audio data
     ///   - metadata: Audio chunk metadata
-    func sendAudioChunk(_ audioData: Data, metadata: AudioChunkMetadata) throws {
+    private func sendAudioChunk(_ audioData: Data, metadata: AudioChunkMetadata) throws {
         // Generate unique filename for this chunk
         let pcmFileName = "chunk_\(metadata.sessionId)_\(metadata.chunkId).pcm"
 
@@ -61,7 +124,7 @@ class IPCPipe {
         try AppGroups.writeData(
             audioData,
             to: pcmFileName,
-            in: AppGroups.Paths.audioBuffers
+            in: audioBuffersDirectory
         )
 
         // Write metadata
@@ -72,7 +135,7 @@ class IPCPipe {
         try AppGroups.writeData(
             metadataData,
             to: metadataFileName,
-            in: AppGroups.Paths.audioBuffers
+            in: audioBuffersDirectory
         )
 
         print("[IPCPipe] Sent audio chunk \(metadata.chunkId)")
@@ -84,6 +147,11 @@ class IPCPipe {
     func startMonitoring() {
         stopMonitoring()
 
+        // Only deliver results published from now on
+        ipcQueue.async {
+            self.lastTranscriptionGeneration = self.sharedState?.transcriptionGeneration ?? 0
+        }
+
         print("[IPCPipe] Started monitoring for transcription updates")
 
         monitorTimer = Timer.scheduledTimer(
@@ -92,6 +160,7 @@ class IPCPipe {
         ) { [weak self] _ in
             self?.checkForTranscriptionUpdates()
             self?.checkForErrors()
+            self?.checkForCredits()
         }
     }
 
@@ -106,81 +175,43 @@ class IPCPipe {
         ipcQueue.async { [weak self] in
             guard let self = self else { return }
 
-            do {
-                // Check latest transcription file
-                if AppGroups.fileExists(AppGroups.Files.latestTranscription, in: AppGroups.Paths.transcriptions) {
-                    // Check modification date to avoid processing same result multiple times
-                    let modDate = AppGroups.fileModificationDate(
-                        AppGroups.Files.latestTranscription,
-                        in: AppGroups.Paths.transcriptions
-                    )
-
-                    if let modDate = modDate,
-                       let lastCheck = self.lastTranscriptionCheck,
-                       modDate <= lastCheck {
-                        // Already processed this result
-                        return
-                    }
-
-                    // Read transcription result
-                    let data = try AppGroups.readData(
-                        from: AppGroups.Files.latestTranscription,
-                        in: AppGroups.Paths.transcriptions
-                    )
-
-                    let result = try data.decode(as: TranscriptionResult.self)
-
-                    // Update last check time
-                    self.lastTranscriptionCheck = Date()
+            // Generation check is a single shared-memory load; the record is copied only when it changed
+            if let latest = self.sharedState?.latestTranscription(newerThan: self.lastTranscriptionGeneration) {
+                self.lastTranscriptionGeneration = latest.generation
 
-                    // Notify callback on main thread
-                    DispatchQueue.main.async {
-                        self.onTranscriptionUpdate?(result)
-                    }
+                // Notify callback on main thread
+                DispatchQueue.main.async {
+                    self.onTranscriptionUpdate?(latest.result)
                 }
-
-                // Also check for streaming token updates
-                self.checkForTokenUpdates()
-
-            } catch {
-                // Silently ignore errors (file might not exist yet)
             }
+
+            // Also check for streaming token updates
+            self.checkForTokenUpdates()
         }
     }
 
     /// Check for streaming token updates
     private func checkForTokenUpdates() {
+        guard let sessionId = journalSessionId else { return }
+
+        // The journal file appears with the session's first update
+        if journalReader == nil {
+            journalReader = JournalReader(sessionId: sessionId)
+        }
+
+        guard let reader = journalReader else { return }
+
         do {
-            guard let transcriptionsPath = AppGroups.Paths.transcriptions else { return }
-
-            let fileManager = FileManager.default
-            let files = try fileManager.contentsOfDirectory(
-                at: transcriptionsPath,
-                includingPropertiesForKeys: [.contentModificationDateKey],
-                options: [.skipsHiddenFiles]
-            )
-
-            // Find token update files
-            let tokenUpdateFiles = files
-                .filter { $0.lastPathComponent.starts(with: "token_update_") }
-                .sorted { url1, url2 in
-                    let date1 = (try? url1.resourceValues(forKeys: [.contentModificationDateKey]))?.contentModificationDate ?? Date.distantPast
-                    let date2 = (try? url2.resourceValues(forKeys: [.contentModificationDateKey]))?.contentModificationDate ?? Date.distantPast
-                    return date1 < date2
-                }
+            // Records appended since the last poll, in sequence order
+            try reader.readNewRecords { record in
+                guard record.type == .tokenUpdate else { return }
 
-            // Process and delete token update files
-            for fileURL in tokenUpdateFiles {
-                let data = try Data(contentsOf: fileURL)
-                let tokenUpdate = try data.decode(as: TokenUpdate.self)
+                let tokenUpdate = try record.payload.decode(as: TokenUpdate.self)
 
                 // Notify callback on main thread
                 DispatchQueue.main.async {
                     self.onTokenUpdate?(tokenUpdate)
                 }
-
-                // Delete processed file
-                try fileManager.removeItem(at: fileURL)
             }
 
         } catch {
@@ -217,50 +248,150 @@ class IPCPipe {
         }
     }
 
-    // MARK: - App Status
+    // MARK: - Flow Control
 
-    /// Check main app status
-    /// - Parameter completion: Completion handler with app status
-    func checkAppStatus(completion: @escaping (AppStatus) -> Void) {
-        ipcQueue.async {
-            do {
-                // Send ping signal
-                self.sendControlSignal(.ping, sessionId: "status_check")
+    /// Send held-back audio once the app returns credits
+    func checkForCredits() {
+        ipcQueue.async { [weak self] in
+            self?.drainPendingAudio(force: false)
+        }
+    }
 
-                // Wait a bit for response
-                Thread.sleep(forTimeInterval: 0.1)
+    /// Add a captured chunk to the held-back batch (ipcQueue)
+    private func appendPendingAudio(_ audioData: Data, metadata: AudioChunkMetadata) {
+        if pendingMetadata == nil {
+            pendingMetadata = metadata
+        }
+        pendingIsLast = pendingIsLast || metadata.isLastChunk
 
-                // Read status file
-                if AppGroups.fileExists(AppGroups.Files.statusFile, in: AppGroups.Paths.control) {
-                    let data = try AppGroups.readData(
-                        from: AppGroups.Files.statusFile,
-                        in: AppGroups.Paths.control
-                    )
+        if pendingFormat == .pcm16 && metadata.format == .float32 {
+            pendingAudio.append(Self.convertFloat32ToPCM16(audioData))
+        } else {
+            pendingAudio.append(audioData)
+        }
+        pendingDuration += metadata.duration
+
+        // Bound memory: drop the oldest audio beyond the hold-back limit
+        let excess = pendingDuration - WhisperBoardConfig.IPC.flowMaxPendingSeconds
+        if excess > 0 {
+            let bytesPerSample = pendingFormat == .pcm16 ? 2 : 4
+            let samplesToDrop = Int(excess * Double(metadata.sampleRate))
+            pendingAudio.removeFirst(min(pendingAudio.count, samplesToDrop * bytesPerSample))
+            pendingDuration = WhisperBoardConfig.IPC.flowMaxPendingSeconds
+
+            print("[IPCPipe] ⚠️ Main app is not keeping up, dropped \(Int(excess * 1000))ms of audio")
+            updateFlowState(.overloaded)
+        }
+    }
 
-                    let status = try data.decode(as: AppStatus.self)
+    /// Send the held-back batch as one chunk if a credit is available (ipcQueue)
+    private func drainPendingAudio(force: Bool) {
+        guard !pendingAudio.isEmpty, let first = pendingMetadata else { return }
+
+        let granted = sharedState?.acquireCredit(force: force) ?? true
+        let lagMs = sharedState?.flow().lagMs ?? 0
+
+        guard granted else {
+            // Still waiting: shrink what we hold if inference is far behind
+            if pendingFormat == .float32 && (lagMs >= WhisperBoardConfig.IPC.flowDowngradeLagMs ||
+                                             Int(pendingDuration * 1000) >= WhisperBoardConfig.IPC.flowDowngradeLagMs) {
+                pendingAudio = Self.convertFloat32ToPCM16(pendingAudio)
+                pendingFormat = .pcm16
+                updateFlowState(.degraded)
+            } else if flowState == .normal {
+                updateFlowState(.batching)
+            }
+            return
+        }
 
-                    DispatchQueue.main.async {
-                        completion(status)
-                    }
-                } else {
-                    // No status file - app might not be running
-                    let defaultStatus = AppStatus(
-                        isModelLoaded: false,
-                        isProcessing: false,
-                        currentSessionId: nil,
-                        modelVariant: "unknown",
-                        memoryUsageMB: 0
-                    )
+        let metadata = AudioChunkMetadata(
+            chunkId: nextChunkId,
+            sampleRate: first.sampleRate,
+            channels: first.channels,
+            format: pendingFormat,
+            duration: pendingDuration,
+            timestamp: first.timestamp,
+            sessionId: first.sessionId,
+            isLastChunk: pendingIsLast
+        )
 
-                    DispatchQueue.main.async {
-                        completion(defaultStatus)
-                    }
+        do {
+            try sendAudioChunk(pendingAudio, metadata: metadata)
+        } catch {
+            // Keep the batch for the next drain; the credit was not used
+            sharedState?.cancelCredit()
+            print("[IPCPipe] Failed to send audio chunk \(metadata.chunkId), will retry: \(error)")
+            return
+        }
+
+        nextChunkId += 1
+        resetPendingAudio()
+
+        // Back to full-rate float32 once inference has (mostly) caught up
+        if lagMs < WhisperBoardConfig.IPC.flowDowngradeLagMs / 2 {
+            pendingFormat = .float32
+            updateFlowState(.normal)
+        }
+    }
+
+    private func resetPendingAudio() {
+        pendingAudio = Data()
+        pendingDuration = 0
+        pendingMetadata = nil
+        pendingIsLast = false
+    }
+
+    /// Flow state and held-back audio, read on the IPC queue (tests and diagnostics)
+    func flowSnapshot() -> (state: FlowState, heldBackBytes: Int, heldBackSeconds: TimeInterval, chunksSent: Int) {
+        ipcQueue.sync {
+            (flowState, pendingAudio.count, pendingDuration, nextChunkId)
+        }
+    }
+
+    private func updateFlowState(_ state: FlowState) {
+        guard state != flowState else { return }
+
+        flowState = state
+        print("[IPCPipe] Flow state: \(state)")
+
+        DispatchQueue.main.async {
+            self.onFlowStateChange?(state)
+        }
+    }
+
+    /// Convert float32 samples to 16-bit PCM (halves the bytes written and mapped)
+    private static func convertFloat32ToPCM16(_ data: Data) -> Data {
+        let sampleCount = data.count / MemoryLayout<Float>.size
+        var pcm16 = Data(count: sampleCount * MemoryLayout<Int16>.size)
+
+        data.withUnsafeBytes { rawSource in
+            pcm16.withUnsafeMutableBytes { rawDestination in
+                let source = rawSource.bindMemory(to: Float.self)
+                let destination = rawDestination.bindMemory(to: Int16.self)
+
+                for i in 0..<sampleCount {
+                    let clamped = max(-1.0, min(1.0, source[i]))
+                    destination[i] = Int16(clamped * 32767.0)
                 }
+            }
+        }
 
-            } catch {
-                print("[IPCPipe] Failed to check app status: \(error)")
+        return pcm16
+    }
+
+    // MARK: - App Status
 
-                // Return default status on error
+    /// Check main app status
+    /// - Parameter completion: Completion handler with app status
+    func checkAppStatus(completion: @escaping (AppStatus) -> Void) {
+        ipcQueue.async {
+            // The app republishes its status every second, so no ping round-trip is needed
+            if let status = self.sharedState?.status() {
+                DispatchQueue.main.async {
+                    completion(status)
+                }
+            } else {
+                // Nothing published - app might not be running
                 let defaultStatus = AppStatus(
                     isModelLoaded: false,
                     isProcessing: false,
@@ -281,33 +412,14 @@ class IPCPipe {
     /// Clean up old files
     func cleanupOldFiles() {
         ipcQueue.async {
-            do {
-                // Clean up audio buffers directory
-                if let audioBuffersPath = AppGroups.Paths.audioBuffers {
-                    let fileManager = FileManager.default
-                    let files = try fileManager.contentsOfDirectory(
-                        at: audioBuffersPath,
-                        includingPropertiesForKeys: [.contentModificationDateKey],
-                        options: [.skipsHiddenFiles]
-                    )
-
-                    // Delete files older than 1 minute
-                    let cutoffTime = Date().addingTimeInterval(-60)
-
-                    for fileURL in files {
-                        guard let attributes = try? fileManager.attributesOfItem(atPath: fileURL.path),
-                              let modDate = attributes[.modificationDate] as? Date else {
-                            continue
-                        }
+            // Clean up audio buffers directory
+            guard let index = AppGroups.index(for: AppGroups.Paths.audioBuffers) else { return }
 
-                        if modDate < cutoffTime {
-                            try? fileManager.removeItem(at: fileURL)
-                        }
-                    }
-                }
+            // Delete files older than 1 minute
+            let cutoffTime = Date().addingTimeInterval(-60)
 
-            } catch {
-                print("[IPCPipe] Failed to cleanup old files: \(error)")
+            for file in index.entries(olderThan: cutoffTime) {
+                index.remove(file.name)
             }
         }
     }
@@ -0,0 +1,21 @@
+//
+//  KeyboardExtension-Bridging-Header.h
+//  WhisperBoard Keyboard Extension
+//
+//  Bridging header for the native IPC core shared with the main app
+//  The keyboard extension never links whisper.cpp, only WhisperBoard/Native
+//
+//  Usage:
+//  1. Add WhisperBoard/Native/*.cpp to the "WhisperBoard Keyboard" target
+//  2. Set this file as "Objective-C Bridging Header" for the keyboard target
+//  3. Add WhisperBoard/Native to Header Search Paths
+//
+
+#ifndef KeyboardExtension_Bridging_Header_h
+#define KeyboardExtension_Bridging_Header_h
+
+#include "wb_dir_index.h"
+#include "wb_journal.h"
+#include "wb_shared_state.h"
+
+#endif /* KeyboardExtension_Bridging_Header_h */
@@ -57,9 +57,15 @@ class KeyboardViewController: UIInputViewController {
         ipcPipe.onTranscriptionUpdate = { [weak self] result in
             self?.handleTranscriptionUpdate(result)
         }
+        ipcPipe.onTokenUpdate = { [weak self] update in
+            self?.handleTokenUpdate(update)
+        }
         ipcPipe.onError = { [weak self] error in
             self?.handleIPCError(error)
         }
+        ipcPipe.onFlowStateChange = { [weak self] state in
+            self?.handleFlowStateChange(state)
+        }
 
         // Initialize transcription display
         transcriptionDisplay = TranscriptionDisplay()
@@ -213,11 +219,23 @@ class KeyboardViewController: UIInputViewController {
     // MARK: - Audio Chunk Handling
 
     private func handleAudioChunk(_ audioData: Data, metadata: AudioChunkMetadata) {
-        // Send audio chunk to main app via IPC
-        do {
-            try ipcPipe.sendAudioChunk(audioData, metadata: metadata)
-        } catch {
-            print("[Keyboard] Failed to send audio chunk: \(error)")
+        // Send audio chunk to main app via IPC (held back while the app is saturated)
+        ipcPipe.submitAudioChunk(audioData, metadata: metadata)
+    }
+
+    private func handleFlowStateChange(_ state: IPCPipe.FlowState) {
+        guard isRecording else { return }
+
+        switch state {
+        case .normal:
+            statusIndicator.backgroundColor = .systemRed
+        case .batching, .degraded:
+            // Still transcribing, just catching up
+            statusIndicator.backgroundColor = .systemYellow
+        case .overloaded:
+            statusIndicator.backgroundColor = .systemOrange
+            transcriptionLabel.text = "⚠️ Transcription falling behind"
+            transcriptionLabel.textColor = .systemOrange
         }
     }
 
@@ -257,6 +275,12 @@ class KeyboardViewController: UIInputViewController {
         }
     }
 
+    private func handleTokenUpdate(_ update: TokenUpdate) {
+        // Tentative text is greyed out until the chunk's real result replaces it
+        transcriptionLabel.text = update.text
+        transcriptionLabel.textColor = update.isTentative ? .secondaryLabel : .label
+    }
+
     private func insertTranscriptionIntoTextField(_ text: String) {
         // Insert text into the current text field
         if let proxy = textDocumentProxy as UITextDocumentProxy? {
@@ -0,0 +1,40 @@
+//
+//  wb_cancel.cpp
+//  WhisperBoard
+//
+
+#include "wb_cancel.h"
+
+#include <atomic>
+
+struct wb_cancel_token {
+    std::atomic<int>  refs{1};
+    std::atomic<bool> cancelled{false};
+};
+
+wb_cancel_token * wb_cancel_token_create(void) {
+    return new wb_cancel_token();
+}
+
+wb_cancel_token * wb_cancel_token_retain(wb_cancel_token * token) {
+    if (token != nullptr) {
+        token->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return token;
+}
+
+void wb_cancel_token_release(wb_cancel_token * token) {
+    if (token != nullptr && token->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete token;
+    }
+}
+
+void wb_cancel_token_cancel(wb_cancel_token * token) {
+    if (token != nullptr) {
+        token->cancelled.store(true, std::memory_order_release);
+    }
+}
+
+bool wb_cancel_token_is_cancelled(const wb_cancel_token * token) {
+    return token != nullptr && token->cancelled.load(std::memory_order_acquire);
+}
@@ -0,0 +1,37 @@
+//
+//  wb_cancel.h
+//  WhisperBoard
+//
+//  Per-session cancellation token shared between Swift and the native pipeline
+//  Cancelling is one atomic store; whisper.cpp polls the token through its abort callbacks
+//
+
+#ifndef wb_cancel_h
+#define wb_cancel_h
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct wb_cancel_token wb_cancel_token;
+
+// New token (not cancelled) holding one reference
+wb_cancel_token * wb_cancel_token_create(void);
+
+// Reference counting: every holder (session, queued chunk, running decode) keeps its own reference
+wb_cancel_token * wb_cancel_token_retain(wb_cancel_token * token);
+void wb_cancel_token_release(wb_cancel_token * token);
+
+// Idempotent, callable from any thread
+void wb_cancel_token_cancel(wb_cancel_token * token);
+
+// NULL tokens are never cancelled
+bool wb_cancel_token_is_cancelled(const wb_cancel_token * token);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_cancel_h */
@@ -0,0 +1,61 @@
+//
+//  wb_confidence.cpp
+//  WhisperBoard
+//
+//  The mean alone hides a garbled word inside otherwise clear text; the worst
+//  window catches it, and short decodes (fewer tokens than a window) fall back
+//  to their mean. Probabilities are floored so one token at p = 0 cannot drive
+//  the sums to -inf.
+//
+
+#include "wb_confidence.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr float k_min_p = 1e-10f;
+
+} // namespace
+
+void wb_confidence_begin(wb_confidence_acc * acc) {
+    *acc = wb_confidence_acc{};
+}
+
+void wb_confidence_add_token(wb_confidence_acc * acc, float p) {
+    const float logprob = std::log(std::max(p, k_min_p));
+    const int   slot    = acc->n_tokens % WB_CONFIDENCE_WINDOW;
+
+    if (acc->n_tokens >= WB_CONFIDENCE_WINDOW) {
+        acc->window_sum -= acc->window[slot];
+    }
+    acc->window[slot] = logprob;
+    acc->window_sum  += logprob;
+    acc->sum_logprob += logprob;
+    acc->n_tokens++;
+
+    if (acc->n_tokens >= WB_CONFIDENCE_WINDOW) {
+        const float mean = (float) (acc->window_sum / WB_CONFIDENCE_WINDOW);
+        acc->min_window = acc->n_tokens == WB_CONFIDENCE_WINDOW ? mean : std::min(acc->min_window, mean);
+    }
+}
+
+void wb_confidence_add_no_speech(wb_confidence_acc * acc, float no_speech_prob) {
+    acc->no_speech_prob = std::max(acc->no_speech_prob, std::min(std::max(no_speech_prob, 0.0f), 1.0f));
+}
+
+wb_confidence wb_confidence_end(const wb_confidence_acc * acc) {
+    wb_confidence confidence = {};
+    confidence.n_tokens       = acc->n_tokens;
+    confidence.no_speech_prob = acc->no_speech_prob;
+    if (acc->n_tokens == 0) {
+        confidence.score = -1.0f;
+        return confidence;
+    }
+
+    confidence.mean_logprob       = (float) (acc->sum_logprob / acc->n_tokens);
+    confidence.min_window_logprob = acc->n_tokens >= WB_CONFIDENCE_WINDOW ? acc->min_window : confidence.mean_logprob;
+    confidence.score = std::exp(0.5f * (confidence.mean_logprob + confidence.min_window_logprob)) * (1.0f - acc->no_speech_prob);
+    return confidence;
+}
@@ -0,0 +1,52 @@
+//
+//  wb_confidence.h
+//  WhisperBoard
+//
+//  Confidence of a decode from its token probabilities, aggregated in the same
+//  pass that collects its text: no per-token strings or buffers. Feed one
+//  accumulator per segment, per utterance, or both side by side.
+//
+
+#ifndef wb_confidence_h
+#define wb_confidence_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WB_CONFIDENCE_WINDOW 8
+
+typedef struct wb_confidence {
+    int   n_tokens;             // text tokens scored
+    float mean_logprob;         // mean log p over them
+    float min_window_logprob;   // lowest mean log p over WB_CONFIDENCE_WINDOW consecutive tokens (all, if fewer)
+    float no_speech_prob;       // highest reported (0 if none)
+    float score;                // 0-1: exp of the mean of the two logprobs above, times 1 - no_speech_prob;
+                                // < 0 without tokens
+} wb_confidence;
+
+// Running state; plain data, lives on the caller's stack
+typedef struct wb_confidence_acc {
+    double sum_logprob;
+    int    n_tokens;
+    float  window[WB_CONFIDENCE_WINDOW];   // ring of the latest log p
+    double window_sum;
+    float  min_window;
+    float  no_speech_prob;
+} wb_confidence_acc;
+
+void wb_confidence_begin(wb_confidence_acc * acc);
+
+// One text token's probability, in decode order (special and timestamp tokens left out)
+void wb_confidence_add_token(wb_confidence_acc * acc, float p);
+
+// whisper's no-speech probability for a window or segment the tokens came from
+void wb_confidence_add_no_speech(wb_confidence_acc * acc, float no_speech_prob);
+
+wb_confidence wb_confidence_end(const wb_confidence_acc * acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_confidence_h */
@@ -0,0 +1,541 @@
+//
+//  wb_decoder.cpp
+//  WhisperBoard
+//
+//  Prompt layout follows whisper_full:
+//    [prev, earlier text...] sot, language, task, no-timestamps
+//  then one whisper_decode_with_state call per generated token on the state's KV cache.
+//
+//  whisper.cpp's public API decodes a single sequence per state, and
+//  whisper_decode_with_state truncates the KV cache to n_past before appending,
+//  so the cache acts as one resident token sequence. wb_decoder_kv remembers
+//  that sequence: moving to another one keeps the common prefix and feeds only
+//  the tokens after it, in one call. That call only returns the logits of its
+//  last token (whisper_batch_prep_legacy requests no other row), so every
+//  choice of a next token costs one call, speculative verification included.
+//
+//  Beam search keeps every hypothesis as a node in a prefix tree. Beams visited
+//  in path order differ by a token or two, so a step costs about one small
+//  decode per live beam, and pruning keeps the live count low once the search
+//  is confident.
+//
+
+#include "wb_decoder.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct wb_decoder_kv {
+    std::vector<whisper_token> resident;            // tokens from position 0 whose KV the state holds
+    bool                       has_logits = false;  // the state's logits follow the last of them
+    int                        logits_row = 0;      // row of those logits in the last call's output
+};
+
+namespace {
+
+// Next-token logits after `seq` (nullptr on failure). whisper_decode_with_state only asks
+// whisper.cpp for the logits of the last token it is given (rows for earlier tokens are left
+// as they were), so one call yields one usable row.
+const float * advance(whisper_context * ctx, whisper_state * state, wb_decoder_kv & kv,
+                      const std::vector<whisper_token> & seq, int n_threads) {
+    const size_t n_vocab = (size_t) whisper_n_vocab(ctx);
+
+    size_t keep = 0;
+    while (keep < kv.resident.size() && keep < seq.size() && kv.resident[keep] == seq[keep]) {
+        ++keep;
+    }
+    if (keep == seq.size() && keep == kv.resident.size() && kv.has_logits) {
+        return whisper_get_logits_from_state(state) + (size_t) kv.logits_row * n_vocab;
+    }
+
+    // At least the last token is fed, for its logits
+    keep = std::min(keep, seq.size() - 1);
+    const int n_new = (int) (seq.size() - keep);
+    if (whisper_decode_with_state(ctx, state, seq.data() + keep, n_new, (int) keep, n_threads) != 0) {
+        kv.resident.clear();
+        kv.has_logits = false;
+        return nullptr;
+    }
+    kv.resident   = seq;
+    kv.has_logits = true;
+    kv.logits_row = n_new - 1;
+
+    return whisper_get_logits_from_state(state) + (size_t) kv.logits_row * n_vocab;
+}
+
+// The caller's suppression mask, or one of just the special tokens for this call
+class suppression {
+public:
+    suppression(whisper_context * ctx, const wb_decoder_params * params)
+        : owned_(params->mask == nullptr ? wb_logits_mask_create(ctx, false) : nullptr)
+        , mask_(params->mask != nullptr ? params->mask : owned_) {}
+
+    ~suppression() { wb_logits_mask_free(owned_); }
+
+    suppression(const suppression &) = delete;
+    suppression & operator=(const suppression &) = delete;
+
+    // Most likely allowed token, -1 if none
+    whisper_token pick(const float * logits, bool first_step) const {
+        wb_logits_top top;
+        return wb_logits_top_k(mask_, logits, first_step, 1, false, &top) > 0 ? top.ids[0] : -1;
+    }
+
+    const wb_logits_mask * get() const { return mask_; }
+
+private:
+    wb_logits_mask *       owned_;
+    const wb_logits_mask * mask_;
+};
+
+// Returns false for an unknown language
+bool build_prompt(whisper_context * ctx, const wb_decoder_params * params, std::vector<whisper_token> & prompt) {
+    const int n_text_ctx = whisper_n_text_ctx(ctx);
+    prompt.clear();
+    prompt.reserve((size_t) n_text_ctx);
+
+    // Same budget as whisper_full: at most half the context for earlier text
+    if (params->n_prompt_tokens > 0 && params->prompt_tokens != nullptr) {
+        const int keep = params->n_prompt_tokens < n_text_ctx / 2 - 1 ? params->n_prompt_tokens : n_text_ctx / 2 - 1;
+        prompt.push_back(whisper_token_prev(ctx));
+        prompt.insert(prompt.end(), params->prompt_tokens + params->n_prompt_tokens - keep,
+                      params->prompt_tokens + params->n_prompt_tokens);
+    }
+
+    const int lang_id = whisper_lang_id(params->language != nullptr ? params->language : "en");
+    if (lang_id < 0) {
+        return false;
+    }
+    prompt.push_back(whisper_token_sot(ctx));
+    prompt.push_back(whisper_token_lang(ctx, lang_id));
+    prompt.push_back(params->translate ? whisper_token_translate(ctx) : whisper_token_transcribe(ctx));
+    prompt.push_back(whisper_token_not(ctx));
+    return true;
+}
+
+int max_new_tokens(whisper_context * ctx, const wb_decoder_params * params, int capacity) {
+    int max_tokens = params->max_tokens > 0 ? params->max_tokens : whisper_n_text_ctx(ctx) / 2;
+    return max_tokens < capacity ? max_tokens : capacity;
+}
+
+// Length to cut the tokens so far back to when they have started looping, 0 to go on
+int runaway_cut(const wb_decoder_params * params, const whisper_token * tokens, int n_tokens) {
+    return params->stop_runaway ? wb_repetition_check(tokens, n_tokens) : 0;
+}
+
+void report_runaway(const wb_decoder_params * params, bool cut) {
+    if (params->runaway != nullptr) {
+        *params->runaway = cut;
+    }
+}
+
+// MARK: - Beam search
+
+struct tree_node {
+    whisper_token token;
+    int           parent;   // -1: child of the prompt
+    int           depth;    // tokens from the prompt to here, inclusive
+    double        sum_logprob;
+};
+
+struct live_beam {
+    int                        node;          // -1: the empty hypothesis
+    double                     sum_logprob;
+    std::vector<whisper_token> seq;           // prompt and the tokens so far
+};
+
+struct candidate {
+    int           parent;   // index into the live beams
+    whisper_token token;
+    double        sum_logprob;
+};
+
+struct hypothesis {
+    int    node;
+    double score;
+    bool   cut;   // ended at a repetition loop
+};
+
+// As whisper_full ranks its sequences
+double length_score(double sum_logprob, int length, float length_penalty) {
+    double penalty = length > 0 ? length : 1;
+    if (length_penalty > 0.0f) {
+        penalty = std::pow((5.0 + penalty) / 6.0, length_penalty);
+    }
+    return sum_logprob / penalty;
+}
+
+std::vector<whisper_token> path_to(const std::vector<tree_node> & tree, int node) {
+    std::vector<whisper_token> path;
+    for (; node >= 0; node = tree[(size_t) node].parent) {
+        path.push_back(tree[(size_t) node].token);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+} // namespace
+
+wb_decoder_kv * wb_decoder_kv_create(struct whisper_context * ctx) {
+    auto * kv = new wb_decoder_kv();
+    kv->resident.reserve((size_t) whisper_n_text_ctx(ctx));
+    return kv;
+}
+
+void wb_decoder_kv_free(wb_decoder_kv * kv) {
+    delete kv;
+}
+
+void wb_decoder_kv_reset(wb_decoder_kv * kv) {
+    if (kv != nullptr) {
+        kv->resident.clear();
+        kv->has_logits = false;
+    }
+}
+
+size_t wb_decoder_kv_state_bytes(struct whisper_context * ctx) {
+    return 2 * sizeof(uint16_t) * (size_t) whisper_model_n_text_layer(ctx) *
+           (size_t) whisper_model_n_text_ctx(ctx) * (size_t) whisper_model_n_text_state(ctx);
+}
+
+wb_decoder_params wb_decoder_default_params(void) {
+    wb_decoder_params params;
+    params.n_threads       = 2;
+    params.max_tokens      = 0;
+    params.language        = nullptr;
+    params.translate       = false;
+    params.prompt_tokens   = nullptr;
+    params.n_prompt_tokens = 0;
+    params.token           = nullptr;
+    params.kv              = nullptr;
+    params.mask            = nullptr;
+    params.stop_runaway    = false;
+    params.runaway         = nullptr;
+    return params;
+}
+
+wb_beam_params wb_beam_default_params(void) {
+    wb_beam_params params;
+    params.beam_size      = 5;
+    params.patience       = 1.0f;
+    params.length_penalty = -1.0f;
+    params.prune_logprob  = 5.0f;
+    return params;
+}
+
+int wb_decode_greedy(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    const wb_decoder_params * params,
+    int32_t * tokens,
+    int capacity
+) {
+    const int n_text_ctx = whisper_n_text_ctx(ctx);
+    const whisper_token eot = whisper_token_eot(ctx);
+    report_runaway(params, false);
+
+    std::vector<whisper_token> prompt;
+    if (!build_prompt(ctx, params, prompt)) {
+        return -1;
+    }
+
+    const int max_tokens = max_new_tokens(ctx, params, capacity);
+
+    wb_decoder_kv local;
+    wb_decoder_kv & kv = params->kv != nullptr ? *params->kv : local;
+    const suppression suppress(ctx, params);
+
+    std::vector<whisper_token> seq = prompt;
+    int n_tokens = 0;
+    while (n_tokens < max_tokens && (int) seq.size() < n_text_ctx) {
+        if (wb_cancel_token_is_cancelled(params->token)) {
+            return -1;
+        }
+
+        const float * logits = advance(ctx, state, kv, seq, params->n_threads);
+        if (logits == nullptr) {
+            return -1;
+        }
+
+        const whisper_token best = suppress.pick(logits, n_tokens == 0);
+        if (best < 0 || best == eot) {
+            break;
+        }
+
+        tokens[n_tokens++] = best;
+        seq.push_back(best);
+
+        const int cut = runaway_cut(params, tokens, n_tokens);
+        if (cut > 0) {
+            report_runaway(params, true);
+            return cut;
+        }
+    }
+
+    return n_tokens;
+}
+
+int wb_decode_speculative(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    struct whisper_context * draft_ctx,
+    struct whisper_state * draft_state,
+    wb_decoder_kv * draft_kv,
+    const wb_decoder_params * params,
+    int n_draft,
+    int32_t * tokens,
+    int capacity,
+    wb_speculative_stats * stats
+) {
+    const whisper_token eot = whisper_token_eot(ctx);
+    if (draft_ctx == nullptr || draft_state == nullptr || n_draft < 1 ||
+        whisper_n_vocab(draft_ctx) != whisper_n_vocab(ctx) || whisper_token_eot(draft_ctx) != eot) {
+        return wb_decode_greedy(ctx, state, params, tokens, capacity);
+    }
+
+    const size_t n_text_ctx = (size_t) std::min(whisper_n_text_ctx(ctx), whisper_n_text_ctx(draft_ctx));
+    report_runaway(params, false);
+
+    std::vector<whisper_token> prompt;
+    if (!build_prompt(ctx, params, prompt)) {
+        return -1;
+    }
+
+    const int max_tokens = max_new_tokens(ctx, params, capacity);
+
+    wb_decoder_kv local, draft_local;
+    wb_decoder_kv & kv  = params->kv != nullptr ? *params->kv : local;
+    wb_decoder_kv & dkv = draft_kv != nullptr ? *draft_kv : draft_local;
+    const suppression suppress(ctx, params);
+
+    wb_speculative_stats counts = {};
+    std::vector<whisper_token> seq = prompt;
+    std::vector<whisper_token> drafted;
+    bool drafting = true;   // off for good if the draft model fails
+    int  n_tokens = 0;
+
+    while (n_tokens < max_tokens && seq.size() < n_text_ctx) {
+        if (wb_cancel_token_is_cancelled(params->token)) {
+            return -1;
+        }
+
+        // Draft greedily; the target then scores seq + drafts, which must fit its context
+        const size_t room = std::min({ (size_t) n_draft, (size_t) (max_tokens - n_tokens), n_text_ctx - seq.size() - 1 });
+        drafted.assign(seq.begin(), seq.end());
+        while (drafting && drafted.size() - seq.size() < room) {
+            const float * logits = advance(draft_ctx, draft_state, dkv, drafted, params->n_threads);
+            if (logits == nullptr) {
+                drafting = false;
+                break;
+            }
+            const whisper_token next = suppress.pick(logits, n_tokens == 0 && drafted.size() == seq.size());
+            if (next < 0 || next == eot) {
+                break;
+            }
+            drafted.push_back(next);
+        }
+        const size_t n_proposed = drafted.size() - seq.size();
+        counts.drafted += (int) n_proposed;
+
+        // Check the drafts in order, one target call each (a call yields only its last row):
+        // keep what the target agrees with, then its own token where it disagrees (or after
+        // the last draft), exactly the tokens greedy decoding picks
+        const size_t base = seq.size();
+        bool ended = false;
+        for (size_t i = 0; i <= n_proposed; ++i) {
+            if (i > 0 && wb_cancel_token_is_cancelled(params->token)) {
+                return -1;
+            }
+
+            const float * logits = advance(ctx, state, kv, seq, params->n_threads);
+            if (logits == nullptr) {
+                return -1;
+            }
+            counts.target_passes++;
+
+            const whisper_token best = suppress.pick(logits, n_tokens == 0);
+            if (best < 0 || best == eot) {
+                ended = true;
+                break;
+            }
+
+            tokens[n_tokens++] = best;
+            seq.push_back(best);
+
+            const int cut = runaway_cut(params, tokens, n_tokens);
+            if (cut > 0) {
+                report_runaway(params, true);
+                n_tokens = cut;
+                ended = true;
+                break;
+            }
+
+            const bool agreed = i < n_proposed && best == drafted[base + i];
+            counts.accepted += agreed ? 1 : 0;
+            if (!agreed || n_tokens >= max_tokens) {
+                break;
+            }
+        }
+        if (ended) {
+            break;
+        }
+    }
+
+    if (stats != nullptr) {
+        *stats = counts;
+    }
+    return n_tokens;
+}
+
+int wb_decode_beam(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    const wb_decoder_params * params,
+    const wb_beam_params * beam,
+    int32_t * tokens,
+    int capacity
+) {
+    if (beam == nullptr || beam->beam_size <= 1) {
+        return wb_decode_greedy(ctx, state, params, tokens, capacity);
+    }
+
+    const int n_text_ctx = whisper_n_text_ctx(ctx);
+    const whisper_token eot = whisper_token_eot(ctx);
+    const int beam_size  = std::min(beam->beam_size, WB_LOGITS_MAX_TOP);
+    const size_t enough  = (size_t) std::max(1, (int) std::lround(beam_size * (beam->patience > 0.0f ? beam->patience : 1.0f)));
+    report_runaway(params, false);
+
+    std::vector<whisper_token> prompt;
+    if (!build_prompt(ctx, params, prompt)) {
+        return -1;
+    }
+    const int n_prompt   = (int) prompt.size();
+    const int max_tokens = std::min(max_new_tokens(ctx, params, capacity), n_text_ctx - n_prompt);
+    if (max_tokens <= 0) {
+        return 0;
+    }
+
+    wb_decoder_kv local;
+    wb_decoder_kv & kv = params->kv != nullptr ? *params->kv : local;
+    const suppression suppress(ctx, params);
+
+    std::vector<tree_node>  tree;
+    std::vector<live_beam>  beams(1, live_beam{ -1, 0.0, prompt });
+    std::vector<hypothesis> finished;
+    std::vector<candidate>  candidates;
+    wb_logits_top           top;
+
+    for (int depth = 0; depth < max_tokens && !beams.empty(); ++depth) {
+        // Path order: neighbours share the longest prefixes
+        std::sort(beams.begin(), beams.end(), [](const live_beam & a, const live_beam & b) { return a.seq < b.seq; });
+
+        candidates.clear();
+        bool all_chose_eot = true;
+
+        for (size_t b = 0; b < beams.size(); ++b) {
+            if (wb_cancel_token_is_cancelled(params->token)) {
+                return -1;
+            }
+
+            const live_beam & current = beams[b];
+            const float * logits = advance(ctx, state, kv, current.seq, params->n_threads);
+            if (logits == nullptr) {
+                return -1;
+            }
+
+            wb_logits_top_k(suppress.get(), logits, depth == 0, beam_size, true, &top);
+
+            all_chose_eot = all_chose_eot && top.n > 0 && top.ids[0] == eot;
+            for (int k = 0; k < top.n; ++k) {
+                candidates.push_back(candidate{ (int) b, top.ids[k], current.sum_logprob + top.logprobs[k] });
+            }
+        }
+
+        // Best first; ties in beam order, as whisper_full keeps them
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const candidate & a, const candidate & c) { return a.sum_logprob > c.sum_logprob; });
+
+        // Every hypothesis wants to stop here: further steps would only extend weaker ones
+        if (all_chose_eot) {
+            for (const candidate & c : candidates) {
+                if (c.token == eot) {
+                    finished.push_back(hypothesis{ beams[(size_t) c.parent].node, length_score(c.sum_logprob, depth, beam->length_penalty), false });
+                }
+            }
+            break;
+        }
+
+        // As whisper_full: walking down the ranking until beam_size beams live on, an EOT
+        // met on the way ends its hypothesis. An EOT ranked below them ends nothing.
+        std::vector<live_beam> next;
+        next.reserve((size_t) beam_size);
+        for (const candidate & c : candidates) {
+            if (next.size() >= (size_t) beam_size ||
+                (beam->prune_logprob > 0.0f && c.sum_logprob < candidates[0].sum_logprob - beam->prune_logprob)) {
+                break;
+            }
+            const live_beam & parent = beams[(size_t) c.parent];
+            if (c.token == eot) {
+                finished.push_back(hypothesis{ parent.node, length_score(c.sum_logprob, depth, beam->length_penalty), false });
+                continue;
+            }
+
+            live_beam child{ -1, c.sum_logprob, parent.seq };
+            child.seq.push_back(c.token);
+
+            // A looping beam ends where its loop began, scored as it stood there
+            const int cut = runaway_cut(params, child.seq.data() + n_prompt, depth + 1);
+            if (cut > 0) {
+                int node = parent.node;
+                while (node >= 0 && tree[(size_t) node].depth > cut) {
+                    node = tree[(size_t) node].parent;
+                }
+                const double sum_logprob = node >= 0 ? tree[(size_t) node].sum_logprob : 0.0;
+                finished.push_back(hypothesis{ node, length_score(sum_logprob, cut, beam->length_penalty), true });
+                continue;
+            }
+
+            tree.push_back(tree_node{ c.token, parent.node, depth + 1, c.sum_logprob });
+            child.node = (int) tree.size() - 1;
+            next.push_back(std::move(child));
+        }
+        beams.swap(next);
+
+        if (finished.size() >= enough) {
+            break;
+        }
+    }
+
+    // Best ended hypothesis, or the best unfinished one if none ended in time
+    int    best_node  = -2;
+    double best_score = 0.0;
+    bool   best_cut   = false;
+    for (const auto & h : finished) {
+        if (best_node == -2 || h.score > best_score) {
+            best_node  = h.node;
+            best_score = h.score;
+            best_cut   = h.cut;
+        }
+    }
+    if (best_node == -2) {
+        for (const auto & b : beams) {
+            const double score = length_score(b.sum_logprob, (int) b.seq.size() - n_prompt, beam->length_penalty);
+            if (best_node == -2 || score > best_score) {
+                best_node  = b.node;
+                best_score = score;
+            }
+        }
+    }
+    report_runaway(params, best_cut);
+    if (best_node < 0) {
+        return 0;
+    }
+
+    const std::vector<whisper_token> best = path_to(tree, best_node);
+    const int n_tokens = std::min((int) best.size(), capacity);
+    std::copy(best.begin(), best.begin() + n_tokens, tokens);
+    return n_tokens;
+}
@@ -0,0 +1,126 @@
+//
+//  wb_decoder.h
+//  WhisperBoard
+//
+//  Text decoder over a whisper_state whose encoder has already run
+//  Lets the encoder pass be scheduled separately from decoding (whisper_full
+//  always encodes and decodes together). Greedy or beam search, no timestamps.
+//
+
+#ifndef wb_decoder_h
+#define wb_decoder_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wb_cancel.h"
+#include "wb_logits.h"
+#include "wb_repetition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct whisper_context;
+struct whisper_state;
+
+// Tracks which tokens a state's decoder KV cache holds, so decodes on the same encoder
+// output keep their common prefix (prompt and earlier text) instead of recomputing it.
+// From the second layer on that KV depends on the audio through cross-attention, so it
+// is only reusable until the state is encoded again: reset after every encode.
+typedef struct wb_decoder_kv wb_decoder_kv;
+
+wb_decoder_kv * wb_decoder_kv_create(struct whisper_context * ctx);
+void wb_decoder_kv_free(wb_decoder_kv * kv);
+void wb_decoder_kv_reset(wb_decoder_kv * kv);
+
+// Self-attention KV a whisper_state allocates for the full text context (f16 K and V)
+size_t wb_decoder_kv_state_bytes(struct whisper_context * ctx);
+
+typedef struct wb_decoder_params {
+    int               n_threads;
+    int               max_tokens;        // 0 = up to half the text context
+    const char *      language;          // NULL = "en"
+    bool              translate;
+    const int32_t *   prompt_tokens;     // earlier text of the session, oldest first (may be NULL)
+    int               n_prompt_tokens;
+    wb_cancel_token * token;             // checked between decoder steps (may be NULL)
+    wb_decoder_kv *   kv;                // the state's KV tracker (NULL = nothing reused between calls)
+    const wb_logits_mask * mask;         // suppressed tokens (NULL = those after EOT and blank, built per call)
+    bool              stop_runaway;      // end the decode at a repetition loop, dropping the repeats (wb_repetition)
+    bool *            runaway;           // set to whether it did (may be NULL)
+} wb_decoder_params;
+
+wb_decoder_params wb_decoder_default_params(void);
+
+// Decode the audio encoded in `state` (whisper_encode_with_state). Writes up to `capacity`
+// text tokens, without special tokens, to `tokens`.
+// Returns the token count, or -1 if decoding failed or `token` was cancelled.
+int wb_decode_greedy(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    const wb_decoder_params * params,
+    int32_t * tokens,
+    int capacity
+);
+
+typedef struct wb_speculative_stats {
+    int drafted;         // tokens proposed by the draft model
+    int accepted;        // drafted tokens the target model agreed with
+    int target_passes;   // target decoder calls (one per token checked, as greedy)
+} wb_speculative_stats;
+
+// Greedy decoding checked against a smaller model's guesses. `draft_state` holds the same
+// audio encoded by `draft_ctx`; it proposes up to `n_draft` tokens, `state` checks them in
+// order, and the prefix it agrees with is kept plus its own next token. Produces the tokens
+// wb_decode_greedy would on `state`. whisper.cpp's public decode returns logits for the last
+// fed token only, so each check is its own target call: the target makes as many calls as
+// greedy, and the draft's calls come on top. That makes it slower than greedy until
+// whisper.cpp exposes a logits row per fed token, so only Bench/bench_decoder uses it.
+// Both models must share the vocabulary, otherwise this is plain greedy. `draft_kv` tracks
+// `draft_state` (may be NULL); `stats` may be NULL.
+int wb_decode_speculative(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    struct whisper_context * draft_ctx,
+    struct whisper_state * draft_state,
+    wb_decoder_kv * draft_kv,
+    const wb_decoder_params * params,
+    int n_draft,
+    int32_t * tokens,
+    int capacity,
+    wb_speculative_stats * stats
+);
+
+typedef struct wb_beam_params {
+    int   beam_size;       // beams kept per step (<= 1 falls back to greedy, at most WB_LOGITS_MAX_TOP)
+    float patience;        // stop once beam_size * patience hypotheses have ended
+    float length_penalty;  // < 0: rank by mean log-probability; else by sum / ((5 + length) / 6)^penalty
+    float prune_logprob;   // drop beams this far (nats) below the best live beam (<= 0 = never)
+} wb_beam_params;
+
+wb_beam_params wb_beam_default_params(void);
+
+// Beam search over the same prompt as wb_decode_greedy. Beams form a prefix tree and the
+// state's KV cache holds one path at a time: visiting beams in path order, each decode
+// keeps the prefix it shares with the previous beam and only feeds the tokens after it.
+// Leaves the KV tracker on the last beam visited.
+// A hypothesis ends where EOT ranks among the step's beam_size best continuations, as in
+// whisper_full. Decoding stops early once every live beam picks EOT. With `stop_runaway`, a beam that
+// starts looping ends there as a hypothesis without its repeats.
+// Returns the token count of the best hypothesis, or -1 on failure or cancellation.
+int wb_decode_beam(
+    struct whisper_context * ctx,
+    struct whisper_state * state,
+    const wb_decoder_params * params,
+    const wb_beam_params * beam,
+    int32_t * tokens,
+    int capacity
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_decoder_h */
@@ -0,0 +1,450 @@
+//
+//  wb_dir_index.cpp
+//  WhisperBoard
+//
+//  Directory index backing AppGroups polling and cleanup
+//  Only the initial pass stats every file; afterwards each change notification
+//  re-stats just the affected name (or the names whose inode changed)
+//  kqueue only says that the directory changed, so on Darwin an event costs a
+//  listing: known names are matched by inode through a reused key buffer and
+//  marked by pass number, so it allocates nothing and stats only new files
+//
+
+#include "wb_dir_index.h"
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#define WB_DIR_INDEX_INOTIFY 1
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#define WB_DIR_INDEX_KQUEUE 1
+#endif
+
+#if defined(__APPLE__)
+#define WB_ST_MTIME(st) ((st).st_mtimespec)
+#else
+#define WB_ST_MTIME(st) ((st).st_mtim)
+#endif
+
+namespace {
+
+struct cached_entry {
+    uint64_t ino;
+    int64_t  mtime_ns;
+    int64_t  size;
+    uint64_t seq  = 0;   // change order
+    uint64_t pass = 0;   // last rescan that listed it
+};
+
+using entry_map  = std::unordered_map<std::string, cached_entry>;
+using entry_node = entry_map::value_type;                  // node-stable: the orders point at it
+using mtime_key  = std::pair<int64_t, uint64_t>;           // (mtime_ns, seq)
+
+int64_t to_ns(const struct timespec & ts) {
+    return (int64_t) ts.tv_sec * 1000000000LL + (int64_t) ts.tv_nsec;
+}
+
+bool is_hidden(const char * name) {
+    return name[0] == '.';
+}
+
+bool ends_with(const std::string & s, const char * suffix) {
+    const size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+bool matches(const std::string & name, const cached_entry & e, const wb_dir_filter * f) {
+    if (f == nullptr) {
+        return true;
+    }
+    if (f->prefix && name.compare(0, strlen(f->prefix), f->prefix) != 0) {
+        return false;
+    }
+    if (f->suffix && !ends_with(name, f->suffix)) {
+        return false;
+    }
+    if (f->contains && name.find(f->contains) == std::string::npos) {
+        return false;
+    }
+    if (f->older_than_ns > 0 && e.mtime_ns >= f->older_than_ns) {
+        return false;
+    }
+    return true;
+}
+
+void copy_out(const entry_node & node, wb_dir_entry & out) {
+    strncpy(out.name, node.first.c_str(), WB_DIR_ENTRY_NAME_MAX - 1);
+    out.name[WB_DIR_ENTRY_NAME_MAX - 1] = '\0';
+    out.mtime_ns = node.second.mtime_ns;
+    out.size     = node.second.size;
+    out.seq      = node.second.seq;
+}
+
+// Enumerate directory entries without stat'ing them.
+// fn(name, ino, d_type)
+template <typename F>
+int scan_dir(int dir_fd, F && fn) {
+#if defined(__linux__)
+    struct linux_dirent64 {
+        uint64_t       d_ino;
+        int64_t        d_off;
+        unsigned short d_reclen;
+        unsigned char  d_type;
+        char           d_name[];
+    };
+
+    if (lseek(dir_fd, 0, SEEK_SET) < 0) {
+        return -errno;
+    }
+
+    alignas(8) char buf[16384];
+    for (;;) {
+        const long n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf));
+        if (n < 0) {
+            return -errno;
+        }
+        if (n == 0) {
+            break;
+        }
+        for (long off = 0; off < n;) {
+            const auto * d = reinterpret_cast<const linux_dirent64 *>(buf + off);
+            off += d->d_reclen;
+            fn(d->d_name, d->d_ino, d->d_type);
+        }
+    }
+    return 0;
+#else
+    // fdopendir takes ownership of the descriptor, so hand it a duplicate
+    const int fd = dup(dir_fd);
+    if (fd < 0) {
+        return -errno;
+    }
+    DIR * dir = fdopendir(fd);
+    if (dir == nullptr) {
+        const int err = errno;
+        close(fd);
+        return -err;
+    }
+    rewinddir(dir);
+    while (struct dirent * d = readdir(dir)) {
+        fn(d->d_name, (uint64_t) d->d_ino, d->d_type);
+    }
+    closedir(dir);
+    return 0;
+#endif
+}
+
+} // namespace
+
+struct wb_dir_index {
+    std::mutex  mutex;
+    std::string path;
+    int         dir_fd    = -1;
+    int         notify_fd = -1;
+    bool        needs_rescan = true;
+    int64_t     dir_mtime_ns = -1;
+
+    entry_map                          entries;
+    std::map<mtime_key, entry_node *>  by_mtime;   // oldest first
+    std::map<uint64_t, entry_node *>   by_seq;     // change order
+    uint64_t                           next_seq    = 0;
+    uint64_t                           rescan_pass = 0;
+    std::string                        scratch;    // lookup key, reused
+
+    void unlink_orders(const cached_entry & e) {
+        by_mtime.erase(mtime_key(e.mtime_ns, e.seq));
+        by_seq.erase(e.seq);
+    }
+
+    // Add or update a name; either way it moves to the end of the change order
+    void store(const std::string & name, const cached_entry & e) {
+        auto it = entries.find(name);
+        if (it == entries.end()) {
+            it = entries.emplace(name, e).first;
+        } else {
+            unlink_orders(it->second);
+            const uint64_t pass = it->second.pass;
+            it->second      = e;
+            it->second.pass = pass;
+        }
+        it->second.seq = ++next_seq;
+        by_mtime.emplace(mtime_key(e.mtime_ns, it->second.seq), &*it);
+        by_seq.emplace(it->second.seq, &*it);
+    }
+
+    entry_map::iterator drop(entry_map::iterator it) {
+        unlink_orders(it->second);
+        return entries.erase(it);
+    }
+
+    bool drop(const std::string & name) {
+        auto it = entries.find(name);
+        if (it == entries.end()) {
+            return false;
+        }
+        drop(it);
+        return true;
+    }
+
+    // Re-stat one name. Returns 1 if the index changed.
+    int restat(const std::string & name) {
+        struct stat st;
+        if (fstatat(dir_fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) {
+            return drop(name) ? 1 : 0;
+        }
+
+        cached_entry e = { (uint64_t) st.st_ino, to_ns(WB_ST_MTIME(st)), (int64_t) st.st_size };
+        auto it = entries.find(name);
+        if (it != entries.end() && it->second.ino == e.ino && it->second.mtime_ns == e.mtime_ns && it->second.size == e.size) {
+            return 0;
+        }
+        store(name, e);
+        return 1;
+    }
+
+    // Diff the directory listing against the cache; only new inodes are stat'ed.
+    int rescan() {
+        int changed = 0;
+        const uint64_t pass = ++rescan_pass;
+
+        const int rc = scan_dir(dir_fd, [&](const char * name, uint64_t ino, unsigned char type) {
+            if (is_hidden(name) || (type != DT_REG && type != DT_UNKNOWN)) {
+                return;
+            }
+            scratch.assign(name);
+            auto it = entries.find(scratch);
+            if (it == entries.end() || it->second.ino != ino) {
+                changed += restat(scratch);
+                it = entries.find(scratch);
+            }
+            if (it != entries.end()) {
+                it->second.pass = pass;
+            }
+        });
+        if (rc != 0) {
+            return rc;
+        }
+
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.pass != pass) {
+                it = drop(it);
+                changed++;
+            } else {
+                ++it;
+            }
+        }
+
+        needs_rescan = false;
+        return changed;
+    }
+
+    int refresh_locked() {
+        int changed = 0;
+
+#if defined(WB_DIR_INDEX_INOTIFY)
+        if (notify_fd >= 0) {
+            alignas(struct inotify_event) char buf[8192];
+            for (;;) {
+                const ssize_t n = read(notify_fd, buf, sizeof(buf));
+                if (n <= 0) {
+                    break;
+                }
+                for (ssize_t off = 0; off < n;) {
+                    const auto * ev = reinterpret_cast<const struct inotify_event *>(buf + off);
+                    off += sizeof(struct inotify_event) + ev->len;
+
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        needs_rescan = true;
+                    } else if (ev->len > 0 && !is_hidden(ev->name)) {
+                        scratch.assign(ev->name);
+                        changed += restat(scratch);
+                    }
+                }
+            }
+        }
+#elif defined(WB_DIR_INDEX_KQUEUE)
+        if (notify_fd >= 0) {
+            // Directory vnode events say "something changed" but not what,
+            // so fall back to an inode diff, which only stats new names.
+            struct kevent ev;
+            const struct timespec zero = { 0, 0 };
+            while (kevent(notify_fd, nullptr, 0, &ev, 1, &zero) > 0) {
+                needs_rescan = true;
+            }
+        }
+#endif
+
+        if (notify_fd < 0) {
+            struct stat st;
+            if (fstat(dir_fd, &st) != 0) {
+                return -errno;
+            }
+            const int64_t mtime_ns = to_ns(WB_ST_MTIME(st));
+            if (mtime_ns != dir_mtime_ns) {
+                dir_mtime_ns = mtime_ns;
+                needs_rescan = true;
+            }
+        }
+
+        if (needs_rescan) {
+            const int rc = rescan();
+            if (rc < 0) {
+                return rc;
+            }
+            changed += rc;
+        }
+
+        return changed;
+    }
+};
+
+wb_dir_index * wb_dir_index_open(const char * path) {
+    if (path == nullptr) {
+        return nullptr;
+    }
+
+    const int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    auto * index = new wb_dir_index();
+    index->path   = path;
+    index->dir_fd = fd;
+
+#if defined(WB_DIR_INDEX_INOTIFY)
+    index->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (index->notify_fd >= 0) {
+        const uint32_t mask = IN_CREATE | IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB |
+                              IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR;
+        if (inotify_add_watch(index->notify_fd, path, mask) < 0) {
+            close(index->notify_fd);
+            index->notify_fd = -1;
+        }
+    }
+#elif defined(WB_DIR_INDEX_KQUEUE)
+    index->notify_fd = kqueue();
+    if (index->notify_fd >= 0) {
+        struct kevent ev;
+        EV_SET(&ev, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+               NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_RENAME | NOTE_DELETE, 0, nullptr);
+        if (kevent(index->notify_fd, &ev, 1, nullptr, 0, nullptr) < 0) {
+            close(index->notify_fd);
+            index->notify_fd = -1;
+        }
+    }
+#endif
+
+    // Initial single pass (watch is armed first so nothing slips between the two)
+    std::lock_guard<std::mutex> lock(index->mutex);
+    index->refresh_locked();
+
+    return index;
+}
+
+void wb_dir_index_free(wb_dir_index * index) {
+    if (index == nullptr) {
+        return;
+    }
+    if (index->notify_fd >= 0) {
+        close(index->notify_fd);
+    }
+    if (index->dir_fd >= 0) {
+        close(index->dir_fd);
+    }
+    delete index;
+}
+
+int wb_dir_index_refresh(wb_dir_index * index) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+    return index->refresh_locked();
+}
+
+size_t wb_dir_index_count(wb_dir_index * index) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+    return index->entries.size();
+}
+
+size_t wb_dir_index_query(wb_dir_index * index, const wb_dir_filter * filter, wb_dir_cursor * cursor, wb_dir_entry * out, size_t capacity) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+
+    const bool first = cursor->mtime_ns == 0 && cursor->seq == 0;
+    if (first) {
+        index->refresh_locked();
+    }
+
+    const int64_t cutoff = filter != nullptr ? filter->older_than_ns : 0;
+    size_t n = 0;
+    auto it = first ? index->by_mtime.begin() : index->by_mtime.upper_bound(mtime_key(cursor->mtime_ns, cursor->seq));
+    while (it != index->by_mtime.end() && n < capacity) {
+        if (cutoff > 0 && it->first.first >= cutoff) {
+            break;   // everything after is newer still
+        }
+        const auto next = std::next(it);
+        entry_node * node = it->second;
+
+        // Age-based queries drive deletions: confirm each candidate's mtime so an
+        // in-place append that produced no directory event can't make it look stale.
+        // A candidate that changed has moved on in the order (or is gone).
+        if (cutoff > 0 && matches(node->first, node->second, filter)) {
+            index->scratch = node->first;
+            if (index->restat(index->scratch) != 0) {
+                it = next;
+                continue;
+            }
+        }
+
+        if (matches(node->first, node->second, filter)) {
+            copy_out(*node, out[n++]);
+            cursor->mtime_ns = node->second.mtime_ns;
+            cursor->seq      = node->second.seq;
+        }
+        it = next;
+    }
+    return n;
+}
+
+size_t wb_dir_index_changes(wb_dir_index * index, const wb_dir_filter * filter, uint64_t * since, wb_dir_entry * out, size_t capacity) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+    index->refresh_locked();
+
+    size_t n = 0;
+    for (auto it = index->by_seq.upper_bound(*since); it != index->by_seq.end() && n < capacity; ++it) {
+        *since = it->first;
+        if (matches(it->second->first, it->second->second, filter)) {
+            copy_out(*it->second, out[n++]);
+        }
+    }
+    return n;
+}
+
+int wb_dir_index_remove(wb_dir_index * index, const char * name) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+    const int rc = unlinkat(index->dir_fd, name, 0) == 0 ? 0 : -errno;
+    // A file that could not be unlinked is still there and stays indexed
+    if (rc == 0 || rc == -ENOENT) {
+        index->scratch.assign(name);
+        index->drop(index->scratch);
+    }
+    return rc;
+}
+
+void wb_dir_index_note_changed(wb_dir_index * index, const char * name) {
+    std::lock_guard<std::mutex> lock(index->mutex);
+    index->scratch.assign(name);
+    index->restat(index->scratch);
+}
@@ -0,0 +1,96 @@
+//
+//  wb_dir_index.h
+//  WhisperBoard
+//
+//  Cached index of an App Groups directory (name, mtime, size)
+//  One readdir/getdents + fstatat pass on open, then updated incrementally
+//  from change notifications (inotify on Linux, kqueue on Darwin)
+//  Entries are kept in mtime order and in change order, so queries page
+//  through them from a cursor instead of copying and sorting the directory
+//
+
+#ifndef wb_dir_index_h
+#define wb_dir_index_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WB_DIR_ENTRY_NAME_MAX 256
+
+typedef struct wb_dir_index wb_dir_index;
+
+// Snapshot of one indexed file
+typedef struct wb_dir_entry {
+    char     name[WB_DIR_ENTRY_NAME_MAX];
+    int64_t  mtime_ns;   // modification time, nanoseconds since 1970
+    int64_t  size;       // size in bytes
+    uint64_t seq;        // when the index last saw it added or changed (increasing, never 0)
+} wb_dir_entry;
+
+// Position in an mtime-ordered query: the last entry returned. Zeroed = before the oldest.
+typedef struct wb_dir_cursor {
+    int64_t  mtime_ns;
+    uint64_t seq;
+} wb_dir_cursor;
+
+// Query filter. NULL / 0 fields match everything.
+typedef struct wb_dir_filter {
+    const char * prefix;        // name must start with this
+    const char * suffix;        // name must end with this
+    const char * contains;      // name must contain this
+    int64_t      older_than_ns; // mtime must be < this (0 = no age limit)
+} wb_dir_filter;
+
+// Open an index for a directory. Returns NULL if the directory cannot be opened.
+wb_dir_index * wb_dir_index_open(const char * path);
+void           wb_dir_index_free(wb_dir_index * index);
+
+// Apply pending change notifications.
+// Costs one non-blocking read when nothing changed, regardless of how many files are indexed.
+// Returns the number of entries that were added/updated/removed, or -errno.
+int wb_dir_index_refresh(wb_dir_index * index);
+
+// Number of entries currently indexed (after the last refresh).
+size_t wb_dir_index_count(wb_dir_index * index);
+
+// Copy up to `capacity` matching entries into `out`, oldest mtime first (ties in change
+// order), starting after `cursor`, and move `cursor` to the last one copied. A zeroed cursor
+// refreshes first and starts at the oldest entry. Returns the number copied; fewer than
+// `capacity` means there are no more. With older_than_ns the walk stops at the first newer
+// entry, so it only touches the files old enough to match.
+size_t wb_dir_index_query(
+    wb_dir_index * index,
+    const wb_dir_filter * filter,
+    wb_dir_cursor * cursor,
+    wb_dir_entry * out,
+    size_t capacity
+);
+
+// Refresh, then copy up to `capacity` matching entries added or changed after `*since`
+// (an entry's seq; 0 = everything indexed) in the order the index saw them, and advance
+// `*since` past every entry looked at. Returns the number copied; fewer than `capacity`
+// means there are no more. A poller keeps `since` between polls and only sees new files.
+size_t wb_dir_index_changes(
+    wb_dir_index * index,
+    const wb_dir_filter * filter,
+    uint64_t * since,
+    wb_dir_entry * out,
+    size_t capacity
+);
+
+// Unlink a file and drop it from the index. Returns 0 or -errno (-ENOENT is not an error for callers that race).
+// On any other error the file is still there and keeps its entry.
+int wb_dir_index_remove(wb_dir_index * index, const char * name);
+
+// Re-stat a single file written by this process (cheaper than waiting for the notification).
+void wb_dir_index_note_changed(wb_dir_index * index, const char * name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_dir_index_h */
@@ -0,0 +1,318 @@
+//
+//  wb_journal.cpp
+//  WhisperBoard
+//
+//  Append-only session journal: one write(2) per record on the producer,
+//  an offset bump over an mmap'd window on the consumer
+//
+
+#include "wb_journal.h"
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct record_header {
+    uint32_t magic;
+    uint32_t length;
+    uint64_t seq;
+    uint32_t type;
+    uint32_t checksum;
+};
+
+static_assert(sizeof(record_header) == WB_JOURNAL_HEADER_SIZE, "journal header layout changed");
+
+uint32_t fnv1a(const void * data, size_t length) {
+    const auto * p = static_cast<const uint8_t *>(data);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+enum parse_result {
+    PARSE_OK,
+    PARSE_INCOMPLETE,   // producer is mid-write or file not grown yet
+    PARSE_TORN,         // full length present but checksum mismatch
+    PARSE_CORRUPT,      // bad magic / impossible length
+};
+
+parse_result parse(const uint8_t * p, size_t avail, record_header & hdr) {
+    if (avail < sizeof(record_header)) {
+        return PARSE_INCOMPLETE;
+    }
+    memcpy(&hdr, p, sizeof(hdr));
+    if (hdr.magic != WB_JOURNAL_MAGIC || hdr.length > WB_JOURNAL_MAX_PAYLOAD) {
+        return PARSE_CORRUPT;
+    }
+    if (avail < sizeof(record_header) + hdr.length) {
+        return PARSE_INCOMPLETE;
+    }
+    if (fnv1a(p + sizeof(record_header), hdr.length) != hdr.checksum) {
+        return PARSE_TORN;
+    }
+    return PARSE_OK;
+}
+
+size_t page_size() {
+    static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+} // namespace
+
+// MARK: - Reader
+
+struct wb_journal_reader {
+    int       fd       = -1;
+    uint64_t  offset   = 0;       // file offset of the next record
+    uint8_t * map      = nullptr;
+    size_t    map_len  = 0;
+    uint64_t  map_base = 0;       // file offset of map[0] (page aligned)
+    uint64_t  last_seq = 0;
+
+    uint64_t map_end() const {
+        return map_base + map_len;
+    }
+
+    void unmap() {
+        if (map != nullptr) {
+            munmap(map, map_len);
+            map     = nullptr;
+            map_len = 0;
+        }
+    }
+
+    // Map [offset rounded down to a page, EOF). Returns false if there are no new bytes.
+    bool remap() {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (uint64_t) st.st_size <= map_end()) {
+            return false;
+        }
+
+        unmap();
+
+        const uint64_t base = offset & ~((uint64_t) page_size() - 1);
+        const size_t   len  = (size_t) ((uint64_t) st.st_size - base);
+        void * p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, (off_t) base);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+
+        map      = static_cast<uint8_t *>(p);
+        map_len  = len;
+        map_base = base;
+        return true;
+    }
+
+    int next(wb_journal_record * out) {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (map != nullptr && offset >= map_base && offset < map_end()) {
+                const uint8_t * p     = map + (offset - map_base);
+                const size_t    avail = (size_t) (map_end() - offset);
+
+                record_header hdr;
+                switch (parse(p, avail, hdr)) {
+                    case PARSE_OK:
+                        out->seq     = hdr.seq;
+                        out->type    = hdr.type;
+                        out->length  = hdr.length;
+                        out->payload = p + sizeof(hdr);
+                        offset      += sizeof(hdr) + hdr.length;
+                        last_seq     = hdr.seq;
+                        return 1;
+
+                    case PARSE_TORN:
+                        // Only skip once later bytes prove the producer moved on
+                        if (avail > sizeof(hdr) + hdr.length) {
+                            offset += sizeof(hdr) + hdr.length;
+                            continue;
+                        }
+                        break;
+
+                    case PARSE_CORRUPT:
+                        return -EBADMSG;
+
+                    case PARSE_INCOMPLETE:
+                        break;
+                }
+            }
+
+            if (!remap()) {
+                return 0;
+            }
+        }
+        return 0;
+    }
+};
+
+wb_journal_reader * wb_journal_reader_open(const char * path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto * reader = new wb_journal_reader();
+    reader->fd = fd;
+    return reader;
+}
+
+void wb_journal_reader_close(wb_journal_reader * reader) {
+    if (reader == nullptr) {
+        return;
+    }
+    reader->unmap();
+    close(reader->fd);
+    delete reader;
+}
+
+int wb_journal_reader_next(wb_journal_reader * reader, wb_journal_record * out) {
+    return reader->next(out);
+}
+
+uint64_t wb_journal_reader_last_seq(wb_journal_reader * reader) {
+    return reader->last_seq;
+}
+
+// MARK: - Writer
+
+struct wb_journal_writer {
+    std::mutex           mutex;
+    int                  fd       = -1;
+    uint64_t             next_seq = 1;
+    std::vector<uint8_t> buf;
+};
+
+wb_journal_writer * wb_journal_writer_open(const char * path) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    auto * writer = new wb_journal_writer();
+    writer->fd = fd;
+
+    // Continue numbering after whatever is already in the file
+    if (wb_journal_reader * reader = wb_journal_reader_open(path)) {
+        wb_journal_record rec;
+        while (reader->next(&rec) > 0) {
+        }
+        writer->next_seq = reader->last_seq + 1;
+        wb_journal_reader_close(reader);
+    }
+
+    return writer;
+}
+
+void wb_journal_writer_close(wb_journal_writer * writer) {
+    if (writer == nullptr) {
+        return;
+    }
+    close(writer->fd);
+    delete writer;
+}
+
+int64_t wb_journal_append(wb_journal_writer * writer, uint32_t type, const void * payload, size_t length) {
+    if (length > WB_JOURNAL_MAX_PAYLOAD) {
+        return -EMSGSIZE;
+    }
+
+    std::lock_guard<std::mutex> lock(writer->mutex);
+
+    record_header hdr;
+    hdr.magic    = WB_JOURNAL_MAGIC;
+    hdr.length   = (uint32_t) length;
+    hdr.seq      = writer->next_seq;
+    hdr.type     = type;
+    hdr.checksum = fnv1a(payload, length);
+
+    writer->buf.resize(sizeof(hdr) + length);
+    memcpy(writer->buf.data(), &hdr, sizeof(hdr));
+    if (length > 0) {
+        memcpy(writer->buf.data() + sizeof(hdr), payload, length);
+    }
+
+    // One write(2); the loop only runs again on a short write
+    size_t done = 0;
+    while (done < writer->buf.size()) {
+        const ssize_t n = write(writer->fd, writer->buf.data() + done, writer->buf.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        done += (size_t) n;
+    }
+
+    return (int64_t) writer->next_seq++;
+}
+
+// MARK: - Compaction
+
+int64_t wb_journal_compact(const char * path) {
+    wb_journal_reader * reader = wb_journal_reader_open(path);
+    if (reader == nullptr) {
+        return -errno;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0) {
+        const int err = errno;
+        wb_journal_reader_close(reader);
+        return -err;
+    }
+
+    // Newest record per type, ordered by sequence number
+    std::map<uint32_t, std::pair<uint64_t, std::vector<uint8_t>>> latest;
+    wb_journal_record rec;
+    while (reader->next(&rec) > 0) {
+        const auto * p = static_cast<const uint8_t *>(rec.payload);
+        latest[rec.type] = { rec.seq, std::vector<uint8_t>(p, p + rec.length) };
+    }
+    wb_journal_reader_close(reader);
+
+    std::map<uint64_t, std::pair<uint32_t, const std::vector<uint8_t> *>> ordered;
+    for (const auto & kv : latest) {
+        ordered[kv.second.first] = { kv.first, &kv.second.second };
+    }
+
+    std::vector<uint8_t> out;
+    for (const auto & kv : ordered) {
+        const auto & payload = *kv.second.second;
+        record_header hdr = { WB_JOURNAL_MAGIC, (uint32_t) payload.size(), kv.first, kv.second.first, fnv1a(payload.data(), payload.size()) };
+        const auto * h = reinterpret_cast<const uint8_t *>(&hdr);
+        out.insert(out.end(), h, h + sizeof(hdr));
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    // Hidden temp name so directory indexes and cleanup passes never see it
+    std::string tmp(path);
+    const size_t slash = tmp.find_last_of('/');
+    tmp.insert(slash == std::string::npos ? 0 : slash + 1, ".");
+    tmp += ".compact";
+    const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+    const bool ok = write(fd, out.data(), out.size()) == (ssize_t) out.size();
+    close(fd);
+
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        const int err = ok ? errno : EIO;
+        unlink(tmp.c_str());
+        return -err;
+    }
+
+    return (int64_t) st.st_size - (int64_t) out.size();
+}
@@ -0,0 +1,78 @@
+//
+//  wb_journal.h
+//  WhisperBoard
+//
+//  Per-session append-only journal for streaming updates (main app → keyboard)
+//  Length-prefixed binary records with a monotonically increasing sequence number
+//
+//  Record layout (little-endian, no padding):
+//    uint32 magic | uint32 length | uint64 seq | uint32 type | uint32 checksum | payload[length]
+//
+
+#ifndef wb_journal_h
+#define wb_journal_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WB_JOURNAL_MAGIC       0x4A425752u   // "RWBJ"
+#define WB_JOURNAL_HEADER_SIZE 24
+#define WB_JOURNAL_MAX_PAYLOAD (1u << 20)
+
+// Record types carried by the journal
+enum wb_journal_record_type {
+    WB_JOURNAL_TOKEN_UPDATE         = 1,
+    WB_JOURNAL_TRANSCRIPTION_RESULT = 2,
+    WB_JOURNAL_BATCH_PROGRESS       = 3,   // Batch/ CLI: a finished file (not in session journals)
+};
+
+typedef struct wb_journal_writer wb_journal_writer;
+typedef struct wb_journal_reader wb_journal_reader;
+
+// Record view returned by the reader.
+// `payload` points into the reader's mapping and stays valid until the next call on that reader.
+typedef struct wb_journal_record {
+    uint64_t     seq;
+    uint32_t     type;
+    uint32_t     length;
+    const void * payload;
+} wb_journal_record;
+
+// Producer
+
+// Open (creating if needed) a journal for appending. Sequence numbers continue after the last existing record.
+wb_journal_writer * wb_journal_writer_open(const char * path);
+void                wb_journal_writer_close(wb_journal_writer * writer);
+
+// Append one record with a single write(2). Returns the record's sequence number, or -errno.
+int64_t wb_journal_append(wb_journal_writer * writer, uint32_t type, const void * payload, size_t length);
+
+// Consumer
+
+// Open a journal for reading from the start. Returns NULL if the file does not exist yet.
+wb_journal_reader * wb_journal_reader_open(const char * path);
+void                wb_journal_reader_close(wb_journal_reader * reader);
+
+// Fetch the next complete record.
+// Returns 1 and fills `out` if a record is available, 0 if the reader is caught up, or -errno.
+int wb_journal_reader_next(wb_journal_reader * reader, wb_journal_record * out);
+
+// Sequence number of the last record returned (0 = none yet)
+uint64_t wb_journal_reader_last_seq(wb_journal_reader * reader);
+
+// Maintenance
+
+// Rewrite the journal keeping only the newest record of each type, then atomically replace it.
+// Readers that already have the old file open keep reading it to the end.
+// Returns the number of bytes reclaimed, or -errno.
+int64_t wb_journal_compact(const char * path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_journal_h */
@@ -0,0 +1,319 @@
+//
+//  wb_logits.cpp
+//  WhisperBoard
+//
+//  The vocabulary is walked in blocks of 64 tokens, one mask word each. A block
+//  is loaded once: suppressed lanes are replaced by -inf while taking its max,
+//  the masked copy stays in L1 for the top-k check (only blocks whose max can
+//  still place) and for the exp sum of an online log-softmax (the running sum
+//  is rescaled when a block raises the max). Tokens after EOT are never
+//  walked, and fully suppressed blocks are skipped without loading them.
+//
+
+#include "wb_logits.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct wb_logits_mask {
+    int                   limit = 0;    // EOT + 1: no token at or after it is ever a candidate
+    std::vector<uint64_t> any_step;     // bit set = suppressed; bits past `limit` are set
+    std::vector<uint64_t> first_step;   // any_step plus blank and EOT
+};
+
+namespace {
+
+constexpr int   k_block   = 64;
+constexpr float k_neg_inf = -std::numeric_limits<float>::infinity();
+
+// As whisper.cpp's suppress_non_speech_tokens, each also with a leading space
+const char * const k_non_speech[] = {
+    "\"", "#", "(", ")", "*", "+", "/", ":", ";", "<", "=", ">", "@", "[", "\\", "]", "^",
+    "_", "`", "{", "|", "}", "~", "「", "」", "『", "』", "<<", ">>", "<<<", ">>>", "--",
+    "---", "-(", "-[", "('", "(\"", "((", "))", "(((", ")))", "[[", "]]", "{{", "}}", "♪♪",
+    "♪♪♪", "♩", "♪", "♫", "♬", "♭", "♮", "♯",
+};
+
+void set_bit(std::vector<uint64_t> & bits, int id) {
+    bits[(size_t) id / k_block] |= uint64_t(1) << (id % k_block);
+}
+
+// Suppress `text` if it is a single token
+void suppress_text(whisper_context * ctx, std::vector<uint64_t> & bits, int limit, const std::string & text) {
+    whisper_token tokens[4];
+    if (whisper_tokenize(ctx, text.c_str(), tokens, 4) == 1 && tokens[0] >= 0 && tokens[0] < limit) {
+        set_bit(bits, tokens[0]);
+    }
+}
+
+// MARK: - Block kernels
+// masked_block: copy 64 logits to `dst` with suppressed lanes at -inf, return their max
+// exp_sum:      sum of exp(dst[i] - ref) over the block
+
+#if defined(__aarch64__) || defined(__SSE2__)
+
+// Lane masks for 4 mask bits: all-ones where the bit is set
+struct lane_masks {
+    alignas(16) uint32_t lanes[16][4];
+
+    lane_masks() {
+        for (int bits = 0; bits < 16; ++bits) {
+            for (int lane = 0; lane < 4; ++lane) {
+                lanes[bits][lane] = (bits >> lane) & 1 ? 0xffffffffu : 0u;
+            }
+        }
+    }
+};
+
+const lane_masks k_lanes;
+
+#endif
+
+#if defined(__aarch64__)
+
+// Cephes expf: range reduction by ln 2, degree-5 polynomial, exponent bits from the integer part
+inline float32x4_t exp4(float32x4_t x) {
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.3f)), vdupq_n_f32(88.3f));
+    const float32x4_t fx = vrndmq_f32(vfmaq_f32(vdupq_n_f32(0.5f), x, vdupq_n_f32(1.44269504088896341f)));
+    x = vfmsq_f32(x, fx, vdupq_n_f32(0.693359375f));
+    x = vfmsq_f32(x, fx, vdupq_n_f32(-2.12194440e-4f));
+
+    float32x4_t y = vdupq_n_f32(1.9875691500e-4f);
+    y = vfmaq_f32(vdupq_n_f32(1.3981999507e-3f), y, x);
+    y = vfmaq_f32(vdupq_n_f32(8.3334519073e-3f), y, x);
+    y = vfmaq_f32(vdupq_n_f32(4.1665795894e-2f), y, x);
+    y = vfmaq_f32(vdupq_n_f32(1.6666665459e-1f), y, x);
+    y = vfmaq_f32(vdupq_n_f32(5.0000001201e-1f), y, x);
+    y = vfmaq_f32(vaddq_f32(x, vdupq_n_f32(1.0f)), y, vmulq_f32(x, x));
+
+    const int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(fx), vdupq_n_s32(127)), 23);
+    return vmulq_f32(y, vreinterpretq_f32_s32(e));
+}
+
+float masked_block(const float * src, uint64_t word, float * dst) {
+    const float32x4_t neg_inf = vdupq_n_f32(k_neg_inf);
+    float32x4_t best = neg_inf;
+    for (int j = 0; j < k_block / 4; ++j, word >>= 4) {
+        const uint32x4_t m = vld1q_u32(k_lanes.lanes[word & 15]);
+        const float32x4_t v = vbslq_f32(m, neg_inf, vld1q_f32(src + 4 * j));
+        best = vmaxq_f32(best, v);
+        vst1q_f32(dst + 4 * j, v);
+    }
+    return vmaxvq_f32(best);
+}
+
+float exp_sum(const float * block, float ref) {
+    const float32x4_t r = vdupq_n_f32(ref);
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (int j = 0; j < k_block / 4; ++j) {
+        sum = vaddq_f32(sum, exp4(vsubq_f32(vld1q_f32(block + 4 * j), r)));
+    }
+    return vaddvq_f32(sum);
+}
+
+#elif defined(__SSE2__)
+
+inline __m128 exp4(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.3f));
+    const __m128 t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+    __m128 fx = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    fx = _mm_sub_ps(fx, _mm_and_ps(_mm_cmpgt_ps(fx, t), _mm_set1_ps(1.0f)));   // floor
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+    const __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(e));
+}
+
+inline float hmax(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+inline float hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+float masked_block(const float * src, uint64_t word, float * dst) {
+    const __m128 neg_inf = _mm_set1_ps(k_neg_inf);
+    __m128 best = neg_inf;
+    for (int j = 0; j < k_block / 4; ++j, word >>= 4) {
+        const __m128 m = _mm_load_ps(reinterpret_cast<const float *>(k_lanes.lanes[word & 15]));
+        const __m128 v = _mm_or_ps(_mm_and_ps(m, neg_inf), _mm_andnot_ps(m, _mm_loadu_ps(src + 4 * j)));
+        best = _mm_max_ps(best, v);
+        _mm_storeu_ps(dst + 4 * j, v);
+    }
+    return hmax(best);
+}
+
+float exp_sum(const float * block, float ref) {
+    const __m128 r = _mm_set1_ps(ref);
+    __m128 sum = _mm_setzero_ps();
+    for (int j = 0; j < k_block / 4; ++j) {
+        sum = _mm_add_ps(sum, exp4(_mm_sub_ps(_mm_loadu_ps(block + 4 * j), r)));
+    }
+    return hsum(sum);
+}
+
+#else
+
+float masked_block(const float * src, uint64_t word, float * dst) {
+    float best = k_neg_inf;
+    for (int i = 0; i < k_block; ++i) {
+        dst[i] = (word >> i) & 1 ? k_neg_inf : src[i];
+        best = std::max(best, dst[i]);
+    }
+    return best;
+}
+
+float exp_sum(const float * block, float ref) {
+    float sum = 0.0f;
+    for (int i = 0; i < k_block; ++i) {
+        sum += std::exp(block[i] - ref);
+    }
+    return sum;
+}
+
+#endif
+
+// Best-first insertion; equal values keep the earlier (lower) id
+void offer(wb_logits_top & top, int k, float value, int32_t id) {
+    int pos = top.n < k ? top.n : k - 1;
+    if (top.n == k && !(value > top.logprobs[k - 1])) {
+        return;
+    }
+    while (pos > 0 && value > top.logprobs[pos - 1]) {
+        top.ids[pos]      = top.ids[pos - 1];
+        top.logprobs[pos] = top.logprobs[pos - 1];
+        --pos;
+    }
+    top.ids[pos]      = id;
+    top.logprobs[pos] = value;
+    if (top.n < k) {
+        top.n++;
+    }
+}
+
+} // namespace
+
+wb_logits_mask * wb_logits_mask_create(struct whisper_context * ctx, bool suppress_non_speech) {
+    auto * mask = new wb_logits_mask();
+    mask->limit = whisper_token_eot(ctx) + 1;
+
+    const size_t words = ((size_t) mask->limit + k_block - 1) / k_block;
+    mask->any_step.assign(words, 0);
+    for (int id = mask->limit; id < (int) (words * k_block); ++id) {
+        set_bit(mask->any_step, id);
+    }
+
+    if (suppress_non_speech) {
+        for (const char * symbol : k_non_speech) {
+            suppress_text(ctx, mask->any_step, mask->limit, symbol);
+            suppress_text(ctx, mask->any_step, mask->limit, std::string(" ") + symbol);
+        }
+        // Hyphens and apostrophes only inside words
+        suppress_text(ctx, mask->any_step, mask->limit, " -");
+        suppress_text(ctx, mask->any_step, mask->limit, " '");
+    }
+
+    mask->first_step = mask->any_step;
+    set_bit(mask->first_step, whisper_token_eot(ctx));
+    suppress_text(ctx, mask->first_step, mask->limit, " ");
+    return mask;
+}
+
+void wb_logits_mask_free(wb_logits_mask * mask) {
+    delete mask;
+}
+
+bool wb_logits_suppressed(const wb_logits_mask * mask, int32_t id, bool first_step) {
+    if (id < 0 || id >= mask->limit) {
+        return true;
+    }
+    const std::vector<uint64_t> & bits = first_step ? mask->first_step : mask->any_step;
+    return (bits[(size_t) id / k_block] >> (id % k_block)) & 1;
+}
+
+int wb_logits_top_k(
+    const wb_logits_mask * mask,
+    const float * logits,
+    bool first_step,
+    int k,
+    bool normalize,
+    wb_logits_top * top
+) {
+    top->n = 0;
+    k = std::max(1, std::min(k, WB_LOGITS_MAX_TOP));
+
+    const std::vector<uint64_t> & bits = first_step ? mask->first_step : mask->any_step;
+    const int n_words = (int) bits.size();
+
+    alignas(16) float block[k_block];
+    alignas(16) float tail[k_block];
+    float run_max = k_neg_inf;
+    float run_sum = 0.0f;
+
+    for (int w = 0; w < n_words; ++w) {
+        const uint64_t word = bits[(size_t) w];
+        if (word == ~uint64_t(0)) {
+            continue;
+        }
+
+        // The last block may end before a full 64 logits; its padding bits are set
+        const int base = w * k_block;
+        const float * src = logits + base;
+        if (base + k_block > mask->limit) {
+            const int count = mask->limit - base;
+            std::memcpy(tail, src, sizeof(float) * (size_t) count);
+            std::fill(tail + count, tail + k_block, k_neg_inf);
+            src = tail;
+        }
+
+        const float block_max = masked_block(src, word, block);
+
+        if (top->n < k || block_max > top->logprobs[k - 1]) {
+            for (int i = 0; i < k_block; ++i) {
+                if (block[i] != k_neg_inf) {
+                    offer(*top, k, block[i], base + i);
+                }
+            }
+        }
+
+        if (normalize && block_max != k_neg_inf) {
+            if (block_max > run_max) {
+                run_sum = run_sum * std::exp(run_max - block_max);
+                run_max = block_max;
+            }
+            run_sum += exp_sum(block, run_max);
+        }
+    }
+
+    const float log_sum = normalize && top->n > 0 ? run_max + std::log(run_sum) : 0.0f;
+    for (int i = 0; i < top->n; ++i) {
+        top->logprobs[i] = normalize ? top->logprobs[i] - log_sum : 0.0f;
+    }
+    return top->n;
+}
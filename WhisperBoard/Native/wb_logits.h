@@ -0,0 +1,60 @@
+//
+//  wb_logits.h
+//  WhisperBoard
+//
+//  Per-step logits processing for wb_decoder in a single pass over the vocabulary:
+//  suppressed tokens, the log-softmax normaliser and the best k tokens together,
+//  NEON or SSE2 where available. Decoding runs without timestamps, so every token
+//  after EOT (special and timestamp tokens) is always suppressed.
+//
+
+#ifndef wb_logits_h
+#define wb_logits_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct whisper_context;
+
+#define WB_LOGITS_MAX_TOP 16
+
+typedef struct wb_logits_mask wb_logits_mask;
+
+// Bitmask of the tokens the decoder never emits for `ctx`: everything after EOT and, with
+// `suppress_non_speech`, whisper's non-speech symbols (as suppress_non_speech_tokens).
+// The first step also suppresses blank and EOT, as suppress_blank does. Read-only once
+// built: one mask can serve every decoder thread.
+wb_logits_mask * wb_logits_mask_create(struct whisper_context * ctx, bool suppress_non_speech);
+void wb_logits_mask_free(wb_logits_mask * mask);
+
+// Whether the mask suppresses `id` (ids outside the vocabulary count as suppressed), so a
+// reference implementation can apply the same suppression token by token.
+bool wb_logits_suppressed(const wb_logits_mask * mask, int32_t id, bool first_step);
+
+typedef struct wb_logits_top {
+    int     n;                              // tokens found (up to k)
+    int32_t ids[WB_LOGITS_MAX_TOP];         // best first; ties go to the lower id
+    float   logprobs[WB_LOGITS_MAX_TOP];    // log-softmax over the allowed tokens (0 without `normalize`)
+} wb_logits_top;
+
+// The `k` (<= WB_LOGITS_MAX_TOP) best allowed tokens of one row of logits. `normalize`
+// also computes their log-probabilities; greedy decoding only needs the argmax and skips it.
+// Returns the number of tokens found.
+int wb_logits_top_k(
+    const wb_logits_mask * mask,
+    const float * logits,
+    bool first_step,
+    int k,
+    bool normalize,
+    wb_logits_top * top
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_logits_h */
@@ -0,0 +1,266 @@
+//
+//  wb_longform.cpp
+//  WhisperBoard
+//
+//  Planning is one pass of 20 ms frame energies over each cut's search range.
+//  Stitching works on text token ids, each placed in time by the timestamp
+//  token before it: whisper writes those relative to its current seek, so a
+//  segment's first timestamp and its t0 give the seek, and the window's start
+//  puts them on the recording's clock. Matching compares ids,
+//  not text, so a word both windows heard joins exactly even where its bytes
+//  are only part of a character.
+//
+
+#include "wb_longform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t k_sample_rate       = 16000;
+constexpr size_t k_frame             = 320;   // 20 ms
+constexpr size_t k_timestamp_samples = 320;   // one timestamp token step, 20 ms
+constexpr int64_t k_t0_samples       = 160;   // one segment t0 step, 10 ms
+constexpr size_t k_match_tokens      = 48;    // tokens searched on each side of an overlap
+constexpr size_t k_min_match         = 2;     // a single shared token is as likely " the" as a join
+
+size_t to_samples(float seconds) {
+    return seconds > 0.0f ? (size_t) (seconds * (float) k_sample_rate) : 0;
+}
+
+// Window bounds in samples, made consistent: a cut always moves forward, and a window
+// widened by the overlap still fits max_len
+struct limits {
+    size_t max_len;
+    size_t min_len;
+    size_t half_overlap;
+    size_t min_silence;
+    float  silence_rms;
+
+    explicit limits(const wb_longform_params & params) {
+        max_len      = std::max(to_samples(params.max_window_s), 2 * k_frame);
+        half_overlap = std::min(to_samples(params.overlap_s) / 2, max_len / 4);
+        min_len      = std::min(std::max(to_samples(params.min_window_s), half_overlap + k_frame), max_len - half_overlap);
+        min_silence  = to_samples(params.min_silence_s);
+        silence_rms  = params.silence_rms;
+    }
+
+    size_t min_step() const { return min_len - half_overlap; }
+};
+
+float frame_rms(const float * samples) {
+    float energy = 0.0f;
+    for (size_t i = 0; i < k_frame; ++i) {
+        energy += samples[i] * samples[i];
+    }
+    return std::sqrt(energy / (float) k_frame);
+}
+
+} // namespace
+
+wb_longform_params wb_longform_default_params(void) {
+    wb_longform_params params;
+    params.max_window_s  = 30.0f;
+    params.min_window_s  = 15.0f;
+    params.silence_rms   = 0.005f;
+    params.min_silence_s = 0.3f;
+    params.overlap_s     = 2.0f;
+    return params;
+}
+
+size_t wb_longform_max_windows(size_t n_samples, const wb_longform_params * params) {
+    const limits lim(*params);
+    return n_samples <= lim.max_len ? 1 : (n_samples - lim.max_len) / lim.min_step() + 2;
+}
+
+size_t wb_longform_plan(const float * samples, size_t n_samples, const wb_longform_params * params, wb_longform_window * windows) {
+    const limits lim(*params);
+    size_t count = 0;
+    size_t pos   = 0;
+
+    while (n_samples - pos > lim.max_len) {
+        const size_t lo = pos + lim.min_len;
+        const size_t hi = pos + lim.max_len - lim.half_overlap;
+
+        size_t quietest     = lo;
+        float  quietest_rms = INFINITY;
+        size_t run_start    = 0, run_len   = 0;   // silent frames, in samples
+        size_t best_start   = 0, best_len  = 0;
+        for (size_t f = lo; f + k_frame <= hi; f += k_frame) {
+            const float rms = frame_rms(samples + f);
+            if (rms < quietest_rms) {
+                quietest_rms = rms;
+                quietest     = f;
+            }
+            if (rms >= lim.silence_rms) {
+                run_len = 0;
+                continue;
+            }
+            if (run_len == 0) {
+                run_start = f;
+            }
+            run_len += k_frame;
+            if (run_len > best_len) {
+                best_start = run_start;
+                best_len   = run_len;
+            }
+        }
+
+        if (best_len > 0 && best_len >= lim.min_silence) {
+            const size_t cut = best_start + best_len / 2;
+            windows[count++] = { pos, cut };
+            pos = cut;
+        } else {
+            const size_t cut = quietest + k_frame / 2;
+            windows[count++] = { pos, cut + lim.half_overlap };
+            pos = cut - lim.half_overlap;
+        }
+    }
+    windows[count++] = { pos, n_samples };
+    return count;
+}
+
+// MARK: - Stitching
+
+struct wb_longform_stitch {
+    const wb_vocab *     vocab = nullptr;
+    std::vector<int32_t> ids;   // text tokens kept so far
+    std::vector<size_t>  at;    // when each was said, in samples from the start of the recording
+    size_t               end   = 0;       // end of the last window added
+    bool                 empty = true;    // no window added yet
+    std::string          text;
+
+    std::vector<int32_t> window_ids;   // the window being added, text tokens only
+    std::vector<size_t>  window_at;
+
+    void append_from(size_t first) {
+        ids.insert(ids.end(), window_ids.begin() + (std::ptrdiff_t) first, window_ids.end());
+        at.insert(at.end(), window_at.begin() + (std::ptrdiff_t) first, window_at.end());
+    }
+
+    // The window overlaps what is kept over [from, to)
+    void join(size_t from, size_t to) {
+        const size_t margin = to - from;   // timestamps are only as good as the segments they bound
+
+        size_t a0 = ids.size();
+        while (a0 > 0 && ids.size() - a0 < k_match_tokens && at[a0 - 1] + margin >= from) {
+            --a0;
+        }
+        size_t b1 = 0;
+        while (b1 < window_ids.size() && b1 < k_match_tokens && window_at[b1] < to + margin) {
+            ++b1;
+        }
+
+        // Longest common run between kept[a0, end) and window[0, b1)
+        std::vector<size_t> prev(b1 + 1, 0), row(b1 + 1, 0);
+        size_t best = 0, best_a = 0, best_b = 0;   // run length, and its last token on each side
+        for (size_t a = a0; a < ids.size(); ++a) {
+            for (size_t b = 0; b < b1; ++b) {
+                row[b + 1] = ids[a] == window_ids[b] ? prev[b] + 1 : 0;
+                if (row[b + 1] > best) {
+                    best   = row[b + 1];
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+            std::swap(prev, row);
+        }
+
+        if (best >= k_min_match) {
+            ids.resize(best_a + 1);
+            at.resize(best_a + 1);
+            append_from(best_b + 1);
+            return;
+        }
+
+        const size_t middle = from + (to - from) / 2;
+        while (!at.empty() && at.back() >= middle) {
+            ids.pop_back();
+            at.pop_back();
+        }
+        size_t first = 0;
+        while (first < window_at.size() && window_at[first] < middle) {
+            ++first;
+        }
+        append_from(first);
+    }
+};
+
+wb_longform_stitch * wb_longform_stitch_create(const wb_vocab * vocab) {
+    if (vocab == nullptr) {
+        return nullptr;
+    }
+    auto * stitch = new wb_longform_stitch();
+    stitch->vocab = vocab;
+    return stitch;
+}
+
+void wb_longform_stitch_free(wb_longform_stitch * stitch) {
+    delete stitch;
+}
+
+void wb_longform_stitch_reset(wb_longform_stitch * stitch) {
+    stitch->ids.clear();
+    stitch->at.clear();
+    stitch->end   = 0;
+    stitch->empty = true;
+}
+
+void wb_longform_stitch_add(
+    wb_longform_stitch * stitch,
+    const wb_longform_window * window,
+    const int32_t * ids,
+    const int64_t * t0,
+    int n_ids
+) {
+    const int32_t eot = wb_vocab_eot(stitch->vocab);
+    const int32_t beg = wb_vocab_timestamp_begin(stitch->vocab);
+
+    stitch->window_ids.clear();
+    stitch->window_at.clear();
+    size_t time = window->start;
+    size_t seek = window->start;   // where the segment's timestamps count from
+    bool   new_segment = false;     // its first timestamp still has to fix `seek`
+    for (int i = 0; i < n_ids; ++i) {
+        if (t0 != nullptr && (i == 0 || t0[i] != t0[i - 1])) {
+            time        = window->start + (size_t) std::max<int64_t>(t0[i], 0) * k_t0_samples;
+            new_segment = true;
+        }
+        if (ids[i] >= beg) {
+            const size_t offset = (size_t) (ids[i] - beg) * k_timestamp_samples;
+            if (new_segment) {
+                seek        = std::max(time, window->start + offset) - offset;
+                new_segment = false;
+            }
+            time = seek + offset;
+        } else if (ids[i] < eot) {
+            stitch->window_ids.push_back(ids[i]);
+            stitch->window_at.push_back(time);
+        }
+    }
+
+    if (stitch->empty || window->start >= stitch->end) {
+        stitch->append_from(0);
+    } else {
+        stitch->join(window->start, stitch->end);
+    }
+    stitch->end   = window->end;
+    stitch->empty = false;
+}
+
+const char * wb_longform_stitch_text(wb_longform_stitch * stitch) {
+    std::vector<char> out(wb_vocab_max_emit(stitch->vocab));
+    wb_detok detok;
+    wb_detok_begin(&detok);
+
+    stitch->text.clear();
+    for (const int32_t id : stitch->ids) {
+        stitch->text.append(out.data(), wb_detok_push(&detok, stitch->vocab, id, out.data()));
+    }
+    stitch->text.append(out.data(), wb_detok_end(&detok, out.data()));
+    return stitch->text.c_str();
+}
@@ -0,0 +1,87 @@
+//
+//  wb_longform.h
+//  WhisperBoard
+//
+//  Long recordings as independent windows. whisper_full walks audio past 30 s
+//  one window after another, each seek waiting on the previous decode. Planned
+//  up front instead, the windows are separate chunks any free whisper state
+//  can decode, and the stitcher puts their tokens back together in order.
+//  Cuts go into silence where there is some; a cut through speech gets an
+//  overlap both windows decode, and the stitcher keeps one copy of it.
+//
+
+#ifndef wb_longform_h
+#define wb_longform_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wb_vocab.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct wb_longform_params {
+    float max_window_s;    // longest window, overlap included; whisper decodes 30 s at a time
+    float min_window_s;    // cuts are searched from here up to max_window_s
+    float silence_rms;     // 20 ms frames below this are silence
+    float min_silence_s;   // a silent run this long takes the cut without overlap
+    float overlap_s;       // audio both windows decode around a cut through speech
+} wb_longform_params;
+
+wb_longform_params wb_longform_default_params(void);
+
+// Samples [start, end) of the recording; a window overlaps the next when it ends after it starts
+typedef struct wb_longform_window {
+    size_t start;
+    size_t end;
+} wb_longform_window;
+
+// Room `windows` needs for wb_longform_plan
+size_t wb_longform_max_windows(size_t n_samples, const wb_longform_params * params);
+
+// Splits 16 kHz mono `samples` into windows of at most max_window_s, in order, and returns
+// how many. Each cut is at the middle of the longest silent run in the search range; with
+// none long enough, at the quietest frame, widened by overlap_s. Audio that fits one window
+// is one window.
+size_t wb_longform_plan(
+    const float * samples,
+    size_t n_samples,
+    const wb_longform_params * params,
+    wb_longform_window * windows
+);
+
+// Joins decoded windows into one token sequence
+typedef struct wb_longform_stitch wb_longform_stitch;
+
+wb_longform_stitch * wb_longform_stitch_create(const wb_vocab * vocab);
+void wb_longform_stitch_free(wb_longform_stitch * stitch);
+
+// Starts a new recording
+void wb_longform_stitch_reset(wb_longform_stitch * stitch);
+
+// Adds the next window's decode: every token whisper_full produced, timestamps included,
+// in order, with `t0` the start of each token's segment (whisper_full_get_segment_t0, in
+// 10 ms steps from the window's start). whisper_full restarts its timestamps at every seek
+// within the window; the segment's t0 says where that seek was. NULL `t0` reads every
+// timestamp from the window's start. Windows must be added in plan order; an empty decode
+// is fine. Across an overlap the longest run of tokens both windows agree on joins them;
+// without one, each side keeps the tokens its timestamps put before or after the middle of
+// the overlap.
+void wb_longform_stitch_add(
+    wb_longform_stitch * stitch,
+    const wb_longform_window * window,
+    const int32_t * ids,
+    const int64_t * t0,
+    int n_ids
+);
+
+// Text of everything added so far; valid until the next call on `stitch`
+const char * wb_longform_stitch_text(wb_longform_stitch * stitch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_longform_h */
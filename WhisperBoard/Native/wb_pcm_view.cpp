@@ -0,0 +1,127 @@
+//
+//  wb_pcm_view.cpp
+//  WhisperBoard
+//
+//  One read-only mmap per chunk file. The keyboard writes chunks with an atomic
+//  rename, so a mapped file never changes underneath the view.
+//
+
+#include "wb_pcm_view.h"
+
+#include <atomic>
+#include <cerrno>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<uint64_t> g_copies_total{0};
+
+} // namespace
+
+struct wb_pcm_view {
+    void *             map    = nullptr;
+    size_t             bytes  = 0;
+    std::vector<float> widened;        // int16 chunks only
+    wb_sample_span     span   = {nullptr, 0};
+    uint32_t           copies = 0;
+};
+
+wb_pcm_view * wb_pcm_view_open(const char * path, int format) {
+    if (format != WB_PCM_FLOAT32 && format != WB_PCM_INT16) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int err = errno;
+        close(fd);
+        errno = err;
+        return nullptr;
+    }
+
+    auto * view = new wb_pcm_view();
+    view->bytes = (size_t) st.st_size;
+
+    if (view->bytes > 0) {
+        void * p = mmap(nullptr, view->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            const int err = errno;
+            close(fd);
+            delete view;
+            errno = err;
+            return nullptr;
+        }
+        // The mel frontend walks the chunk front to back exactly once
+        madvise(p, view->bytes, MADV_SEQUENTIAL);
+        view->map = p;
+    }
+    // The mapping holds its own reference to the file
+    close(fd);
+
+    if (view->map == nullptr) {
+        return view;
+    }
+
+    if (format == WB_PCM_FLOAT32) {
+        // mmap is page-aligned, so the mapping is a valid float array as-is
+        view->span.data  = static_cast<const float *>(view->map);
+        view->span.count = view->bytes / sizeof(float);
+        return view;
+    }
+
+    // int16 has to be widened for whisper.cpp; do it once, straight from the mapping
+    const auto * src = static_cast<const int16_t *>(view->map);
+    const size_t n   = view->bytes / sizeof(int16_t);
+
+    view->widened.resize(n);
+    float * dst = view->widened.data();
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = (float) src[i] * (1.0f / 32768.0f);
+    }
+
+    munmap(view->map, view->bytes);
+    view->map = nullptr;
+
+    view->span.data  = dst;
+    view->span.count = n;
+    view->copies     = 1;
+    g_copies_total.fetch_add(1, std::memory_order_relaxed);
+    return view;
+}
+
+void wb_pcm_view_close(wb_pcm_view * view) {
+    if (view == nullptr) {
+        return;
+    }
+    if (view->map != nullptr) {
+        munmap(view->map, view->bytes);
+    }
+    delete view;
+}
+
+wb_sample_span wb_pcm_view_samples(const wb_pcm_view * view) {
+    return view->span;
+}
+
+size_t wb_pcm_view_byte_count(const wb_pcm_view * view) {
+    return view->bytes;
+}
+
+uint32_t wb_pcm_view_copies(const wb_pcm_view * view) {
+    return view->copies;
+}
+
+uint64_t wb_pcm_copies_total(void) {
+    return g_copies_total.load(std::memory_order_relaxed);
+}
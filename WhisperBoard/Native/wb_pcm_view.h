@@ -0,0 +1,55 @@
+//
+//  wb_pcm_view.h
+//  WhisperBoard
+//
+//  Read-only sample views over audio chunk files in the App Groups container
+//  float32 chunks are handed to whisper.cpp straight from the file mapping
+//  (whisper_pcm_to_mel still pads them into a buffer of its own; that copy is whisper.cpp's)
+//
+
+#ifndef wb_pcm_view_h
+#define wb_pcm_view_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample encodings (mirror AudioChunkMetadata.AudioFormat)
+enum wb_pcm_format {
+    WB_PCM_FLOAT32 = 0,
+    WB_PCM_INT16   = 1,
+};
+
+// Borrowed mono float samples; valid for the lifetime of the view that returned them
+typedef struct wb_sample_span {
+    const float * data;
+    size_t        count;
+} wb_sample_span;
+
+typedef struct wb_pcm_view wb_pcm_view;
+
+// Map a chunk file read-only. float32 samples are served from the mapping itself;
+// int16 samples are widened once into a buffer owned by the view.
+// The file may be unlinked while the view is open. Returns NULL on error (errno is set).
+wb_pcm_view * wb_pcm_view_open(const char * path, int format);
+void          wb_pcm_view_close(wb_pcm_view * view);
+
+wb_sample_span wb_pcm_view_samples(const wb_pcm_view * view);
+
+// Size of the chunk file in bytes
+size_t wb_pcm_view_byte_count(const wb_pcm_view * view);
+
+// Sample buffers this view copied or converted (0 on the float32 path)
+uint32_t wb_pcm_view_copies(const wb_pcm_view * view);
+
+// Sample buffers copied or converted by all views since launch (diagnostics)
+uint64_t wb_pcm_copies_total(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_pcm_view_h */
@@ -0,0 +1,1268 @@
+//
+//  wb_pipeline.cpp
+//  WhisperBoard
+//
+//  Each stage is one thread reading a single-producer/single-consumer ring.
+//  A chunk carries its own whisper_state from the mel stage to the post stage;
+//  the post stage hands the state back through another ring, so the number of
+//  states bounds how many chunks can sit between mel and post.
+//
+//  Speculation: when the prepare stage sees speech start, it copies the first
+//  speculative_window_ms of speech (from just before the first loud frame) into
+//  a one-slot mailbox. The speculation thread decodes that prefix on its own
+//  state with an audio_ctx sized to it and a few tokens, so its encoder pass is
+//  a fraction of the main one and its text arrives first. Chunks no longer than
+//  the window are not speculated: that decode would be the main path's own.
+//  whisper.cpp polls abort_callback, which fires once the post stage has
+//  published that chunk (or anything later).
+//
+//  Cancellation: a chunk is stale once its epoch is invalidated or its session's
+//  token is cancelled. Stale chunks are checked at every stage boundary and,
+//  while decoding, from whisper.cpp's encoder-begin and abort callbacks.
+//
+//  Cores: whisper.cpp's mel and whisper_full spawn their own threads, so the
+//  mel, infer and speculation stages lease their thread count from the shared
+//  wb_pool for the duration of each call. Chunks are LIVE work on a deadline
+//  (submit time + deadline_ms). The speculation is LIVE on its chunk's deadline
+//  as well, with one lease for its mel and decode that the prepare stage takes
+//  when it sees the onset if cores are free: the speculation is only worth
+//  anything before that chunk's decode, which would otherwise win the race to the
+//  cores. It is bounded by the window and its token budget, and it is not
+//  preempted, since aborting it for the chunk it is meant to get ahead of would
+//  make it useless exactly when decodes are slow.
+//  The stage and speculation threads themselves are not pool workers and are not
+//  counted in its budget. Between leases they wait on their rings, and what they
+//  compute on their own (prepare's RMS, post's token text) is one pass over the
+//  chunk's samples or tokens, small next to a leased call.
+//
+//  Text: the post stage turns token ids into text through a vocabulary byte
+//  table (wb_vocab) built once per pipeline, not one string per token.
+//
+//  Refinement (wb_refiner) sits outside the stage threads: the caller runs it
+//  with a larger model on spans the live pipeline has already published.
+//
+
+#include "wb_pipeline.h"
+
+#include "wb_confidence.h"
+#include "wb_pool.h"
+#include "wb_repetition.h"
+#include "wb_vocab.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+inline void cpu_relax() {
+#if defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+float elapsed_ms(clock_type::time_point since) {
+    return std::chrono::duration<float, std::milli>(clock_type::now() - since).count();
+}
+
+// Sleep/wake for a ring side; the data path never takes the mutex
+class parker {
+public:
+    template <typename Ready>
+    void wait(Ready ready) {
+        for (int spin = 0; spin < 64; ++spin) {
+            if (ready()) {
+                return;
+            }
+            cpu_relax();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        cv_.wait(lock, ready);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+    }
+
+private:
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    std::atomic<int>        waiters_{0};
+};
+
+template <typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+
+    void push(T value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        not_full_.wait([&] { return tail - head_.load(std::memory_order_acquire) <= mask_; });
+
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        not_empty_.notify();
+    }
+
+    T pop() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        not_empty_.wait([&] { return tail_.load(std::memory_order_acquire) != head; });
+
+        T value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        not_full_.notify();
+        return value;
+    }
+
+private:
+    std::vector<T>      slots_;
+    size_t              mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};   // consumer
+    alignas(64) std::atomic<size_t> tail_{0};   // producer
+    parker              not_empty_;
+    parker              not_full_;
+};
+
+// Encoder positions per sample: 160-sample mel hop, then the stride-2 conv
+constexpr size_t k_samples_per_audio_ctx = 320;
+constexpr size_t k_samples_per_ms        = 16;
+constexpr int    k_max_audio_ctx         = 1500;
+constexpr int    k_audio_ctx_margin      = 32;
+
+// Speech onset: the first 20 ms frame at the VAD threshold, less a lead for the word's attack
+constexpr size_t k_onset_frame_samples = 20 * k_samples_per_ms;
+constexpr size_t k_onset_lead_samples  = 100 * k_samples_per_ms;
+
+// end_runaway's repetition state across one caller's whisper_full decodes. The hook is not
+// told which decoder is asking, so a sequence goes to the slot holding it minus its newest
+// token (that decoder's previous step), and only the new token is checked. A beam that forked
+// or a new decode rewinds the least recently used slot to the prefix it shares with it.
+class runaway_guard {
+public:
+    runaway_guard() {
+        for (auto & s : slots_) {
+            s.raw.reserve(k_capacity);
+            s.text_after.reserve(k_capacity);
+            s.tracker = wb_repetition_tracker_create(k_capacity);
+        }
+    }
+
+    ~runaway_guard() {
+        for (auto & s : slots_) {
+            wb_repetition_tracker_free(s.tracker);
+        }
+    }
+
+    runaway_guard(const runaway_guard &) = delete;
+    runaway_guard & operator=(const runaway_guard &) = delete;
+
+    // wb_repetition_check of the text tokens in `tokens`
+    int check(whisper_token eot, const whisper_token_data * tokens, int n_tokens) {
+        const size_t n = (size_t) n_tokens;
+        slot * best   = nullptr;
+        slot * oldest = nullptr;
+        size_t oldest_common = 0;
+        for (auto & s : slots_) {
+            size_t common = 0;
+            const size_t limit = std::min(s.raw.size(), n);
+            while (common < limit && s.raw[common] == tokens[common].id) {
+                ++common;
+            }
+            if (common == s.raw.size() && (best == nullptr || common > best->raw.size())) {
+                best = &s;
+            }
+            if (oldest == nullptr || s.used < oldest->used) {
+                oldest        = &s;
+                oldest_common = common;
+            }
+        }
+        if (best == nullptr) {
+            best = oldest;
+            best->raw.resize(oldest_common);
+            best->text_after.resize(oldest_common);
+            best->keep = wb_repetition_tracker_truncate(best->tracker, oldest_common == 0 ? 0 : best->text_after.back());
+        }
+
+        best->used = ++tick_;
+        for (size_t i = best->raw.size(); i < n; ++i) {
+            const whisper_token id = tokens[i].id;
+            const int before = best->text_after.empty() ? 0 : best->text_after.back();
+            best->raw.push_back(id);
+            best->text_after.push_back(before + (id < eot ? 1 : 0));
+            if (id < eot) {
+                best->keep = wb_repetition_tracker_push(best->tracker, id);
+            }
+        }
+        return best->keep;
+    }
+
+private:
+    static constexpr int    k_capacity = 448;   // whisper's text context
+    static constexpr size_t k_slots    = 8;     // whisper_full's most decoders
+
+    struct slot {
+        std::vector<whisper_token> raw;          // every token, special and timestamp ones included
+        std::vector<int>           text_after;   // text tokens in raw[0..i]
+        wb_repetition_tracker *    tracker = nullptr;
+        int                        keep    = 0;
+        uint64_t                   used    = 0;
+    };
+
+    slot     slots_[k_slots];
+    uint64_t tick_ = 0;
+};
+
+// whisper_full's logits hook, per decoder and step: a sequence that has started looping
+// gets nothing but EOT, so it ends now (decoded_text drops the repeats)
+void end_runaway(whisper_context * ctx, whisper_state *, const whisper_token_data * tokens, int n_tokens, float * logits, void * user_data) {
+    auto * guard = static_cast<runaway_guard *>(user_data);
+    if (guard->check(whisper_token_eot(ctx), tokens, n_tokens) == 0) {
+        return;
+    }
+
+    const whisper_token eot = whisper_token_eot(ctx);
+    const int n_vocab = whisper_n_vocab(ctx);
+    for (int i = 0; i < n_vocab; ++i) {
+        if (i != eot) {
+            logits[i] = -std::numeric_limits<float>::infinity();
+        }
+    }
+}
+
+// Text, token strings and confidence of a finished decode
+struct decoded_text {
+    std::string               text;
+    std::string               token_bytes;   // every token's text, NUL-terminated, back to back
+    std::vector<const char *> tokens;        // into token_bytes
+    std::vector<int32_t>      token_ids;     // aligned with tokens
+    std::vector<int64_t>      token_t0;      // aligned with tokens: their segment's t0, which includes the seek
+    bool                      runaway = false;   // cut at a repetition loop
+    wb_confidence             confidence = { 0, 0.0f, 0.0f, 0.0f, -1.0f };
+
+    // Text comes from the token ids through the vocabulary table, so a character split
+    // across tokens arrives whole with the token that completes it
+    void collect(const wb_vocab * vocab, whisper_state * state) {
+        const whisper_token eot = wb_vocab_eot(vocab);
+        std::vector<int32_t> ids;          // text tokens
+        std::vector<size_t>  starts;       // each token's offset in token_bytes
+        std::vector<size_t>  where;        // text token k is token where[k]
+        std::vector<size_t>  text_at;      // text length before text token k
+        std::vector<char>    out(wb_vocab_max_emit(vocab));
+        wb_detok             detok;
+        wb_confidence_acc    acc;
+        wb_detok_begin(&detok);
+        wb_confidence_begin(&acc);
+
+        const int n_segments = whisper_full_n_segments_from_state(state);
+        for (int i = 0; i < n_segments; ++i) {
+            wb_confidence_add_no_speech(&acc, whisper_full_get_segment_no_speech_prob_from_state(state, i));
+
+            const int64_t t0 = whisper_full_get_segment_t0_from_state(state, i);
+            const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+            for (int j = 0; j < n_tokens; ++j) {
+                const whisper_token id = whisper_full_get_token_id_from_state(state, i, j);
+                const size_t n = wb_detok_push(&detok, vocab, id, out.data());
+                if (id < eot) {
+                    ids.push_back(id);
+                    where.push_back(starts.size());
+                    text_at.push_back(text.size());
+                    text.append(out.data(), n);
+                    wb_confidence_add_token(&acc, whisper_full_get_token_p_from_state(state, i, j));
+                }
+                starts.push_back(token_bytes.size());
+                token_ids.push_back(id);
+                token_t0.push_back(t0);
+                token_bytes.append(out.data(), n);
+                token_bytes += '\0';
+            }
+        }
+        text.append(out.data(), wb_detok_end(&detok, out.data()));
+        confidence = wb_confidence_end(&acc);
+
+        // A decode end_runaway stopped still holds the repeats that gave the loop away
+        const int keep = wb_repetition_check(ids.data(), (int) ids.size());
+        runaway = keep > 0;
+        if (runaway) {
+            confidence.score = 0.0f;
+        }
+        if (runaway && (size_t) keep < ids.size()) {
+            token_bytes.resize(starts[where[(size_t) keep]]);
+            starts.resize(where[(size_t) keep]);
+            token_ids.resize(where[(size_t) keep]);
+            token_t0.resize(where[(size_t) keep]);
+            text.resize(text_at[(size_t) keep]);
+        }
+
+        tokens.reserve(starts.size());
+        for (const size_t start : starts) {
+            tokens.push_back(token_bytes.c_str() + start);
+        }
+    }
+};
+
+struct work_item {
+    const float *     samples   = nullptr;
+    size_t            n_samples = 0;
+    void *            user_data = nullptr;
+    wb_cancel_token * token     = nullptr;   // retained
+    uint64_t          epoch     = 0;
+    uint64_t          seq       = 0;
+
+    int             status    = WB_PIPELINE_OK;
+    whisper_state * state     = nullptr;
+    std::unique_ptr<decoded_text> decoded;   // set when the infer stage already picked the text
+
+    clock_type::time_point submitted;
+    float           stage_ms[WB_STAGE_COUNT] = {};
+};
+
+struct speculation_job {
+    std::vector<float> samples;   // onset prefix, copied: the main path may finish and release the caller's buffer first
+    void *             user_data = nullptr;
+    wb_cancel_token *  token     = nullptr;   // retained
+    uint64_t           epoch     = 0;
+    uint64_t           seq       = 0;
+    uint64_t           deadline  = 0;         // the chunk's, on the wb_pool clock
+    wb_pool *          pool      = nullptr;
+    int                leased    = 0;         // cores reserved at the onset, until the speculation thread takes them
+
+    ~speculation_job() {
+        wb_cancel_token_release(token);
+        if (leased > 0) {
+            wb_pool_release(pool, leased, WB_PRIORITY_LIVE);
+        }
+    }
+};
+
+// Owned copy of whisper_full_params, so the caller's strings can go away
+struct full_params_copy {
+    whisper_full_params        params;
+    std::string                language;
+    std::string                prompt;
+    std::vector<whisper_token> prompt_tokens;
+
+    void assign(const whisper_full_params & src) {
+        params   = src;
+        language = src.language != nullptr ? src.language : "";
+        prompt   = src.initial_prompt != nullptr ? src.initial_prompt : "";
+        prompt_tokens.assign(src.prompt_tokens, src.prompt_tokens + (src.prompt_tokens != nullptr ? src.prompt_n_tokens : 0));
+
+        params.language       = src.language != nullptr ? language.c_str() : nullptr;
+        params.initial_prompt = src.initial_prompt != nullptr ? prompt.c_str() : nullptr;
+        params.prompt_tokens  = src.prompt_tokens != nullptr ? prompt_tokens.data() : nullptr;
+    }
+};
+
+// whisper.cpp's log-mel into `state`, on `n_threads` cores leased from `pool`
+bool compute_mel(wb_pool * pool, whisper_context * ctx, whisper_state * state, const float * samples, size_t n_samples,
+                 int n_threads, int priority, uint64_t deadline_ns) {
+    const int granted = wb_pool_lease(pool, n_threads, priority, deadline_ns);
+    const int rc      = whisper_pcm_to_mel_with_state(ctx, state, samples, (int) n_samples, granted);
+    wb_pool_release(pool, granted, priority);
+    return rc == 0;
+}
+
+} // namespace
+
+struct wb_pipeline {
+    whisper_context *  ctx = nullptr;
+    wb_pipeline_params params;
+
+    std::mutex         full_params_mutex;
+    full_params_copy   full_params;
+
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<size_t>   in_flight{0};
+    uint64_t              next_seq = 1;   // submit thread only
+
+    // Speculation
+    std::atomic<int>        speculative_max_tokens{0};
+    std::atomic<uint64_t>   published_seq{0};   // last chunk whose real result was delivered
+    std::atomic<bool>       stopping{false};
+    bool                    in_speech  = false; // prepare thread only
+    uint64_t                vad_epoch  = 0;     // prepare thread only
+    whisper_state *         speculative_state = nullptr;
+    std::mutex              mailbox_mutex;
+    std::condition_variable mailbox_cv;
+    std::unique_ptr<speculation_job> mailbox;   // newest onset wins
+
+    // Serialises result delivery so a TENTATIVE never follows its chunk's real result
+    std::mutex              deliver_mutex;
+
+    // Temperature fallback under the deadline (infer thread writes, anyone reads)
+    struct {
+        std::atomic<uint64_t> by_retries[WB_FALLBACK_BUCKETS] = {};
+        std::atomic<uint64_t> budget_stops{0};
+        std::atomic<uint64_t> deadline_aborts{0};
+    } fallback;
+
+    // item == nullptr is the shutdown marker; it travels through every stage
+    spsc_ring<work_item *>       to_prepare;
+    spsc_ring<work_item *>       to_mel;
+    spsc_ring<work_item *>       to_infer;
+    spsc_ring<work_item *>       to_post;
+    spsc_ring<whisper_state *>   free_states;
+
+    std::vector<whisper_state *> states;
+    std::vector<std::thread>     threads;
+
+    wb_pool *                    pool = nullptr;
+    runaway_guard                infer_guard;           // infer thread only
+    runaway_guard                speculation_guard;     // speculation thread only
+    wb_vocab *                   vocab     = nullptr;   // token bytes for every decode's text
+
+    explicit wb_pipeline(size_t capacity, size_t n_states)
+        : to_prepare(capacity), to_mel(capacity), to_infer(capacity), to_post(capacity), free_states(n_states) {}
+
+    bool stale(const work_item * item) const {
+        return item->epoch != epoch.load(std::memory_order_acquire) || wb_cancel_token_is_cancelled(item->token);
+    }
+
+    struct stale_probe {
+        const wb_pipeline *    pipeline;
+        const work_item *      item;
+        bool                   has_deadline = false;   // set for fallback retries
+        clock_type::time_point deadline;
+    };
+
+    // whisper_full polls these between encoder/decoder graph nodes
+    static bool item_abort(void * data) {
+        const auto * probe = static_cast<const stale_probe *>(data);
+        return probe->pipeline->stale(probe->item) || (probe->has_deadline && clock_type::now() >= probe->deadline);
+    }
+
+    static bool item_encoder_begin(whisper_context *, whisper_state *, void * data) {
+        return !item_abort(data);
+    }
+
+    // Common stage loop: stale or failed chunks pass through untouched so ordering is kept
+    template <typename Body>
+    void run_stage(int stage, spsc_ring<work_item *> & in, spsc_ring<work_item *> & out, Body body) {
+        for (;;) {
+            work_item * item = in.pop();
+            if (item == nullptr) {
+                out.push(nullptr);
+                return;
+            }
+
+            if (item->status == WB_PIPELINE_OK && stale(item)) {
+                item->status = WB_PIPELINE_DROPPED;
+            }
+
+            if (item->status == WB_PIPELINE_OK) {
+                const auto start = clock_type::now();
+                body(item);
+                item->stage_ms[stage] = elapsed_ms(start);
+            }
+
+            out.push(item);
+        }
+    }
+
+    void prepare(work_item * item) {
+        // A new epoch (session) starts out of speech
+        if (item->epoch != vad_epoch) {
+            vad_epoch = item->epoch;
+            in_speech = false;
+        }
+
+        if (item->n_samples == 0) {
+            item->status = WB_PIPELINE_SILENT;
+            return;
+        }
+
+        if (params.vad_rms_threshold > 0.0f) {
+            double energy = 0.0;
+            for (size_t i = 0; i < item->n_samples; ++i) {
+                energy += (double) item->samples[i] * item->samples[i];
+            }
+            const float rms = (float) std::sqrt(energy / (double) item->n_samples);
+            if (rms < params.vad_rms_threshold) {
+                item->status = WB_PIPELINE_SILENT;
+                in_speech = false;
+                return;
+            }
+        }
+
+        // Speech onset: start a speculative decode beside the main path
+        if (!in_speech) {
+            in_speech = true;
+            speculate(item);
+        }
+    }
+
+    // Decode only the chunk's audio, with a token budget to match, and end loops early
+    static void bound_decode(whisper_full_params & full, size_t n_samples, runaway_guard * guard) {
+        const int duration_ms = (int) (n_samples / k_samples_per_ms);
+        if (full.duration_ms <= 0 || full.duration_ms > duration_ms) {
+            full.duration_ms = duration_ms;
+        }
+
+        const int max_tokens = wb_repetition_token_cap(n_samples);
+        if (full.max_tokens <= 0 || full.max_tokens > max_tokens) {
+            full.max_tokens = max_tokens;
+        }
+
+        full.logits_filter_callback           = end_runaway;
+        full.logits_filter_callback_user_data = guard;
+    }
+
+    // First sample of the first frame at the VAD threshold; 0 with VAD off, or when the
+    // chunk is only loud as a whole
+    size_t onset_sample(const work_item * item) const {
+        if (params.vad_rms_threshold <= 0.0f) {
+            return 0;
+        }
+        const double threshold = (double) params.vad_rms_threshold * params.vad_rms_threshold;
+        for (size_t begin = 0; begin < item->n_samples; begin += k_onset_frame_samples) {
+            const size_t end = std::min(begin + k_onset_frame_samples, item->n_samples);
+            double energy = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                energy += (double) item->samples[i] * item->samples[i];
+            }
+            if (energy >= threshold * (double) (end - begin)) {
+                return begin;
+            }
+        }
+        return 0;
+    }
+
+    void speculate(const work_item * item) {
+        if (speculative_state == nullptr || speculative_max_tokens.load(std::memory_order_relaxed) <= 0 ||
+            params.speculative_window_ms <= 0) {
+            return;
+        }
+
+        const size_t onset = onset_sample(item);
+        const size_t begin = onset > k_onset_lead_samples ? onset - k_onset_lead_samples : 0;
+        const size_t end   = std::min(item->n_samples, begin + (size_t) params.speculative_window_ms * k_samples_per_ms);
+        if (end - begin >= item->n_samples) {
+            return;   // the whole chunk: no sooner than the main path's decode of it
+        }
+
+        auto job = std::make_unique<speculation_job>();
+        job->samples.assign(item->samples + begin, item->samples + end);
+        job->user_data = item->user_data;
+        job->token     = wb_cancel_token_retain(item->token);
+        job->epoch     = item->epoch;
+        job->seq       = item->seq;
+        job->deadline  = deadline_ns(item);
+
+        // Reserve the cores now, before this chunk's mel asks for any. Without a free core the
+        // speculation thread queues for them like any live lease.
+        int n_threads;
+        {
+            std::lock_guard<std::mutex> lock(full_params_mutex);
+            n_threads = full_params.params.n_threads;
+        }
+        job->pool      = pool;
+        job->leased    = wb_pool_try_lease(pool, n_threads, WB_PRIORITY_LIVE);
+
+        {
+            std::lock_guard<std::mutex> lock(mailbox_mutex);
+            mailbox = std::move(job);
+        }
+        mailbox_cv.notify_one();
+    }
+
+    // Speculation is worthless once the real result is out, the session moved on, or we are stopping
+    bool speculation_superseded(const speculation_job & job) const {
+        return stopping.load(std::memory_order_relaxed) ||
+               job.epoch != epoch.load(std::memory_order_acquire) ||
+               wb_cancel_token_is_cancelled(job.token) ||
+               job.seq <= published_seq.load(std::memory_order_acquire);
+    }
+
+    struct abort_probe {
+        const wb_pipeline *     pipeline;
+        const speculation_job * job;
+    };
+
+    static bool speculation_abort(void * data) {
+        const auto * probe = static_cast<const abort_probe *>(data);
+        return probe->pipeline->speculation_superseded(*probe->job);
+    }
+
+    static bool speculation_encoder_begin(whisper_context *, whisper_state *, void * data) {
+        return !speculation_abort(data);
+    }
+
+    void run_speculation() {
+        for (;;) {
+            std::unique_ptr<speculation_job> job;
+            {
+                std::unique_lock<std::mutex> lock(mailbox_mutex);
+                mailbox_cv.wait(lock, [&] { return mailbox != nullptr || stopping.load(std::memory_order_relaxed); });
+                if (stopping.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                job = std::move(mailbox);
+            }
+
+            const int max_tokens = speculative_max_tokens.load(std::memory_order_relaxed);
+            if (max_tokens <= 0 || speculation_superseded(*job)) {
+                continue;
+            }
+
+            const auto start = clock_type::now();
+
+            full_params_copy p;
+            {
+                std::lock_guard<std::mutex> lock(full_params_mutex);
+                p.assign(full_params.params);
+            }
+
+            // Cheap settings: greedy, a handful of tokens, encoder limited to the prefix's length
+            const int audio_ctx = (int) (job->samples.size() / k_samples_per_audio_ctx) + k_audio_ctx_margin;
+            p.params.strategy       = WHISPER_SAMPLING_GREEDY;
+            p.params.max_tokens     = max_tokens;
+            p.params.audio_ctx      = audio_ctx < k_max_audio_ctx ? audio_ctx : k_max_audio_ctx;
+            p.params.single_segment = true;
+            p.params.no_context     = true;
+            p.params.temperature_inc = 0.0f;   // no fallback retries
+            bound_decode(p.params, job->samples.size(), &speculation_guard);
+
+            abort_probe probe = { this, job.get() };
+            p.params.encoder_begin_callback           = speculation_encoder_begin;
+            p.params.encoder_begin_callback_user_data = &probe;
+            p.params.abort_callback                   = speculation_abort;
+            p.params.abort_callback_user_data         = &probe;
+
+            // One lease for the mel and the decode. A queued one can wait out an older chunk's
+            // decode, by the end of which this chunk may be published.
+            int granted = job->leased;
+            job->leased = 0;
+            if (granted == 0) {
+                granted = wb_pool_lease(pool, p.params.n_threads, WB_PRIORITY_LIVE, job->deadline);
+            }
+            p.params.n_threads = granted;
+            int rc = -1;
+            if (!speculation_superseded(*job) &&
+                whisper_pcm_to_mel_with_state(ctx, speculative_state, job->samples.data(), (int) job->samples.size(),
+                                              std::min(granted, params.mel_threads)) == 0) {
+                rc = whisper_full_with_state(ctx, speculative_state, p.params, nullptr, 0);
+            }
+            wb_pool_release(pool, granted, WB_PRIORITY_LIVE);
+            if (rc != 0) {
+                continue;   // aborted or failed; the real result follows anyway
+            }
+
+            decoded_text decoded;
+            decoded.collect(vocab, speculative_state);
+
+            wb_pipeline_result result = {};
+            result.status     = WB_PIPELINE_TENTATIVE;
+            result.text       = decoded.text.c_str();
+            result.n_tokens   = (int) decoded.tokens.size();
+            result.tokens     = decoded.tokens.data();
+            result.token_ids  = decoded.token_ids.data();
+            result.token_t0   = decoded.token_t0.data();
+            result.runaway    = decoded.runaway;
+            result.confidence = decoded.confidence.score;
+            result.user_data  = job->user_data;
+            result.stage_ms[WB_STAGE_INFER] = elapsed_ms(start);
+
+            std::lock_guard<std::mutex> lock(deliver_mutex);
+            if (!speculation_superseded(*job) && params.on_result != nullptr) {
+                params.on_result(&result, params.callback_data);
+            }
+        }
+    }
+
+    void mel(work_item * item) {
+        // Blocks while every state is still between mel and post
+        item->state = free_states.pop();
+
+        if (!compute_mel(pool, ctx, item->state, item->samples, item->n_samples, params.mel_threads, WB_PRIORITY_LIVE,
+                         deadline_ns(item))) {
+            item->status = WB_PIPELINE_FAILED;
+        }
+    }
+
+    uint64_t deadline_ns(const work_item * item) const {
+        const auto deadline = item->submitted + std::chrono::milliseconds(params.deadline_ms);
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    }
+
+    void infer(work_item * item) {
+        // Private copy: wb_pipeline_set_full_params may replace the strings mid-decode
+        full_params_copy p;
+        {
+            std::lock_guard<std::mutex> lock(full_params_mutex);
+            p.assign(full_params.params);
+        }
+
+        stale_probe probe = { this, item, false, clock_type::time_point() };
+        p.params.encoder_begin_callback           = item_encoder_begin;
+        p.params.encoder_begin_callback_user_data = &probe;
+        p.params.abort_callback                   = item_abort;
+        p.params.abort_callback_user_data         = &probe;
+        bound_decode(p.params, item->n_samples, &infer_guard);
+
+        // n_samples == 0: decode the mel the previous stage left in this state
+        const int granted = wb_pool_lease(pool, p.params.n_threads, WB_PRIORITY_LIVE, deadline_ns(item));
+        p.params.n_threads = granted;
+        const int rc = params.fallback_budget && p.params.temperature_inc > 0.0f
+            ? decode_within_budget(item, p.params, probe)
+            : whisper_full_with_state(ctx, item->state, p.params, nullptr, 0);
+        wb_pool_release(pool, granted, WB_PRIORITY_LIVE);
+        if (rc != 0) {
+            item->status = stale(item) ? WB_PIPELINE_DROPPED : WB_PIPELINE_FAILED;
+        }
+    }
+
+    // whisper_full's temperature fallback, run one temperature at a time so it fits the
+    // chunk's deadline. A retry only starts if the previous attempt's duration still fits,
+    // a retry running at the deadline is aborted, and the best attempt so far is kept.
+    // The first attempt always runs to completion.
+    int decode_within_budget(work_item * item, whisper_full_params full, stale_probe & probe) {
+        const float inc = full.temperature_inc;
+        full.temperature_inc = 0.0f;
+
+        const auto deadline = item->submitted + std::chrono::milliseconds(params.deadline_ms);
+        std::unique_ptr<decoded_text> best;
+        float best_logprob = 0.0f;
+        bool  passed       = false;
+        bool  aborted      = false;
+        int   attempts     = 0;
+        clock_type::duration last_attempt{};
+
+        for (float temperature = full.temperature; temperature <= 1.0f + 1e-6f; temperature += inc) {
+            const auto start = clock_type::now();
+            if (attempts > 0) {
+                if (start + last_attempt > deadline) {
+                    break;
+                }
+                probe.has_deadline = true;
+                probe.deadline     = deadline;
+            }
+
+            full.temperature = temperature;
+            const int rc = whisper_full_with_state(ctx, item->state, full, nullptr, 0);
+            last_attempt = clock_type::now() - start;
+            if (rc != 0) {
+                if (attempts == 0 || stale(item)) {
+                    return rc;
+                }
+                aborted = true;
+                break;
+            }
+            ++attempts;
+
+            const attempt_quality quality = assess(item->state, full);
+            if (best == nullptr || quality.avg_logprob > best_logprob) {
+                best = std::make_unique<decoded_text>();
+                best->collect(vocab, item->state);
+                best_logprob = quality.avg_logprob;
+            }
+            if (quality.passed) {
+                passed = true;
+                break;
+            }
+        }
+
+        const int retries = std::min(attempts - 1, WB_FALLBACK_BUCKETS - 1);
+        fallback.by_retries[retries].fetch_add(1, std::memory_order_relaxed);
+        if (aborted) {
+            fallback.deadline_aborts.fetch_add(1, std::memory_order_relaxed);
+        } else if (!passed && temperature_left(full.temperature, inc)) {
+            fallback.budget_stops.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        item->decoded = std::move(best);
+        return 0;
+    }
+
+    static bool temperature_left(float last, float inc) {
+        return last + inc <= 1.0f + 1e-6f;
+    }
+
+    struct attempt_quality {
+        float avg_logprob = 0.0f;
+        bool  passed      = true;
+    };
+
+    // whisper_full's checks on its best decoder: mean token log-probability against
+    // logprob_thold, and the entropy of the last 32 tokens (repetition) against entropy_thold.
+    // A low log-probability passes when the no-speech probability reaches no_speech_thold:
+    // the window is silence, and retrying it would not find words.
+    static attempt_quality assess(whisper_state * state, const whisper_full_params & full) {
+        std::vector<whisper_token> ids;
+        double sum_logprob    = 0.0;
+        float  no_speech_prob = 0.0f;
+        const int n_segments = whisper_full_n_segments_from_state(state);
+        for (int i = 0; i < n_segments; ++i) {
+            no_speech_prob = std::max(no_speech_prob, whisper_full_get_segment_no_speech_prob_from_state(state, i));
+            const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+            for (int j = 0; j < n_tokens; ++j) {
+                ids.push_back(whisper_full_get_token_id_from_state(state, i, j));
+                sum_logprob += std::log(std::max(whisper_full_get_token_p_from_state(state, i, j), 1e-10f));
+            }
+        }
+
+        attempt_quality quality;
+        if (ids.empty()) {
+            return quality;
+        }
+        quality.avg_logprob = (float) (sum_logprob / (double) ids.size());
+
+        const size_t window = std::min<size_t>(ids.size(), 32);
+        std::vector<whisper_token> tail(ids.end() - (std::ptrdiff_t) window, ids.end());
+        std::sort(tail.begin(), tail.end());
+        double entropy = 0.0;
+        for (size_t i = 0; i < tail.size();) {
+            size_t j = i;
+            while (j < tail.size() && tail[j] == tail[i]) {
+                ++j;
+            }
+            const double share = (double) (j - i) / (double) window;
+            entropy -= share * std::log(share);
+            i = j;
+        }
+
+        // As whisper_full, repetition only counts once a sequence is longer than the window
+        const bool likely = quality.avg_logprob >= full.logprob_thold || no_speech_prob >= full.no_speech_thold;
+        quality.passed = likely && (ids.size() <= 32 || entropy >= full.entropy_thold);
+        return quality;
+    }
+
+    // Last stage: runs for every chunk, whatever its status
+    void post(work_item * item) {
+        const auto start = clock_type::now();
+
+        if (item->status == WB_PIPELINE_OK && stale(item)) {
+            item->status = WB_PIPELINE_DROPPED;
+        }
+
+        decoded_text decoded;
+        if (item->status == WB_PIPELINE_OK) {
+            if (item->decoded != nullptr) {
+                decoded = std::move(*item->decoded);
+            } else {
+                decoded.collect(vocab, item->state);
+            }
+        }
+
+        if (item->state != nullptr) {
+            free_states.push(item->state);
+            item->state = nullptr;
+        }
+
+        if (item->status == WB_PIPELINE_OK) {
+            item->stage_ms[WB_STAGE_POST] = elapsed_ms(start);
+        }
+
+        wb_pipeline_result result = {};
+        result.status     = item->status;
+        result.text       = decoded.text.c_str();
+        result.n_tokens   = (int) decoded.tokens.size();
+        result.tokens     = decoded.tokens.data();
+        result.token_ids  = decoded.token_ids.data();
+        result.token_t0   = decoded.token_t0.data();
+        result.runaway    = decoded.runaway;
+        result.confidence = decoded.confidence.score;
+        result.user_data  = item->user_data;
+
+        float busy_ms = 0.0f;
+        for (int s = 0; s < WB_STAGE_COUNT; ++s) {
+            result.stage_ms[s] = item->stage_ms[s];
+            busy_ms += item->stage_ms[s];
+        }
+        const float total_ms = elapsed_ms(item->submitted);
+        result.queued_ms = total_ms > busy_ms ? total_ms - busy_ms : 0.0f;
+
+        const uint64_t seq = item->seq;
+        wb_cancel_token_release(item->token);
+        delete item;
+
+        {
+            // Publishing this chunk supersedes (and aborts) its speculation
+            std::lock_guard<std::mutex> lock(deliver_mutex);
+            published_seq.store(seq, std::memory_order_release);
+            if (params.on_result != nullptr) {
+                params.on_result(&result, params.callback_data);
+            }
+        }
+        in_flight.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+wb_pipeline_params wb_pipeline_default_params(void) {
+    wb_pipeline_params params;
+    params.n_states          = 2;
+    params.queue_capacity    = 16;
+    params.mel_threads       = 2;
+    params.vad_rms_threshold = 0.0f;
+    params.speculative_max_tokens = 0;
+    params.speculative_window_ms  = 1000;
+    params.deadline_ms       = 500;
+    params.fallback_budget   = true;
+    params.on_result         = nullptr;
+    params.callback_data     = nullptr;
+    return params;
+}
+
+wb_pipeline * wb_pipeline_init(
+    struct whisper_context * ctx,
+    const struct whisper_full_params * full_params,
+    wb_pipeline_params params
+) {
+    if (ctx == nullptr || full_params == nullptr) {
+        return nullptr;
+    }
+    if (params.n_states < 2) {
+        params.n_states = 2;
+    }
+    if (params.queue_capacity < 2) {
+        params.queue_capacity = 2;
+    }
+    if (params.mel_threads < 1) {
+        params.mel_threads = 1;
+    }
+
+    auto * p = new wb_pipeline((size_t) params.queue_capacity, (size_t) params.n_states);
+    p->ctx    = ctx;
+    p->params = params;
+    p->full_params.assign(*full_params);
+    p->pool   = wb_pool_shared();
+    p->vocab  = wb_vocab_create(ctx);
+    if (p->vocab == nullptr) {
+        delete p;
+        return nullptr;
+    }
+
+    for (int i = 0; i < params.n_states; ++i) {
+        whisper_state * state = whisper_init_state(ctx);
+        if (state == nullptr) {
+            for (auto * s : p->states) {
+                whisper_free_state(s);
+            }
+            wb_vocab_free(p->vocab);
+            delete p;
+            return nullptr;
+        }
+        p->states.push_back(state);
+        p->free_states.push(state);
+    }
+
+    // Speculation is best effort: without a spare state it simply stays off
+    p->speculative_max_tokens.store(params.speculative_max_tokens, std::memory_order_relaxed);
+    p->speculative_state = whisper_init_state(ctx);
+    if (p->speculative_state != nullptr) {
+        p->threads.emplace_back([p] { p->run_speculation(); });
+    }
+
+    p->threads.emplace_back([p] {
+        p->run_stage(WB_STAGE_PREPARE, p->to_prepare, p->to_mel, [p](work_item * item) { p->prepare(item); });
+    });
+    p->threads.emplace_back([p] {
+        p->run_stage(WB_STAGE_MEL, p->to_mel, p->to_infer, [p](work_item * item) { p->mel(item); });
+    });
+    p->threads.emplace_back([p] {
+        p->run_stage(WB_STAGE_INFER, p->to_infer, p->to_post, [p](work_item * item) { p->infer(item); });
+    });
+    p->threads.emplace_back([p] {
+        for (;;) {
+            work_item * item = p->to_post.pop();
+            if (item == nullptr) {
+                return;
+            }
+            p->post(item);
+        }
+    });
+
+    return p;
+}
+
+void wb_pipeline_free(wb_pipeline * pipeline) {
+    if (pipeline == nullptr) {
+        return;
+    }
+
+    // Everything still queued completes as DROPPED; the marker then stops each stage in turn
+    wb_pipeline_invalidate(pipeline);
+    pipeline->to_prepare.push(nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline->mailbox_mutex);
+        pipeline->stopping.store(true, std::memory_order_relaxed);
+    }
+    pipeline->mailbox_cv.notify_one();
+
+    for (auto & thread : pipeline->threads) {
+        thread.join();
+    }
+    for (auto * state : pipeline->states) {
+        whisper_free_state(state);
+    }
+    if (pipeline->speculative_state != nullptr) {
+        whisper_free_state(pipeline->speculative_state);
+    }
+    wb_vocab_free(pipeline->vocab);
+    delete pipeline;
+}
+
+void wb_pipeline_set_full_params(wb_pipeline * pipeline, const struct whisper_full_params * full_params) {
+    std::lock_guard<std::mutex> lock(pipeline->full_params_mutex);
+    pipeline->full_params.assign(*full_params);
+}
+
+void wb_pipeline_fallback_stats(const wb_pipeline * pipeline, wb_fallback_stats * stats) {
+    for (int i = 0; i < WB_FALLBACK_BUCKETS; ++i) {
+        stats->chunks_by_retries[i] = pipeline->fallback.by_retries[i].load(std::memory_order_relaxed);
+    }
+    stats->budget_stops    = pipeline->fallback.budget_stops.load(std::memory_order_relaxed);
+    stats->deadline_aborts = pipeline->fallback.deadline_aborts.load(std::memory_order_relaxed);
+}
+
+void wb_pipeline_set_speculation(wb_pipeline * pipeline, int max_tokens) {
+    pipeline->speculative_max_tokens.store(max_tokens, std::memory_order_relaxed);
+}
+
+void wb_pipeline_submit(
+    wb_pipeline * pipeline,
+    const float * samples,
+    size_t n_samples,
+    wb_cancel_token * token,
+    void * user_data
+) {
+    auto * item = new work_item();
+    item->seq       = pipeline->next_seq++;
+    item->samples   = samples;
+    item->n_samples = n_samples;
+    item->token     = wb_cancel_token_retain(token);
+    item->user_data = user_data;
+    item->epoch     = pipeline->epoch.load(std::memory_order_acquire);
+    item->submitted = clock_type::now();
+
+    pipeline->in_flight.fetch_add(1, std::memory_order_relaxed);
+    pipeline->to_prepare.push(item);
+}
+
+void wb_pipeline_invalidate(wb_pipeline * pipeline) {
+    pipeline->epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+size_t wb_pipeline_in_flight(const wb_pipeline * pipeline) {
+    return pipeline->in_flight.load(std::memory_order_acquire);
+}
+
+namespace {
+
+struct warmup_probe {
+    wb_pool *               pool;
+    const wb_cancel_token * token;
+};
+
+bool warmup_abort(void * data) {
+    const auto * probe = static_cast<const warmup_probe *>(data);
+    return wb_cancel_token_is_cancelled(probe->token) || wb_pool_should_yield(probe->pool, WB_PRIORITY_BACKGROUND);
+}
+
+bool warmup_encoder_begin(whisper_context *, whisper_state *, void * data) {
+    return !warmup_abort(data);
+}
+
+constexpr int    k_warmup_poll_ms = 100;
+constexpr size_t k_warmup_samples = 1000 * k_samples_per_ms;   // one second
+
+} // namespace
+
+int wb_pipeline_warmup(
+    struct whisper_context * ctx,
+    const struct whisper_full_params * full_params,
+    wb_cancel_token * token
+) {
+    if (ctx == nullptr || full_params == nullptr) {
+        return -1;
+    }
+
+    wb_pool * pool = wb_pool_shared();
+
+    // Wait for an idle moment, checking the token now and then
+    while (!wb_pool_wait_turn(pool, WB_PRIORITY_BACKGROUND,
+                              wb_pool_now_ns() + (uint64_t) k_warmup_poll_ms * 1000000)) {
+        if (wb_cancel_token_is_cancelled(token)) {
+            return 1;
+        }
+    }
+
+    whisper_state * state = whisper_init_state(ctx);
+    if (state == nullptr) {
+        return -1;
+    }
+
+    full_params_copy p;
+    p.assign(*full_params);
+
+    warmup_probe probe = { pool, token };
+    p.params.encoder_begin_callback           = warmup_encoder_begin;
+    p.params.encoder_begin_callback_user_data = &probe;
+    p.params.abort_callback                   = warmup_abort;
+    p.params.abort_callback_user_data         = &probe;
+
+    std::vector<float> silence(k_warmup_samples, 0.0f);
+
+    const int granted = wb_pool_lease(pool, p.params.n_threads, WB_PRIORITY_BACKGROUND, 0);
+    p.params.n_threads = granted;
+    const int rc = warmup_abort(&probe) ? 0 : whisper_full_with_state(ctx, state, p.params, silence.data(), (int) silence.size());
+    const bool preempted = warmup_abort(&probe);
+    wb_pool_release(pool, granted, WB_PRIORITY_BACKGROUND);
+
+    whisper_free_state(state);
+    return preempted ? 1 : rc == 0 ? 0 : -1;
+}
+
+// MARK: - Refinement
+
+struct wb_refiner {
+    whisper_context * ctx   = nullptr;
+    whisper_state *   state = nullptr;
+    wb_vocab *        vocab = nullptr;
+    int               mel_threads = 1;
+    std::vector<float> samples;   // spans joined
+    runaway_guard      guard;
+    std::string        text;
+    float              confidence = -1.0f;
+};
+
+namespace {
+
+struct refine_probe {
+    wb_pool *               pool;
+    int                     priority;
+    const wb_cancel_token * token;
+};
+
+bool refine_abort(void * data) {
+    const auto * probe = static_cast<const refine_probe *>(data);
+    return wb_cancel_token_is_cancelled(probe->token) || wb_pool_should_yield(probe->pool, probe->priority);
+}
+
+bool refine_encoder_begin(whisper_context *, whisper_state *, void * data) {
+    return !refine_abort(data);
+}
+
+} // namespace
+
+wb_refiner * wb_refiner_create(struct whisper_context * ctx, int mel_threads) {
+    if (ctx == nullptr) {
+        return nullptr;
+    }
+
+    auto * refiner = new wb_refiner();
+    refiner->ctx         = ctx;
+    refiner->mel_threads = mel_threads < 1 ? 1 : mel_threads;
+    refiner->state       = whisper_init_state(ctx);
+    refiner->vocab       = wb_vocab_create(ctx);
+    if (refiner->state == nullptr || refiner->vocab == nullptr) {
+        wb_refiner_free(refiner);
+        return nullptr;
+    }
+    return refiner;
+}
+
+void wb_refiner_free(wb_refiner * refiner) {
+    if (refiner == nullptr) {
+        return;
+    }
+    if (refiner->state != nullptr) {
+        whisper_free_state(refiner->state);
+    }
+    wb_vocab_free(refiner->vocab);
+    delete refiner;
+}
+
+int wb_refiner_run(
+    wb_refiner * refiner,
+    const struct whisper_full_params * full_params,
+    const float * const * spans,
+    const size_t * span_samples,
+    int n_spans,
+    int priority,
+    wb_cancel_token * token
+) {
+    if (refiner == nullptr || full_params == nullptr || (n_spans > 0 && (spans == nullptr || span_samples == nullptr))) {
+        return -1;
+    }
+
+    refiner->text.clear();
+    refiner->confidence = -1.0f;
+    refiner->samples.clear();
+    for (int i = 0; i < n_spans; ++i) {
+        refiner->samples.insert(refiner->samples.end(), spans[i], spans[i] + span_samples[i]);
+    }
+    if (refiner->samples.empty()) {
+        return 0;
+    }
+
+    wb_pool * pool = wb_pool_shared();
+    refine_probe probe = { pool, priority, token };
+    if (refine_abort(&probe)) {
+        return 1;
+    }
+
+    if (!compute_mel(pool, refiner->ctx, refiner->state, refiner->samples.data(), refiner->samples.size(),
+                     refiner->mel_threads, priority, 0)) {
+        return refine_abort(&probe) ? 1 : -1;
+    }
+
+    full_params_copy p;
+    p.assign(*full_params);
+    p.params.encoder_begin_callback           = refine_encoder_begin;
+    p.params.encoder_begin_callback_user_data = &probe;
+    p.params.abort_callback                   = refine_abort;
+    p.params.abort_callback_user_data         = &probe;
+
+    wb_pipeline::bound_decode(p.params, refiner->samples.size(), &refiner->guard);
+
+    const int granted = wb_pool_lease(pool, p.params.n_threads, priority, 0);
+    p.params.n_threads = granted;
+    const int rc = whisper_full_with_state(refiner->ctx, refiner->state, p.params, nullptr, 0);
+    wb_pool_release(pool, granted, priority);
+
+    if (rc != 0) {
+        return refine_abort(&probe) ? 1 : -1;
+    }
+
+    decoded_text decoded;
+    decoded.collect(refiner->vocab, refiner->state);
+    refiner->text       = std::move(decoded.text);
+    refiner->confidence = decoded.confidence.score;
+    return 0;
+}
+
+const char * wb_refiner_text(const wb_refiner * refiner) {
+    return refiner != nullptr ? refiner->text.c_str() : "";
+}
+
+float wb_refiner_confidence(const wb_refiner * refiner) {
+    return refiner != nullptr ? refiner->confidence : -1.0f;
+}
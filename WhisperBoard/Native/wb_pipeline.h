@@ -0,0 +1,180 @@
+//
+//  wb_pipeline.h
+//  WhisperBoard
+//
+//  Staged inference pipeline: prepare (convert + VAD) → mel → infer → post/publish
+//  One worker thread per stage, bounded lock-free queues between them, so the
+//  next chunk's mel is computed while the current one is still being decoded.
+//  On speech onset a cheap speculative decode of the first second of speech runs
+//  beside the main path and is aborted as soon as the chunk's real result is published.
+//
+
+#ifndef wb_pipeline_h
+#define wb_pipeline_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wb_cancel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// whisper.cpp types (complete definitions come from whisper.h or the bridging header)
+struct whisper_context;
+struct whisper_full_params;
+
+enum wb_pipeline_stage {
+    WB_STAGE_PREPARE = 0,   // sample checks + energy VAD
+    WB_STAGE_MEL     = 1,   // whisper_pcm_to_mel_with_state on cores leased from the shared pool
+    WB_STAGE_INFER   = 2,   // encode + decode (whisper_full_with_state on the precomputed mel)
+    WB_STAGE_POST    = 3,   // segment text / token extraction, then the result callback
+    WB_STAGE_COUNT   = 4,
+};
+
+enum wb_pipeline_status {
+    WB_PIPELINE_OK      = 0,
+    WB_PIPELINE_SILENT  = 1,   // VAD found no speech; text is empty
+    WB_PIPELINE_DROPPED = 2,   // invalidated or cancelled while in flight; text is empty
+    WB_PIPELINE_FAILED  = 3,   // mel or inference error
+    WB_PIPELINE_TENTATIVE = 4, // speculative text for the start of a chunk whose real result is still pending
+};
+
+// Delivered once per submitted chunk, in submission order, on the post-stage thread.
+// TENTATIVE results come from the speculation thread in addition to that, always before
+// the same chunk's real result; their `user_data` is only borrowed.
+// Pointers are only valid for the duration of the callback.
+typedef struct wb_pipeline_result {
+    int                  status;
+    const char *         text;
+    int                  n_tokens;
+    const char * const * tokens;                     // whole UTF-8 characters; "" for a token that only starts one
+    const int32_t *      token_ids;                  // id of each entry in tokens (text, special and timestamp)
+    const int64_t *      token_t0;                   // start of each entry's segment, 10 ms steps from the chunk start
+    bool                 runaway;                    // decode cut at a repetition loop: low-confidence text
+    float                confidence;                 // 0-1 from token probabilities (wb_confidence); < 0 without text
+    float                stage_ms[WB_STAGE_COUNT];   // time spent in each stage (0 if skipped)
+    float                queued_ms;                  // time spent waiting between stages
+    void *               user_data;                  // as passed to wb_pipeline_submit
+} wb_pipeline_result;
+
+typedef void (*wb_pipeline_result_callback)(const wb_pipeline_result * result, void * callback_data);
+
+typedef struct wb_pipeline_params {
+    int   n_states;          // whisper states in flight (mel of chunk N+1 overlaps decode of N); >= 2
+    int   queue_capacity;    // per-stage queue length (rounded up to a power of two)
+    int   mel_threads;       // threads per mel, leased from the shared pool (inference leases full_params.n_threads)
+    float vad_rms_threshold; // chunks below this RMS skip mel + inference (0 = off)
+    int   speculative_max_tokens; // tokens for the speech-onset speculative decode (0 = off)
+    int   speculative_window_ms;  // speech it decodes from the onset; shorter chunks are not speculated
+    int   deadline_ms;       // latency budget per chunk from submit; orders live work on the shared pool
+    bool  fallback_budget;   // run temperature fallback (temperature_inc > 0) within deadline_ms, see below
+
+    wb_pipeline_result_callback on_result;
+    void *                      callback_data;
+} wb_pipeline_params;
+
+typedef struct wb_pipeline wb_pipeline;
+
+wb_pipeline_params wb_pipeline_default_params(void);
+
+// Creates the stage threads and `n_states` whisper states on `ctx`. `full_params` is copied
+// (including the language and prompt strings). Returns NULL on failure.
+wb_pipeline * wb_pipeline_init(
+    struct whisper_context * ctx,
+    const struct whisper_full_params * full_params,
+    wb_pipeline_params params
+);
+
+// Drops everything in flight (each chunk still gets its DROPPED callback), then joins the threads
+void wb_pipeline_free(wb_pipeline * pipeline);
+
+// Replace the inference parameters for chunks that have not reached the infer stage yet
+void wb_pipeline_set_full_params(wb_pipeline * pipeline, const struct whisper_full_params * full_params);
+
+// Temperature fallback under a budget: instead of letting whisper_full retry at every
+// temperature, the infer stage runs one temperature per call and checks the result as
+// whisper does: logprob_thold (waived once no_speech_thold is reached) and entropy_thold.
+// A retry starts only if the previous attempt's duration still fits before the chunk's
+// deadline; one running at the deadline is aborted.
+// The chunk gets the best attempt so far. The first attempt always completes.
+#define WB_FALLBACK_BUCKETS 6
+
+typedef struct wb_fallback_stats {
+    uint64_t chunks_by_retries[WB_FALLBACK_BUCKETS];   // chunks decoded with 0, 1, ... retries (last: or more)
+    uint64_t budget_stops;      // chunks still failing the checks when no retry fitted the budget
+    uint64_t deadline_aborts;   // retries aborted at the deadline
+} wb_fallback_stats;
+
+void wb_pipeline_fallback_stats(const wb_pipeline * pipeline, wb_fallback_stats * stats);
+
+// Change the speculative token budget (0 turns speculation off)
+void wb_pipeline_set_speculation(wb_pipeline * pipeline, int max_tokens);
+
+// Queue one chunk. `samples` is borrowed until its result callback; call from a single thread.
+// Blocks while the prepare queue is full. `token` (may be NULL) is retained until the result:
+// once it is cancelled the chunk skips every remaining stage, and a decode already running
+// is aborted through whisper.cpp's encoder-begin and abort callbacks.
+void wb_pipeline_submit(
+    wb_pipeline * pipeline,
+    const float * samples,
+    size_t n_samples,
+    wb_cancel_token * token,
+    void * user_data
+);
+
+// Mark everything submitted so far as stale. Stale chunks skip the remaining stages and
+// complete as DROPPED; results already published are unaffected.
+void wb_pipeline_invalidate(wb_pipeline * pipeline);
+
+// Chunks submitted but not yet delivered
+size_t wb_pipeline_in_flight(const wb_pipeline * pipeline);
+
+// Warm a freshly loaded model with one second of silence on a private state, as BACKGROUND
+// work on the shared pool: it waits until live and tentative work is idle, and aborts as
+// soon as either shows up or `token` (may be NULL) is cancelled.
+// Returns 0 when warmed, 1 when preempted or cancelled, -1 on failure.
+int wb_pipeline_warmup(
+    struct whisper_context * ctx,
+    const struct whisper_full_params * full_params,
+    wb_cancel_token * token
+);
+
+// MARK: - Refinement
+
+// Second pass with a larger model over audio the live pipeline has already transcribed:
+// the spans are decoded together as one utterance on the refiner's own state.
+typedef struct wb_refiner wb_refiner;
+
+// One whisper state on `ctx` (the refinement model); its mel leases `mel_threads` cores.
+// Returns NULL on failure.
+wb_refiner * wb_refiner_create(struct whisper_context * ctx, int mel_threads);
+void         wb_refiner_free(wb_refiner * refiner);
+
+// Decode `n_spans` buffers of 16 kHz samples back to back as one utterance; call from one
+// thread at a time. `priority` is the wb_pool class it runs as: a TENTATIVE pass steps aside
+// while live work waits for cores. The text is read with wb_refiner_text.
+// Returns 0 when done, 1 when preempted or `token` (may be NULL) was cancelled, -1 on failure.
+int wb_refiner_run(
+    wb_refiner * refiner,
+    const struct whisper_full_params * full_params,
+    const float * const * spans,
+    const size_t * span_samples,
+    int n_spans,
+    int priority,
+    wb_cancel_token * token
+);
+
+// Text of the last successful run; valid until the next run
+const char * wb_refiner_text(const wb_refiner * refiner);
+
+// Confidence of the last pass's text, as wb_pipeline_result.confidence
+float wb_refiner_confidence(const wb_refiner * refiner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_pipeline_h */
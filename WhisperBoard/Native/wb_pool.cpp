@@ -0,0 +1,471 @@
+//
+//  wb_pool.cpp
+//  WhisperBoard
+//
+//  Each worker owns one deque per class. Tasks submitted from a worker go to its
+//  own deque (popped newest-first, so nested work stays cache-warm); tasks from
+//  outside are dealt round-robin. An idle worker takes the most urgent class it
+//  can find, own deque first, stealing the oldest task of the others otherwise,
+//  before it sleeps. `active` is the number of workers allowed to take tasks:
+//  the worker count minus the cores currently leased to whisper.cpp.
+//
+//  Leases wait in a list ordered by (class, deadline, arrival); only the head
+//  may take free cores. Per-class counters of queued/running tasks, held and
+//  waiting leases and entered sessions answer wb_pool_should_yield without a lock.
+//
+
+#include "wb_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct task {
+    wb_pool_task_fn fn;
+    void *          data;
+    int             priority;
+};
+
+struct worker_queue {
+    std::mutex       mutex;
+    std::deque<task> tasks[WB_PRIORITY_COUNT];
+};
+
+struct range_job {
+    size_t           n        = 0;
+    size_t           grain    = 1;
+    size_t           n_ranges = 0;
+    wb_pool_range_fn fn       = nullptr;
+    void *           data     = nullptr;
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+
+    // Claim ranges until none are left; helpers that start late just find nothing
+    void run() {
+        for (;;) {
+            const size_t r = next.fetch_add(1, std::memory_order_relaxed);
+            if (r >= n_ranges) {
+                return;
+            }
+            const size_t begin = r * grain;
+            fn(begin, std::min(n, begin + grain), data);
+
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == n_ranges) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+void run_range_helper(void * data) {
+    // The helper's reference keeps the job alive even if the caller already returned
+    auto * job = static_cast<std::shared_ptr<range_job> *>(data);
+    (*job)->run();
+    delete job;
+}
+
+struct lease_waiter {
+    int      priority;
+    uint64_t deadline;   // UINT64_MAX = none
+    uint64_t ticket;
+
+    bool before(const lease_waiter & other) const {
+        if (priority != other.priority) {
+            return priority < other.priority;
+        }
+        if (deadline != other.deadline) {
+            return deadline < other.deadline;
+        }
+        return ticket < other.ticket;
+    }
+};
+
+int online_cores() {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? (int) n : 1;
+}
+
+int clamp_priority(int priority) {
+    return priority < WB_PRIORITY_LIVE ? WB_PRIORITY_LIVE
+         : priority >= WB_PRIORITY_COUNT ? WB_PRIORITY_BACKGROUND
+         : priority;
+}
+
+} // namespace
+
+struct wb_pool {
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<std::thread>                   threads;
+
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_queue{0};
+    std::atomic<int>    active{0};
+
+    // Demand per class, read lock-free by wb_pool_should_yield
+    struct demand {
+        std::atomic<int> queued{0};
+        std::atomic<int> running{0};
+        std::atomic<int> held{0};      // cores leased
+        std::atomic<int> waiting{0};   // leases not granted yet
+        std::atomic<int> entered{0};
+    } demand[WB_PRIORITY_COUNT];
+
+    // Guards sleeping, leases, turn waiters and shutdown
+    std::mutex                   sleep_mutex;
+    std::condition_variable      sleep_cv;
+    std::condition_variable      lease_cv;
+    std::condition_variable      turn_cv;
+    std::vector<lease_waiter *>  waiters;
+    uint64_t                     next_ticket  = 0;
+    std::atomic<int>             turn_waiters{0};   // wait_turn callers + background leases
+    int                          leased   = 0;
+    bool                         stopping = false;
+
+    int size() const { return (int) queues.size(); }
+
+    void push(task t);
+    bool take(size_t index, task & out);
+    void run_task(const task & t);
+    void run_worker(size_t index);
+    void wake_all();
+    void wake_turn_waiters();
+
+    // Sequentially consistent loads: pairs with the decrement-then-check in wake_turn_waiters
+    bool foreground_busy() const {
+        for (int c = WB_PRIORITY_LIVE; c < WB_PRIORITY_BACKGROUND; ++c) {
+            const auto & d = demand[c];
+            if (d.queued.load() + d.running.load() + d.held.load() + d.waiting.load() + d.entered.load() > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool should_yield(int priority) const {
+        switch (priority) {
+        case WB_PRIORITY_TENTATIVE:  return demand[WB_PRIORITY_LIVE].waiting.load() > 0;
+        case WB_PRIORITY_BACKGROUND: return foreground_busy();
+        default:                     return false;
+        }
+    }
+
+    // Lease head: the most urgent waiter, if there is one (sleep_mutex held)
+    const lease_waiter * head() const {
+        const lease_waiter * best = nullptr;
+        for (const auto * w : waiters) {
+            if (best == nullptr || w->before(*best)) {
+                best = w;
+            }
+        }
+        return best;
+    }
+};
+
+namespace {
+thread_local wb_pool * t_pool     = nullptr;
+thread_local size_t    t_index    = 0;
+thread_local int       t_priority = WB_PRIORITY_LIVE;
+}
+
+void wb_pool::push(task t) {
+    const size_t index = t_pool == this ? t_index : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks[t.priority].push_back(t);
+    }
+    demand[t.priority].queued.fetch_add(1, std::memory_order_release);
+    queued.fetch_add(1, std::memory_order_release);
+}
+
+bool wb_pool::take(size_t index, task & out) {
+    for (int c = WB_PRIORITY_LIVE; c < WB_PRIORITY_COUNT; ++c) {
+        if (demand[c].queued.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+
+        // Own deque: newest first. Others: oldest first, starting with the next worker
+        // so thieves spread out
+        for (size_t k = 0; k < queues.size(); ++k) {
+            auto & q = *queues[(index + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            auto & tasks = q.tasks[c];
+            if (tasks.empty()) {
+                continue;
+            }
+            if (k == 0) {
+                out = tasks.back();
+                tasks.pop_back();
+            } else {
+                out = tasks.front();
+                tasks.pop_front();
+            }
+            demand[c].running.fetch_add(1, std::memory_order_relaxed);
+            demand[c].queued.fetch_sub(1, std::memory_order_release);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void wb_pool::run_task(const task & t) {
+    const int saved = t_priority;
+    t_priority = t.priority;
+    t.fn(t.data);
+    t_priority = saved;
+
+    if (demand[t.priority].running.fetch_sub(1) == 1 && t.priority != WB_PRIORITY_BACKGROUND) {
+        wake_turn_waiters();
+    }
+}
+
+void wb_pool::run_worker(size_t index) {
+    t_pool  = this;
+    t_index = index;
+
+    for (;;) {
+        task t;
+        if ((int) index < active.load(std::memory_order_acquire) && take(index, t)) {
+            run_task(t);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_cv.wait(lock, [&] {
+            return stopping || (queued.load(std::memory_order_acquire) > 0 && (int) index < size() - leased);
+        });
+        if (stopping) {
+            lock.unlock();
+            // Drain whatever is left, ignoring leases
+            while (take(index, t)) {
+                run_task(t);
+            }
+            return;
+        }
+    }
+}
+
+void wb_pool::wake_all() {
+    // Taking the lock orders the wake after a worker's predicate check
+    { std::lock_guard<std::mutex> lock(sleep_mutex); }
+    sleep_cv.notify_all();
+}
+
+void wb_pool::wake_turn_waiters() {
+    if (turn_waiters.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex); }
+        turn_cv.notify_all();
+        lease_cv.notify_all();
+    }
+}
+
+wb_pool * wb_pool_shared(void) {
+    static wb_pool * shared = wb_pool_create(0);
+    return shared;
+}
+
+wb_pool * wb_pool_create(int n_workers) {
+    if (n_workers <= 0) {
+        n_workers = online_cores();
+    }
+
+    auto * pool = new wb_pool();
+    for (int i = 0; i < n_workers; ++i) {
+        pool->queues.push_back(std::make_unique<worker_queue>());
+    }
+    pool->active.store(n_workers, std::memory_order_release);
+    for (int i = 0; i < n_workers; ++i) {
+        pool->threads.emplace_back([pool, i] { pool->run_worker((size_t) i); });
+    }
+    return pool;
+}
+
+void wb_pool_free(wb_pool * pool) {
+    if (pool == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->sleep_mutex);
+        pool->stopping = true;
+    }
+    pool->sleep_cv.notify_all();
+    for (auto & thread : pool->threads) {
+        thread.join();
+    }
+    delete pool;
+}
+
+int wb_pool_size(const wb_pool * pool) {
+    return pool->size();
+}
+
+uint64_t wb_pool_now_ns(void) {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+void wb_pool_set_thread_priority(int priority) {
+    t_priority = clamp_priority(priority);
+}
+
+void wb_pool_submit(wb_pool * pool, wb_pool_task_fn fn, void * data) {
+    pool->push({ fn, data, t_priority });
+    pool->wake_all();
+}
+
+void wb_pool_parallel_for(wb_pool * pool, size_t n, size_t grain, wb_pool_range_fn fn, void * data) {
+    if (n == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    const size_t n_ranges = (n + grain - 1) / grain;
+
+    // One active worker fewer than the budget: the calling thread takes a share too
+    const int    active  = pool != nullptr ? pool->active.load(std::memory_order_acquire) : 0;
+    const size_t helpers = std::min(n_ranges - 1, (size_t) std::max(0, active - 1));
+    if (helpers == 0) {
+        for (size_t begin = 0; begin < n; begin += grain) {
+            fn(begin, std::min(n, begin + grain), data);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<range_job>();
+    job->n        = n;
+    job->grain    = grain;
+    job->n_ranges = n_ranges;
+    job->fn       = fn;
+    job->data     = data;
+
+    for (size_t i = 0; i < helpers; ++i) {
+        pool->push({ run_range_helper, new std::shared_ptr<range_job>(job), t_priority });
+    }
+    pool->wake_all();
+
+    job->run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&] { return job->done.load(std::memory_order_acquire) == n_ranges; });
+}
+
+int wb_pool_lease(wb_pool * pool, int want, int priority, uint64_t deadline_ns) {
+    if (want < 1) {
+        want = 1;
+    }
+    priority = clamp_priority(priority);
+
+    auto & demand = pool->demand[priority];
+    std::unique_lock<std::mutex> lock(pool->sleep_mutex);
+
+    lease_waiter self = { priority, deadline_ns != 0 ? deadline_ns : UINT64_MAX, pool->next_ticket++ };
+    pool->waiters.push_back(&self);
+    demand.waiting.fetch_add(1);
+
+    // Background leases also wait for the other classes to go idle, which task completions signal
+    const bool background = priority == WB_PRIORITY_BACKGROUND;
+    if (background) {
+        pool->turn_waiters.fetch_add(1);
+    }
+
+    pool->lease_cv.wait(lock, [&] {
+        return pool->leased < pool->size() && pool->head() == &self && (!background || !pool->foreground_busy());
+    });
+
+    pool->waiters.erase(std::find(pool->waiters.begin(), pool->waiters.end(), &self));
+    if (background) {
+        pool->turn_waiters.fetch_sub(1);
+    }
+
+    const int granted = std::min(want, pool->size() - pool->leased);
+    pool->leased += granted;
+    pool->active.store(pool->size() - pool->leased, std::memory_order_release);
+    demand.held.fetch_add(granted);
+    demand.waiting.fetch_sub(1);
+    lock.unlock();
+
+    // The next waiter may fit in what is left
+    pool->lease_cv.notify_all();
+    return granted;
+}
+
+int wb_pool_try_lease(wb_pool * pool, int want, int priority) {
+    if (want < 1) {
+        want = 1;
+    }
+    priority = clamp_priority(priority);
+
+    std::lock_guard<std::mutex> lock(pool->sleep_mutex);
+    if (pool->leased >= pool->size() || !pool->waiters.empty() ||
+        (priority == WB_PRIORITY_BACKGROUND && pool->foreground_busy())) {
+        return 0;
+    }
+
+    const int granted = std::min(want, pool->size() - pool->leased);
+    pool->leased += granted;
+    pool->active.store(pool->size() - pool->leased, std::memory_order_release);
+    pool->demand[priority].held.fetch_add(granted);
+    return granted;
+}
+
+void wb_pool_release(wb_pool * pool, int granted, int priority) {
+    priority = clamp_priority(priority);
+    {
+        std::lock_guard<std::mutex> lock(pool->sleep_mutex);
+        pool->leased -= granted;
+        pool->active.store(pool->size() - pool->leased, std::memory_order_release);
+        pool->demand[priority].held.fetch_sub(granted);
+    }
+    pool->lease_cv.notify_all();
+    pool->sleep_cv.notify_all();
+    pool->turn_cv.notify_all();
+}
+
+void wb_pool_enter(wb_pool * pool, int priority) {
+    pool->demand[clamp_priority(priority)].entered.fetch_add(1);
+}
+
+void wb_pool_leave(wb_pool * pool, int priority) {
+    pool->demand[clamp_priority(priority)].entered.fetch_sub(1);
+    pool->wake_turn_waiters();
+}
+
+bool wb_pool_should_yield(const wb_pool * pool, int priority) {
+    return pool->should_yield(clamp_priority(priority));
+}
+
+bool wb_pool_wait_turn(wb_pool * pool, int priority, uint64_t deadline_ns) {
+    priority = clamp_priority(priority);
+    if (!pool->should_yield(priority)) {
+        return true;
+    }
+
+    const auto deadline = clock_type::time_point(std::chrono::nanoseconds(deadline_ns));
+
+    std::unique_lock<std::mutex> lock(pool->sleep_mutex);
+    pool->turn_waiters.fetch_add(1);
+    bool turn = true;
+    if (deadline_ns == 0) {
+        pool->turn_cv.wait(lock, [&] { return !pool->should_yield(priority); });
+    } else {
+        turn = pool->turn_cv.wait_until(lock, deadline, [&] { return !pool->should_yield(priority); });
+    }
+    pool->turn_waiters.fetch_sub(1);
+    return turn;
+}
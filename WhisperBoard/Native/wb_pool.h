@@ -0,0 +1,96 @@
+//
+//  wb_pool.h
+//  WhisperBoard
+//
+//  Work-stealing thread pool that owns the cores for native compute
+//  Per-worker deques (owner pops newest, thieves take oldest), parked workers
+//  sleep instead of spinning. whisper.cpp/ggml still creates its own threads
+//  for graph compute, so those calls lease cores from the pool: leased cores
+//  park the same number of pool workers, and a lease waits while every core is
+//  taken, so pool workers + leased threads never exceed the core count.
+//  Work is classed live > tentative > background; lower classes poll
+//  wb_pool_should_yield at their stage boundaries and step aside.
+//
+
+#ifndef wb_pool_h
+#define wb_pool_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct wb_pool wb_pool;
+
+typedef void (*wb_pool_task_fn)(void * data);
+typedef void (*wb_pool_range_fn)(size_t begin, size_t end, void * data);
+
+// Work classes, most urgent first. Queued tasks run by class, and lease waiters are
+// served by class and then earliest deadline.
+enum wb_pool_priority {
+    WB_PRIORITY_LIVE       = 0,   // dictation chunks, each on a latency deadline
+    WB_PRIORITY_TENTATIVE  = 1,   // refinement passes
+    WB_PRIORITY_BACKGROUND = 2,   // warmup and maintenance: runs only while the others are idle
+    WB_PRIORITY_COUNT      = 3,
+};
+
+// Process-wide pool with one worker per online core, created on first use and never freed
+wb_pool * wb_pool_shared(void);
+
+// Private pool (0 = one worker per online core)
+wb_pool * wb_pool_create(int n_workers);
+
+// Runs everything still queued, then joins the workers
+void wb_pool_free(wb_pool * pool);
+
+// Worker count (= core budget)
+int wb_pool_size(const wb_pool * pool);
+
+// Deadline clock (steady, nanoseconds)
+uint64_t wb_pool_now_ns(void);
+
+// Class of the work the calling thread queues (default LIVE). Pool workers take on the
+// class of the task they are running, so nested work keeps its class.
+void wb_pool_set_thread_priority(int priority);
+
+// Fire-and-forget task. From a pool worker it lands on that worker's own deque.
+void wb_pool_submit(wb_pool * pool, wb_pool_task_fn fn, void * data);
+
+// Run `fn` over [0, n) in ranges of at most `grain` items. The calling thread works
+// on ranges too, and it returns once every range has finished.
+void wb_pool_parallel_for(wb_pool * pool, size_t n, size_t grain, wb_pool_range_fn fn, void * data);
+
+// Reserve cores for a call that creates its own threads (whisper_full, whisper_encode, ...).
+// Waits until at least one core is free and no more urgent lease is waiting (BACKGROUND
+// also waits for the other classes to go idle), grants up to `want`, and returns the
+// thread count to pass to that call. The calling thread counts as one of them.
+// `deadline_ns` (wb_pool_now_ns clock, 0 = none) orders waiters within a class.
+int  wb_pool_lease(wb_pool * pool, int want, int priority, uint64_t deadline_ns);
+void wb_pool_release(wb_pool * pool, int granted, int priority);
+
+// wb_pool_lease without the wait: grants only if a core is free and no lease is waiting
+// (BACKGROUND: and the other classes are idle), otherwise returns 0. Any thread may
+// release what it grants.
+int  wb_pool_try_lease(wb_pool * pool, int want, int priority);
+
+// Mark a class busy beyond its tasks and leases, e.g. a live session between chunks
+void wb_pool_enter(wb_pool * pool, int priority);
+void wb_pool_leave(wb_pool * pool, int priority);
+
+// Preemption check for work of class `priority`, meant for stage boundaries and
+// whisper.cpp abort callbacks: TENTATIVE yields while a LIVE lease is waiting for cores,
+// BACKGROUND while any live or tentative work is queued, running, leased or entered.
+bool wb_pool_should_yield(const wb_pool * pool, int priority);
+
+// Block until wb_pool_should_yield is false or `deadline_ns` passes (0 = no limit).
+// Returns false on timeout.
+bool wb_pool_wait_turn(wb_pool * pool, int priority, uint64_t deadline_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_pool_h */
@@ -0,0 +1,201 @@
+//
+//  wb_repetition.cpp
+//  WhisperBoard
+//
+//  wb_repetition_check runs both checks over the whole sequence, for callers
+//  that look once. Per-token callers use a tracker: the periodic check only
+//  walks the tail (a run it follows back is shorter than the 48 tokens that
+//  would already have ended the decode), and the trigram counts are kept in an
+//  open-addressing table that a new token adds one key to.
+//
+
+#include "wb_repetition.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr size_t k_samples_per_second = 16000;
+constexpr int    k_tokens_per_second  = 8;    // twice fast speech
+constexpr int    k_token_slack        = 16;   // punctuation and the odd long word in a short chunk
+
+constexpr int    k_max_period      = 16;
+constexpr int    k_min_repeats     = 3;
+constexpr int    k_min_loop_tokens = 16;
+
+constexpr int    k_min_ratio_tokens = 32;
+constexpr double k_max_ratio        = 2.4;
+
+// The tail repeats itself with some period: keep everything before the repeats
+int periodic_tail(const int32_t * tokens, int n) {
+    for (int period = 1; period <= k_max_period; ++period) {
+        const int needed = std::max(period * k_min_repeats, k_min_loop_tokens);
+        if (n < needed) {
+            break;
+        }
+
+        // Tokens from the end that equal the one a period earlier
+        int run = 0;
+        while (run < n - period && tokens[n - 1 - run] == tokens[n - 1 - run - period]) {
+            ++run;
+        }
+        if (run + period >= needed) {
+            return n - run;
+        }
+    }
+    return 0;
+}
+
+// Trigrams of a sequence, counted as its tokens arrive
+class trigram_counter {
+public:
+    void reserve(int n_tokens) {
+        size_t n = 64;
+        while (n < 2 * (size_t) std::max(n_tokens, 0)) {
+            n <<= 1;
+        }
+        if (n > table_.size()) {
+            rehash(n);
+        }
+    }
+
+    void clear() {
+        std::fill(table_.begin(), table_.end(), 0);
+        used_      = 0;
+        covered_   = 0;
+        run_start_ = 0;
+        last_      = -1;
+    }
+
+    // tokens[i] (i >= 2) completes a trigram
+    void add(const int32_t * tokens, int i) {
+        const uint64_t key = ((uint64_t) (tokens[i - 2] & 0x1fffff) << 42) |
+                             ((uint64_t) (tokens[i - 1] & 0x1fffff) << 21) |
+                              (uint64_t) (tokens[i] & 0x1fffff);
+        if (insert(key)) {
+            return;
+        }
+        ++covered_;
+        if (last_ != i - 1) {
+            run_start_ = i;
+        }
+        last_ = i;
+    }
+
+    // Too many trigrams seen before: keep everything before the trailing run of them
+    int check(int n) const {
+        if (n < k_min_ratio_tokens || (double) n <= k_max_ratio * (double) (n - covered_)) {
+            return 0;
+        }
+        // The run's first trigram starts two tokens before the token that completes it
+        return last_ == n - 1 ? run_start_ - 2 : n;
+    }
+
+private:
+    static constexpr uint64_t k_occupied = 1ull << 63;   // keys use the low 63 bits
+
+    // False if the key was there already
+    bool insert(uint64_t key) {
+        if (2 * (used_ + 1) > table_.size()) {
+            rehash(std::max<size_t>(64, 2 * table_.size()));
+        }
+        const uint64_t entry = key | k_occupied;
+        const size_t   mask  = table_.size() - 1;
+        for (size_t i = (size_t) ((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;; i = (i + 1) & mask) {
+            if (table_[i] == entry) {
+                return false;
+            }
+            if (table_[i] == 0) {
+                table_[i] = entry;
+                ++used_;
+                return true;
+            }
+        }
+    }
+
+    void rehash(size_t n) {
+        std::vector<uint64_t> old(n, 0);
+        old.swap(table_);
+        used_ = 0;
+        for (const uint64_t entry : old) {
+            if (entry != 0) {
+                insert(entry & ~k_occupied);
+            }
+        }
+    }
+
+    std::vector<uint64_t> table_;   // power-of-two size, at most half full; 0 = empty
+    size_t used_      = 0;
+    int    covered_   = 0;    // trigrams seen before
+    int    run_start_ = 0;    // first token of the current run of repeated trigrams
+    int    last_      = -1;   // last token ending a repeated trigram
+};
+
+int repeated_trigrams(const int32_t * tokens, int n) {
+    if (n < k_min_ratio_tokens) {
+        return 0;
+    }
+    trigram_counter trigrams;
+    trigrams.reserve(n);
+    for (int i = 2; i < n; ++i) {
+        trigrams.add(tokens, i);
+    }
+    return trigrams.check(n);
+}
+
+} // namespace
+
+struct wb_repetition_tracker {
+    std::vector<int32_t> tokens;
+    trigram_counter      trigrams;
+
+    int check() const {
+        const int n    = (int) tokens.size();
+        const int keep = periodic_tail(tokens.data(), n);
+        return keep > 0 ? keep : trigrams.check(n);
+    }
+};
+
+int wb_repetition_token_cap(size_t n_samples) {
+    const size_t seconds = (n_samples + k_samples_per_second - 1) / k_samples_per_second;
+    return k_token_slack + (int) seconds * k_tokens_per_second;
+}
+
+int wb_repetition_check(const int32_t * tokens, int n_tokens) {
+    if (tokens == nullptr || n_tokens <= 0) {
+        return 0;
+    }
+    const int keep = periodic_tail(tokens, n_tokens);
+    return keep > 0 ? keep : repeated_trigrams(tokens, n_tokens);
+}
+
+wb_repetition_tracker * wb_repetition_tracker_create(int capacity) {
+    auto * tracker = new wb_repetition_tracker();
+    tracker->tokens.reserve((size_t) std::max(capacity, 0));
+    tracker->trigrams.reserve(capacity);
+    return tracker;
+}
+
+void wb_repetition_tracker_free(wb_repetition_tracker * tracker) {
+    delete tracker;
+}
+
+int wb_repetition_tracker_push(wb_repetition_tracker * tracker, int32_t token) {
+    tracker->tokens.push_back(token);
+    if (tracker->tokens.size() >= 3) {
+        tracker->trigrams.add(tracker->tokens.data(), (int) tracker->tokens.size() - 1);
+    }
+    return tracker->check();
+}
+
+int wb_repetition_tracker_truncate(wb_repetition_tracker * tracker, int n_tokens) {
+    if (n_tokens >= 0 && (size_t) n_tokens < tracker->tokens.size()) {
+        tracker->tokens.resize((size_t) n_tokens);
+        tracker->trigrams.clear();
+        for (int i = 2; i < n_tokens; ++i) {
+            tracker->trigrams.add(tracker->tokens.data(), i);
+        }
+    }
+    return tracker->check();
+}
@@ -0,0 +1,52 @@
+//
+//  wb_repetition.h
+//  WhisperBoard
+//
+//  Runaway decode detection. On silence or noise whisper can loop ("Thank you.
+//  Thank you. Thank you.") until it runs out of tokens, the slowest decode there
+//  is. Checked after every token, these let a decoder stop as soon as a loop
+//  shows and keep the text before the repeats.
+//
+
+#ifndef wb_repetition_h
+#define wb_repetition_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Token budget for `n_samples` of 16 kHz audio. Fast speech is about four tokens a second;
+// a decode that needs far more than that is looping or transcribing noise.
+int wb_repetition_token_cap(size_t n_samples);
+
+// Looks at decoded text tokens (no special or timestamp tokens), oldest first. Returns 0
+// while they read like speech. Once they loop, returns how many to keep: the text up to
+// the end of the loop's first pass (all of them if the repeats are not at the end).
+// Two signs of a loop:
+//   - the tail repeats a unit of up to 16 tokens, 3 times or more, over 16+ tokens
+//   - most trigrams have been seen before (a token-level compression ratio above 2.4,
+//     whisper's threshold for its gzip ratio), which catches longer repeated units
+int wb_repetition_check(const int32_t * tokens, int n_tokens);
+
+// The same check for a sequence that grows a token at a time: each push only looks at
+// the new token (and the tail's period), with no allocation once the capacity is reached.
+typedef struct wb_repetition_tracker wb_repetition_tracker;
+
+// `capacity`: tokens to make room for up front (the tracker grows past it if needed)
+wb_repetition_tracker * wb_repetition_tracker_create(int capacity);
+void wb_repetition_tracker_free(wb_repetition_tracker * tracker);
+
+// Append a text token; returns wb_repetition_check of every token pushed so far
+int wb_repetition_tracker_push(wb_repetition_tracker * tracker, int32_t token);
+
+// Keep only the first `n_tokens` (a sequence that forked); returns wb_repetition_check of them
+int wb_repetition_tracker_truncate(wb_repetition_tracker * tracker, int n_tokens);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_repetition_h */
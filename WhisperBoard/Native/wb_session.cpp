@@ -0,0 +1,334 @@
+//
+//  wb_session.cpp
+//  WhisperBoard
+//
+//  Every chunk carries a small record (session, user_data, is_last) through the
+//  pipeline as its user_data, holding a session reference until its result.
+//  TENTATIVE results are advisory: they are dropped rather than waited for when
+//  the channel is full, and a real result evicts queued tentative ones first.
+//
+
+#include "wb_session.h"
+
+#include "wb_cancel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct chunk_record {
+    wb_session * session   = nullptr;
+    void *       user_data = nullptr;
+    bool         is_last   = false;
+};
+
+struct stored_event {
+    int                       status    = WB_PIPELINE_OK;
+    bool                      is_last   = false;
+    std::string               text;
+    std::vector<std::string>  tokens;
+    std::vector<const char *> token_ptrs;
+    bool                      runaway   = false;
+    float                     confidence = -1.0f;
+    float                     stage_ms[WB_STAGE_COUNT] = {};
+    float                     queued_ms = 0.0f;
+    void *                    user_data = nullptr;
+
+    stored_event() = default;
+
+    stored_event(const wb_pipeline_result & result, const chunk_record & record)
+        : status(result.status)
+        , is_last(record.is_last && result.status != WB_PIPELINE_TENTATIVE)
+        , text(result.text != nullptr ? result.text : "")
+        , runaway(result.runaway)
+        , confidence(result.confidence)
+        , queued_ms(result.queued_ms)
+        , user_data(record.user_data) {
+        tokens.reserve((size_t) result.n_tokens);
+        for (int i = 0; i < result.n_tokens; ++i) {
+            tokens.emplace_back(result.tokens[i] != nullptr ? result.tokens[i] : "");
+        }
+        for (int s = 0; s < WB_STAGE_COUNT; ++s) {
+            stage_ms[s] = result.stage_ms[s];
+        }
+    }
+
+    // The pointers must be taken where the event finally lives (moving strings may move their bytes)
+    void fill(wb_session_event * event) {
+        token_ptrs.clear();
+        for (const auto & token : tokens) {
+            token_ptrs.push_back(token.c_str());
+        }
+
+        event->status     = status;
+        event->is_last    = is_last;
+        event->text       = text.c_str();
+        event->n_tokens   = (int) token_ptrs.size();
+        event->tokens     = token_ptrs.data();
+        event->runaway    = runaway;
+        event->confidence = confidence;
+        event->queued_ms  = queued_ms;
+        event->user_data  = user_data;
+        for (int s = 0; s < WB_STAGE_COUNT; ++s) {
+            event->stage_ms[s] = stage_ms[s];
+        }
+    }
+};
+
+using waiter = std::pair<wb_session_wake_fn, void *>;
+
+} // namespace
+
+struct wb_session {
+    wb_pipeline *     pipeline = nullptr;
+    wb_cancel_token * token    = nullptr;
+    wb_session_params params;
+    std::atomic<int>  refs{1};   // the consumer + one per chunk in the pipeline
+
+    std::mutex               mutex;
+    std::condition_variable  space;
+    std::deque<stored_event> events;
+    stored_event             current;   // backs the event last returned by wb_session_next
+    size_t                   in_flight      = 0;
+    bool                     last_delivered = false;
+    bool                     closed         = false;
+    waiter                   next_waiter{nullptr, nullptr};
+    std::vector<waiter>      cancel_waiters;
+
+    bool cancelled() const {
+        return wb_cancel_token_is_cancelled(token);
+    }
+
+    // mutex held
+    bool ended() const {
+        return events.empty() && in_flight == 0 && (last_delivered || cancelled());
+    }
+
+    // mutex held: waiters that may run now, to be called after unlocking
+    void take_ready(std::vector<waiter> & ready) {
+        if (next_waiter.first != nullptr && (!events.empty() || ended())) {
+            ready.push_back(next_waiter);
+            next_waiter = {nullptr, nullptr};
+        }
+        if (!cancel_waiters.empty() && (cancelled() || ended())) {
+            ready.insert(ready.end(), cancel_waiters.begin(), cancel_waiters.end());
+            cancel_waiters.clear();
+        }
+    }
+
+    void release_user_data(void * user_data) const {
+        if (params.release_user_data != nullptr) {
+            params.release_user_data(user_data);
+        }
+    }
+};
+
+namespace {
+
+void session_release(wb_session * session) {
+    if (session->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        wb_cancel_token_release(session->token);
+        delete session;
+    }
+}
+
+void wake_all(const std::vector<waiter> & ready) {
+    for (const auto & w : ready) {
+        w.first(w.second);
+    }
+}
+
+// Speculative text: queued only if there is room, never waited for
+void deliver_tentative(wb_session * session, const wb_pipeline_result & result, const chunk_record & record) {
+    std::vector<waiter> ready;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (session->closed || session->cancelled() || (int) session->events.size() >= session->params.capacity) {
+            return;
+        }
+        session->events.emplace_back(result, record);
+        session->take_ready(ready);
+    }
+    wake_all(ready);
+}
+
+// A chunk's real result: waits for room (backpressure), releases it if nobody will read it
+void deliver_final(wb_session * session, const wb_pipeline_result & result, const chunk_record & record) {
+    bool release = result.status == WB_PIPELINE_DROPPED;
+    std::vector<waiter> ready;
+    {
+        std::unique_lock<std::mutex> lock(session->mutex);
+        if (!release && !session->closed) {
+            auto & events = session->events;
+            for (auto it = events.begin(); it != events.end() && (int) events.size() >= session->params.capacity;) {
+                it = it->status == WB_PIPELINE_TENTATIVE ? events.erase(it) : it + 1;
+            }
+            session->space.wait(lock, [&] {
+                return session->closed || (int) events.size() < session->params.capacity;
+            });
+        }
+        release = release || session->closed;
+
+        if (!release) {
+            session->events.emplace_back(result, record);
+        }
+        if (record.is_last) {
+            session->last_delivered = true;
+        }
+        session->in_flight--;
+        session->take_ready(ready);
+    }
+    wake_all(ready);
+
+    if (release) {
+        session->release_user_data(record.user_data);
+    }
+}
+
+} // namespace
+
+wb_session_params wb_session_default_params(void) {
+    wb_session_params params;
+    params.capacity          = 8;
+    params.release_user_data = nullptr;
+    return params;
+}
+
+void wb_session_pipeline_result(const wb_pipeline_result * result, void * /* callback_data */) {
+    auto * record = static_cast<chunk_record *>(result->user_data);
+    wb_session * session = record->session;
+
+    if (result->status == WB_PIPELINE_TENTATIVE) {
+        deliver_tentative(session, *result, *record);
+        return;
+    }
+
+    deliver_final(session, *result, *record);
+    delete record;
+    session_release(session);
+}
+
+wb_session * wb_session_open(wb_pipeline * pipeline, wb_session_params params) {
+    if (pipeline == nullptr) {
+        return nullptr;
+    }
+    auto * session = new wb_session();
+    session->pipeline = pipeline;
+    session->token    = wb_cancel_token_create();
+    session->params   = params;
+    if (session->params.capacity < 1) {
+        session->params.capacity = 1;
+    }
+    return session;
+}
+
+void wb_session_close(wb_session * session) {
+    if (session == nullptr) {
+        return;
+    }
+    wb_session_cancel(session);
+
+    std::deque<stored_event> pending;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->closed = true;
+        pending.swap(session->events);
+        session->next_waiter = {nullptr, nullptr};
+    }
+    session->space.notify_all();
+
+    for (const auto & event : pending) {
+        if (event.status != WB_PIPELINE_TENTATIVE) {
+            session->release_user_data(event.user_data);
+        }
+    }
+    session_release(session);
+}
+
+void wb_session_submit(
+    wb_session * session,
+    const float * samples,
+    size_t n_samples,
+    void * user_data,
+    bool is_last
+) {
+    auto * record = new chunk_record();
+    record->session   = session;
+    record->user_data = user_data;
+    record->is_last   = is_last;
+
+    session->refs.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->in_flight++;
+    }
+    wb_pipeline_submit(session->pipeline, samples, n_samples, session->token, record);
+}
+
+void wb_session_cancel(wb_session * session) {
+    wb_cancel_token_cancel(session->token);
+
+    std::vector<waiter> ready;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        // Speculative text of a cancelled session is stale
+        auto & events = session->events;
+        for (auto it = events.begin(); it != events.end();) {
+            it = it->status == WB_PIPELINE_TENTATIVE ? events.erase(it) : it + 1;
+        }
+        session->take_ready(ready);
+    }
+    session->space.notify_all();
+    wake_all(ready);
+}
+
+bool wb_session_is_cancelled(const wb_session * session) {
+    return session->cancelled();
+}
+
+wb_cancel_token * wb_session_token(const wb_session * session) {
+    return session->token;
+}
+
+int wb_session_next(wb_session * session, wb_session_event * event) {
+    std::vector<waiter> ready;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (session->events.empty()) {
+            return session->ended() ? -1 : 0;
+        }
+        session->current = std::move(session->events.front());
+        session->events.pop_front();
+        // Taking the last result may be what ends the session
+        session->take_ready(ready);
+    }
+    session->space.notify_one();
+    wake_all(ready);
+
+    session->current.fill(event);
+    return 1;
+}
+
+bool wb_session_await_next(wb_session * session, wb_session_wake_fn wake, void * data) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (!session->events.empty() || session->ended()) {
+        return false;
+    }
+    session->next_waiter = {wake, data};
+    return true;
+}
+
+bool wb_session_await_cancel(wb_session * session, wb_session_wake_fn wake, void * data) {
+    std::lock_guard<std::mutex> lock(session->mutex);
+    if (session->cancelled() || session->ended()) {
+        return false;
+    }
+    session->cancel_waiters.emplace_back(wake, data);
+    return true;
+}
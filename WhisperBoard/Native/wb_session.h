@@ -0,0 +1,100 @@
+//
+//  wb_session.h
+//  WhisperBoard
+//
+//  One dictation session over a wb_pipeline, consumed by pulling instead of callbacks
+//  Results queue in a bounded per-session channel. The consumer either polls it or
+//  registers a one-shot wake-up and pulls after that. When the channel is full the
+//  pipeline's post stage waits, and that holds up submit, so a slow consumer slows
+//  the producer instead of piling up results. wb_session.hpp builds C++20 coroutine
+//  awaitables on top of this; Swift wraps the same calls in continuations.
+//
+
+#ifndef wb_session_h
+#define wb_session_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wb_pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct wb_session wb_session;
+
+// One result, as returned by wb_session_next. Pointers stay valid until the next
+// wb_session_next or wb_session_close on the same session.
+typedef struct wb_session_event {
+    int                  status;      // wb_pipeline_status; never DROPPED
+    bool                 is_last;     // result of the chunk submitted with is_last
+    const char *         text;
+    int                  n_tokens;
+    const char * const * tokens;
+    bool                 runaway;     // cut at a repetition loop: low-confidence text
+    float                confidence;  // 0-1, < 0 without text
+    float                stage_ms[WB_STAGE_COUNT];
+    float                queued_ms;
+    void *               user_data;   // as passed to wb_session_submit; borrowed for TENTATIVE
+} wb_session_event;
+
+typedef void (*wb_session_wake_fn)(void * data);
+typedef void (*wb_session_release_fn)(void * user_data);
+
+typedef struct wb_session_params {
+    int capacity;   // results buffered before the pipeline waits for the consumer
+    // Called for chunks whose result the consumer never sees: dropped or cancelled chunks
+    // (on a pipeline thread), and anything still queued at wb_session_close (on its caller)
+    wb_session_release_fn release_user_data;
+} wb_session_params;
+
+wb_session_params wb_session_default_params(void);
+
+// Pass as the pipeline's on_result (callback_data unused) to route results to sessions.
+// A pipeline wired this way only accepts chunks through wb_session_submit.
+void wb_session_pipeline_result(const wb_pipeline_result * result, void * callback_data);
+
+// New session on `pipeline` with its own cancellation token. The pipeline must outlive it.
+wb_session * wb_session_open(wb_pipeline * pipeline, wb_session_params params);
+
+// Cancels, releases whatever is still queued, and drops the caller's reference. Chunks
+// still in the pipeline keep the session alive until they drain. Not while a wake-up is pending.
+void wb_session_close(wb_session * session);
+
+// Queue one chunk (see wb_pipeline_submit: blocks while the pipeline is full, `samples`
+// borrowed until its result). Mark the final chunk `is_last`; its result ends the session.
+void wb_session_submit(
+    wb_session * session,
+    const float * samples,
+    size_t n_samples,
+    void * user_data,
+    bool is_last
+);
+
+// Cancel every chunk of this session. The rest complete as dropped and are released;
+// the session ends once they have drained. Any thread.
+void wb_session_cancel(wb_session * session);
+bool wb_session_is_cancelled(const wb_session * session);
+
+// The session's token (borrowed), for work done on its behalf outside the pipeline
+wb_cancel_token * wb_session_token(const wb_session * session);
+
+// Pop the next result without waiting. 1: `*event` filled; 0: nothing yet; -1: the
+// session has ended (last chunk delivered, or cancelled with nothing left in flight).
+int wb_session_next(wb_session * session, wb_session_event * event);
+
+// Arrange for `wake` to be called once when wb_session_next has something to return
+// (a result or the end). Returns false, without registering, if that is already the case.
+// `wake` runs on the thread that produced the result; keep it short. One waiter at a time.
+bool wb_session_await_next(wb_session * session, wb_session_wake_fn wake, void * data);
+
+// Same for cancellation: `wake` runs once the session is cancelled or has ended.
+// Returns false if it already is. Any number of waiters.
+bool wb_session_await_cancel(wb_session * session, wb_session_wake_fn wake, void * data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_session_h */
@@ -0,0 +1,249 @@
+//
+//  wb_session.hpp
+//  WhisperBoard
+//
+//  C++20 coroutine interface to wb_session
+//    while (auto partial = co_await session.next()) { ... }    async stream of results
+//    auto final = co_await session.final_result();             last chunk's result
+//    bool cancelled = co_await session.cancelled();            cancelled (true) or ended
+//  A suspended coroutine is resumed as a task on the executor pool, never on the
+//  pipeline thread that produced the result. Requires C++20; C++17 translation
+//  units see nothing from this header.
+//
+
+#ifndef wb_session_hpp
+#define wb_session_hpp
+
+#include "wb_pool.h"
+#include "wb_session.h"
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wb {
+
+// Owned copy of a wb_session_event
+struct partial {
+    int                      status   = WB_PIPELINE_OK;
+    bool                     is_last  = false;
+    std::string              text;
+    std::vector<std::string> tokens;
+    bool                     runaway  = false;
+    float                    confidence = -1.0f;
+    float                    stage_ms[WB_STAGE_COUNT] = {};
+    float                    queued_ms = 0.0f;
+    void *                   user_data = nullptr;
+
+    bool tentative() const { return status == WB_PIPELINE_TENTATIVE; }
+};
+
+namespace detail {
+
+inline partial copy_event(const wb_session_event & event) {
+    partial p;
+    p.status     = event.status;
+    p.is_last    = event.is_last;
+    p.text       = event.text != nullptr ? event.text : "";
+    p.runaway    = event.runaway;
+    p.confidence = event.confidence;
+    p.queued_ms  = event.queued_ms;
+    p.user_data  = event.user_data;
+    p.tokens.reserve((size_t) event.n_tokens);
+    for (int i = 0; i < event.n_tokens; ++i) {
+        p.tokens.emplace_back(event.tokens[i] != nullptr ? event.tokens[i] : "");
+    }
+    for (int s = 0; s < WB_STAGE_COUNT; ++s) {
+        p.stage_ms[s] = event.stage_ms[s];
+    }
+    return p;
+}
+
+inline void resume_task(void * address) {
+    std::coroutine_handle<>::from_address(address).resume();
+}
+
+} // namespace detail
+
+class session {
+public:
+    // Opens a session on `pipeline` (whose on_result must be wb_session_pipeline_result)
+    explicit session(
+        wb_pipeline * pipeline,
+        wb_session_params params = wb_session_default_params(),
+        wb_pool * executor = wb_pool_shared()
+    )
+        : handle_(wb_session_open(pipeline, params))
+        , params_(params)
+        , executor_(executor) {}
+
+    ~session() {
+        wb_session_close(handle_);
+    }
+
+    session(const session &) = delete;
+    session & operator=(const session &) = delete;
+
+    explicit operator bool() const { return handle_ != nullptr; }
+    wb_session * get() const { return handle_; }
+
+    void submit(const float * samples, size_t n_samples, void * user_data, bool is_last) {
+        wb_session_submit(handle_, samples, n_samples, user_data, is_last);
+    }
+
+    void cancel() { wb_session_cancel(handle_); }
+
+    // MARK: - Awaitables
+
+    // Next result, or nullopt once the session has ended
+    class next_awaiter {
+    public:
+        explicit next_awaiter(session & owner) : owner_(owner) {}
+
+        bool await_ready() { return poll(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            if (wb_session_await_next(owner_.handle_, &wake, this)) {
+                return true;
+            }
+            return !poll();
+        }
+
+        std::optional<partial> await_resume() {
+            if (!done_) {
+                poll();
+            }
+            return std::move(value_);
+        }
+
+    private:
+        static void wake(void * data) {
+            auto * self = static_cast<next_awaiter *>(data);
+            wb_pool_submit(self->owner_.executor_, &detail::resume_task, self->handle_.address());
+        }
+
+        bool poll() {
+            wb_session_event event;
+            const int r = wb_session_next(owner_.handle_, &event);
+            if (r == 0) {
+                return false;
+            }
+            if (r > 0) {
+                value_ = detail::copy_event(event);
+            }
+            done_ = true;
+            return true;
+        }
+
+        session &                owner_;
+        std::coroutine_handle<>  handle_;
+        std::optional<partial>   value_;
+        bool                     done_ = false;
+    };
+
+    // Skips to the last chunk's result (intermediate ones are released);
+    // nullopt if the session ended without it, i.e. was cancelled
+    class final_awaiter {
+    public:
+        explicit final_awaiter(session & owner) : owner_(owner) {}
+
+        bool await_ready() { return drain(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            return park();
+        }
+
+        std::optional<partial> await_resume() { return std::move(value_); }
+
+    private:
+        // Register for the next result; false if the final one is already here
+        bool park() {
+            while (wb_session_await_next(owner_.handle_, &wake, this) == false) {
+                if (drain()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void wake(void * data) {
+            wb_pool_submit(static_cast<final_awaiter *>(data)->owner_.executor_, &step, data);
+        }
+
+        // On the executor: keep draining, resume once the final result or the end shows up
+        static void step(void * data) {
+            auto * self = static_cast<final_awaiter *>(data);
+            if (self->drain() || !self->park()) {
+                self->handle_.resume();
+            }
+        }
+
+        bool drain() {
+            wb_session_event event;
+            for (;;) {
+                const int r = wb_session_next(owner_.handle_, &event);
+                if (r == 0) {
+                    return false;
+                }
+                if (r < 0) {
+                    return true;
+                }
+                if (event.is_last) {
+                    value_ = detail::copy_event(event);
+                    return true;
+                }
+                if (event.status != WB_PIPELINE_TENTATIVE && owner_.params_.release_user_data != nullptr) {
+                    owner_.params_.release_user_data(event.user_data);
+                }
+            }
+        }
+
+        session &               owner_;
+        std::coroutine_handle<> handle_;
+        std::optional<partial>  value_;
+    };
+
+    // true once cancelled, false if the session ended normally first
+    class cancel_awaiter {
+    public:
+        explicit cancel_awaiter(session & owner) : owner_(owner) {}
+
+        bool await_ready() { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            return wb_session_await_cancel(owner_.handle_, &wake, this);
+        }
+
+        bool await_resume() { return wb_session_is_cancelled(owner_.handle_); }
+
+    private:
+        static void wake(void * data) {
+            auto * self = static_cast<cancel_awaiter *>(data);
+            wb_pool_submit(self->owner_.executor_, &detail::resume_task, self->handle_.address());
+        }
+
+        session &               owner_;
+        std::coroutine_handle<> handle_;
+    };
+
+    next_awaiter   next()         { return next_awaiter(*this); }
+    final_awaiter  final_result() { return final_awaiter(*this); }
+    cancel_awaiter cancelled()    { return cancel_awaiter(*this); }
+
+private:
+    wb_session *      handle_;
+    wb_session_params params_;
+    wb_pool *         executor_;
+};
+
+} // namespace wb
+
+#endif // C++20
+
+#endif /* wb_session_hpp */
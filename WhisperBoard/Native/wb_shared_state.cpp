@@ -0,0 +1,322 @@
+//
+//  wb_shared_state.cpp
+//  WhisperBoard
+//
+//  Seqlock over a MAP_SHARED file: the writer makes the sequence odd, copies,
+//  then makes it even; readers retry if the sequence moved while they copied.
+//  Flow-control credits are plain counters: produced (keyboard) vs consumed (app).
+//
+
+#include "wb_shared_state.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t k_magic   = 0x53425752u;   // "RWBS"
+constexpr uint32_t k_version = 2;
+
+// Give up on a slot whose writer died mid-publish (sequence stuck odd)
+constexpr int k_max_read_spins = 1 << 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs address-free atomics to work across processes");
+
+struct transcription_payload {
+    wb_transcription_record record;
+    char                    text[WB_SHARED_TEXT_MAX];
+};
+
+// Producer and consumer counters live on separate cache lines
+struct flow_block {
+    alignas(64) std::atomic<uint64_t> produced;
+    alignas(64) std::atomic<uint64_t> consumed;
+    std::atomic<uint32_t>             capacity;
+    std::atomic<uint32_t>             lag_ms;
+    std::atomic<int64_t>              heartbeat_ms;
+};
+
+template <typename T>
+struct alignas(64) seqlock_slot {
+    std::atomic<uint64_t> seq;   // even = stable, odd = write in progress; generation = seq / 2
+    T                     data;
+};
+
+struct region {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+
+    seqlock_slot<wb_status_record>     status;
+    seqlock_slot<transcription_payload> transcription;
+    flow_block                          flow;
+};
+
+int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+size_t clamp_text_length(uint32_t length) {
+    return length < WB_SHARED_TEXT_MAX ? length : WB_SHARED_TEXT_MAX - 1;
+}
+
+inline void cpu_relax() {
+#if defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Open the write section; returns the sequence value to close it with
+template <typename T>
+uint64_t begin_write(seqlock_slot<T> & slot) {
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    if (seq & 1) {
+        seq++;   // previous writer died mid-publish; the data is rewritten anyway
+    }
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return seq + 2;
+}
+
+template <typename T>
+void end_write(seqlock_slot<T> & slot, uint64_t seq) {
+    slot.seq.store(seq, std::memory_order_release);
+}
+
+// Run `copy` until it observes a stable, unchanged sequence
+template <typename T, typename F>
+int read_consistent(const seqlock_slot<T> & slot, F && copy) {
+    for (int spin = 0; spin < k_max_read_spins; ++spin) {
+        const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+        if (s1 == 0) {
+            return 0;
+        }
+        if (s1 & 1) {
+            cpu_relax();
+            continue;
+        }
+
+        copy();
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == s1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+struct wb_shared_state {
+    int        fd  = -1;
+    region *   mem = nullptr;
+    std::mutex status_mutex;
+    std::mutex transcription_mutex;
+};
+
+wb_shared_state * wb_shared_state_open(const char * path) {
+    const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t) st.st_size < sizeof(region) && ftruncate(fd, sizeof(region)) != 0)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void * p = mmap(nullptr, sizeof(region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto * mem = static_cast<region *>(p);
+    if (mem->magic != k_magic || mem->version != k_version || mem->size != sizeof(region)) {
+        // Fresh file (zero-filled: nothing published) or a layout from another build
+        memset(static_cast<void *>(mem), 0, sizeof(region));
+        mem->version = k_version;
+        mem->size    = sizeof(region);
+        std::atomic_thread_fence(std::memory_order_release);
+        mem->magic   = k_magic;
+    }
+
+    auto * state = new wb_shared_state();
+    state->fd  = fd;
+    state->mem = mem;
+    return state;
+}
+
+void wb_shared_state_close(wb_shared_state * state) {
+    if (state == nullptr) {
+        return;
+    }
+    munmap(state->mem, sizeof(region));
+    close(state->fd);
+    delete state;
+}
+
+uint64_t wb_shared_state_publish_transcription(
+    wb_shared_state * state,
+    const wb_transcription_record * record,
+    const char * text,
+    size_t text_length
+) {
+    std::lock_guard<std::mutex> lock(state->transcription_mutex);
+    auto & slot = state->mem->transcription;
+
+    const size_t n = text_length < WB_SHARED_TEXT_MAX ? text_length : WB_SHARED_TEXT_MAX - 1;
+    const uint64_t seq = begin_write(slot);
+
+    // Only the used part of the text buffer is touched
+    slot.data.record             = *record;
+    slot.data.record.generation  = seq / 2;
+    slot.data.record.text_length = (uint32_t) n;
+    slot.data.record.truncated   = n < text_length ? 1 : 0;
+    memcpy(slot.data.text, text, n);
+    slot.data.text[n] = '\0';
+
+    end_write(slot, seq);
+    return seq / 2;
+}
+
+uint64_t wb_shared_state_publish_status(wb_shared_state * state, const wb_status_record * record) {
+    std::lock_guard<std::mutex> lock(state->status_mutex);
+    auto & slot = state->mem->status;
+
+    const uint64_t seq = begin_write(slot);
+    slot.data            = *record;
+    slot.data.generation = seq / 2;
+    end_write(slot, seq);
+    return seq / 2;
+}
+
+uint64_t wb_shared_state_transcription_generation(wb_shared_state * state) {
+    return state->mem->transcription.seq.load(std::memory_order_acquire) / 2;
+}
+
+uint64_t wb_shared_state_status_generation(wb_shared_state * state) {
+    return state->mem->status.seq.load(std::memory_order_acquire) / 2;
+}
+
+int wb_shared_state_read_transcription(wb_shared_state * state, wb_transcription_record * out, char * text, size_t capacity) {
+    const auto & slot = state->mem->transcription;
+    size_t n = 0;
+
+    const int ok = read_consistent(slot, [&] {
+        *out = slot.data.record;
+        // The length may be torn until the sequence check passes; clamp before using it
+        n = clamp_text_length(out->text_length);
+        if (capacity > 0 && n > capacity - 1) {
+            n = capacity - 1;
+        }
+        if (capacity > 0) {
+            memcpy(text, slot.data.text, n);
+        }
+    });
+
+    if (ok && capacity > 0) {
+        text[n] = '\0';
+    }
+    return ok;
+}
+
+int wb_shared_state_read_status(wb_shared_state * state, wb_status_record * out) {
+    const auto & slot = state->mem->status;
+    return read_consistent(slot, [&] {
+        *out = slot.data;
+    });
+}
+
+void wb_shared_state_flow_advertise(wb_shared_state * state, uint32_t capacity, uint32_t lag_ms) {
+    auto & flow = state->mem->flow;
+    flow.capacity.store(capacity, std::memory_order_relaxed);
+    flow.lag_ms.store(lag_ms, std::memory_order_relaxed);
+    flow.heartbeat_ms.store(now_ms(), std::memory_order_release);
+}
+
+void wb_shared_state_flow_consumed(wb_shared_state * state, uint32_t chunks, uint32_t lag_ms) {
+    auto & flow = state->mem->flow;
+    flow.lag_ms.store(lag_ms, std::memory_order_relaxed);
+
+    // Never run ahead of the producer (a chunk discarded twice, or after a resync)
+    uint64_t consumed = flow.consumed.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint64_t produced = flow.produced.load(std::memory_order_acquire);
+        const uint64_t next     = consumed + chunks < produced ? consumed + chunks : produced;
+        if (flow.consumed.compare_exchange_weak(consumed, next, std::memory_order_release, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+void wb_shared_state_flow_resync(wb_shared_state * state) {
+    auto & flow = state->mem->flow;
+    // A chunk the keyboard sends concurrently is credited early; the error is bounded by one chunk
+    flow.consumed.store(flow.produced.load(std::memory_order_acquire), std::memory_order_release);
+    flow.lag_ms.store(0, std::memory_order_relaxed);
+}
+
+int wb_shared_state_flow_acquire(wb_shared_state * state, int force) {
+    auto & flow = state->mem->flow;
+
+    uint32_t capacity = flow.capacity.load(std::memory_order_relaxed);
+    if (capacity == 0) {
+        capacity = WB_FLOW_DEFAULT_CAPACITY;
+    }
+
+    uint64_t produced = flow.produced.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint64_t consumed = flow.consumed.load(std::memory_order_acquire);
+        if (!force && produced - consumed >= capacity) {
+            return 0;
+        }
+        if (flow.produced.compare_exchange_weak(produced, produced + 1, std::memory_order_release, std::memory_order_relaxed)) {
+            return 1;
+        }
+    }
+}
+
+void wb_shared_state_flow_cancel(wb_shared_state * state) {
+    auto & flow = state->mem->flow;
+
+    // Never below what the app has consumed (it may have resynced since the acquire)
+    uint64_t produced = flow.produced.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint64_t consumed = flow.consumed.load(std::memory_order_acquire);
+        if (produced <= consumed) {
+            return;
+        }
+        if (flow.produced.compare_exchange_weak(produced, produced - 1, std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void wb_shared_state_flow_read(wb_shared_state * state, wb_flow_snapshot * out) {
+    auto & flow = state->mem->flow;
+
+    const uint64_t consumed = flow.consumed.load(std::memory_order_acquire);
+    const uint64_t produced = flow.produced.load(std::memory_order_acquire);
+    const uint64_t in_flight = produced > consumed ? produced - consumed : 0;
+
+    out->capacity     = flow.capacity.load(std::memory_order_relaxed);
+    out->in_flight    = in_flight > UINT32_MAX ? UINT32_MAX : (uint32_t) in_flight;
+    const uint32_t capacity = out->capacity != 0 ? out->capacity : WB_FLOW_DEFAULT_CAPACITY;
+    out->credits      = out->in_flight < capacity ? capacity - out->in_flight : 0;
+    out->lag_ms       = flow.lag_ms.load(std::memory_order_relaxed);
+    out->heartbeat_ms = flow.heartbeat_ms.load(std::memory_order_acquire);
+}
@@ -0,0 +1,108 @@
+//
+//  wb_shared_state.h
+//  WhisperBoard
+//
+//  Seqlock-published records in a shared mapping of the App Groups container
+//  Latest TranscriptionResult and AppStatus, readable without locks or syscalls
+//  Also carries the chunk credits the keyboard needs before it sends audio
+//
+
+#ifndef wb_shared_state_h
+#define wb_shared_state_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WB_SHARED_TEXT_MAX       16384
+#define WB_SHARED_SESSION_ID_MAX 128
+#define WB_SHARED_VARIANT_MAX    32
+
+// Credits granted before the app has advertised any
+#define WB_FLOW_DEFAULT_CAPACITY 4
+
+typedef struct wb_shared_state wb_shared_state;
+
+// Fixed-size mirror of TranscriptionResult (text travels separately, up to WB_SHARED_TEXT_MAX - 1 bytes)
+typedef struct wb_transcription_record {
+    uint64_t generation;            // bumped on every publish (0 = never published)
+    int64_t  timestamp_ms;
+    int32_t  processing_time_ms;
+    float    confidence;            // < 0 = no confidence
+    uint8_t  is_final;
+    uint8_t  truncated;             // text did not fit WB_SHARED_TEXT_MAX
+    uint16_t reserved;
+    uint32_t text_length;           // published bytes, excluding the terminator
+    char     session_id[WB_SHARED_SESSION_ID_MAX];
+} wb_transcription_record;
+
+// Fixed-size mirror of AppStatus
+typedef struct wb_status_record {
+    uint64_t generation;
+    int64_t  last_update_ms;
+    int32_t  memory_usage_mb;
+    uint8_t  is_model_loaded;
+    uint8_t  is_processing;
+    uint8_t  has_session;
+    uint8_t  reserved;
+    char     current_session_id[WB_SHARED_SESSION_ID_MAX];
+    char     model_variant[WB_SHARED_VARIANT_MAX];
+} wb_status_record;
+
+// Flow control view. Credits are counted in chunks: the keyboard may have at most
+// `capacity` chunks in flight (sent but not yet transcribed or discarded by the app).
+typedef struct wb_flow_snapshot {
+    uint32_t capacity;              // 0 = app has not advertised yet
+    uint32_t in_flight;
+    uint32_t credits;               // capacity - in_flight, 0 when exhausted
+    uint32_t lag_ms;                // audio queued in the app, not yet transcribed
+    int64_t  heartbeat_ms;          // app's last advertisement (0 = never)
+} wb_flow_snapshot;
+
+// Map (creating if needed) the shared state file. Both processes call this.
+wb_shared_state * wb_shared_state_open(const char * path);
+void              wb_shared_state_close(wb_shared_state * state);
+
+// Writers (main app). `generation`, `text_length` and `truncated` are filled in by the call; returns the new generation.
+uint64_t wb_shared_state_publish_transcription(
+    wb_shared_state * state,
+    const wb_transcription_record * record,
+    const char * text,
+    size_t text_length
+);
+uint64_t wb_shared_state_publish_status(wb_shared_state * state, const wb_status_record * record);
+
+// Readers (keyboard extension). Pure memory reads.
+// Current generation, without copying the record (0 = never published)
+uint64_t wb_shared_state_transcription_generation(wb_shared_state * state);
+uint64_t wb_shared_state_status_generation(wb_shared_state * state);
+
+// Consistent snapshot. Returns 1 on success, 0 if nothing was published yet.
+// `text` receives at most `capacity - 1` bytes plus a terminator (WB_SHARED_TEXT_MAX always fits).
+int wb_shared_state_read_transcription(wb_shared_state * state, wb_transcription_record * out, char * text, size_t capacity);
+int wb_shared_state_read_status(wb_shared_state * state, wb_status_record * out);
+
+// Flow control, consumer side (main app)
+// Advertise how many chunks may be in flight and how far behind inference is; doubles as a heartbeat
+void wb_shared_state_flow_advertise(wb_shared_state * state, uint32_t capacity, uint32_t lag_ms);
+// Return credits for chunks that were transcribed or discarded
+void wb_shared_state_flow_consumed(wb_shared_state * state, uint32_t chunks, uint32_t lag_ms);
+// Forget every chunk in flight (the app dropped its whole backlog, e.g. on session start/cancel)
+void wb_shared_state_flow_resync(wb_shared_state * state);
+
+// Flow control, producer side (keyboard extension)
+// Take one credit. Returns 1 if the chunk may be sent, 0 if the app is saturated.
+// `force` takes the credit even when none is left (final flush on stop).
+int  wb_shared_state_flow_acquire(wb_shared_state * state, int force);
+// Give back a credit taken for a chunk that could not be sent
+void wb_shared_state_flow_cancel(wb_shared_state * state);
+void wb_shared_state_flow_read(wb_shared_state * state, wb_flow_snapshot * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_shared_state_h */
@@ -0,0 +1,388 @@
+//
+//  wb_text_post.cpp
+//  WhisperBoard
+//
+//  Every code point gets a class: from a 128-entry table for ASCII, from a
+//  sorted range table (binary search) above it, where anything unlisted counts
+//  as a letter. Punctuation that may sit inside a word or a number ("don't",
+//  "well-known", "3.5", "1,000") is held until the next character shows
+//  whether it does. Capitalisation covers the cased scripts dictation meets
+//  here (Latin-1, Latin Extended-A, Greek, Cyrillic); other letters pass as is.
+//
+
+#include "wb_text_post.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace {
+
+enum char_class : uint8_t {
+    k_drop,       // controls, zero-width and bidi marks
+    k_space,
+    k_letter,
+    k_digit,
+    k_symbol,     // kept in every mode: # $ % & + < = > @ ^ ` | ~ and the like
+    k_punct,      // removed outside WB_TEXT_AUTO
+    k_terminal,   // removed outside WB_TEXT_AUTO; ends a sentence
+};
+
+enum inner_kind : uint8_t {
+    k_never_inner,
+    k_inner_word,     // kept between two letters: apostrophes and hyphens
+    k_inner_number,   // kept between two digits: decimal and thousands separators
+};
+
+struct ascii_table {
+    uint8_t cls[128];
+    uint8_t inner[128];
+};
+
+constexpr ascii_table make_ascii_table() {
+    ascii_table table = {};
+    for (int c = 0; c < 128; ++c) {
+        table.cls[c]   = c < 0x20 || c == 0x7f ? k_drop : k_symbol;
+        table.inner[c] = k_never_inner;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+        table.cls[c] = k_digit;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        table.cls[c]            = k_letter;
+        table.cls[c - 'a' + 'A'] = k_letter;
+    }
+    for (const char * p = " \t\n\v\f\r"; *p != '\0'; ++p) {
+        table.cls[(int) *p] = k_space;
+    }
+    for (const char * p = ",;:\"'()[]{}-_/\\*"; *p != '\0'; ++p) {
+        table.cls[(int) *p] = k_punct;
+    }
+    for (const char * p = ".!?"; *p != '\0'; ++p) {
+        table.cls[(int) *p] = k_terminal;
+    }
+    table.inner[(int) '\''] = k_inner_word;
+    table.inner[(int) '-']  = k_inner_word;
+    table.inner[(int) '.']  = k_inner_number;
+    table.inner[(int) ',']  = k_inner_number;
+    return table;
+}
+
+constexpr ascii_table k_ascii = make_ascii_table();
+
+struct class_range {
+    char32_t first;
+    char32_t last;
+    uint8_t  cls;
+};
+
+// Sorted, non-overlapping; code points above ASCII not listed are letters
+constexpr class_range k_ranges[] = {
+    { 0x0080, 0x009F, k_drop },       // C1 controls
+    { 0x00A0, 0x00A0, k_space },      // no-break space
+    { 0x00A1, 0x00A1, k_punct },      // ¡
+    { 0x00A7, 0x00A7, k_punct },      // §
+    { 0x00AB, 0x00AB, k_punct },      // «
+    { 0x00AD, 0x00AD, k_drop },       // soft hyphen
+    { 0x00B6, 0x00B7, k_punct },      // ¶ ·
+    { 0x00BB, 0x00BB, k_punct },      // »
+    { 0x00BF, 0x00BF, k_punct },      // ¿
+    { 0x037E, 0x037E, k_terminal },   // Greek question mark
+    { 0x0387, 0x0387, k_punct },      // Greek ano teleia
+    { 0x060C, 0x060C, k_punct },      // Arabic comma
+    { 0x061B, 0x061B, k_punct },      // Arabic semicolon
+    { 0x061F, 0x061F, k_terminal },   // Arabic question mark
+    { 0x06D4, 0x06D4, k_terminal },   // Arabic full stop
+    { 0x0964, 0x0965, k_terminal },   // Devanagari danda
+    { 0x1680, 0x1680, k_space },
+    { 0x2000, 0x200A, k_space },      // typographic spaces
+    { 0x200B, 0x200F, k_drop },       // zero-width, LRM, RLM
+    { 0x2010, 0x2025, k_punct },      // dashes, quotes, daggers, bullets
+    { 0x2026, 0x2026, k_terminal },   // …
+    { 0x2027, 0x2027, k_punct },
+    { 0x2028, 0x2029, k_space },      // line and paragraph separators
+    { 0x202A, 0x202E, k_drop },       // bidi embedding
+    { 0x202F, 0x202F, k_space },
+    { 0x2030, 0x2031, k_symbol },     // per mille, per ten thousand
+    { 0x2032, 0x203B, k_punct },
+    { 0x203C, 0x203D, k_terminal },   // ‼ ‽
+    { 0x203E, 0x2046, k_punct },
+    { 0x2047, 0x2049, k_terminal },   // ⁇ ⁈ ⁉
+    { 0x204A, 0x205E, k_punct },
+    { 0x205F, 0x205F, k_space },
+    { 0x2060, 0x2064, k_drop },
+    { 0x2100, 0x2BFF, k_symbol },     // letterlike, arrows, maths, shapes
+    { 0x3000, 0x3000, k_space },      // ideographic space
+    { 0x3001, 0x3001, k_punct },      // 、
+    { 0x3002, 0x3002, k_terminal },   // 。
+    { 0x3003, 0x3003, k_punct },
+    { 0x3008, 0x3011, k_punct },      // CJK brackets
+    { 0x3014, 0x301F, k_punct },
+    { 0xFEFF, 0xFEFF, k_drop },       // BOM
+    { 0xFF01, 0xFF01, k_terminal },   // ！
+    { 0xFF02, 0xFF02, k_punct },
+    { 0xFF07, 0xFF0A, k_punct },      // ＇（）＊
+    { 0xFF0C, 0xFF0D, k_punct },      // ，－
+    { 0xFF0E, 0xFF0E, k_terminal },   // ．
+    { 0xFF0F, 0xFF0F, k_punct },
+    { 0xFF1A, 0xFF1B, k_punct },      // ：；
+    { 0xFF1F, 0xFF1F, k_terminal },   // ？
+    { 0xFF3B, 0xFF3D, k_punct },
+    { 0xFF3F, 0xFF3F, k_punct },
+    { 0xFF5B, 0xFF5B, k_punct },
+    { 0xFF5D, 0xFF5D, k_punct },
+    { 0xFF5F, 0xFF60, k_punct },
+    { 0xFF61, 0xFF61, k_terminal },   // ｡
+    { 0xFF62, 0xFF65, k_punct },
+    { 0x1F000, 0x1FAFF, k_symbol },   // emoji and pictographs
+};
+
+uint8_t classify(char32_t cp) {
+    if (cp < 0x80) {
+        return k_ascii.cls[cp];
+    }
+    const auto * end = std::end(k_ranges);
+    const auto * it  = std::upper_bound(std::begin(k_ranges), end, cp,
+                                        [](char32_t value, const class_range & r) { return value < r.first; });
+    if (it != std::begin(k_ranges) && cp <= (it - 1)->last) {
+        return (it - 1)->cls;
+    }
+    return k_letter;
+}
+
+uint8_t inner_kind_of(char32_t cp) {
+    if (cp < 0x80) {
+        return k_ascii.inner[cp];
+    }
+    // ‐ ‑ ’
+    return cp == 0x2010 || cp == 0x2011 || cp == 0x2019 ? k_inner_word : k_never_inner;
+}
+
+char32_t to_upper(char32_t cp) {
+    if (cp >= 'a' && cp <= 'z') {
+        return cp - 0x20;
+    }
+    if (cp < 0xE0) {
+        return cp;
+    }
+    if (cp <= 0xFE) {
+        return cp == 0xF7 ? cp : cp - 0x20;                      // à-þ, not ÷
+    }
+    if (cp == 0xFF) {
+        return 0x178;                                            // ÿ
+    }
+    if ((cp >= 0x100 && cp <= 0x137) || (cp >= 0x14A && cp <= 0x177)) {
+        return cp & ~(char32_t) 1;                               // even upper, odd lower
+    }
+    if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+        return (cp & 1) == 0 ? cp - 1 : cp;                      // odd upper, even lower
+    }
+    if (cp >= 0x3B1 && cp <= 0x3C9 && cp != 0x3C2) {
+        return cp - 0x20;                                        // Greek, not final sigma
+    }
+    if (cp >= 0x430 && cp <= 0x44F) {
+        return cp - 0x20;                                        // Cyrillic а-я
+    }
+    if (cp >= 0x450 && cp <= 0x45F) {
+        return cp - 0x50;                                        // ѐ-џ
+    }
+    return cp;
+}
+
+// Length of the sequence at `s` and its code point; 0 if the `n` bytes end inside it,
+// -1 if it is not valid UTF-8
+int decode_utf8(const unsigned char * s, size_t n, char32_t & cp) {
+    const unsigned char lead = s[0];
+    int      len      = 0;
+    char32_t smallest = 0;
+    if (lead < 0x80) {
+        cp = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        len = 2; cp = lead & 0x1F; smallest = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        len = 3; cp = lead & 0x0F; smallest = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        len = 4; cp = lead & 0x07; smallest = 0x10000;
+    } else {
+        return -1;
+    }
+
+    for (int k = 1; k < len; ++k) {
+        if ((size_t) k >= n) {
+            return 0;
+        }
+        if ((s[k] & 0xC0) != 0x80) {
+            return -1;
+        }
+        cp = (cp << 6) | (s[k] & 0x3F);
+    }
+    if (cp < smallest || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return -1;
+    }
+    return len;
+}
+
+void append_utf8(std::string & out, char32_t cp) {
+    if (cp < 0x80) {
+        out += (char) cp;
+    } else if (cp < 0x800) {
+        out += (char) (0xC0 | (cp >> 6));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char) (0xE0 | (cp >> 12));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else {
+        out += (char) (0xF0 | (cp >> 18));
+        out += (char) (0x80 | ((cp >> 12) & 0x3F));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    }
+}
+
+// What the next piece needs from the ones before it
+struct stream_state {
+    bool          sentence_start = true;
+    unsigned char partial[3]     = {};        // a UTF-8 sequence split at the end of the last piece
+    size_t        n_partial      = 0;
+    uint8_t       last           = k_space;   // class of the last character written
+    char32_t      held           = 0;         // punctuation that may be inside a word or number
+    uint8_t       held_cls       = k_drop;    // k_drop: nothing held
+    uint8_t       held_inner     = k_never_inner;
+};
+
+} // namespace
+
+struct wb_text_post {
+    stream_state state;
+    std::string  joined;   // split sequence + the new piece
+    std::string  out;
+};
+
+wb_text_post * wb_text_post_create(void) {
+    return new wb_text_post();
+}
+
+void wb_text_post_free(wb_text_post * post) {
+    delete post;
+}
+
+void wb_text_post_reset(wb_text_post * post) {
+    post->state = stream_state();
+}
+
+const char * wb_text_post_append(wb_text_post * post, int mode, const char * text, size_t len, bool commit) {
+    stream_state s = post->state;
+    std::string & out = post->out;
+    out.clear();
+    if (text == nullptr) {
+        len = 0;
+    }
+
+    const unsigned char * data = reinterpret_cast<const unsigned char *>(text);
+    size_t n = len;
+    if (s.n_partial > 0) {
+        post->joined.assign(reinterpret_cast<const char *>(s.partial), s.n_partial);
+        post->joined.append(text != nullptr ? text : "", len);
+        data = reinterpret_cast<const unsigned char *>(post->joined.data());
+        n    = post->joined.size();
+        s.n_partial = 0;
+    }
+    out.reserve(n);
+
+    const bool strip = mode != WB_TEXT_AUTO;
+    bool pending_space = false;
+
+    // Everything removed counts as a word break; terminals also end the sentence
+    auto drop_separator = [&](uint8_t cls) {
+        pending_space = true;
+        s.last        = k_space;
+        if (cls == k_terminal) {
+            s.sentence_start = true;
+        }
+    };
+
+    auto write = [&](char32_t cp, uint8_t cls) {
+        if (pending_space && !out.empty()) {
+            out += ' ';
+        }
+        pending_space = false;
+        append_utf8(out, cp);
+        s.last = cls;
+    };
+
+    for (size_t i = 0; i < n;) {
+        char32_t cp = 0;
+        const int r = decode_utf8(data + i, n - i, cp);
+        if (r == 0) {
+            std::memcpy(s.partial, data + i, n - i);
+            s.n_partial = n - i;
+            break;
+        }
+        if (r < 0) {
+            ++i;
+            continue;
+        }
+        i += (size_t) r;
+
+        const uint8_t cls = classify(cp);
+
+        if (s.held_cls != k_drop) {
+            const bool inside = (s.held_inner == k_inner_word && cls == k_letter) ||
+                                (s.held_inner == k_inner_number && cls == k_digit);
+            if (inside) {
+                write(s.held, s.held_cls);
+            } else {
+                drop_separator(s.held_cls);
+            }
+            s.held_cls = k_drop;
+        }
+
+        switch (cls) {
+        case k_drop:
+            break;
+
+        case k_space:
+            pending_space = true;
+            s.last        = k_space;
+            break;
+
+        case k_punct:
+        case k_terminal:
+            if (!strip) {
+                write(cp, cls);
+                if (cls == k_terminal) {
+                    s.sentence_start = true;
+                }
+                break;
+            }
+            s.held_inner = inner_kind_of(cp);
+            if (!pending_space && ((s.held_inner == k_inner_word && s.last == k_letter) ||
+                                   (s.held_inner == k_inner_number && s.last == k_digit))) {
+                s.held     = cp;
+                s.held_cls = cls;
+            } else {
+                drop_separator(cls);
+            }
+            break;
+
+        default:   // letter, digit, symbol
+            if (cls == k_letter && s.sentence_start && mode == WB_TEXT_SENTENCE) {
+                cp = to_upper(cp);
+            }
+            if (cls != k_symbol) {
+                s.sentence_start = false;
+            }
+            write(cp, cls);
+            break;
+        }
+    }
+
+    // A separator still held waits for the next piece: "well-" + "known" is one word
+    if (commit) {
+        post->state = s;
+    }
+    return out.c_str();
+}
@@ -0,0 +1,49 @@
+//
+//  wb_text_post.h
+//  WhisperBoard
+//
+//  Punctuation mode and whitespace clean-up of transcribed text, one UTF-8
+//  pass over each new piece. A stream carries what the next piece needs from
+//  the previous ones (is it starting a sentence, a split UTF-8 sequence, a
+//  hyphen or decimal point the next piece may continue), so each update costs
+//  only its own length however long the dictation gets.
+//
+
+#ifndef wb_text_post_h
+#define wb_text_post_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum wb_text_mode {
+    WB_TEXT_AUTO     = 0,   // whisper's punctuation kept; whitespace normalised
+    WB_TEXT_NONE     = 1,   // punctuation removed (apostrophes and hyphens inside words, and
+                            // separators inside numbers, are kept), whitespace normalised
+    WB_TEXT_SENTENCE = 2,   // as NONE, and the first letter of every sentence capitalised
+};
+
+typedef struct wb_text_post wb_text_post;
+
+// A stream positioned at the start of a dictation
+wb_text_post * wb_text_post_create(void);
+void wb_text_post_free(wb_text_post * post);
+void wb_text_post_reset(wb_text_post * post);
+
+// Clean up `len` bytes of text that follow everything this stream has committed. Runs of
+// whitespace (and removed punctuation) become one space; there is none at either end.
+// Punctuation that may sit inside a word or number is left out at the end of a piece and
+// written at the start of the next one if that continues the word ("well-" + "known"
+// gives "well" and "-known"). Returns the cleaned piece, NUL-terminated and owned by
+// `post` until its next call. `commit` = false leaves the stream as it was, for text that may still be replaced.
+// One thread at a time.
+const char * wb_text_post_append(wb_text_post * post, int mode, const char * text, size_t len, bool commit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_text_post_h */
@@ -0,0 +1,204 @@
+//
+//  wb_vocab.cpp
+//  WhisperBoard
+//
+//  Offsets index one byte buffer, so a token's text is two loads and no
+//  allocation. Most tokens are whole, valid UTF-8 on their own; the table marks
+//  them so the detokenizer copies them straight through while nothing is
+//  pending, and only walks byte by byte around split characters.
+//
+
+#include "wb_vocab.h"
+
+#include "whisper.h"
+
+#include <cstring>
+#include <vector>
+
+struct wb_vocab {
+    std::vector<char>     bytes;
+    std::vector<uint32_t> offsets;   // n_vocab + 1
+    std::vector<uint8_t>  whole;     // token is complete, valid UTF-8
+    int32_t               eot     = 0;
+    int32_t               beg     = 0;   // first timestamp token
+    size_t                max_len = 0;
+};
+
+namespace {
+
+constexpr char k_replacement[] = "\xEF\xBF\xBD";   // U+FFFD
+constexpr size_t k_replacement_len = 3;
+
+// Sequence length a lead byte starts (1 for ASCII), 0 if it cannot start one
+int sequence_length(unsigned char lead) {
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return 2;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        return 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        return 4;
+    }
+    return 0;
+}
+
+// Whether `byte` may follow `seq` (a lead and `n` >= 1 continuation bytes so far); the
+// second byte's range rules out overlong forms, surrogates and code points past U+10FFFF
+bool continues(const unsigned char * seq, int n, unsigned char byte) {
+    if (n == 1) {
+        switch (seq[0]) {
+        case 0xE0: return byte >= 0xA0 && byte <= 0xBF;
+        case 0xED: return byte >= 0x80 && byte <= 0x9F;
+        case 0xF0: return byte >= 0x90 && byte <= 0xBF;
+        case 0xF4: return byte >= 0x80 && byte <= 0x8F;
+        default:   break;
+        }
+    }
+    return (byte & 0xC0) == 0x80;
+}
+
+bool is_whole_utf8(const unsigned char * s, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        const int len = sequence_length(s[i]);
+        if (len == 0 || i + (size_t) len > n) {
+            return false;
+        }
+        for (int k = 1; k < len; ++k) {
+            if (!continues(s + i, k, s[i + (size_t) k])) {
+                return false;
+            }
+        }
+        i += (size_t) len;
+    }
+    return true;
+}
+
+} // namespace
+
+wb_vocab * wb_vocab_create(struct whisper_context * ctx) {
+    const int n_vocab = ctx != nullptr ? whisper_n_vocab(ctx) : 0;
+    if (n_vocab <= 0) {
+        return nullptr;
+    }
+
+    auto * vocab = new wb_vocab();
+    vocab->eot = whisper_token_eot(ctx);
+    vocab->beg = whisper_token_beg(ctx);
+    vocab->offsets.reserve((size_t) n_vocab + 1);
+    vocab->whole.reserve((size_t) n_vocab);
+    vocab->bytes.reserve((size_t) n_vocab * 8);
+
+    for (int id = 0; id < n_vocab; ++id) {
+        const char * text = whisper_token_to_str(ctx, id);
+        const size_t len  = text != nullptr ? strlen(text) : 0;
+
+        vocab->offsets.push_back((uint32_t) vocab->bytes.size());
+        vocab->bytes.insert(vocab->bytes.end(), text, text + len);
+        vocab->whole.push_back(is_whole_utf8(reinterpret_cast<const unsigned char *>(text), len) ? 1 : 0);
+        if (len > vocab->max_len) {
+            vocab->max_len = len;
+        }
+    }
+    vocab->offsets.push_back((uint32_t) vocab->bytes.size());
+    vocab->bytes.shrink_to_fit();
+    return vocab;
+}
+
+void wb_vocab_free(wb_vocab * vocab) {
+    delete vocab;
+}
+
+int wb_vocab_size(const wb_vocab * vocab) {
+    return vocab != nullptr ? (int) vocab->whole.size() : 0;
+}
+
+int32_t wb_vocab_eot(const wb_vocab * vocab) {
+    return vocab != nullptr ? vocab->eot : 0;
+}
+
+int32_t wb_vocab_timestamp_begin(const wb_vocab * vocab) {
+    return vocab != nullptr ? vocab->beg : 0;
+}
+
+const char * wb_vocab_bytes(const wb_vocab * vocab, int32_t id, size_t * len) {
+    if (vocab == nullptr || id < 0 || id >= wb_vocab_size(vocab)) {
+        *len = 0;
+        return nullptr;
+    }
+    *len = vocab->offsets[(size_t) id + 1] - vocab->offsets[(size_t) id];
+    return vocab->bytes.data() + vocab->offsets[(size_t) id];
+}
+
+size_t wb_vocab_max_emit(const wb_vocab * vocab) {
+    // A pending character replaced, then every byte of the longest token replaced
+    return k_replacement_len * (vocab->max_len + 1);
+}
+
+void wb_detok_begin(wb_detok * detok) {
+    detok->n_pending = 0;
+}
+
+size_t wb_detok_push(wb_detok * detok, const wb_vocab * vocab, int32_t id, char * out) {
+    size_t len = 0;
+    const char * text = wb_vocab_bytes(vocab, id, &len);
+    if (text == nullptr) {
+        return 0;
+    }
+
+    // Special tokens are markers, not part of the text around them
+    if (id >= vocab->eot || (detok->n_pending == 0 && vocab->whole[(size_t) id])) {
+        memcpy(out, text, len);
+        return len;
+    }
+
+    const auto * s = reinterpret_cast<const unsigned char *>(text);
+    size_t n = 0;
+    for (size_t i = 0; i < len;) {
+        const unsigned char byte = s[i];
+
+        if (detok->n_pending > 0) {
+            if (continues(detok->pending, detok->n_pending, byte)) {
+                detok->pending[detok->n_pending++] = byte;
+                ++i;
+                if (detok->n_pending == sequence_length(detok->pending[0])) {
+                    memcpy(out + n, detok->pending, (size_t) detok->n_pending);
+                    n += (size_t) detok->n_pending;
+                    detok->n_pending = 0;
+                }
+                continue;
+            }
+            // Cut short: replace what was pending, then look at this byte afresh
+            memcpy(out + n, k_replacement, k_replacement_len);
+            n += k_replacement_len;
+            detok->n_pending = 0;
+            continue;
+        }
+
+        const int seq = sequence_length(byte);
+        if (seq == 1) {
+            out[n++] = (char) byte;
+        } else if (seq == 0) {
+            memcpy(out + n, k_replacement, k_replacement_len);
+            n += k_replacement_len;
+        } else {
+            detok->pending[0] = byte;
+            detok->n_pending  = 1;
+        }
+        ++i;
+    }
+    return n;
+}
+
+size_t wb_detok_end(wb_detok * detok, char * out) {
+    if (detok->n_pending == 0) {
+        return 0;
+    }
+    detok->n_pending = 0;
+    memcpy(out, k_replacement, k_replacement_len);
+    return k_replacement_len;
+}
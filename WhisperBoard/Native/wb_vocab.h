@@ -0,0 +1,66 @@
+//
+//  wb_vocab.h
+//  WhisperBoard
+//
+//  Token text without per-token strings. The vocabulary is copied once into one
+//  contiguous byte table; a detokenizer then turns token ids into UTF-8 as they
+//  arrive. BPE tokens can end in the middle of a character (common outside
+//  English), so the detokenizer holds those bytes back until the token that
+//  completes the character, and never emits half a code point.
+//
+
+#ifndef wb_vocab_h
+#define wb_vocab_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct whisper_context;
+
+typedef struct wb_vocab wb_vocab;
+
+// Table of every token's bytes, from whisper_token_to_str. Immutable once built: share it
+// between threads. NULL if the context has no vocabulary.
+wb_vocab * wb_vocab_create(struct whisper_context * ctx);
+void wb_vocab_free(wb_vocab * vocab);
+
+int wb_vocab_size(const wb_vocab * vocab);
+
+// First special token (EOT): ids below it are text
+int32_t wb_vocab_eot(const wb_vocab * vocab);
+
+// First timestamp token: `id - begin` is a time in 20 ms steps from the start of the decode
+int32_t wb_vocab_timestamp_begin(const wb_vocab * vocab);
+
+// A token's raw bytes (not NUL-terminated, possibly part of a character); NULL for unknown ids
+const char * wb_vocab_bytes(const wb_vocab * vocab, int32_t id, size_t * len);
+
+// Most bytes one wb_detok_push or wb_detok_end can write
+size_t wb_vocab_max_emit(const wb_vocab * vocab);
+
+// Streaming detokenizer; plain data, lives on the caller's stack, one per decode
+typedef struct wb_detok {
+    unsigned char pending[4];   // start of a character the next token should complete
+    int           n_pending;
+} wb_detok;
+
+void wb_detok_begin(wb_detok * detok);
+
+// Writes the complete characters `id` makes available to `out` (room for
+// wb_vocab_max_emit bytes) and returns how many bytes that is; 0 when the token only
+// starts a character. Invalid bytes become U+FFFD. Special tokens are written as they
+// are and leave a pending character pending.
+size_t wb_detok_push(wb_detok * detok, const wb_vocab * vocab, int32_t id, char * out);
+
+// End of the decode: a character still pending is written as U+FFFD
+size_t wb_detok_end(wb_detok * detok, char * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_vocab_h */
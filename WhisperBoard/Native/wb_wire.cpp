@@ -0,0 +1,162 @@
+//
+//  wb_wire.cpp
+//  WhisperBoard
+//
+//  Frame send/receive over stream sockets: one writev per frame,
+//  one read buffer per connection reused across frames
+//
+
+#include "wb_wire.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+struct frame_header {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t length;
+};
+
+static_assert(sizeof(frame_header) == WB_WIRE_HEADER_SIZE, "wire header layout changed");
+static_assert(sizeof(wb_wire_control) == 144, "wire control layout changed");
+static_assert(sizeof(wb_wire_audio_chunk) == 152, "wire audio chunk layout changed");
+static_assert(sizeof(wb_wire_token_update) == 152, "wire token update layout changed");
+static_assert(sizeof(wb_wire_transcription) == 152, "wire transcription layout changed");
+static_assert(sizeof(wb_wire_error) == 144, "wire error layout changed");
+static_assert(sizeof(wb_wire_status) == 64, "wire status layout changed");
+
+// Read exactly `length` bytes. Returns 1, 0 on EOF before the first byte, or -errno
+int read_full(int fd, void * buffer, size_t length) {
+    auto * p = static_cast<uint8_t *>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        const ssize_t n = read(fd, p + done, length - done);
+        if (n > 0) {
+            done += (size_t) n;
+        } else if (n == 0) {
+            return done == 0 ? 0 : -EBADMSG;   // peer closed mid-frame
+        } else if (errno != EINTR) {
+            return -errno;
+        }
+    }
+    return 1;
+}
+
+} // namespace
+
+struct wb_wire_reader {
+    int                  fd = -1;
+    std::vector<uint8_t> body;
+};
+
+size_t wb_wire_fixed_size(uint16_t type) {
+    switch (type) {
+    case WB_WIRE_CONTROL:       return sizeof(wb_wire_control);
+    case WB_WIRE_AUDIO_CHUNK:   return sizeof(wb_wire_audio_chunk);
+    case WB_WIRE_TOKEN_UPDATE:  return sizeof(wb_wire_token_update);
+    case WB_WIRE_TRANSCRIPTION: return sizeof(wb_wire_transcription);
+    case WB_WIRE_ERROR:         return sizeof(wb_wire_error);
+    case WB_WIRE_STATUS:        return sizeof(wb_wire_status);
+    default:                    return 0;
+    }
+}
+
+int wb_wire_send(int fd, uint16_t type, const void * fixed, const void * tail, size_t tail_length) {
+    const size_t fixed_size = wb_wire_fixed_size(type);
+    if (fixed_size == 0 || fixed == nullptr || fixed_size + tail_length > WB_WIRE_MAX_BODY) {
+        return -EINVAL;
+    }
+
+    frame_header header = { WB_WIRE_MAGIC, type, 0, (uint32_t) (fixed_size + tail_length) };
+
+    iovec parts[3] = {
+        { &header, sizeof(header) },
+        { const_cast<void *>(fixed), fixed_size },
+        { const_cast<void *>(tail), tail_length },
+    };
+    iovec * iov = parts;
+    int     iov_count = tail_length > 0 ? 3 : 2;
+
+    msghdr message = {};
+    while (iov_count > 0) {
+        message.msg_iov    = iov;
+        message.msg_iovlen = (size_t) iov_count;
+
+        ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (n < 0 && errno == ENOTSOCK) {
+            n = writev(fd, iov, iov_count);   // a file or pipe (batch output)
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+
+        // Partial write: skip what went out and resend the rest
+        while (iov_count > 0 && (size_t) n >= iov->iov_len) {
+            n -= (ssize_t) iov->iov_len;
+            ++iov;
+            --iov_count;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+wb_wire_reader * wb_wire_reader_create(int fd) {
+    auto * reader = new wb_wire_reader();
+    reader->fd = fd;
+    return reader;
+}
+
+void wb_wire_reader_free(wb_wire_reader * reader) {
+    delete reader;
+}
+
+int wb_wire_reader_next(wb_wire_reader * reader, wb_wire_frame * out) {
+    frame_header header;
+    int rc = read_full(reader->fd, &header, sizeof(header));
+    if (rc <= 0) {
+        return rc;
+    }
+
+    const size_t fixed_size = wb_wire_fixed_size(header.type);
+    if (header.magic != WB_WIRE_MAGIC || fixed_size == 0 ||
+        header.length < fixed_size || header.length > WB_WIRE_MAX_BODY) {
+        return -EBADMSG;
+    }
+
+    // Grows to the largest frame seen, then stays
+    if (reader->body.size() < header.length) {
+        reader->body.resize(header.length);
+    }
+    rc = read_full(reader->fd, reader->body.data(), header.length);
+    if (rc <= 0) {
+        return rc == 0 ? -EBADMSG : rc;
+    }
+
+    out->type        = header.type;
+    out->fixed       = reader->body.data();
+    out->tail        = reader->body.data() + fixed_size;
+    out->tail_length = header.length - fixed_size;
+    return 1;
+}
+
+void wb_wire_set_session_id(char * field, const char * session_id) {
+    memset(field, 0, WB_WIRE_SESSION_ID_MAX);
+    if (session_id != nullptr) {
+        strncpy(field, session_id, WB_WIRE_SESSION_ID_MAX - 1);
+    }
+}
@@ -0,0 +1,152 @@
+//
+//  wb_wire.h
+//  WhisperBoard
+//
+//  Binary framing of the IPC messages (MessageTypes.swift) for stream sockets
+//  Used by the Linux server (Server/) where JSON files in a shared container do not apply
+//
+//  Frame layout (host byte order - both ends run on the same machine, no padding):
+//    uint32 magic | uint16 type | uint16 reserved | uint32 length | body[length]
+//  body = the fixed struct for `type`, then a variable tail (PCM bytes, UTF-8 text, ...)
+//
+
+#ifndef wb_wire_h
+#define wb_wire_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WB_WIRE_MAGIC          0x46425757u   // "WWBF"
+#define WB_WIRE_HEADER_SIZE    12
+#define WB_WIRE_MAX_BODY       (8u << 20)    // 8 MB: ~2 minutes of 16 kHz float32 per chunk
+#define WB_WIRE_SESSION_ID_MAX 128
+#define WB_WIRE_VARIANT_MAX    32
+
+enum wb_wire_type {
+    WB_WIRE_CONTROL       = 1,   // client → server: wb_wire_control
+    WB_WIRE_AUDIO_CHUNK   = 2,   // client → server: wb_wire_audio_chunk + PCM bytes
+    WB_WIRE_TOKEN_UPDATE  = 3,   // server → client: wb_wire_token_update + text + tokens
+    WB_WIRE_TRANSCRIPTION = 4,   // server → client: wb_wire_transcription + text
+    WB_WIRE_ERROR         = 5,   // server → client: wb_wire_error + description
+    WB_WIRE_STATUS        = 6,   // server → client: wb_wire_status (reply to PING)
+};
+
+// ControlSignal, in declaration order
+enum wb_wire_signal {
+    WB_WIRE_SIGNAL_START       = 0,
+    WB_WIRE_SIGNAL_STOP        = 1,
+    WB_WIRE_SIGNAL_CANCEL      = 2,
+    WB_WIRE_SIGNAL_PING        = 3,
+    WB_WIRE_SIGNAL_RESET_MODEL = 4,
+};
+
+// ErrorMessage.ErrorType, in declaration order
+enum wb_wire_error_type {
+    WB_WIRE_ERROR_MODEL_LOAD_FAILED       = 0,
+    WB_WIRE_ERROR_AUDIO_PROCESSING_FAILED = 1,
+    WB_WIRE_ERROR_INFERENCE_FAILED        = 2,
+    WB_WIRE_ERROR_MEMORY_PRESSURE         = 3,
+    WB_WIRE_ERROR_INVALID_AUDIO_FORMAT    = 4,
+    WB_WIRE_ERROR_TIMEOUT                 = 5,
+    WB_WIRE_ERROR_UNKNOWN                 = 6,
+};
+
+// Session ids are NUL-terminated inside their fixed field
+
+typedef struct wb_wire_control {
+    int64_t timestamp_ms;
+    uint8_t signal;                 // wb_wire_signal
+    uint8_t reserved[7];
+    char    session_id[WB_WIRE_SESSION_ID_MAX];
+} wb_wire_control;
+
+// Tail: chunk samples, interleaved if channels > 1
+typedef struct wb_wire_audio_chunk {
+    int64_t  timestamp_ms;
+    int32_t  chunk_id;
+    int32_t  sample_rate;
+    float    duration;              // seconds
+    uint16_t channels;
+    uint8_t  format;                // wb_pcm_format (Native/wb_pcm_view.h)
+    uint8_t  is_last_chunk;
+    char     session_id[WB_WIRE_SESSION_ID_MAX];
+} wb_wire_audio_chunk;
+
+// Tail: text[text_length], then n_tokens NUL-terminated token strings
+typedef struct wb_wire_token_update {
+    int64_t  timestamp_ms;
+    uint32_t n_tokens;
+    uint32_t text_length;
+    uint8_t  is_tentative;
+    uint8_t  reserved[7];
+    char     session_id[WB_WIRE_SESSION_ID_MAX];
+} wb_wire_token_update;
+
+// Tail: UTF-8 text
+typedef struct wb_wire_transcription {
+    int64_t timestamp_ms;
+    int32_t processing_time_ms;
+    float   confidence;             // < 0 = no confidence
+    uint8_t is_final;
+    uint8_t reserved[7];
+    char    session_id[WB_WIRE_SESSION_ID_MAX];
+} wb_wire_transcription;
+
+// Tail: UTF-8 description. Empty session id = not tied to a session
+typedef struct wb_wire_error {
+    int64_t timestamp_ms;
+    uint8_t error_type;             // wb_wire_error_type
+    uint8_t is_recoverable;
+    uint8_t reserved[6];
+    char    session_id[WB_WIRE_SESSION_ID_MAX];
+} wb_wire_error;
+
+typedef struct wb_wire_status {
+    int64_t  timestamp_ms;
+    uint8_t  is_model_loaded;
+    uint8_t  reserved[3];
+    uint32_t active_sessions;
+    uint32_t max_sessions;
+    uint32_t queued_chunks;
+    float    batch_occupancy;       // filled fraction of encoder batches (server), 0-1
+    float    queue_delay_ms;        // mean wait from ready to encoder start (server)
+    char     model_variant[WB_WIRE_VARIANT_MAX];
+} wb_wire_status;
+
+// Frame view returned by the reader.
+// Pointers reference the reader's buffer and stay valid until the next call on that reader.
+typedef struct wb_wire_frame {
+    uint16_t     type;
+    const void * fixed;             // the fixed struct for `type`
+    const void * tail;
+    size_t       tail_length;
+} wb_wire_frame;
+
+typedef struct wb_wire_reader wb_wire_reader;
+
+// Size of the fixed struct for a frame type (0 = unknown type)
+size_t wb_wire_fixed_size(uint16_t type);
+
+// Send one frame with a single writev(2) loop. Returns 0 or -errno (EPIPE is not raised as SIGPIPE
+// on sockets). `fd` may also be a file or pipe, e.g. to store frames.
+int wb_wire_send(int fd, uint16_t type, const void * fixed, const void * tail, size_t tail_length);
+
+// Blocking frame reader over `fd` (not owned)
+wb_wire_reader * wb_wire_reader_create(int fd);
+void             wb_wire_reader_free(wb_wire_reader * reader);
+
+// Returns 1 and fills `out`, 0 on clean EOF, -EBADMSG on a malformed frame, or -errno
+int wb_wire_reader_next(wb_wire_reader * reader, wb_wire_frame * out);
+
+// Copy a session id into its fixed field, truncating if needed
+void wb_wire_set_session_id(char * field, const char * session_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_wire_h */
@@ -0,0 +1,914 @@
+//
+//  wb_server.cpp
+//  WhisperBoard
+//
+//  One reader thread per connection parses frames and queues converted chunks
+//  on their session. Sessions with queued audio sit in a ready queue. The
+//  batcher collects up to batch_size of them (or whatever is ready when the
+//  oldest has waited batch_window_ms), takes one chunk from each and runs their
+//  encoder passes back to back with every encoder thread, then scatters the
+//  sessions to the decoder workers. A decoder runs the text decoder on the
+//  session's state and puts the session back in the ready queue if more audio
+//  is waiting. A session is only ever held by one thread at a time (chunks stay
+//  in order, its state keeps the text context), while different sessions decode
+//  in parallel.
+//
+//  whisper.cpp builds one encoder graph per state, so a batch is N consecutive
+//  full-width encoder passes rather than one concatenated GEMM; the win is that
+//  the compute-bound encoder gets all cores while memory-bound decoding of
+//  other sessions overlaps it.
+//
+//  Cores are budgeted by the shared wb_pool: the mel, encoder and decoder calls
+//  (which spawn whisper.cpp threads) lease their thread counts from it, so
+//  concurrent decoders shrink the encoder's width instead of oversubscribing
+//  the machine. The reader, batcher and decoder threads themselves are outside
+//  that budget; they only coordinate between leased calls.
+//
+
+#include "wb_server.h"
+
+#include "wb_cancel.h"
+#include "wb_decoder.h"
+#include "wb_logits.h"
+#include "wb_pcm_view.h"
+#include "wb_pool.h"
+#include "wb_repetition.h"
+#include "wb_vocab.h"
+#include "wb_wire.h"
+
+#include "whisper.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int k_sample_rate = 16000;
+constexpr int k_listen_backlog = 64;
+constexpr uint64_t k_stats_log_interval = 256;   // encoder batches between stats lines
+
+std::atomic<bool> g_stop{false};
+std::atomic<int>  g_listen_fd{-1};
+
+int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+int elapsed_ms(clock_type::time_point since) {
+    using namespace std::chrono;
+    return (int) duration_cast<milliseconds>(clock_type::now() - since).count();
+}
+
+std::string session_id_of(const char * field) {
+    return std::string(field, strnlen(field, WB_WIRE_SESSION_ID_MAX));
+}
+
+// "…/ggml-small-q5_1.bin" → "small-q5_1"
+std::string model_variant(const char * model_path) {
+    std::string name = model_path;
+    const size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos) {
+        name.erase(0, slash + 1);
+    }
+    if (name.compare(0, 5, "ggml-") == 0) {
+        name.erase(0, 5);
+    }
+    const size_t dot = name.rfind(".bin");
+    if (dot != std::string::npos && dot + 4 == name.size()) {
+        name.erase(dot);
+    }
+    return name;
+}
+
+struct connection {
+    int        fd = -1;
+    std::mutex write_mutex;   // frames from workers and the reader interleave whole
+
+    explicit connection(int fd) : fd(fd) {}
+    ~connection() { close(fd); }
+
+    int send(uint16_t type, const void * fixed, const void * tail = nullptr, size_t tail_length = 0) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        return wb_wire_send(fd, type, fixed, tail, tail_length);
+    }
+
+    void send_error(const std::string & session_id, int error_type, bool recoverable, const std::string & description) {
+        wb_wire_error error = {};
+        error.timestamp_ms   = now_ms();
+        error.error_type     = (uint8_t) error_type;
+        error.is_recoverable = recoverable ? 1 : 0;
+        wb_wire_set_session_id(error.session_id, session_id.c_str());
+        send(WB_WIRE_ERROR, &error, description.data(), description.size());
+    }
+};
+
+struct chunk {
+    std::vector<float>     samples;
+    int32_t                chunk_id = 0;
+    bool                   is_last  = false;
+    clock_type::time_point received;
+};
+
+struct session {
+    std::string                 id;
+    std::shared_ptr<connection> conn;
+    whisper_state *             state = nullptr;
+    wb_decoder_kv *             kv    = nullptr;   // what `state` holds since its last encode
+    wb_cancel_token *           token = nullptr;
+
+    // Guarded by mutex
+    std::mutex                  mutex;
+    std::condition_variable     space_cv;        // reader waits here while `pending` is full
+    std::deque<chunk>           pending;
+    std::map<int32_t, chunk>    out_of_order;
+    int32_t                     next_chunk_id = 0;
+    bool                        scheduled     = false;
+
+    clock_type::time_point      ready_since;      // guarded by the server's ready_mutex
+
+    // Only touched by the thread currently holding the session
+    std::string                 text;
+    std::vector<int32_t>        history;          // text tokens so far, the next chunk's prompt
+    std::vector<int32_t>        tokens;           // decoder output buffer
+    bool                        runaway = false;  // a chunk was cut at a repetition loop
+
+    ~session() {
+        whisper_free_state(state);
+        wb_decoder_kv_free(kv);
+        wb_cancel_token_release(token);
+    }
+
+    bool cancelled() const { return wb_cancel_token_is_cancelled(token); }
+};
+
+using session_key = std::pair<const connection *, std::string>;
+
+// An encoded chunk on its way from the batcher to a decoder
+struct decode_job {
+    std::shared_ptr<session> s;
+    chunk                    c;
+    bool                     encoded = false;
+};
+
+struct server {
+    wb_server_options options;
+    std::string       language;
+    std::string       variant;
+    whisper_context * ctx = nullptr;
+    wb_logits_mask *  suppress  = nullptr;   // read-only, shared by every decoder
+    wb_vocab *        vocab     = nullptr;   // token bytes, read-only, shared by every decoder
+    wb_pool *         pool = nullptr;
+
+    std::mutex                                        sessions_mutex;
+    std::map<session_key, std::shared_ptr<session>>   sessions;
+
+    // ready_mutex guards both queues and `stopping`
+    std::mutex                                 ready_mutex;
+    std::condition_variable                    ready_cv;
+    std::deque<std::shared_ptr<session>>       ready;
+    std::condition_variable                    decode_cv;
+    std::deque<decode_job>                     decode_queue;
+    bool                                       stopping = false;
+
+    std::atomic<size_t> queued_chunks{0};
+    std::vector<std::thread> workers;   // batcher + decoders
+
+    struct {
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> slots{0};            // chunks encoded across all batches
+        std::atomic<uint64_t> queue_delay_us{0};   // ready → encode start, summed over slots
+        std::atomic<uint64_t> decoded_chunks{0};
+        std::atomic<uint64_t> runaway_chunks{0};   // cut at a repetition loop
+    } stats;
+
+    // Reader threads are detached; shutdown waits for the count to reach zero
+    std::mutex                                   connections_mutex;
+    std::condition_variable                      connections_cv;
+    std::map<const connection *, std::weak_ptr<connection>> connections;
+
+    // MARK: - Sessions
+
+    std::shared_ptr<session> find_session(const connection * conn, const std::string & id) {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto it = sessions.find({ conn, id });
+        return it != sessions.end() ? it->second : nullptr;
+    }
+
+    // Cancel a session and purge its queued audio; a worker holding it finishes on the abort callback
+    void cancel_session(const std::shared_ptr<session> & s) {
+        wb_cancel_token_cancel(s->token);
+
+        std::lock_guard<std::mutex> lock(s->mutex);
+        queued_chunks.fetch_sub(s->pending.size(), std::memory_order_relaxed);
+        s->pending.clear();
+        s->out_of_order.clear();
+        s->space_cv.notify_all();
+    }
+
+    // Remove `s` if it is still the live session for its key
+    void remove_session(const std::shared_ptr<session> & s) {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto it = sessions.find({ s->conn.get(), s->id });
+        if (it != sessions.end() && it->second == s) {
+            sessions.erase(it);
+        }
+    }
+
+    void cancel_sessions(const connection * conn) {
+        std::vector<std::shared_ptr<session>> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(sessions_mutex);
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                if (conn == nullptr || it->first.first == conn) {
+                    cancelled.push_back(std::move(it->second));
+                    it = sessions.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (const auto & s : cancelled) {
+            cancel_session(s);
+        }
+    }
+
+    void start_session(const std::shared_ptr<connection> & conn, const std::string & id) {
+        // Restarting an id replaces the old session
+        if (auto previous = find_session(conn.get(), id)) {
+            cancel_session(previous);
+            remove_session(previous);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sessions_mutex);
+            if ((int) sessions.size() >= options.max_sessions) {
+                conn->send_error(id, WB_WIRE_ERROR_MEMORY_PRESSURE, true, "Too many concurrent sessions");
+                return;
+            }
+        }
+
+        auto s = std::make_shared<session>();
+        s->id    = id;
+        s->conn  = conn;
+        s->token = wb_cancel_token_create();
+        s->state = whisper_init_state(ctx);
+        s->kv    = wb_decoder_kv_create(ctx);
+        if (s->state == nullptr) {
+            conn->send_error(id, WB_WIRE_ERROR_MEMORY_PRESSURE, true, "Failed to allocate whisper state");
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        sessions[{ conn.get(), id }] = std::move(s);
+    }
+
+    // MARK: - Frames
+
+    void handle_control(const std::shared_ptr<connection> & conn, const wb_wire_control & message) {
+        const std::string id = session_id_of(message.session_id);
+
+        switch (message.signal) {
+        case WB_WIRE_SIGNAL_START:
+            start_session(conn, id);
+            break;
+
+        case WB_WIRE_SIGNAL_STOP:
+            // The chunk flagged is_last_chunk finalises the session
+            break;
+
+        case WB_WIRE_SIGNAL_CANCEL:
+            if (auto s = find_session(conn.get(), id)) {
+                cancel_session(s);
+                remove_session(s);
+            }
+            break;
+
+        case WB_WIRE_SIGNAL_PING: {
+            wb_wire_status status = {};
+            status.timestamp_ms    = now_ms();
+            status.is_model_loaded = 1;
+            status.max_sessions    = (uint32_t) options.max_sessions;
+            status.queued_chunks   = (uint32_t) queued_chunks.load(std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(sessions_mutex);
+                status.active_sessions = (uint32_t) sessions.size();
+            }
+            status.batch_occupancy = batch_occupancy();
+            status.queue_delay_ms  = queue_delay_ms();
+            strncpy(status.model_variant, variant.c_str(), WB_WIRE_VARIANT_MAX - 1);
+            conn->send(WB_WIRE_STATUS, &status);
+            break;
+        }
+
+        case WB_WIRE_SIGNAL_RESET_MODEL:
+            // The model is shared; only this client's sessions are reset
+            cancel_sessions(conn.get());
+            break;
+
+        default:
+            conn->send_error(id, WB_WIRE_ERROR_UNKNOWN, true, "Unknown control signal");
+            break;
+        }
+    }
+
+    void handle_audio(const std::shared_ptr<connection> & conn, const wb_wire_audio_chunk & message,
+                      const void * pcm, size_t pcm_length) {
+        const std::string id = session_id_of(message.session_id);
+
+        auto s = find_session(conn.get(), id);
+        if (s == nullptr) {
+            return;   // cancelled or never started: same as the app, stale chunks are ignored
+        }
+
+        const size_t sample_size = message.format == WB_PCM_FLOAT32 ? sizeof(float) : sizeof(int16_t);
+        if (message.sample_rate != k_sample_rate || message.channels != 1 ||
+            (message.format != WB_PCM_FLOAT32 && message.format != WB_PCM_INT16) ||
+            pcm_length % sample_size != 0) {
+            conn->send_error(id, WB_WIRE_ERROR_INVALID_AUDIO_FORMAT, true, "Expected 16 kHz mono pcm16 or float32");
+            return;
+        }
+
+        chunk c;
+        c.chunk_id = message.chunk_id;
+        c.is_last  = message.is_last_chunk != 0;
+        c.received = clock_type::now();
+        c.samples.resize(pcm_length / sample_size);
+        if (message.format == WB_PCM_FLOAT32) {
+            memcpy(c.samples.data(), pcm, pcm_length);
+        } else {
+            const auto * src = static_cast<const int16_t *>(pcm);
+            for (size_t i = 0; i < c.samples.size(); ++i) {
+                c.samples[i] = (float) src[i] / 32768.0f;
+            }
+        }
+
+        bool schedule = false;
+        {
+            std::unique_lock<std::mutex> lock(s->mutex);
+
+            // Backpressure: stop reading this connection until a worker catches up
+            s->space_cv.wait(lock, [&] {
+                return (int) s->pending.size() < options.max_pending_chunks || s->cancelled();
+            });
+            if (s->cancelled() || c.chunk_id < s->next_chunk_id) {
+                return;
+            }
+
+            size_t added = 0;
+            if (c.chunk_id > s->next_chunk_id) {
+                s->out_of_order[c.chunk_id] = std::move(c);
+                if ((int) s->out_of_order.size() <= options.max_pending_chunks) {
+                    return;
+                }
+                // The gap is not coming: give up on it and continue from the oldest buffered chunk
+                s->next_chunk_id = s->out_of_order.begin()->first;
+            } else {
+                s->pending.push_back(std::move(c));
+                ++added;
+                ++s->next_chunk_id;
+            }
+
+            // Queue anything buffered that is now in sequence
+            for (auto it = s->out_of_order.find(s->next_chunk_id); it != s->out_of_order.end();
+                 it = s->out_of_order.find(s->next_chunk_id)) {
+                s->pending.push_back(std::move(it->second));
+                s->out_of_order.erase(it);
+                ++added;
+                ++s->next_chunk_id;
+            }
+            queued_chunks.fetch_add(added, std::memory_order_relaxed);
+
+            if (!s->scheduled) {
+                s->scheduled = true;
+                schedule = true;
+            }
+        }
+
+        if (schedule) {
+            make_ready(s);
+        }
+    }
+
+    void serve(std::shared_ptr<connection> conn) {
+        wb_wire_reader * reader = wb_wire_reader_create(conn->fd);
+        wb_wire_frame frame;
+        int rc;
+
+        while ((rc = wb_wire_reader_next(reader, &frame)) == 1) {
+            switch (frame.type) {
+            case WB_WIRE_CONTROL:
+                handle_control(conn, *static_cast<const wb_wire_control *>(frame.fixed));
+                break;
+            case WB_WIRE_AUDIO_CHUNK:
+                handle_audio(conn, *static_cast<const wb_wire_audio_chunk *>(frame.fixed), frame.tail, frame.tail_length);
+                break;
+            default:
+                conn->send_error("", WB_WIRE_ERROR_UNKNOWN, true, "Unexpected frame type");
+                break;
+            }
+        }
+
+        if (rc < 0 && !g_stop.load(std::memory_order_relaxed)) {
+            fprintf(stderr, "[Server] Connection closed: %s\n", strerror(-rc));
+        }
+        wb_wire_reader_free(reader);
+
+        // Nobody is left to receive these sessions' results
+        cancel_sessions(conn.get());
+
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        connections.erase(conn.get());
+        connections_cv.notify_all();
+    }
+
+    // MARK: - Encoder Batches
+
+    void make_ready(std::shared_ptr<session> s) {
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            s->ready_since = clock_type::now();
+            ready.push_back(std::move(s));
+        }
+        ready_cv.notify_one();
+    }
+
+    // Take the next chunk of a scheduled session; false if it has nothing left
+    bool take_chunk(session & s, chunk & c) {
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.pending.empty() || s.cancelled()) {
+                s.scheduled = false;
+                return false;
+            }
+            c = std::move(s.pending.front());
+            s.pending.pop_front();
+            queued_chunks.fetch_sub(1, std::memory_order_relaxed);
+        }
+        s.space_cv.notify_one();
+        return true;
+    }
+
+    // Gathers up to batch_size ready sessions (or whatever is ready when the window closes),
+    // runs their mel + encoder passes back to back at full width, then scatters them to decoders
+    void run_batcher() {
+        std::vector<std::shared_ptr<session>> batch;
+        batch.reserve((size_t) options.batch_size);
+
+        for (;;) {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> lock(ready_mutex);
+                ready_cv.wait(lock, [&] { return stopping || !ready.empty(); });
+                if (stopping) {
+                    return;
+                }
+
+                // The window opens with the oldest waiting session, so its deadline is what counts
+                const auto deadline = ready.front()->ready_since + std::chrono::milliseconds(options.batch_window_ms);
+                ready_cv.wait_until(lock, deadline, [&] {
+                    return stopping || (int) ready.size() >= options.batch_size;
+                });
+                if (stopping) {
+                    return;
+                }
+
+                while (!ready.empty() && (int) batch.size() < options.batch_size) {
+                    batch.push_back(std::move(ready.front()));
+                    ready.pop_front();
+                }
+            }
+
+            const auto batch_start = clock_type::now();
+            int occupied = 0;
+
+            for (auto & s : batch) {
+                decode_job job;
+                job.s = s;
+                if (!take_chunk(*s, job.c)) {
+                    continue;
+                }
+                ++occupied;
+                stats.queue_delay_us.fetch_add(
+                    (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(batch_start - s->ready_since).count(),
+                    std::memory_order_relaxed);
+
+                job.encoded = compute_mel(*s, job.c) && !s->cancelled() && encode(*s, job.c);
+
+                push_decode(std::move(job));
+            }
+
+            if (occupied > 0) {
+                const uint64_t batches = stats.batches.fetch_add(1, std::memory_order_relaxed) + 1;
+                stats.slots.fetch_add((uint64_t) occupied, std::memory_order_relaxed);
+                if (batches % k_stats_log_interval == 0) {
+                    fprintf(stderr, "[Server] %llu encoder batches: occupancy %.0f%%, queueing delay %.1f ms\n",
+                            (unsigned long long) batches, 100.0f * batch_occupancy(), queue_delay_ms());
+                }
+            }
+        }
+    }
+
+    bool compute_mel(session & s, const chunk & c) {
+        const int granted = wb_pool_lease(pool, options.encoder_threads, WB_PRIORITY_LIVE, deadline_ns(c));
+        const int rc      = whisper_pcm_to_mel_with_state(ctx, s.state, c.samples.data(), (int) c.samples.size(), granted);
+        wb_pool_release(pool, granted, WB_PRIORITY_LIVE);
+        return rc == 0;
+    }
+
+    bool encode(session & s, const chunk & c) {
+        const int granted = wb_pool_lease(pool, options.encoder_threads, WB_PRIORITY_LIVE, deadline_ns(c));
+        const int rc      = whisper_encode_with_state(ctx, s.state, 0, granted);
+        wb_pool_release(pool, granted, WB_PRIORITY_LIVE);
+        // The decoder KV is conditioned on the previous audio
+        wb_decoder_kv_reset(s.kv);
+        return rc == 0;
+    }
+
+    // Live work on the pool is ordered by arrival: the oldest chunk is closest to its deadline
+    static uint64_t deadline_ns(const chunk & c) {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(c.received.time_since_epoch()).count();
+    }
+
+    float batch_occupancy() const {
+        const uint64_t batches = stats.batches.load(std::memory_order_relaxed);
+        return batches == 0 ? 0.0f
+            : (float) stats.slots.load(std::memory_order_relaxed) / (float) (batches * (uint64_t) options.batch_size);
+    }
+
+    float queue_delay_ms() const {
+        const uint64_t slots = stats.slots.load(std::memory_order_relaxed);
+        return slots == 0 ? 0.0f
+            : (float) stats.queue_delay_us.load(std::memory_order_relaxed) / 1000.0f / (float) slots;
+    }
+
+    // MARK: - Decoders
+
+    void push_decode(decode_job job) {
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            decode_queue.push_back(std::move(job));
+        }
+        decode_cv.notify_one();
+    }
+
+    void run_decoder() {
+        for (;;) {
+            decode_job job;
+            {
+                std::unique_lock<std::mutex> lock(ready_mutex);
+                decode_cv.wait(lock, [&] { return stopping || !decode_queue.empty(); });
+                if (stopping) {
+                    return;
+                }
+                job = std::move(decode_queue.front());
+                decode_queue.pop_front();
+            }
+
+            auto & s = job.s;
+            decode(*s, job.c, job.encoded);
+            if (job.c.is_last) {
+                remove_session(s);
+            }
+
+            // Back of the line, so every session with audio gets a turn in a batch
+            bool requeue = false;
+            {
+                std::lock_guard<std::mutex> lock(s->mutex);
+                requeue = !s->pending.empty() && !s->cancelled();
+                s->scheduled = requeue;
+            }
+            if (requeue) {
+                make_ready(std::move(s));
+            }
+        }
+    }
+
+    void decode(session & s, const chunk & c, bool encoded) {
+        if (s.cancelled()) {
+            return;
+        }
+
+        int  n_tokens = -1;
+        bool runaway  = false;
+        if (encoded) {
+            wb_decoder_params params = wb_decoder_default_params();
+            params.n_threads       = wb_pool_lease(pool, options.threads_per_session, WB_PRIORITY_LIVE, deadline_ns(c));
+            params.language        = language.c_str();
+            params.prompt_tokens   = s.history.data();   // the session's text so far, as whisper_full would
+            params.n_prompt_tokens = (int) s.history.size();
+            params.token           = s.token;
+            params.kv              = s.kv;
+            params.mask            = suppress;
+            params.max_tokens      = wb_repetition_token_cap(c.samples.size());
+            params.stop_runaway    = true;
+            params.runaway         = &runaway;
+
+            s.tokens.resize((size_t) whisper_n_text_ctx(ctx));
+            if (c.is_last && options.final_beam_size > 1) {
+                // The final text is worth a wider search; streaming chunks stay greedy
+                wb_beam_params beam = wb_beam_default_params();
+                beam.beam_size = options.final_beam_size;
+                n_tokens = wb_decode_beam(ctx, s.state, &params, &beam, s.tokens.data(), (int) s.tokens.size());
+            } else {
+                n_tokens = wb_decode_greedy(ctx, s.state, &params, s.tokens.data(), (int) s.tokens.size());
+            }
+            wb_pool_release(pool, params.n_threads, WB_PRIORITY_LIVE);
+        }
+        if (s.cancelled()) {
+            return;
+        }
+
+        if (n_tokens >= 0) {
+            stats.decoded_chunks.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (runaway) {
+            stats.runaway_chunks.fetch_add(1, std::memory_order_relaxed);
+            s.runaway = true;
+        }
+
+        if (n_tokens < 0) {
+            s.conn->send_error(s.id, WB_WIRE_ERROR_INFERENCE_FAILED, !c.is_last, "Whisper inference failed");
+        } else if (n_tokens > 0) {
+            // Characters split across tokens go out whole, with the token that completes them
+            std::string       chunk_text;
+            std::string       token_bytes;   // each token's text, NUL-terminated
+            std::vector<char> out(wb_vocab_max_emit(vocab));
+            wb_detok          detok;
+            wb_detok_begin(&detok);
+            for (int i = 0; i < n_tokens; ++i) {
+                const size_t n = wb_detok_push(&detok, vocab, s.tokens[(size_t) i], out.data());
+                chunk_text.append(out.data(), n);
+                token_bytes.append(out.data(), n);
+                token_bytes += '\0';
+            }
+            chunk_text.append(out.data(), wb_detok_end(&detok, out.data()));
+            append_text(s.text, chunk_text);
+
+            // Text that looped once is not a prompt to condition the next chunk on
+            if (runaway) {
+                s.history.clear();
+            } else {
+                s.history.insert(s.history.end(), s.tokens.begin(), s.tokens.begin() + n_tokens);
+            }
+            const size_t max_history = (size_t) whisper_n_text_ctx(ctx) / 2;
+            if (s.history.size() > max_history) {
+                s.history.erase(s.history.begin(), s.history.end() - (std::ptrdiff_t) max_history);
+            }
+
+            send_token_update(s, token_bytes, n_tokens);
+        }
+
+        if (c.is_last) {
+            wb_wire_transcription result = {};
+            result.timestamp_ms       = now_ms();
+            result.processing_time_ms = elapsed_ms(c.received);
+            result.confidence         = s.runaway ? 0.0f : -1.0f;   // unknown, or low: part of it looped
+            result.is_final           = 1;
+            wb_wire_set_session_id(result.session_id, s.id.c_str());
+            s.conn->send(WB_WIRE_TRANSCRIPTION, &result, s.text.data(), s.text.size());
+        }
+    }
+
+    static void append_text(std::string & text, const std::string & chunk_text) {
+        const size_t first = chunk_text.find_first_not_of(' ');
+        if (first == std::string::npos) {
+            return;
+        }
+        const size_t last = chunk_text.find_last_not_of(' ');
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text.append(chunk_text, first, last - first + 1);
+    }
+
+    void send_token_update(session & s, const std::string & token_bytes, int n_tokens) {
+        // Tail: text so far, then each token NUL-terminated (as token_bytes already is)
+        std::string tail = s.text;
+        tail += token_bytes;
+
+        wb_wire_token_update update = {};
+        update.timestamp_ms = now_ms();
+        update.n_tokens     = (uint32_t) n_tokens;
+        update.text_length  = (uint32_t) s.text.size();
+        wb_wire_set_session_id(update.session_id, s.id.c_str());
+        s.conn->send(WB_WIRE_TOKEN_UPDATE, &update, tail.data(), tail.size());
+    }
+
+    // MARK: - Lifecycle
+
+    int listen_on(const char * path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            return -ENAMETOOLONG;
+        }
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -errno;
+        }
+
+        unlink(path);   // stale socket from a previous run
+        if (bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            chmod(path, 0660) != 0 ||
+            listen(fd, k_listen_backlog) != 0) {
+            const int err = errno;
+            close(fd);
+            return -err;
+        }
+        return fd;
+    }
+
+    void accept_loop(int listen_fd) {
+        while (!g_stop.load(std::memory_order_relaxed)) {
+            const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (!g_stop.load(std::memory_order_relaxed)) {
+                    fprintf(stderr, "[Server] accept failed: %s\n", strerror(errno));
+                }
+                return;
+            }
+
+            auto conn = std::make_shared<connection>(fd);
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex);
+                connections[conn.get()] = conn;
+            }
+            std::thread([this, conn] { serve(conn); }).detach();
+        }
+    }
+
+    void shutdown_all() {
+        // Abort decodes, then unblock every reader
+        cancel_sessions(nullptr);
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (auto & entry : connections) {
+                if (auto conn = entry.second.lock()) {
+                    shutdown(conn->fd, SHUT_RDWR);
+                }
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            connections_cv.wait(lock, [&] { return connections.empty(); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            stopping = true;
+        }
+        ready_cv.notify_all();
+        decode_cv.notify_all();
+        for (auto & worker : workers) {
+            worker.join();
+        }
+
+        // States must go before the context they were created from
+        ready.clear();
+        decode_queue.clear();
+        cancel_sessions(nullptr);
+    }
+};
+
+} // namespace
+
+wb_server_options wb_server_default_options(void) {
+    wb_server_options options;
+    options.model_path          = nullptr;
+    options.socket_path         = "/run/whisperboard/whisperboard.sock";
+    options.language            = nullptr;
+    options.workers             = 0;
+    options.threads_per_session = 2;
+    options.max_sessions        = 16;
+    options.max_pending_chunks  = 8;
+    options.batch_size          = 4;
+    options.batch_window_ms     = 15;
+    options.encoder_threads     = 0;
+    options.final_beam_size     = 5;
+    options.use_gpu             = false;
+    return options;
+}
+
+int wb_server_run(const wb_server_options * options) {
+    if (options == nullptr || options->model_path == nullptr || options->socket_path == nullptr) {
+        return -EINVAL;
+    }
+
+    server srv;
+    srv.options  = *options;
+    srv.language = options->language != nullptr ? options->language : "en";
+    srv.variant  = model_variant(options->model_path);
+
+    if (srv.options.threads_per_session < 1) {
+        srv.options.threads_per_session = 1;
+    }
+    if (srv.options.workers < 1) {
+        const int cores = (int) std::thread::hardware_concurrency();
+        srv.options.workers = std::max(1, cores / srv.options.threads_per_session);
+    }
+    if (srv.options.max_sessions < 1) {
+        srv.options.max_sessions = 1;
+    }
+    if (srv.options.max_pending_chunks < 1) {
+        srv.options.max_pending_chunks = 1;
+    }
+    if (srv.options.batch_size < 1) {
+        srv.options.batch_size = 1;
+    }
+    if (srv.options.batch_window_ms < 0) {
+        srv.options.batch_window_ms = 0;
+    }
+    if (srv.options.encoder_threads < 1) {
+        srv.options.encoder_threads = std::max(1, (int) std::thread::hardware_concurrency());
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = options->use_gpu;
+    srv.ctx = whisper_init_from_file_with_params(options->model_path, cparams);
+    if (srv.ctx == nullptr) {
+        fprintf(stderr, "[Server] Failed to load model: %s\n", options->model_path);
+        return -ENOENT;
+    }
+    srv.pool = wb_pool_shared();
+
+    // As the app's whisper_full parameters: no non-speech symbols
+    srv.suppress = wb_logits_mask_create(srv.ctx, true);
+    srv.vocab    = wb_vocab_create(srv.ctx);
+
+    const int listen_fd = srv.listen_on(options->socket_path);
+    if (listen_fd < 0) {
+        fprintf(stderr, "[Server] Cannot listen on %s: %s\n", options->socket_path, strerror(-listen_fd));
+        wb_logits_mask_free(srv.suppress);
+        wb_vocab_free(srv.vocab);
+        whisper_free(srv.ctx);
+        return listen_fd;
+    }
+
+    g_stop.store(false, std::memory_order_relaxed);
+    g_listen_fd.store(listen_fd, std::memory_order_release);
+
+    srv.workers.emplace_back([&srv] { srv.run_batcher(); });
+    for (int i = 0; i < srv.options.workers; ++i) {
+        srv.workers.emplace_back([&srv] { srv.run_decoder(); });
+    }
+
+    const double kv_mb = (double) wb_decoder_kv_state_bytes(srv.ctx) / (1024.0 * 1024.0);
+    fprintf(stderr, "[Server] Decoder KV %.1f MB per session, %.1f MB at %d sessions\n",
+            kv_mb, kv_mb * srv.options.max_sessions, srv.options.max_sessions);
+    fprintf(stderr, "[Server] Listening on %s (%s, encoder batches of %d within %d ms, %d decoders x %d threads, up to %d sessions, final beam %d)\n",
+            options->socket_path, srv.variant.c_str(), srv.options.batch_size, srv.options.batch_window_ms,
+            srv.options.workers, srv.options.threads_per_session, srv.options.max_sessions, srv.options.final_beam_size);
+
+    srv.accept_loop(listen_fd);
+
+    g_listen_fd.store(-1, std::memory_order_release);
+    close(listen_fd);
+    unlink(options->socket_path);
+
+    srv.shutdown_all();
+    wb_logits_mask_free(srv.suppress);
+    wb_vocab_free(srv.vocab);
+    whisper_free(srv.ctx);
+
+    fprintf(stderr, "[Server] Stopped after %llu encoder batches (occupancy %.0f%%, queueing delay %.1f ms)\n",
+            (unsigned long long) srv.stats.batches.load(), 100.0f * srv.batch_occupancy(), srv.queue_delay_ms());
+    fprintf(stderr, "[Server] Cut %llu of %llu decodes at a repetition loop\n",
+            (unsigned long long) srv.stats.runaway_chunks.load(), (unsigned long long) srv.stats.decoded_chunks.load());
+    return 0;
+}
+
+void wb_server_stop(void) {
+    g_stop.store(true, std::memory_order_relaxed);
+
+    // shutdown(2) wakes the blocked accept4 and is async-signal-safe
+    const int fd = g_listen_fd.load(std::memory_order_acquire);
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
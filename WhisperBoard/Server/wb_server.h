@@ -0,0 +1,48 @@
+//
+//  wb_server.h
+//  WhisperBoard
+//
+//  Linux transcription server: many concurrent sessions over a Unix domain socket
+//  One shared whisper_context, one whisper_state per session, encoder passes
+//  batched across sessions, a fixed pool of decoder workers. Frames are the
+//  binary IPC messages from Native/wb_wire.h.
+//
+
+#ifndef wb_server_h
+#define wb_server_h
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct wb_server_options {
+    const char * model_path;
+    const char * socket_path;
+    const char * language;            // NULL = "en"
+    int          workers;             // decoder workers (0 = cores / threads_per_session)
+    int          threads_per_session; // whisper.cpp threads per decoder
+    int          max_sessions;        // live sessions (each holds a whisper_state)
+    int          max_pending_chunks;  // queued chunks per session before reading that connection pauses
+    int          batch_size;          // sessions per encoder batch
+    int          batch_window_ms;     // longest a ready session waits for its batch to fill
+    int          encoder_threads;     // mel and encoder threads, leased from the shared pool (0 = cores)
+    int          final_beam_size;     // beams for each session's last chunk (<= 1 = greedy like the rest)
+    bool         use_gpu;
+} wb_server_options;
+
+wb_server_options wb_server_default_options(void);
+
+// Load the model, listen on `socket_path` and serve until wb_server_stop.
+// Returns 0 on a clean stop or -errno.
+int wb_server_run(const wb_server_options * options);
+
+// Async-signal-safe: ask a running server to stop (sessions in flight are cancelled)
+void wb_server_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* wb_server_h */
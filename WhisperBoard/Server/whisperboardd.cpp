@@ -0,0 +1,106 @@
+//
+//  whisperboardd.cpp
+//  WhisperBoard
+//
+//  Linux daemon entry point: option parsing and signal handling around wb_server_run
+//
+
+#include "wb_server.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+void usage(const char * program) {
+    fprintf(stderr,
+            "usage: %s -m MODEL [-s SOCKET] [-l LANG] [-w WORKERS] [-t THREADS] [-n MAX_SESSIONS] [-q MAX_PENDING]\n"
+            "          [-b BATCH] [--batch-window MS] [--encoder-threads N] [--final-beam N] [--gpu]\n"
+            "  -m, --model         ggml model file (e.g. ggml-small-q5_1.bin)\n"
+            "  -s, --socket        Unix socket path (default /run/whisperboard/whisperboard.sock)\n"
+            "  -l, --language      spoken language (default en)\n"
+            "  -w, --workers       decoder workers (default cores / threads)\n"
+            "  -t, --threads       whisper.cpp threads per decoder (default 2)\n"
+            "  -n, --max-sessions  live sessions, each holding a whisper_state (default 16)\n"
+            "  -q, --max-pending   chunks queued per session before reading pauses (default 8)\n"
+            "  -b, --batch         sessions per encoder batch (default 4)\n"
+            "      --batch-window  ms a ready session waits for its batch to fill (default 15)\n"
+            "      --encoder-threads  threads for mel + encoder passes (default cores)\n"
+            "      --final-beam    beams for each session's last chunk, 1 = greedy (default 5)\n"
+            "      --gpu           run the model on the GPU backend if available\n",
+            program);
+}
+
+void handle_signal(int) {
+    wb_server_stop();
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    wb_server_options options = wb_server_default_options();
+
+    for (int i = 1; i < argc; ++i) {
+        const char * arg   = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto is = [arg](const char * short_name, const char * long_name) {
+            return strcmp(arg, short_name) == 0 || strcmp(arg, long_name) == 0;
+        };
+
+        if (strcmp(arg, "--gpu") == 0) {
+            options.use_gpu = true;
+            continue;
+        }
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (value == nullptr) {
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (is("-m", "--model")) {
+            options.model_path = value;
+        } else if (is("-s", "--socket")) {
+            options.socket_path = value;
+        } else if (is("-l", "--language")) {
+            options.language = value;
+        } else if (is("-w", "--workers")) {
+            options.workers = atoi(value);
+        } else if (is("-t", "--threads")) {
+            options.threads_per_session = atoi(value);
+        } else if (is("-n", "--max-sessions")) {
+            options.max_sessions = atoi(value);
+        } else if (is("-q", "--max-pending")) {
+            options.max_pending_chunks = atoi(value);
+        } else if (is("-b", "--batch")) {
+            options.batch_size = atoi(value);
+        } else if (strcmp(arg, "--batch-window") == 0) {
+            options.batch_window_ms = atoi(value);
+        } else if (strcmp(arg, "--encoder-threads") == 0) {
+            options.encoder_threads = atoi(value);
+        } else if (strcmp(arg, "--final-beam") == 0) {
+            options.final_beam_size = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    if (options.model_path == nullptr) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    return wb_server_run(&options) == 0 ? 0 : 1;
+}
@@ -47,17 +47,40 @@ enum AppGroups {
         /// Current audio chunk being processed
         static let currentAudioChunk = "current_audio.pcm"
 
-        /// Latest transcription result
-        static let latestTranscription = "latest_transcription.json"
-
         /// Control signal file (START, STOP, CANCEL)
         static let controlSignal = "control_signal.json"
 
         /// Shared settings
         static let sharedSettings = "settings.json"
 
-        /// Status file for app state
-        static let statusFile = "status.json"
+        /// Shared-memory file holding the latest transcription and app status (see SharedState)
+        static let sharedState = "shared_state.bin"
+    }
+
+    /// Native directory indexes, one per shared directory (opened lazily)
+    private static var indexes: [URL: ContainerIndex] = [:]
+    private static let indexLock = NSLock()
+
+    /// Get the cached index for a shared directory
+    /// Use this instead of contentsOfDirectory + per-file attribute lookups
+    static func index(for directory: URL?) -> ContainerIndex? {
+        guard let directory = directory else {
+            return nil
+        }
+
+        indexLock.lock()
+        defer { indexLock.unlock() }
+
+        if let index = indexes[directory] {
+            return index
+        }
+
+        guard let index = ContainerIndex(directory: directory) else {
+            return nil
+        }
+
+        indexes[directory] = index
+        return index
     }
 
     /// Initialize shared container directories
@@ -146,6 +169,11 @@ enum AppGroups {
             throw AppGroupsError.invalidDirectory
         }
 
+        if let index = index(for: directory) {
+            try index.delete(fileName)
+            return
+        }
+
         let fileURL = directory.appendingPathComponent(fileName)
 
         if FileManager.default.fileExists(atPath: fileURL.path) {
@@ -0,0 +1,167 @@
+//
+//  ContainerIndex.swift
+//  WhisperBoard
+//
+//  Swift wrapper around the native directory index (Native/wb_dir_index)
+//  Replaces contentsOfDirectory + per-file stat scans of the shared container
+//  Results are copied out a page at a time through one reused buffer
+//
+
+import Foundation
+
+/// Cached listing of one App Groups directory, kept current from change notifications
+final class ContainerIndex {
+
+    /// Indexed file snapshot
+    struct Entry {
+        let name: String
+        let modificationDate: Date
+        let size: Int64
+        /// Position in the change order; pass it to `changes(since:)` to resume after this entry
+        let sequence: UInt64
+    }
+
+    // MARK: - Properties
+
+    /// Directory this index covers
+    let directory: URL
+
+    private let handle: OpaquePointer
+
+    /// Entries per native call; the buffer is shared by every query on this index
+    private static let pageSize = 64
+    private var page = [wb_dir_entry](repeating: wb_dir_entry(), count: ContainerIndex.pageSize)
+    private let lock = NSLock()
+
+    // MARK: - Initialization
+
+    init?(directory: URL) {
+        guard let handle = wb_dir_index_open(directory.path) else {
+            return nil
+        }
+        self.directory = directory
+        self.handle = handle
+    }
+
+    deinit {
+        wb_dir_index_free(handle)
+    }
+
+    // MARK: - Queries
+
+    /// Files matching the filter, oldest modification first
+    /// Cost is independent of how many files sit in the directory when nothing changed
+    func entries(
+        prefix: String? = nil,
+        suffix: String? = nil,
+        containing: String? = nil,
+        olderThan cutoff: Date? = nil
+    ) -> [Entry] {
+        withFilter(prefix: prefix, suffix: suffix, containing: containing, olderThan: cutoff) { filter in
+            var cursor = wb_dir_cursor()
+            return collect { buffer, capacity in
+                wb_dir_index_query(handle, &filter, &cursor, buffer, capacity)
+            }
+        }
+    }
+
+    /// Files matching the filter that were added or rewritten after `since`, in that order
+    /// `since` moves past everything examined, so polling with it only costs the new entries
+    func changes(
+        prefix: String? = nil,
+        suffix: String? = nil,
+        containing: String? = nil,
+        since: inout UInt64
+    ) -> [Entry] {
+        var position = since
+        defer { since = position }
+
+        return withFilter(prefix: prefix, suffix: suffix, containing: containing, olderThan: nil) { filter in
+            collect { buffer, capacity in
+                wb_dir_index_changes(handle, &filter, &position, buffer, capacity)
+            }
+        }
+    }
+
+    /// URL of an indexed file
+    func url(for name: String) -> URL {
+        directory.appendingPathComponent(name)
+    }
+
+    // MARK: - Mutation
+
+    /// Delete a file and drop it from the index
+    @discardableResult
+    func remove(_ name: String) -> Bool {
+        wb_dir_index_remove(handle, name) == 0
+    }
+
+    /// Delete a file and drop it from the index; throws if it is still there
+    func delete(_ name: String) throws {
+        let rc = wb_dir_index_remove(handle, name)
+        if rc != 0 && rc != -ENOENT {
+            throw POSIXError(POSIXErrorCode(rawValue: -rc) ?? .EIO)
+        }
+    }
+
+    /// Re-stat a file this process just wrote, without waiting for the change notification
+    func noteChanged(_ name: String) {
+        wb_dir_index_note_changed(handle, name)
+    }
+
+    // MARK: - Private
+
+    private func withFilter<R>(
+        prefix: String?,
+        suffix: String?,
+        containing: String?,
+        olderThan cutoff: Date?,
+        _ body: (inout wb_dir_filter) -> R
+    ) -> R {
+        var filter = wb_dir_filter()
+        filter.older_than_ns = cutoff.map { Int64($0.timeIntervalSince1970 * 1_000_000_000) } ?? 0
+
+        return withOptionalCString(prefix) { prefixPtr in
+            withOptionalCString(suffix) { suffixPtr in
+                withOptionalCString(containing) { containsPtr in
+                    filter.prefix = prefixPtr
+                    filter.suffix = suffixPtr
+                    filter.contains = containsPtr
+                    return body(&filter)
+                }
+            }
+        }
+    }
+
+    /// Call `fetch` a page at a time until it returns a short page
+    private func collect(_ fetch: (UnsafeMutablePointer<wb_dir_entry>, Int) -> Int) -> [Entry] {
+        lock.lock()
+        defer { lock.unlock() }
+
+        var entries: [Entry] = []
+        page.withUnsafeMutableBufferPointer { buffer in
+            while true {
+                let count = fetch(buffer.baseAddress!, buffer.count)
+                for raw in buffer.prefix(count) {
+                    entries.append(Entry(
+                        name: withUnsafeBytes(of: raw.name) { String(cString: $0.bindMemory(to: CChar.self).baseAddress!) },
+                        modificationDate: Date(timeIntervalSince1970: Double(raw.mtime_ns) / 1_000_000_000),
+                        size: raw.size,
+                        sequence: raw.seq
+                    ))
+                }
+                if count < buffer.count {
+                    return
+                }
+            }
+        }
+        return entries
+    }
+
+    private func withOptionalCString<R>(_ string: String?, _ body: (UnsafePointer<CChar>?) -> R) -> R {
+        guard let string = string else {
+            return body(nil)
+        }
+        return string.withCString { body($0) }
+    }
+}
@@ -81,6 +81,16 @@ struct TranscriptionResult: Codable {
         self.sessionId = sessionId
         self.processingTimeMs = processingTimeMs
     }
+
+    /// Rebuild a result received through shared memory (keeps the original timestamp)
+    init(text: String, isFinal: Bool, confidence: Double?, timestamp: Date, sessionId: String, processingTimeMs: Int) {
+        self.text = text
+        self.isFinal = isFinal
+        self.confidence = confidence
+        self.timestamp = timestamp
+        self.sessionId = sessionId
+        self.processingTimeMs = processingTimeMs
+    }
 }
 
 /// Streaming token update (for real-time display)
@@ -88,12 +98,14 @@ struct TokenUpdate: Codable {
     let tokens: [String]
     let text: String            // Decoded text so far
     let sessionId: String
+    let isTentative: Bool       // Speculative early decode, replaced by the chunk's real result
     let timestamp: Date
 
-    init(tokens: [String], text: String, sessionId: String) {
+    init(tokens: [String], text: String, sessionId: String, isTentative: Bool = false) {
         self.tokens = tokens
         self.text = text
         self.sessionId = sessionId
+        self.isTentative = isTentative
         self.timestamp = Date()
     }
 }
@@ -117,6 +129,16 @@ struct AppStatus: Codable {
         self.memoryUsageMB = memoryUsageMB
         self.lastUpdateTime = Date()
     }
+
+    /// Rebuild a status received through shared memory (keeps the original update time)
+    init(isModelLoaded: Bool, isProcessing: Bool, currentSessionId: String?, modelVariant: String, memoryUsageMB: Int, lastUpdateTime: Date) {
+        self.isModelLoaded = isModelLoaded
+        self.isProcessing = isProcessing
+        self.currentSessionId = currentSessionId
+        self.modelVariant = modelVariant
+        self.memoryUsageMB = memoryUsageMB
+        self.lastUpdateTime = lastUpdateTime
+    }
 }
 
 /// Error message from main app to keyboard extension
@@ -334,7 +356,7 @@ extension WhisperBoardSettings: Validatable {
 }
 
 /// Validate audio data size
-func validateAudioDataSize(_ data: Data, metadata: AudioChunkMetadata) throws {
+func validateAudioDataSize(_ byteCount: Int, metadata: AudioChunkMetadata) throws {
     // Calculate expected size
     let expectedSamples = Int(metadata.duration * Double(metadata.sampleRate))
     let bytesPerSample: Int
@@ -347,7 +369,7 @@ func validateAudioDataSize(_ data: Data, metadata: AudioChunkMetadata) throws {
     }
 
     let expectedSize = expectedSamples * bytesPerSample * metadata.channels
-    let actualSize = data.count
+    let actualSize = byteCount
 
     // Allow 10% tolerance for rounding
     let tolerance = Int(Double(expectedSize) * 0.1)
@@ -0,0 +1,199 @@
+//
+//  SharedState.swift
+//  WhisperBoard
+//
+//  Swift wrapper around the native seqlock records (Native/wb_shared_state)
+//  Replaces latest_transcription.json and status.json polling, and carries
+//  the chunk credits used for keyboard → app backpressure
+//
+
+import Foundation
+
+/// Latest TranscriptionResult and AppStatus, published through shared memory
+final class SharedState {
+
+    // MARK: - Properties
+
+    /// Process-wide mapping of the shared state file (nil if App Groups is unavailable)
+    static let shared: SharedState? = {
+        guard let url = AppGroups.Paths.control?.appendingPathComponent(AppGroups.Files.sharedState) else {
+            return nil
+        }
+        return SharedState(url: url)
+    }()
+
+    private let handle: OpaquePointer
+
+    // MARK: - Initialization
+
+    init?(url: URL) {
+        guard let handle = wb_shared_state_open(url.path) else {
+            return nil
+        }
+        self.handle = handle
+    }
+
+    deinit {
+        wb_shared_state_close(handle)
+    }
+
+    // MARK: - Publishing (main app)
+
+    /// Publish a transcription result; returns its generation
+    @discardableResult
+    func publish(_ result: TranscriptionResult) -> UInt64 {
+        var record = wb_transcription_record()
+        record.timestamp_ms = Int64(result.timestamp.timeIntervalSince1970 * 1000)
+        record.processing_time_ms = Int32(clamping: result.processingTimeMs)
+        record.confidence = result.confidence.map { Float($0) } ?? -1
+        record.is_final = result.isFinal ? 1 : 0
+        copyCString(result.sessionId, into: &record.session_id)
+
+        var text = result.text
+        return text.withUTF8 { utf8 in
+            utf8.withMemoryRebound(to: CChar.self) { chars in
+                wb_shared_state_publish_transcription(handle, &record, chars.baseAddress, chars.count)
+            }
+        }
+    }
+
+    /// Publish app status; returns its generation
+    @discardableResult
+    func publish(_ status: AppStatus) -> UInt64 {
+        var record = wb_status_record()
+        record.last_update_ms = Int64(status.lastUpdateTime.timeIntervalSince1970 * 1000)
+        record.memory_usage_mb = Int32(clamping: status.memoryUsageMB)
+        record.is_model_loaded = status.isModelLoaded ? 1 : 0
+        record.is_processing = status.isProcessing ? 1 : 0
+        record.has_session = status.currentSessionId != nil ? 1 : 0
+        copyCString(status.currentSessionId ?? "", into: &record.current_session_id)
+        copyCString(status.modelVariant, into: &record.model_variant)
+
+        return wb_shared_state_publish_status(handle, &record)
+    }
+
+    // MARK: - Reading (keyboard extension)
+
+    /// Current transcription generation (cheap; no copy)
+    var transcriptionGeneration: UInt64 {
+        wb_shared_state_transcription_generation(handle)
+    }
+
+    /// Latest transcription result if it is newer than `generation`
+    func latestTranscription(newerThan generation: UInt64) -> (result: TranscriptionResult, generation: UInt64)? {
+        guard wb_shared_state_transcription_generation(handle) > generation else {
+            return nil
+        }
+
+        var record = wb_transcription_record()
+        var text = [CChar](repeating: 0, count: Int(WB_SHARED_TEXT_MAX))
+
+        guard wb_shared_state_read_transcription(handle, &record, &text, text.count) == 1 else {
+            return nil
+        }
+
+        let result = TranscriptionResult(
+            text: String(cString: text),
+            isFinal: record.is_final != 0,
+            confidence: record.confidence >= 0 ? Double(record.confidence) : nil,
+            timestamp: Date(timeIntervalSince1970: Double(record.timestamp_ms) / 1000),
+            sessionId: string(from: &record.session_id),
+            processingTimeMs: Int(record.processing_time_ms)
+        )
+
+        return (result, record.generation)
+    }
+
+    /// Latest published app status (nil if the app never published one)
+    func status() -> AppStatus? {
+        var record = wb_status_record()
+
+        guard wb_shared_state_read_status(handle, &record) == 1 else {
+            return nil
+        }
+
+        return AppStatus(
+            isModelLoaded: record.is_model_loaded != 0,
+            isProcessing: record.is_processing != 0,
+            currentSessionId: record.has_session != 0 ? string(from: &record.current_session_id) : nil,
+            modelVariant: string(from: &record.model_variant),
+            memoryUsageMB: Int(record.memory_usage_mb),
+            lastUpdateTime: Date(timeIntervalSince1970: Double(record.last_update_ms) / 1000)
+        )
+    }
+
+    // MARK: - Flow Control
+
+    /// Credit view shared by both sides
+    struct Flow {
+        let capacity: Int
+        let inFlight: Int
+        let credits: Int
+        let lagMs: Int
+        let heartbeat: Date?
+    }
+
+    /// Advertise chunk capacity and inference lag (main app; also a heartbeat)
+    func advertiseFlow(capacity: Int, lagMs: Int) {
+        wb_shared_state_flow_advertise(handle, UInt32(clamping: capacity), UInt32(clamping: lagMs))
+    }
+
+    /// Return credits for chunks that were transcribed or discarded (main app)
+    func consumed(chunks: Int = 1, lagMs: Int) {
+        wb_shared_state_flow_consumed(handle, UInt32(clamping: chunks), UInt32(clamping: lagMs))
+    }
+
+    /// Forget every chunk in flight after dropping the whole backlog (main app)
+    func resyncFlow() {
+        wb_shared_state_flow_resync(handle)
+    }
+
+    /// Advertise after the app (re)starts (main app). With no chunk pending, whatever is still
+    /// counted in flight was sent to a run that died before returning its credits: forget it.
+    func restartFlow(capacity: Int, lagMs: Int, pendingChunks: Int) {
+        if pendingChunks == 0 {
+            resyncFlow()
+        }
+        advertiseFlow(capacity: capacity, lagMs: lagMs)
+    }
+
+    /// Take a credit before sending a chunk (keyboard extension)
+    func acquireCredit(force: Bool = false) -> Bool {
+        wb_shared_state_flow_acquire(handle, force ? 1 : 0) == 1
+    }
+
+    /// Give back a credit taken for a chunk that could not be sent (keyboard extension)
+    func cancelCredit() {
+        wb_shared_state_flow_cancel(handle)
+    }
+
+    /// Current credit state
+    func flow() -> Flow {
+        var snapshot = wb_flow_snapshot()
+        wb_shared_state_flow_read(handle, &snapshot)
+
+        return Flow(
+            capacity: Int(snapshot.capacity),
+            inFlight: Int(snapshot.in_flight),
+            credits: Int(snapshot.credits),
+            lagMs: Int(snapshot.lag_ms),
+            heartbeat: snapshot.heartbeat_ms > 0 ? Date(timeIntervalSince1970: Double(snapshot.heartbeat_ms) / 1000) : nil
+        )
+    }
+
+    // MARK: - Private
+
+    private func copyCString<T>(_ string: String, into field: inout T) {
+        withUnsafeMutableBytes(of: &field) { buffer in
+            let utf8 = Array(string.utf8.prefix(buffer.count - 1))
+            buffer.copyBytes(from: utf8)
+            buffer[utf8.count] = 0
+        }
+    }
+
+    private func string<T>(from field: inout T) -> String {
+        withUnsafeBytes(of: &field) { buffer in
+            String(cString: buffer.bindMemory(to: CChar.self).baseAddress!)
+        }
+    }
+}
@@ -0,0 +1,118 @@
+//
+//  TokenJournal.swift
+//  WhisperBoard
+//
+//  Swift wrappers around the native session journal (Native/wb_journal)
+//  One append-only file per session replaces the token_update_<ms>.json files
+//
+
+import Foundation
+
+/// Per-session streaming journal in the Transcriptions directory
+enum TokenJournal {
+
+    /// Record types (mirror wb_journal_record_type)
+    enum RecordType: UInt32 {
+        case tokenUpdate = 1
+        case transcriptionResult = 2
+    }
+
+    /// Journal file name for a session
+    static func fileName(for sessionId: String) -> String {
+        "journal_\(sessionId).wbj"
+    }
+
+    /// Journal URL for a session
+    static func url(for sessionId: String) -> URL? {
+        AppGroups.Paths.transcriptions?.appendingPathComponent(fileName(for: sessionId))
+    }
+
+    /// Keep only the newest record of each type (call at session end)
+    @discardableResult
+    static func compact(sessionId: String) -> Int64 {
+        guard let url = url(for: sessionId) else { return 0 }
+        return wb_journal_compact(url.path)
+    }
+}
+
+/// Producer side of a session journal (main app)
+final class JournalWriter {
+
+    let sessionId: String
+    private let handle: OpaquePointer
+
+    init?(sessionId: String) {
+        guard let url = TokenJournal.url(for: sessionId),
+              let handle = wb_journal_writer_open(url.path) else {
+            return nil
+        }
+        self.sessionId = sessionId
+        self.handle = handle
+    }
+
+    deinit {
+        wb_journal_writer_close(handle)
+    }
+
+    /// Append one record; a single write(2). Returns the sequence number.
+    @discardableResult
+    func append(_ payload: Data, type: TokenJournal.RecordType) throws -> Int64 {
+        let seq = payload.withUnsafeBytes { buffer in
+            wb_journal_append(handle, type.rawValue, buffer.baseAddress, buffer.count)
+        }
+
+        guard seq >= 0 else {
+            throw AppGroupsError.writeFailed
+        }
+
+        return seq
+    }
+}
+
+/// Consumer side of a session journal (keyboard extension)
+final class JournalReader {
+
+    /// Record view; `payload` aliases the reader's mapping and is only valid inside the callback
+    struct Record {
+        let seq: UInt64
+        let type: TokenJournal.RecordType?
+        let payload: Data
+    }
+
+    let sessionId: String
+    private let handle: OpaquePointer
+
+    init?(sessionId: String) {
+        guard let url = TokenJournal.url(for: sessionId),
+              let handle = wb_journal_reader_open(url.path) else {
+            return nil
+        }
+        self.sessionId = sessionId
+        self.handle = handle
+    }
+
+    deinit {
+        wb_journal_reader_close(handle)
+    }
+
+    /// Sequence number of the last record delivered
+    var lastSeq: UInt64 {
+        wb_journal_reader_last_seq(handle)
+    }
+
+    /// Deliver every record appended since the last call
+    func readNewRecords(_ body: (Record) throws -> Void) rethrows {
+        var raw = wb_journal_record()
+
+        while wb_journal_reader_next(handle, &raw) > 0 {
+            let payload: Data
+            if let base = raw.payload, raw.length > 0 {
+                payload = Data(bytesNoCopy: UnsafeMutableRawPointer(mutating: base), count: Int(raw.length), deallocator: .none)
+            } else {
+                payload = Data()
+            }
+
+            try body(Record(seq: raw.seq, type: TokenJournal.RecordType(rawValue: raw.type), payload: payload))
+        }
+    }
+}
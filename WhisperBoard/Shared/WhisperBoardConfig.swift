@@ -54,6 +54,15 @@ struct WhisperBoardConfig {
 
         /// Status update interval (1 second)
         static let statusUpdateIntervalSeconds: TimeInterval = 1.0
+
+        /// Chunks the keyboard may have in flight before it waits for credits
+        static let flowCapacityChunks = 8
+
+        /// Inference lag at which the keyboard downgrades held-back audio to pcm16 (1 second)
+        static let flowDowngradeLagMs = 1000
+
+        /// Maximum audio the keyboard holds back while out of credits (one chunk's validation limit)
+        static let flowMaxPendingSeconds: TimeInterval = 10.0
     }
 
     // MARK: - UI Configuration
@@ -95,6 +104,56 @@ struct WhisperBoardConfig {
 
         /// Maximum processing time allowed (60 seconds)
         static let maxProcessingTimeMs = 60_000
+
+        /// Chunks quieter than this RMS skip mel + inference (about -54 dBFS)
+        static let vadRmsThreshold: Float = 0.002
+
+        /// Token budget for the speculative decode at speech onset (tentative text)
+        static let speculativeMaxTokens: Int = 8
+
+        /// Speech the speculative decode covers from the onset; shorter chunks (unbatched 200 ms ones) skip it
+        static let speculativeWindowMs: Int = 1000
+
+        /// Results a session buffers before the pipeline waits for the app to catch up
+        static let sessionResultCapacity: Int = 4
+    }
+
+    // MARK: - Scheduling
+
+    struct Scheduler {
+        /// Latency budget of a live chunk (submit → result); orders live work on the shared pool
+        static let liveDeadlineMs: Int = 500
+
+        /// Longest a status update waits for a gap in live work
+        static let statusMaxDelaySeconds: TimeInterval = 0.25
+
+        /// Files a cleanup scan removes between checkpoints
+        static let maintenanceStepFiles = 32
+    }
+
+    // MARK: - Two-Pass Refinement
+
+    struct Refine {
+        /// Stream with the tiny model and re-decode finished speech with the main model
+        static let enabled = true
+
+        /// Peak memory both models may reach together (MB); over it the app stays single-model
+        static let memoryBudgetMB = 640
+
+        /// Memory to leave free after loading the tiny model (MB)
+        static let memoryHeadroomMB = 100
+
+        /// Refine at least this often while speech continues without a pause
+        static let maxSpanSeconds: Double = 30
+
+        /// Beams for the final pass of a session (1 = greedy like the tentative passes)
+        static let finalBeamSize = 5
+
+        /// Final pass stops once finalBeamSize * beamPatience hypotheses have ended
+        static let beamPatience: Float = 1.0
+
+        /// Drafts at or above this confidence (0-1) are kept without a main-model pass
+        static let skipConfidence = 0.9
     }
 
     // MARK: - Memory Configuration
@@ -0,0 +1,219 @@
+//
+//  IPCPipeTests.swift
+//  KeyboardExtensionTests
+//
+//  Keyboard-side backpressure against a consumer that stalls or runs slow:
+//  chunks in flight never exceed the app's credits, held-back audio stays
+//  within the hold-back limit, and failed sends neither lose credits nor audio.
+//  A relaunched app returns the credits of chunks a crashed run never finished.
+//  Uses a private shared state file and chunk directory instead of App Groups.
+//
+
+import XCTest
+
+final class IPCPipeTests: XCTestCase {
+
+    private var directory: URL!
+    private var audioDirectory: URL!
+    private var sharedState: SharedState!
+    private let sessionId = UUID().uuidString
+
+    private let chunkSeconds: TimeInterval = 0.2
+    private let sampleRate = 16000
+
+    override func setUpWithError() throws {
+        directory = FileManager.default.temporaryDirectory
+            .appendingPathComponent("IPCPipeTests-\(UUID().uuidString)")
+        audioDirectory = directory.appendingPathComponent("AudioBuffers", isDirectory: true)
+        try FileManager.default.createDirectory(at: audioDirectory, withIntermediateDirectories: true)
+        sharedState = try XCTUnwrap(SharedState(url: directory.appendingPathComponent("shared_state")))
+    }
+
+    override func tearDownWithError() throws {
+        sharedState = nil
+        try? FileManager.default.removeItem(at: directory)
+    }
+
+    // MARK: - Helpers
+
+    private func makePipe() -> IPCPipe {
+        let pipe = IPCPipe(sharedState: sharedState, audioBuffersDirectory: audioDirectory)
+        pipe.sendControlSignal(.start, sessionId: sessionId)
+        return pipe
+    }
+
+    /// One captured chunk, as AudioCapture produces it
+    private func submitChunk(to pipe: IPCPipe, index: Int) {
+        let samples = [Float](repeating: 0.25, count: Int(chunkSeconds * Double(sampleRate)))
+        let data = samples.withUnsafeBufferPointer { Data(buffer: $0) }
+        let metadata = AudioChunkMetadata(
+            chunkId: index,
+            sampleRate: sampleRate,
+            channels: 1,
+            format: .float32,
+            duration: chunkSeconds,
+            timestamp: Date(),
+            sessionId: sessionId,
+            isLastChunk: false
+        )
+        pipe.submitAudioChunk(data, metadata: metadata)
+    }
+
+    /// Chunk messages written so far, by chunk id
+    private func sentChunks() throws -> [AudioChunkMessage] {
+        try FileManager.default.contentsOfDirectory(at: audioDirectory, includingPropertiesForKeys: nil)
+            .filter { $0.pathExtension == "json" }
+            .map { try Data(contentsOf: $0).decode(as: AudioChunkMessage.self) }
+            .sorted { $0.metadata.chunkId < $1.metadata.chunkId }
+    }
+
+    /// The app's side: take every chunk written so far and return its credit
+    /// (or not, as when the app dies with the chunks in inference)
+    private func consumeSentChunks(returnCredits: Bool = true) throws -> Int {
+        let files = try FileManager.default.contentsOfDirectory(at: audioDirectory, includingPropertiesForKeys: nil)
+            .filter { $0.pathExtension == "json" }
+        for file in files {
+            let message = try Data(contentsOf: file).decode(as: AudioChunkMessage.self)
+            try FileManager.default.removeItem(at: file)
+            try? FileManager.default.removeItem(at: audioDirectory.appendingPathComponent(message.pcmFileName))
+        }
+        if returnCredits && !files.isEmpty {
+            sharedState.consumed(chunks: files.count, lagMs: 0)
+        }
+        return files.count
+    }
+
+    private var holdBackLimitBytes: Int {
+        Int(WhisperBoardConfig.IPC.flowMaxPendingSeconds * Double(sampleRate)) * MemoryLayout<Float>.size
+    }
+
+    // MARK: - Tests
+
+    func testStalledConsumerKeepsMemoryBounded() throws {
+        let capacity = 2
+        sharedState.advertiseFlow(capacity: capacity, lagMs: 0)
+        let pipe = makePipe()
+
+        // A minute of audio with the app never taking a chunk
+        for index in 0..<300 {
+            submitChunk(to: pipe, index: index)
+
+            let snapshot = pipe.flowSnapshot()
+            XCTAssertLessThanOrEqual(snapshot.heldBackBytes, holdBackLimitBytes)
+            XCTAssertLessThanOrEqual(snapshot.heldBackSeconds, WhisperBoardConfig.IPC.flowMaxPendingSeconds + 1e-6)
+            XCTAssertLessThanOrEqual(sharedState.flow().inFlight, capacity)
+        }
+
+        let stalled = pipe.flowSnapshot()
+        XCTAssertEqual(stalled.chunksSent, capacity)
+        XCTAssertEqual(try sentChunks().count, capacity)
+        XCTAssertEqual(stalled.state, .overloaded)
+
+        // The app catches up: the held-back audio goes out as one chunk within the limit
+        XCTAssertEqual(try consumeSentChunks(), capacity)
+        pipe.checkForCredits()
+
+        let resumed = pipe.flowSnapshot()
+        XCTAssertEqual(resumed.chunksSent, capacity + 1)
+        XCTAssertEqual(resumed.heldBackBytes, 0)
+        let batch = try XCTUnwrap(try sentChunks().last)
+        XCTAssertEqual(batch.metadata.chunkId, capacity)
+        XCTAssertLessThanOrEqual(batch.metadata.duration, WhisperBoardConfig.IPC.flowMaxPendingSeconds + 1e-6)
+        XCTAssertNoThrow(try batch.metadata.validate())
+    }
+
+    func testSlowConsumerNeverExceedsCredits() throws {
+        let capacity = 4
+        sharedState.advertiseFlow(capacity: capacity, lagMs: 0)
+        let pipe = makePipe()
+
+        // The app takes one chunk for every three the keyboard captures
+        var consumed = 0
+        for index in 0..<600 {
+            submitChunk(to: pipe, index: index)
+            if index % 3 == 0 {
+                consumed += try consumeSentChunks()
+                pipe.checkForCredits()
+            }
+
+            let snapshot = pipe.flowSnapshot()
+            XCTAssertLessThanOrEqual(snapshot.heldBackBytes, holdBackLimitBytes)
+            XCTAssertLessThanOrEqual(sharedState.flow().inFlight, capacity)
+        }
+
+        // Nothing lost or duplicated: chunk ids stay contiguous
+        let sent = pipe.flowSnapshot().chunksSent
+        let remaining = try sentChunks()
+        XCTAssertEqual(consumed + remaining.count, sent)
+        XCTAssertEqual(remaining.map(\.metadata.chunkId), Array((sent - remaining.count)..<sent))
+    }
+
+    func testFailedSendReturnsCreditAndRetries() throws {
+        sharedState.advertiseFlow(capacity: 2, lagMs: 0)
+        try FileManager.default.removeItem(at: audioDirectory)
+        let pipe = makePipe()
+
+        // Every write fails while the directory is missing
+        for index in 0..<5 {
+            submitChunk(to: pipe, index: index)
+        }
+        let failing = pipe.flowSnapshot()
+        XCTAssertEqual(failing.chunksSent, 0)
+        XCTAssertEqual(sharedState.flow().inFlight, 0)
+        XCTAssertEqual(sharedState.flow().credits, 2)
+        XCTAssertEqual(failing.heldBackSeconds, 5 * chunkSeconds, accuracy: 1e-6)
+
+        // Once writes work again the kept batch goes out under chunk id 0
+        try FileManager.default.createDirectory(at: audioDirectory, withIntermediateDirectories: true)
+        pipe.checkForCredits()
+
+        XCTAssertEqual(pipe.flowSnapshot().chunksSent, 1)
+        XCTAssertEqual(sharedState.flow().inFlight, 1)
+        let chunk = try XCTUnwrap(try sentChunks().first)
+        XCTAssertEqual(chunk.metadata.chunkId, 0)
+        XCTAssertEqual(chunk.metadata.duration, 5 * chunkSeconds, accuracy: 1e-6)
+    }
+
+    func testRelaunchedAppForgetsCreditsOfCrashedRun() throws {
+        sharedState.advertiseFlow(capacity: 2, lagMs: 0)
+        let pipe = makePipe()
+
+        // The app takes both chunks into inference and dies before returning their credits
+        for index in 0..<2 {
+            submitChunk(to: pipe, index: index)
+        }
+        _ = pipe.flowSnapshot()
+        XCTAssertEqual(try consumeSentChunks(returnCredits: false), 2)
+        submitChunk(to: pipe, index: 2)
+        XCTAssertEqual(pipe.flowSnapshot().chunksSent, 2)
+        XCTAssertEqual(sharedState.flow().inFlight, 2)
+
+        // Relaunched with nothing pending: the keyboard gets its credits back
+        let relaunched = try XCTUnwrap(SharedState(url: directory.appendingPathComponent("shared_state")))
+        relaunched.restartFlow(capacity: 2, lagMs: 0, pendingChunks: try sentChunks().count)
+        XCTAssertEqual(sharedState.flow().inFlight, 0)
+        pipe.checkForCredits()
+        XCTAssertEqual(pipe.flowSnapshot().chunksSent, 3)
+        XCTAssertEqual(sharedState.flow().inFlight, 1)
+
+        // Restarted again with that chunk still on disk: its credit stays taken
+        relaunched.restartFlow(capacity: 2, lagMs: 0, pendingChunks: try sentChunks().count)
+        XCTAssertEqual(sharedState.flow().inFlight, 1)
+    }
+
+    func testStopMarksFinalBatchAsLastChunk() throws {
+        sharedState.advertiseFlow(capacity: 1, lagMs: 0)
+        let pipe = makePipe()
+
+        for index in 0..<3 {
+            submitChunk(to: pipe, index: index)
+        }
+        pipe.sendControlSignal(.stop, sessionId: sessionId)
+        _ = pipe.flowSnapshot()
+
+        let chunks = try sentChunks()
+        XCTAssertEqual(chunks.map(\.metadata.chunkId), [0, 1])
+        XCTAssertEqual(chunks.map(\.metadata.isLastChunk), [false, true])
+        XCTAssertEqual(chunks[1].metadata.duration, 2 * chunkSeconds, accuracy: 1e-6)
+    }
+}
@@ -0,0 +1,76 @@
+//
+//  PCMSamplesTests.swift
+//  WhisperBoardTests
+//
+//  The float32 inference path must not copy chunk samples: PCMSamples hands
+//  the file mapping itself to the pipeline. pcm16 is widened exactly once.
+//
+
+import XCTest
+@testable import WhisperBoard
+
+final class PCMSamplesTests: XCTestCase {
+
+    private var directory: URL!
+
+    override func setUpWithError() throws {
+        directory = FileManager.default.temporaryDirectory
+            .appendingPathComponent("PCMSamplesTests-\(UUID().uuidString)")
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+    }
+
+    override func tearDownWithError() throws {
+        try? FileManager.default.removeItem(at: directory)
+    }
+
+    /// Write `samples` as the keyboard does: raw native-endian float32
+    private func writeFloat32Chunk(_ samples: [Float], name: String) throws -> URL {
+        let url = directory.appendingPathComponent(name)
+        try samples.withUnsafeBufferPointer { Data(buffer: $0) }.write(to: url, options: .atomic)
+        return url
+    }
+
+    private func sine(count: Int) -> [Float] {
+        (0..<count).map { Float(sin(Double($0) * 2 * .pi * 440 / 16000)) * 0.5 }
+    }
+
+    func testFloat32ChunkReachesInferenceWithoutCopies() throws {
+        let expected = sine(count: 16000)
+        let url = try writeFloat32Chunk(expected, name: "chunk_float32.pcm")
+
+        let samples = try XCTUnwrap(PCMSamples(url: url, format: .float32))
+        XCTAssertEqual(samples.copies, 0)
+        XCTAssertEqual(samples.count, expected.count)
+        XCTAssertEqual(samples.byteCount, expected.count * MemoryLayout<Float>.size)
+
+        // AudioProcessor deletes the file once the chunk is handed off; the span stays valid
+        try FileManager.default.removeItem(at: url)
+
+        // The span InferenceEngine submits to the pipeline
+        let span = samples.unsafeSpan
+        let base = try XCTUnwrap(span.baseAddress)
+        XCTAssertEqual(span.count, expected.count)
+        XCTAssertEqual(Array(UnsafeBufferPointer(start: base, count: span.count)), expected)
+
+        // Page-aligned: the pointer is the mapping, not a heap copy of it
+        XCTAssertEqual(Int(bitPattern: base) % Int(getpagesize()), 0)
+        XCTAssertEqual(samples.copies, 0)
+    }
+
+    func testPCM16ChunkIsWidenedOnce() throws {
+        let values: [Int16] = [0, 16384, -16384, 32767, -32768]
+        let url = directory.appendingPathComponent("chunk_pcm16.pcm")
+        try values.withUnsafeBufferPointer { Data(buffer: $0) }.write(to: url, options: .atomic)
+
+        let samples = try XCTUnwrap(PCMSamples(url: url, format: .pcm16))
+        XCTAssertEqual(samples.copies, 1)
+
+        let span = samples.unsafeSpan
+        let widened = Array(UnsafeBufferPointer(start: span.baseAddress, count: span.count))
+        XCTAssertEqual(widened, values.map { Float($0) / 32768 })
+    }
+
+    func testMissingChunkFails() {
+        XCTAssertNil(PCMSamples(url: directory.appendingPathComponent("missing.pcm"), format: .float32))
+    }
+}
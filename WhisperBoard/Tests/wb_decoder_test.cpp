@@ -0,0 +1,171 @@
+//
+//  wb_decoder_test.cpp
+//  WhisperBoard
+//
+//  wb_decoder against whisper_fake: speculative decoding must reproduce greedy
+//  decoding token for token, with whisper.cpp's one-logits-row-per-call decode,
+//  and beam search must only end hypotheses on EOTs that rank among the best.
+//
+
+#include "wb_decoder.h"
+#include "whisper_fake.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+constexpr int k_n_text = 50;
+constexpr int k_prompt = 4;   // sot, language, task, no-timestamps
+
+uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Scores from the last two tokens, EOT once the text reaches `end_after` tokens.
+// `disagree_every` > 0 makes every so many contexts prefer another token (a draft model).
+struct hashed_model {
+    uint32_t seed;
+    int      end_after;
+    int      disagree_every;
+};
+
+void hashed_scores(const whisper_token * history, int n_history, float * logits, void * user_data) {
+    const auto * model = static_cast<const hashed_model *>(user_data);
+    const uint32_t context = mix(model->seed ^ (uint32_t) history[n_history - 1] * 131u ^
+                                 (n_history > 1 ? (uint32_t) history[n_history - 2] * 7919u : 0u));
+    const bool disagree = model->disagree_every > 0 && context % (uint32_t) model->disagree_every == 0;
+
+    for (int t = 0; t < k_n_text; ++t) {
+        logits[t] = (float) (mix(context + (uint32_t) t) % 1000) / 100.0f;
+    }
+    if (disagree) {
+        logits[(context >> 8) % k_n_text] += 20.0f;
+    }
+    logits[k_n_text] = n_history - k_prompt >= model->end_after ? 100.0f : -100.0f;
+}
+
+void test_speculative_matches_greedy() {
+    for (uint32_t seed = 1; seed <= 20; ++seed) {
+        hashed_model target = { seed, 30 + (int) seed, 0 };
+        hashed_model draft  = { seed, 30 + (int) seed, 3 };
+        whisper_context * ctx       = wb_fake_context_create(k_n_text, hashed_scores, &target);
+        whisper_context * draft_ctx = wb_fake_context_create(k_n_text, hashed_scores, &draft);
+        whisper_state *   state       = whisper_init_state(ctx);
+        whisper_state *   draft_state = whisper_init_state(draft_ctx);
+
+        wb_decoder_kv * kv = wb_decoder_kv_create(ctx);
+        wb_decoder_params params = wb_decoder_default_params();
+        params.kv = kv;
+
+        std::vector<int32_t> greedy(256), speculative(256);
+        const int n_greedy = wb_decode_greedy(ctx, state, &params, greedy.data(), (int) greedy.size());
+
+        for (int n_draft = 1; n_draft <= 6; ++n_draft) {
+            wb_decoder_kv_reset(kv);
+            wb_speculative_stats stats = {};
+            const int n_spec = wb_decode_speculative(ctx, state, draft_ctx, draft_state, nullptr, &params, n_draft,
+                                                     speculative.data(), (int) speculative.size(), &stats);
+
+            CHECK(n_greedy == target.end_after);
+            CHECK(n_spec == n_greedy);
+            bool same = n_spec == n_greedy;
+            for (int i = 0; same && i < n_greedy; ++i) {
+                same = greedy[(size_t) i] == speculative[(size_t) i];
+            }
+            CHECK(same);
+            CHECK(stats.accepted <= stats.drafted);
+            CHECK(stats.accepted > 0);
+            CHECK(stats.accepted < stats.drafted);   // the draft disagrees now and then
+        }
+
+        wb_decoder_kv_free(kv);
+        whisper_free_state(state);
+        whisper_free_state(draft_state);
+        whisper_free(ctx);
+        whisper_free(draft_ctx);
+    }
+}
+
+// A sentence of `length` tokens: after each token, one clear next token, three weaker ones
+// and a low-probability EOT, all in every beam's top 5. EOT wins once the sentence is done.
+struct sentence_model {
+    int length;
+};
+
+whisper_token sentence_next(whisper_token last) {
+    return (whisper_token) (((uint32_t) last * 7u + 3u) % (uint32_t) k_n_text);
+}
+
+void sentence_scores(const whisper_token * history, int n_history, float * logits, void * user_data) {
+    const auto * model = static_cast<const sentence_model *>(user_data);
+    for (int t = 0; t <= k_n_text; ++t) {
+        logits[t] = -20.0f;
+    }
+    const whisper_token next = sentence_next(n_history > k_prompt ? history[n_history - 1] : 0);
+    if (n_history - k_prompt >= model->length) {
+        logits[k_n_text] = 10.0f;
+        return;
+    }
+    logits[next] = 10.0f;
+    for (int i = 1; i <= 3; ++i) {
+        logits[(next + i) % k_n_text] = 4.0f;
+    }
+    logits[k_n_text] = 3.0f;
+}
+
+void test_beam_ignores_low_ranked_eot() {
+    sentence_model model = { 24 };
+    whisper_context * ctx   = wb_fake_context_create(k_n_text, sentence_scores, &model);
+    whisper_state *   state = whisper_init_state(ctx);
+
+    wb_decoder_params params = wb_decoder_default_params();
+    wb_beam_params    beam   = wb_beam_default_params();
+    beam.beam_size     = 5;
+    beam.prune_logprob = 0.0f;   // keep the weak beams alive, each with its EOT
+
+    std::vector<int32_t> tokens(256);
+    const int n_tokens = wb_decode_beam(ctx, state, &params, &beam, tokens.data(), (int) tokens.size());
+
+    CHECK(n_tokens == model.length);
+    whisper_token last = 0;
+    bool follows = n_tokens == model.length;
+    for (int i = 0; follows && i < n_tokens; ++i) {
+        last    = sentence_next(last);
+        follows = tokens[(size_t) i] == last;
+    }
+    CHECK(follows);
+
+    whisper_free_state(state);
+    whisper_free(ctx);
+}
+
+} // namespace
+
+int main() {
+    test_speculative_matches_greedy();
+    test_beam_ignores_low_ranked_eot();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_decoder_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_decoder_test: ok\n");
+    return 0;
+}
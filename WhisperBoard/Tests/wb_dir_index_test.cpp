@@ -0,0 +1,151 @@
+//
+//  wb_dir_index_test.cpp
+//  WhisperBoard
+//
+//  wb_dir_index on a scratch directory: queries page through the entries
+//  oldest first from a cursor, age-limited ones stop at the cutoff, and the
+//  change feed returns each added or rewritten file once, in change order.
+//  Removing drops the entry once the file is gone, and keeps it otherwise.
+//
+
+#include "wb_dir_index.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+constexpr int64_t k_second_ns = 1000000000LL;
+
+// Write `name` with `bytes` bytes and an mtime of `mtime_s` seconds
+void put(const std::string & dir, const char * name, int64_t mtime_s, size_t bytes = 1) {
+    const std::string path = dir + "/" + name;
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    const std::string data(bytes, 'x');
+    CHECK(write(fd, data.data(), data.size()) == (ssize_t) data.size());
+    const struct timespec times[2] = { { mtime_s, 0 }, { mtime_s, 0 } };
+    CHECK(futimens(fd, times) == 0);
+    close(fd);
+}
+
+// Every entry a query returns, `page` at a time
+std::vector<std::string> query_all(wb_dir_index * index, const wb_dir_filter * filter, size_t page) {
+    std::vector<std::string> names;
+    std::vector<wb_dir_entry> out(page);
+    wb_dir_cursor cursor = {};
+    for (;;) {
+        const size_t n = wb_dir_index_query(index, filter, &cursor, out.data(), page);
+        for (size_t i = 0; i < n; ++i) {
+            names.push_back(out[i].name);
+        }
+        if (n < page) {
+            return names;
+        }
+    }
+}
+
+std::vector<std::string> changes(wb_dir_index * index, const wb_dir_filter * filter, uint64_t * since) {
+    std::vector<std::string> names;
+    wb_dir_entry out[2];
+    size_t n;
+    while ((n = wb_dir_index_changes(index, filter, since, out, 2)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            names.push_back(out[i].name);
+        }
+    }
+    return names;
+}
+
+using names = std::vector<std::string>;
+
+void test_queries_and_changes(const std::string & dir) {
+    put(dir, "c.json", 300);
+    put(dir, "a.json", 100);
+    put(dir, "b.pcm", 200);
+    put(dir, "d.json", 400);
+    put(dir, ".hidden", 50);
+
+    wb_dir_index * index = wb_dir_index_open(dir.c_str());
+    CHECK(index != nullptr);
+    CHECK(wb_dir_index_count(index) == 4);
+
+    // Oldest first, whatever the page size
+    for (size_t page = 1; page <= 5; ++page) {
+        CHECK(query_all(index, nullptr, page) == (names{ "a.json", "b.pcm", "c.json", "d.json" }));
+    }
+    const wb_dir_filter json = { nullptr, ".json", nullptr, 0 };
+    CHECK(query_all(index, &json, 1) == (names{ "a.json", "c.json", "d.json" }));
+    const wb_dir_filter old = { nullptr, nullptr, nullptr, 250 * k_second_ns };
+    CHECK(query_all(index, &old, 1) == (names{ "a.json", "b.pcm" }));
+
+    // The change feed starts with everything, then returns only what happened since
+    uint64_t since = 0;
+    CHECK(changes(index, &json, &since).size() == 3);
+    CHECK(changes(index, &json, &since).empty());
+
+    put(dir, "e.json", 50);
+    put(dir, "c.json", 500, 10);
+    put(dir, "f.pcm", 600);
+    CHECK(unlink((dir + "/a.json").c_str()) == 0);
+    CHECK(changes(index, &json, &since) == (names{ "e.json", "c.json" }));
+    CHECK(changes(index, &json, &since).empty());
+    CHECK(query_all(index, nullptr, 2) == (names{ "e.json", "b.pcm", "d.json", "c.json", "f.pcm" }));
+
+    // Removed through the index: gone from both orders
+    CHECK(wb_dir_index_remove(index, "d.json") == 0);
+    CHECK(query_all(index, &json, 3) == (names{ "e.json", "c.json" }));
+    CHECK(changes(index, nullptr, &since).empty());   // f.pcm was passed over by the .json feed
+
+    // Already gone: the entry goes too. Not unlinked: it stays (count does not refresh).
+    const size_t indexed = wb_dir_index_count(index);
+    CHECK(unlink((dir + "/e.json").c_str()) == 0);
+    CHECK(wb_dir_index_remove(index, "e.json") == -ENOENT);
+    CHECK(wb_dir_index_count(index) == indexed - 1);
+    CHECK(unlink((dir + "/b.pcm").c_str()) == 0);
+    CHECK(mkdir((dir + "/b.pcm").c_str(), 0755) == 0);
+    const int rc = wb_dir_index_remove(index, "b.pcm");
+    CHECK(rc < 0 && rc != -ENOENT);
+    CHECK(wb_dir_index_count(index) == indexed - 1);
+    CHECK(rmdir((dir + "/b.pcm").c_str()) == 0);
+
+    wb_dir_index_free(index);
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/wb_dir_index_test.XXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    test_queries_and_changes(dir);
+    for (const char * name : { "b.pcm", "c.json", "e.json", "f.pcm", ".hidden" }) {
+        unlink((std::string(dir) + "/" + name).c_str());
+    }
+    rmdir(dir);
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_dir_index_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_dir_index_test: ok\n");
+    return 0;
+}
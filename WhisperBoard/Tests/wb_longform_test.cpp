@@ -0,0 +1,163 @@
+//
+//  wb_longform_test.cpp
+//  WhisperBoard
+//
+//  wb_longform against whisper_fake's vocabulary: plans cut in a silence
+//  without overlap and through speech with one, and the stitcher joins windows
+//  at a shared run of tokens, falls back to the middle of the overlap, and
+//  places tokens after a seek inside a window by their segment's t0.
+//
+
+#include "wb_longform.h"
+#include "wb_vocab.h"
+#include "whisper_fake.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+constexpr int    k_n_text          = 100;
+constexpr size_t k_samples_per_sec = 16000;
+
+size_t at(double seconds) {
+    return (size_t) (seconds * k_samples_per_sec);
+}
+
+// A tone for `seconds`, silent over [silence_from, silence_to)
+std::vector<float> tone(double seconds, double silence_from, double silence_to) {
+    std::vector<float> samples(at(seconds));
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const bool silent = i >= at(silence_from) && i < at(silence_to);
+        samples[i] = silent ? 0.0f : 0.1f * (float) std::sin(2.0 * M_PI * 220.0 * (double) i / k_samples_per_sec);
+    }
+    return samples;
+}
+
+void test_plan_cuts_in_silence() {
+    const wb_longform_params params = wb_longform_default_params();
+    const std::vector<float> samples = tone(45.0, 20.0, 21.0);
+
+    std::vector<wb_longform_window> windows(wb_longform_max_windows(samples.size(), &params));
+    windows.resize(wb_longform_plan(samples.data(), samples.size(), &params, windows.data()));
+
+    CHECK(windows.size() == 2);
+    if (windows.size() == 2) {
+        CHECK(windows[0].start == 0);
+        CHECK(windows[0].end >= at(20.0) && windows[0].end <= at(21.0));   // in the silence
+        CHECK(windows[1].start == windows[0].end);                         // no overlap
+        CHECK(windows[1].end == samples.size());
+    }
+}
+
+void test_plan_overlaps_through_speech() {
+    const wb_longform_params params = wb_longform_default_params();
+    const std::vector<float> samples = tone(45.0, 0.0, 0.0);
+
+    std::vector<wb_longform_window> windows(wb_longform_max_windows(samples.size(), &params));
+    windows.resize(wb_longform_plan(samples.data(), samples.size(), &params, windows.data()));
+
+    // Every cut is through speech: consecutive windows share overlap_s of audio
+    CHECK(windows.size() >= 2);
+    CHECK(!windows.empty() && windows.front().start == 0 && windows.back().end == samples.size());
+    for (size_t i = 0; i < windows.size(); ++i) {
+        CHECK(windows[i].end - windows[i].start <= at(params.max_window_s));
+        if (i + 1 < windows.size()) {
+            CHECK(windows[i].end - windows[i + 1].start == at(params.overlap_s));
+        }
+    }
+}
+
+struct stitcher {
+    whisper_context *    ctx;
+    wb_vocab *           vocab;
+    wb_longform_stitch * stitch;
+
+    stitcher() {
+        ctx    = wb_fake_context_create(k_n_text, nullptr, nullptr);
+        vocab  = wb_vocab_create(ctx);
+        stitch = wb_longform_stitch_create(vocab);
+    }
+
+    ~stitcher() {
+        wb_longform_stitch_free(stitch);
+        wb_vocab_free(vocab);
+        whisper_free(ctx);
+    }
+
+    // Timestamp token for `seconds` from the seek
+    int32_t ts(double seconds) const {
+        return wb_vocab_timestamp_begin(vocab) + (int32_t) std::lround(seconds * 50.0);
+    }
+
+    void add(double start, double end, const std::vector<int32_t> & ids, const std::vector<int64_t> & t0 = {}) {
+        const wb_longform_window window = { at(start), at(end) };
+        wb_longform_stitch_add(stitch, &window, ids.data(), t0.empty() ? nullptr : t0.data(), (int) ids.size());
+    }
+
+    std::string text() { return wb_longform_stitch_text(stitch); }
+};
+
+// " w1 w2 ..." as the fake's vocabulary writes them
+std::string words(const std::vector<int> & ids) {
+    std::string text;
+    for (const int id : ids) {
+        text += " w" + std::to_string(id);
+    }
+    return text;
+}
+
+void test_stitch_joins_at_shared_run() {
+    stitcher s;
+    s.add(0.0, 20.0, { s.ts(0.0), 1, 2, 3, 4, s.ts(17.0), 5, 6, 7, 8, s.ts(20.0) });
+    s.add(18.0, 38.0, { s.ts(0.0), 6, 7, 8, 9, 10, s.ts(5.0) });
+    CHECK(s.text() == words({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+}
+
+void test_stitch_falls_back_to_middle() {
+    // Overlap [18, 20) s with nothing shared: each side keeps its half around 19 s
+    stitcher s;
+    s.add(0.0, 20.0, { s.ts(0.0), 1, 2, 3, 4, s.ts(17.0), 5, 6, s.ts(19.4), 7, 8, s.ts(20.0) });
+    s.add(18.0, 38.0, { s.ts(0.0), 20, s.ts(1.5), 21, 22, s.ts(4.0), 23, s.ts(6.0) });
+    CHECK(s.text() == words({ 1, 2, 3, 4, 5, 6, 21, 22, 23 }));
+}
+
+void test_stitch_places_seeks_by_segment_t0() {
+    // Three segments, the second and third after seeks to 10 s and 20 s that restart the
+    // timestamps; the third's tokens are at 29.3 s, past the middle of the [28, 30) overlap
+    stitcher s;
+    s.add(0.0, 30.0,
+          { s.ts(0.0), 1, 2, s.ts(10.0), s.ts(0.0), 3, 4, s.ts(8.0), s.ts(9.3), 5, 6, s.ts(9.9) },
+          { 0, 0, 0, 0, 1000, 1000, 1000, 1000, 2930, 2930, 2930, 2930 });
+    s.add(28.0, 50.0, { s.ts(0.0), 40, s.ts(1.2), 41, 42, s.ts(3.0) }, { 0, 0, 0, 0, 0, 0 });
+    CHECK(s.text() == words({ 1, 2, 3, 4, 41, 42 }));
+}
+
+} // namespace
+
+int main() {
+    test_plan_cuts_in_silence();
+    test_plan_overlaps_through_speech();
+    test_stitch_joins_at_shared_run();
+    test_stitch_falls_back_to_middle();
+    test_stitch_places_seeks_by_segment_t0();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_longform_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_longform_test: ok\n");
+    return 0;
+}
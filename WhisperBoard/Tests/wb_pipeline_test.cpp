@@ -0,0 +1,306 @@
+//
+//  wb_pipeline_test.cpp
+//  WhisperBoard
+//
+//  wb_pipeline against whisper_fake, whose encoder takes time in proportion to
+//  audio_ctx as whisper.cpp's does: speech-onset speculation decodes only the
+//  onset prefix, so its tentative text arrives well before the chunk's real
+//  result, and chunks no longer than the window are not speculated. Runaway
+//  decodes end at the loop, each of whisper_full's decoders on its own tokens.
+//  Temperature fallback retries a low-probability decode unless whisper calls
+//  the window silence. A float32 chunk file reaches the mel through its
+//  wb_pcm_view mapping, after the file is unlinked, without a copy.
+//
+
+#include "wb_pcm_view.h"
+#include "wb_pipeline.h"
+#include "whisper_fake.h"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr int    k_n_text           = 50;
+constexpr int    k_prompt           = 4;     // sot, language, task, no-timestamps
+constexpr int    k_us_per_position  = 200;   // full encoder (1500 positions): 300 ms
+constexpr size_t k_samples_per_sec  = 16000;
+
+// Six words, then EOT
+void sentence_scores(const whisper_token *, int n_history, float * logits, void *) {
+    for (int t = 0; t <= k_n_text; ++t) {
+        logits[t] = 0.0f;
+    }
+    logits[n_history - k_prompt >= 6 ? k_n_text : (n_history * 7) % k_n_text] = 10.0f;
+}
+
+// `silence` seconds of nothing, then a tone for the rest of `seconds`
+std::vector<float> clip(double seconds, double silence) {
+    std::vector<float> samples((size_t) (seconds * k_samples_per_sec), 0.0f);
+    for (size_t i = (size_t) (silence * k_samples_per_sec); i < samples.size(); ++i) {
+        samples[i] = 0.1f * (float) std::sin(2.0 * M_PI * 220.0 * (double) i / k_samples_per_sec);
+    }
+    return samples;
+}
+
+struct recorder {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    clock_type::time_point  submitted;
+    std::vector<int>        statuses;
+    std::vector<double>     at_ms;
+    int                     finals = 0;
+    int                     n_tokens = 0;   // of the last real result
+    bool                    runaway  = false;
+
+    static void on_result(const wb_pipeline_result * result, void * data) {
+        auto * r = static_cast<recorder *>(data);
+        std::lock_guard<std::mutex> lock(r->mutex);
+        r->n_tokens = result->n_tokens;
+        r->runaway  = result->runaway;
+        r->statuses.push_back(result->status);
+        r->at_ms.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - r->submitted).count());
+        if (result->status != WB_PIPELINE_TENTATIVE) {
+            r->finals++;
+            r->cv.notify_one();
+        }
+    }
+
+    void run(wb_pipeline * pipeline, const std::vector<float> & samples) {
+        run(pipeline, samples.data(), samples.size());
+    }
+
+    void run(wb_pipeline * pipeline, const float * samples, size_t n_samples) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            statuses.clear();
+            at_ms.clear();
+            finals    = 0;
+            submitted = clock_type::now();
+        }
+        wb_pipeline_submit(pipeline, samples, n_samples, nullptr, nullptr);
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return finals == 1; });
+    }
+};
+
+wb_pipeline * make_pipeline(whisper_context * ctx, recorder * r, float vad, int beam_size = 0) {
+    whisper_full_params full = {};
+    full.strategy  = beam_size > 0 ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY;
+    full.n_threads = 1;
+    full.language  = "en";
+    full.beam_search.beam_size = beam_size;
+
+    wb_pipeline_params params = wb_pipeline_default_params();
+    params.vad_rms_threshold      = vad;
+    params.speculative_max_tokens = beam_size > 0 ? 0 : 8;
+    params.speculative_window_ms  = 1000;
+    params.deadline_ms            = 60000;
+    params.on_result              = recorder::on_result;
+    params.callback_data          = r;
+    return wb_pipeline_init(ctx, &full, params);
+}
+
+void test_onset_prefix_arrives_first(float vad) {
+    whisper_context * ctx = wb_fake_context_create(k_n_text, sentence_scores, nullptr);
+    wb_fake_set_encoder_cost(ctx, k_us_per_position);
+    recorder r;
+    wb_pipeline * pipeline = make_pipeline(ctx, &r, vad);
+    CHECK(pipeline != nullptr);
+
+    // Ten seconds, speech from 0.5 s: the speculation covers 0.4-1.4 s
+    r.run(pipeline, clip(10.0, 0.5));
+    wb_pipeline_free(pipeline);
+
+    CHECK(r.statuses.size() == 2);
+    if (r.statuses.size() == 2) {
+        CHECK(r.statuses[0] == WB_PIPELINE_TENTATIVE);
+        CHECK(r.statuses[1] == WB_PIPELINE_OK);
+        // A whole-chunk speculation (audio_ctx 532) would take over a third of the real decode
+        CHECK(r.at_ms[0] < r.at_ms[1] / 4.0);
+    }
+    whisper_free(ctx);
+}
+
+void test_short_chunk_not_speculated() {
+    whisper_context * ctx = wb_fake_context_create(k_n_text, sentence_scores, nullptr);
+    recorder r;
+    wb_pipeline * pipeline = make_pipeline(ctx, &r, 0.002f);
+    CHECK(pipeline != nullptr);
+
+    r.run(pipeline, clip(0.8, 0.0));
+    wb_pipeline_free(pipeline);
+
+    CHECK(r.statuses.size() == 1);
+    CHECK(!r.statuses.empty() && r.statuses[0] == WB_PIPELINE_OK);
+    whisper_free(ctx);
+}
+
+void test_mapped_chunk_reaches_mel() {
+    // Written as the keyboard writes a float32 chunk: raw native-endian samples
+    const std::vector<float> samples = clip(3.0, 0.5);
+    char path[] = "/tmp/wb_pipeline_test.XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    const ssize_t bytes = (ssize_t) (samples.size() * sizeof(float));
+    CHECK(write(fd, samples.data(), (size_t) bytes) == bytes);
+    close(fd);
+
+    wb_pcm_view * view = wb_pcm_view_open(path, WB_PCM_FLOAT32);
+    CHECK(view != nullptr);
+    unlink(path);   // AudioProcessor deletes the file once the chunk is handed off
+    if (view == nullptr) {
+        return;
+    }
+    const wb_sample_span span = wb_pcm_view_samples(view);
+    CHECK(wb_pcm_view_copies(view) == 0);
+    CHECK(span.count == samples.size());
+
+    whisper_context * ctx = wb_fake_context_create(k_n_text, sentence_scores, nullptr);
+    recorder r;
+    wb_pipeline * pipeline = make_pipeline(ctx, &r, 0.002f);
+    CHECK(pipeline != nullptr);
+    wb_pipeline_set_speculation(pipeline, 0);   // only the chunk's own mel
+
+    r.run(pipeline, span.data, span.count);
+    wb_pipeline_free(pipeline);
+    CHECK(r.statuses.size() == 1 && r.statuses[0] == WB_PIPELINE_OK);
+
+    // The mel read the mapping itself, whole, after the unlink
+    int    n_mel = 0;
+    double sum   = 0.0;
+    CHECK(wb_fake_mel_samples(ctx, &n_mel, &sum) == span.data);
+    CHECK((size_t) n_mel == samples.size());
+    double expected = 0.0;
+    for (const float v : samples) {
+        expected += v;
+    }
+    CHECK(sum == expected);
+    CHECK(wb_pcm_view_copies(view) == 0);
+
+    wb_pcm_view_close(view);
+    whisper_free(ctx);
+}
+
+// Best first token 0, then "1 2 3" forever; second best 5, then a sentence of 40 distinct tokens
+void looping_scores(const whisper_token * history, int n_history, float * logits, void *) {
+    for (int t = 0; t < k_n_text; ++t) {
+        logits[t] = 0.0f;
+    }
+    logits[k_n_text] = -10.0f;
+
+    const int n_text = n_history - k_prompt;
+    if (n_text == 0) {
+        logits[0] = 10.0f;
+        logits[5] = 9.0f;
+    } else if (history[k_prompt] == 0) {
+        logits[history[n_history - 1] % 3 + 1] = 10.0f;
+    } else if (n_text < 40) {
+        logits[5 + n_text] = 10.0f;
+    } else {
+        logits[k_n_text] = 10.0f;
+    }
+}
+
+void test_runaway_ends_per_decoder() {
+    whisper_context * ctx = wb_fake_context_create(k_n_text, looping_scores, nullptr);
+    recorder r;
+    wb_pipeline * pipeline = make_pipeline(ctx, &r, 0.0f, 2);
+    CHECK(pipeline != nullptr);
+
+    // Twice over, so the second decode starts on the first one's repetition state
+    for (int run = 0; run < 2; ++run) {
+        r.run(pipeline, clip(10.0, 0.0));
+
+        // "0 1 2 3" then the loop: ended as soon as it spans 16 tokens, cut back to its first pass
+        CHECK(wb_fake_full_tokens(ctx, 0) == 17);
+        CHECK(wb_fake_full_tokens(ctx, 1) == 40);
+        CHECK(r.statuses.size() == 1);
+        CHECK(r.runaway);
+        CHECK(r.n_tokens == 4);
+    }
+    wb_pipeline_free(pipeline);
+    whisper_free(ctx);
+}
+
+// Retries a chunk took under temperature fallback, at the fake's token and no-speech probabilities
+int fallback_retries(float token_p, float no_speech_prob) {
+    whisper_context * ctx = wb_fake_context_create(k_n_text, sentence_scores, nullptr);
+    wb_fake_set_decode_quality(ctx, token_p, no_speech_prob);
+
+    whisper_full_params full = {};
+    full.strategy        = WHISPER_SAMPLING_GREEDY;
+    full.n_threads       = 1;
+    full.language        = "en";
+    full.temperature_inc = 0.2f;
+    full.entropy_thold   = 2.4f;
+    full.logprob_thold   = -1.0f;
+    full.no_speech_thold = 0.6f;
+
+    recorder r;
+    wb_pipeline_params params = wb_pipeline_default_params();
+    params.deadline_ms   = 60000;
+    params.on_result     = recorder::on_result;
+    params.callback_data = &r;
+    wb_pipeline * pipeline = wb_pipeline_init(ctx, &full, params);
+    CHECK(pipeline != nullptr);
+
+    r.run(pipeline, clip(2.0, 0.0));
+    wb_fallback_stats stats;
+    wb_pipeline_fallback_stats(pipeline, &stats);
+    wb_pipeline_free(pipeline);
+    whisper_free(ctx);
+
+    CHECK(r.statuses.size() == 1 && r.statuses[0] == WB_PIPELINE_OK);
+    for (int retries = 0; retries < WB_FALLBACK_BUCKETS; ++retries) {
+        if (stats.chunks_by_retries[retries] > 0) {
+            return retries;
+        }
+    }
+    return -1;
+}
+
+void test_fallback_spares_silence() {
+    CHECK(fallback_retries(0.9f, 0.0f) == 0);                         // log(0.9) passes logprob_thold
+    CHECK(fallback_retries(0.1f, 0.0f) == WB_FALLBACK_BUCKETS - 1);   // every temperature, 0 to 1
+    CHECK(fallback_retries(0.1f, 0.9f) == 0);                         // silence: nothing to retry for
+}
+
+} // namespace
+
+int main() {
+    test_onset_prefix_arrives_first(0.002f);
+    test_onset_prefix_arrives_first(0.0f);   // VAD off: the prefix starts at the chunk
+    test_short_chunk_not_speculated();
+    test_mapped_chunk_reaches_mel();
+    test_runaway_ends_per_decoder();
+    test_fallback_spares_silence();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_pipeline_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_pipeline_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+//
+//  wb_repetition_test.cpp
+//  WhisperBoard
+//
+//  wb_repetition_tracker must agree with wb_repetition_check after every push
+//  and truncation, on speech-like token streams and on ones that start looping
+//  with short and long units.
+//
+
+#include "wb_repetition.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+struct rng {
+    uint32_t state;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int below(int n) { return (int) (next() % (uint32_t) n); }
+};
+
+// Free text, then (from `loop_at`) a unit of `period` tokens repeated
+std::vector<int32_t> stream(rng & r, int length, int loop_at, int period, int vocab) {
+    std::vector<int32_t> tokens;
+    for (int i = 0; i < length; ++i) {
+        if (i >= loop_at + period) {
+            tokens.push_back(tokens[(size_t) (i - period)]);
+        } else {
+            tokens.push_back(r.below(vocab));
+        }
+    }
+    return tokens;
+}
+
+void test_tracker_matches_check() {
+    rng r = { 12345 };
+    int looped = 0;
+    for (int trial = 0; trial < 400; ++trial) {
+        const int period  = 1 + r.below(40);                 // past k_max_period, so trigrams catch some
+        const int loop_at = r.below(3) == 0 ? 1000 : r.below(120);
+        const int vocab   = r.below(4) == 0 ? 6 : 5000;      // small vocabularies repeat trigrams by chance
+        const std::vector<int32_t> tokens = stream(r, 200, loop_at, period, vocab);
+
+        wb_repetition_tracker * tracker = wb_repetition_tracker_create(trial % 2 == 0 ? 16 : 448);
+        std::vector<int32_t> pushed;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            pushed.push_back(tokens[i]);
+            const int keep = wb_repetition_tracker_push(tracker, tokens[i]);
+            CHECK(keep == wb_repetition_check(pushed.data(), (int) pushed.size()));
+            looped += keep > 0 ? 1 : 0;
+
+            // Now and then a fork: back to an earlier prefix, then on with this stream
+            if (r.below(25) == 0) {
+                const int back = r.below((int) pushed.size() + 1);
+                const int kept = wb_repetition_tracker_truncate(tracker, back);
+                CHECK(kept == wb_repetition_check(pushed.data(), back));
+                for (int j = back; j < (int) pushed.size(); ++j) {
+                    wb_repetition_tracker_push(tracker, pushed[(size_t) j]);
+                }
+                CHECK(wb_repetition_tracker_truncate(tracker, (int) pushed.size()) ==
+                      wb_repetition_check(pushed.data(), (int) pushed.size()));
+            }
+        }
+        wb_repetition_tracker_free(tracker);
+    }
+    CHECK(looped > 0);
+}
+
+} // namespace
+
+int main() {
+    test_tracker_matches_check();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_repetition_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_repetition_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+//
+//  wb_text_post_test.cpp
+//  WhisperBoard
+//
+//  wb_text_post per mode and across pieces: apostrophes and hyphens stay
+//  inside words and separators inside numbers, also when the piece ends
+//  between them; sentences are capitalised across pieces; uncommitted text
+//  leaves the stream as it was; a UTF-8 character split between pieces comes
+//  out whole with the second one.
+//
+
+#include "wb_text_post.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+struct stream {
+    wb_text_post * post = wb_text_post_create();
+    int            mode;
+
+    explicit stream(int mode) : mode(mode) {}
+    ~stream() { wb_text_post_free(post); }
+
+    std::string append(const char * text, bool commit = true) {
+        return wb_text_post_append(post, mode, text, strlen(text), commit);
+    }
+};
+
+std::string clean(int mode, const char * text) {
+    stream s(mode);
+    return s.append(text);
+}
+
+void test_auto_keeps_punctuation() {
+    CHECK(clean(WB_TEXT_AUTO, "  Hello,   world!\n How's  it going? ") == "Hello, world! How's it going?");
+}
+
+void test_apostrophes() {
+    CHECK(clean(WB_TEXT_NONE, " Don't say 'maybe', it's rock 'n' roll.") == "Don't say maybe it's rock n roll");
+    CHECK(clean(WB_TEXT_NONE, "the dogs’ bowls") == "the dogs bowls");
+
+    stream s(WB_TEXT_NONE);
+    CHECK(s.append(" don'") == "don");
+    CHECK(s.append("t stop") == "'t stop");
+    CHECK(s.append(" rock'") == "rock");
+    CHECK(s.append(" n roll") == "n roll");   // the piece broke the word
+}
+
+void test_hyphens() {
+    CHECK(clean(WB_TEXT_NONE, "a well-known - if odd - fact") == "a well-known if odd fact");
+    CHECK(clean(WB_TEXT_NONE, "well--known") == "well known");
+
+    stream s(WB_TEXT_NONE);
+    CHECK(s.append(" a well-") == "a well");
+    CHECK(s.append("known fact") == "-known fact");
+    CHECK(s.append(" fact, ") == "fact");
+    CHECK(s.append("-known") == "known");     // a removed comma already broke the word
+}
+
+void test_numbers() {
+    CHECK(clean(WB_TEXT_NONE, "pi is 3.14, or 1,000 over 318.") == "pi is 3.14 or 1,000 over 318");
+    CHECK(clean(WB_TEXT_NONE, "version 2.a") == "version 2 a");
+
+    stream s(WB_TEXT_NONE);
+    CHECK(s.append(" it costs 3.") == "it costs 3");
+    CHECK(s.append("5 euros") == ".5 euros");
+    CHECK(s.append(" about 1,") == "about 1");
+    CHECK(s.append("000") == ",000");
+}
+
+void test_sentence_case_across_pieces() {
+    stream s(WB_TEXT_SENTENCE);
+    CHECK(s.append(" hello there. how are") == "Hello there How are");
+    CHECK(s.append(" you? fine") == "you Fine");
+    CHECK(s.append(" it was 3.") == "it was 3");
+    CHECK(s.append(" next one") == "Next one");   // the held full stop ended the sentence
+    CHECK(s.append(" \xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82.") == "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82");
+    CHECK(s.append(" \xD0\xBC\xD0\xB8\xD1\x80") == "\xD0\x9C\xD0\xB8\xD1\x80");   // мир -> Мир
+}
+
+void test_uncommitted_piece() {
+    stream s(WB_TEXT_SENTENCE);
+    CHECK(s.append(" so,") == "So");
+
+    // Tentative text that ends a sentence and holds a hyphen, then replaced
+    CHECK(s.append(" the end. well-", false) == "the end Well");
+    CHECK(s.append("known", false) == "known");   // nothing was held
+    CHECK(s.append(" the middle") == "the middle");
+    CHECK(s.append(" of it.") == "of it");
+    CHECK(s.append(" again") == "Again");
+}
+
+void test_utf8_split_across_pieces() {
+    stream s(WB_TEXT_SENTENCE);
+    CHECK(s.append(" \xC3") == "");
+    CHECK(s.append("\xA9t\xC3\xA9 au caf\xC3") == "\xC3\x89t\xC3\xA9 au caf");   // été -> Été
+    CHECK(s.append("\xA9.") == "\xC3\xA9");
+
+    // A split curly apostrophe is still held inside the word
+    stream t(WB_TEXT_NONE);
+    CHECK(t.append("don\xE2\x80") == "don");
+    CHECK(t.append("\x99t") == "\xE2\x80\x99t");
+}
+
+} // namespace
+
+int main() {
+    test_auto_keeps_punctuation();
+    test_apostrophes();
+    test_hyphens();
+    test_numbers();
+    test_sentence_case_across_pieces();
+    test_uncommitted_piece();
+    test_utf8_split_across_pieces();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_text_post_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_text_post_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,133 @@
+//
+//  wb_vocab_test.cpp
+//  WhisperBoard
+//
+//  wb_detok over whisper_fake's vocabulary, with text tokens rewritten to carry
+//  pieces of characters: 2-, 3- and 4-byte characters split across tokens come
+//  out whole with the token that completes them, a sequence cut short becomes
+//  U+FFFD and the byte that cut it is read again, a special token passes
+//  through without touching a pending character, and the end of the decode
+//  replaces what is still pending.
+//
+
+#include "wb_vocab.h"
+#include "whisper_fake.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            ++g_failures;                                                    \
+        }                                                                    \
+    } while (0)
+
+constexpr int k_n_text = 20;
+
+const std::string k_fffd = "\xEF\xBF\xBD";
+
+struct detokenizer {
+    whisper_context * ctx;
+    wb_vocab *        vocab = nullptr;
+    wb_detok          detok;
+    std::vector<char> out;
+
+    // Token i (from 0) gets pieces[i] as its bytes
+    explicit detokenizer(const std::vector<const char *> & pieces) {
+        ctx = wb_fake_context_create(k_n_text, nullptr, nullptr);
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            wb_fake_set_token_text(ctx, (whisper_token) i, pieces[i]);
+        }
+        vocab = wb_vocab_create(ctx);
+        out.resize(wb_vocab_max_emit(vocab));
+        wb_detok_begin(&detok);
+    }
+
+    ~detokenizer() {
+        wb_vocab_free(vocab);
+        whisper_free(ctx);
+    }
+
+    std::string push(int32_t id) {
+        return std::string(out.data(), wb_detok_push(&detok, vocab, id, out.data()));
+    }
+
+    std::string end() {
+        return std::string(out.data(), wb_detok_end(&detok, out.data()));
+    }
+};
+
+void test_split_characters() {
+    // é (C3 A9), € (E2 82 AC), U+1F600 (F0 9F 98 80)
+    detokenizer d({ " caf\xC3", "\xA9!", "\xE2", "\x82", "\xAC" "5", "\xF0\x9F", "\x98", "\x80 ok" });
+
+    CHECK(d.push(0) == " caf");
+    CHECK(d.push(1) == "\xC3\xA9!");
+    CHECK(d.push(2).empty());
+    CHECK(d.push(3).empty());
+    CHECK(d.push(4) == "\xE2\x82\xAC" "5");
+    CHECK(d.push(5).empty());
+    CHECK(d.push(6).empty());
+    CHECK(d.push(7) == "\xF0\x9F\x98\x80 ok");
+    CHECK(d.end().empty());
+}
+
+void test_interrupted_sequence() {
+    detokenizer d({ "\xE2\x82", " w", "\xC3", "\xC3\xA9", "\x80", "\xE0\x80" });
+
+    // Cut short by ASCII, then by another lead byte: each re-read after the replacement
+    CHECK(d.push(0).empty());
+    CHECK(d.push(1) == k_fffd + " w");
+    CHECK(d.push(2).empty());
+    CHECK(d.push(3) == k_fffd + "\xC3\xA9");
+
+    // A continuation byte with nothing pending, and an overlong form (E0 80)
+    CHECK(d.push(4) == k_fffd);
+    CHECK(d.push(5) == k_fffd + k_fffd);
+    CHECK(d.end().empty());
+}
+
+void test_special_token_while_pending() {
+    detokenizer d({ "\xC3", "\xA9" });
+    const int32_t eot = wb_vocab_eot(d.vocab);
+    const int32_t ts  = wb_vocab_timestamp_begin(d.vocab) + 50;
+
+    CHECK(d.push(0).empty());
+    CHECK(d.push(eot) == "[_EOT_]");
+    CHECK(d.push(ts) == "[_TT_50]");
+    CHECK(d.push(1) == "\xC3\xA9");   // still completes the character
+}
+
+void test_end_with_pending() {
+    detokenizer d({ " a\xF0\x9F\x98" });
+
+    CHECK(d.push(0) == " a");
+    CHECK(d.end() == k_fffd);
+    CHECK(d.end().empty());   // once
+
+    // The detokenizer starts over after the end
+    CHECK(d.push(0) == " a");
+}
+
+} // namespace
+
+int main() {
+    test_split_characters();
+    test_interrupted_sequence();
+    test_special_token_while_pending();
+    test_end_with_pending();
+
+    if (g_failures > 0) {
+        fprintf(stderr, "wb_vocab_test: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("wb_vocab_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,294 @@
+//
+//  whisper_fake.cpp
+//  WhisperBoard
+//
+//  Token layout: text tokens, EOT, then sot, no-timestamps, prev, transcribe,
+//  translate, one language ("en") and whisper's 1501 timestamp tokens (0-30 s in
+//  20 ms steps). A new state's logits
+//  buffer is poisoned so a reader of a row whisper.cpp did not write sees nonsense.
+//
+
+#include "whisper_fake.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct whisper_context {
+    int            n_text = 0;
+    wb_fake_scorer scorer = nullptr;
+    void *         user_data = nullptr;
+    int            us_per_position = 0;
+    float          token_p         = 0.9f;
+    float          no_speech_prob  = 0.0f;
+    mutable std::mutex mel_mutex;               // speculation computes its mel alongside the chunk's
+    const float *  mel_samples     = nullptr;   // last whisper_pcm_to_mel_with_state
+    int            mel_n_samples   = 0;
+    double         mel_sum         = 0.0;
+    std::vector<std::string> strings;   // whisper_token_to_str
+    std::vector<int>         decoded;   // per decoder, last whisper_full
+};
+
+struct whisper_state {
+    std::vector<whisper_token> kv;
+    std::vector<float>         logits;
+    int                        calls = 0;
+    std::vector<whisper_token_data> result;   // whisper_full's one segment
+    float                      no_speech_prob = 0.0f;
+};
+
+namespace {
+
+constexpr int k_n_text_ctx   = 448;
+constexpr int k_n_timestamps = 1501;
+constexpr int k_n_special    = 6 + k_n_timestamps;   // after EOT
+constexpr int k_n_audio_ctx  = 1500;
+constexpr int k_n_mels       = 80;
+
+enum special { k_sot = 1, k_not, k_prev, k_transcribe, k_translate, k_lang, k_beg };
+
+// The "encoder": sleeps in 1 ms slices, false once whisper_full's abort callback fires
+bool encode(const whisper_context * ctx, const whisper_full_params & params) {
+    const int positions = params.audio_ctx > 0 && params.audio_ctx < k_n_audio_ctx ? params.audio_ctx : k_n_audio_ctx;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds((long) positions * ctx->us_per_position);
+    while (std::chrono::steady_clock::now() < end) {
+        if (params.abort_callback != nullptr && params.abort_callback(params.abort_callback_user_data)) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+struct whisper_context * wb_fake_context_create(int n_text_tokens, wb_fake_scorer scorer, void * user_data) {
+    auto * ctx = new whisper_context();
+    ctx->n_text    = n_text_tokens;
+    ctx->scorer    = scorer;
+    ctx->user_data = user_data;
+    for (int t = 0; t < n_text_tokens; ++t) {
+        ctx->strings.push_back(" w" + std::to_string(t));
+    }
+    for (const char * special : { "[_EOT_]", "[_SOT_]", "[_NOT_]", "[_PREV_]", "[_TRANSCRIBE_]", "[_TRANSLATE_]", "[_LANG_en]" }) {
+        ctx->strings.push_back(special);
+    }
+    for (int t = 0; t < k_n_timestamps; ++t) {
+        ctx->strings.push_back("[_TT_" + std::to_string(t) + "]");
+    }
+    return ctx;
+}
+
+void wb_fake_set_token_text(struct whisper_context * ctx, whisper_token token, const char * text) {
+    ctx->strings[(size_t) token] = text;
+}
+
+int wb_fake_decode_calls(const struct whisper_state * state) {
+    return state->calls;
+}
+
+void wb_fake_set_encoder_cost(struct whisper_context * ctx, int us_per_position) {
+    ctx->us_per_position = us_per_position;
+}
+
+void wb_fake_set_decode_quality(struct whisper_context * ctx, float token_p, float no_speech_prob) {
+    ctx->token_p        = token_p;
+    ctx->no_speech_prob = no_speech_prob;
+}
+
+const float * wb_fake_mel_samples(const struct whisper_context * ctx, int * n_samples, double * sum) {
+    std::lock_guard<std::mutex> lock(ctx->mel_mutex);
+    *n_samples = ctx->mel_n_samples;
+    *sum       = ctx->mel_sum;
+    return ctx->mel_samples;
+}
+
+int wb_fake_full_tokens(const struct whisper_context * ctx, int decoder) {
+    return decoder >= 0 && (size_t) decoder < ctx->decoded.size() ? ctx->decoded[(size_t) decoder] : -1;
+}
+
+void whisper_free(struct whisper_context * ctx) {
+    delete ctx;
+}
+
+struct whisper_state * whisper_init_state(struct whisper_context * ctx) {
+    auto * state = new whisper_state();
+    // Poison: the first text token wins every stale row
+    state->logits.assign((size_t) k_n_text_ctx * (size_t) whisper_n_vocab(ctx), -1e9f);
+    for (size_t row = 0; row < (size_t) k_n_text_ctx; ++row) {
+        state->logits[row * (size_t) whisper_n_vocab(ctx)] = 1e9f;
+    }
+    return state;
+}
+
+void whisper_free_state(struct whisper_state * state) {
+    delete state;
+}
+
+int whisper_decode_with_state(struct whisper_context * ctx, struct whisper_state * state, const whisper_token * tokens,
+                              int n_tokens, int n_past, int) {
+    if (n_tokens <= 0 || n_past < 0 || n_past > (int) state->kv.size() || n_past + n_tokens > k_n_text_ctx) {
+        return -1;
+    }
+    state->calls++;
+    state->kv.resize((size_t) n_past);
+    state->kv.insert(state->kv.end(), tokens, tokens + n_tokens);
+
+    const size_t n_vocab = (size_t) whisper_n_vocab(ctx);
+    if (state->logits.size() < (size_t) n_tokens * n_vocab) {
+        state->logits.resize((size_t) n_tokens * n_vocab, -1e9f);
+    }
+    ctx->scorer(state->kv.data(), (int) state->kv.size(), state->logits.data() + (size_t) (n_tokens - 1) * n_vocab,
+                ctx->user_data);
+    return 0;
+}
+
+float * whisper_get_logits_from_state(struct whisper_state * state) {
+    return state->logits.data();
+}
+
+int whisper_model_n_mels(struct whisper_context *)           { return k_n_mels; }
+int whisper_n_vocab(struct whisper_context * ctx)            { return ctx->n_text + 1 + k_n_special; }
+int whisper_n_text_ctx(struct whisper_context *)             { return k_n_text_ctx; }
+int whisper_model_n_text_ctx(struct whisper_context *)       { return k_n_text_ctx; }
+int whisper_model_n_text_layer(struct whisper_context *)     { return 1; }
+int whisper_model_n_text_state(struct whisper_context *)     { return 1; }
+
+whisper_token whisper_token_eot(struct whisper_context * ctx)        { return ctx->n_text; }
+whisper_token whisper_token_sot(struct whisper_context * ctx)        { return ctx->n_text + k_sot; }
+whisper_token whisper_token_not(struct whisper_context * ctx)        { return ctx->n_text + k_not; }
+whisper_token whisper_token_prev(struct whisper_context * ctx)       { return ctx->n_text + k_prev; }
+whisper_token whisper_token_transcribe(struct whisper_context * ctx) { return ctx->n_text + k_transcribe; }
+whisper_token whisper_token_translate(struct whisper_context * ctx)  { return ctx->n_text + k_translate; }
+whisper_token whisper_token_lang(struct whisper_context * ctx, int lang_id) { return ctx->n_text + k_lang + lang_id; }
+whisper_token whisper_token_beg(struct whisper_context * ctx)        { return ctx->n_text + k_beg; }
+
+const char * whisper_token_to_str(struct whisper_context * ctx, whisper_token token) {
+    return ctx->strings[(size_t) token].c_str();
+}
+
+int whisper_lang_id(const char * lang) {
+    return strcmp(lang, "en") == 0 ? 0 : -1;
+}
+
+// No text maps to a single token, so only the special tokens are suppressed
+int whisper_tokenize(struct whisper_context *, const char *, whisper_token *, int) {
+    return 0;
+}
+
+// The mel only matters to the real encoder; the samples are read once, as its frontend does
+int whisper_pcm_to_mel_with_state(struct whisper_context * ctx, struct whisper_state *, const float * samples, int n_samples,
+                                  int n_threads) {
+    double sum = 0.0;
+    for (int i = 0; i < n_samples; ++i) {
+        sum += samples[i];
+    }
+    std::lock_guard<std::mutex> lock(ctx->mel_mutex);
+    ctx->mel_samples   = samples;
+    ctx->mel_n_samples = n_samples;
+    ctx->mel_sum       = sum;
+    return n_samples > 0 && n_threads > 0 ? 0 : -1;
+}
+
+// Greedy over the scorer after sot, language, task and no-timestamps; logits_filter_callback
+// sees every decoder's every step, as in whisper.cpp. With WHISPER_SAMPLING_BEAM_SEARCH there
+// are beam_size decoders, taking turns; decoder d starts with the d-th best token and the
+// sequences never merge. Decoder 0's tokens form the one segment.
+int whisper_full_with_state(struct whisper_context * ctx, struct whisper_state * state, struct whisper_full_params params,
+                            const float *, int) {
+    state->result.clear();
+    ctx->decoded.clear();
+    if (params.encoder_begin_callback != nullptr &&
+        !params.encoder_begin_callback(ctx, state, params.encoder_begin_callback_user_data)) {
+        return -1;
+    }
+    if (!encode(ctx, params)) {
+        return -1;
+    }
+
+    struct decoder {
+        std::vector<whisper_token>      history;
+        std::vector<whisper_token_data> tokens;
+        bool                            done = false;
+    };
+    const int n_decoders = params.strategy == WHISPER_SAMPLING_BEAM_SEARCH
+        ? std::min(std::max(params.beam_search.beam_size, 1), 8) : 1;
+    std::vector<decoder> decoders((size_t) n_decoders);
+    for (auto & d : decoders) {
+        d.history = { whisper_token_sot(ctx), whisper_token_lang(ctx, 0), whisper_token_transcribe(ctx), whisper_token_not(ctx) };
+    }
+
+    const whisper_token eot = whisper_token_eot(ctx);
+    const int max_tokens = params.max_tokens > 0 ? params.max_tokens : k_n_text_ctx / 2;
+    std::vector<float> logits((size_t) whisper_n_vocab(ctx));
+    std::vector<whisper_token> ranked((size_t) eot + 1);
+
+    for (int step = 0; step < max_tokens; ++step) {
+        for (size_t i = 0; i < decoders.size(); ++i) {
+            decoder & d = decoders[i];
+            if (d.done) {
+                continue;
+            }
+            if (params.abort_callback != nullptr && params.abort_callback(params.abort_callback_user_data)) {
+                return -1;
+            }
+            ctx->scorer(d.history.data(), (int) d.history.size(), logits.data(), ctx->user_data);
+            if (params.logits_filter_callback != nullptr) {
+                params.logits_filter_callback(ctx, state, d.tokens.data(), (int) d.tokens.size(), logits.data(),
+                                              params.logits_filter_callback_user_data);
+            }
+
+            for (whisper_token t = 0; t <= eot; ++t) {
+                ranked[(size_t) t] = t;
+            }
+            const size_t pick = step == 0 ? i : 0;
+            std::stable_sort(ranked.begin(), ranked.end(),
+                             [&](whisper_token a, whisper_token b) { return logits[(size_t) a] > logits[(size_t) b]; });
+            const whisper_token best = ranked[pick];
+            if (best == eot) {
+                d.done = true;
+                continue;
+            }
+            whisper_token_data token = {};
+            token.id = best;
+            token.p  = ctx->token_p;
+            d.tokens.push_back(token);
+            d.history.push_back(best);
+        }
+    }
+
+    for (const auto & d : decoders) {
+        ctx->decoded.push_back((int) d.tokens.size());
+    }
+    state->result         = decoders[0].tokens;
+    state->no_speech_prob = ctx->no_speech_prob;
+    return 0;
+}
+
+int whisper_full_n_segments_from_state(struct whisper_state * state) {
+    return state->result.empty() ? 0 : 1;
+}
+
+int whisper_full_n_tokens_from_state(struct whisper_state * state, int) {
+    return (int) state->result.size();
+}
+
+whisper_token whisper_full_get_token_id_from_state(struct whisper_state * state, int, int i_token) {
+    return state->result[(size_t) i_token].id;
+}
+
+float whisper_full_get_token_p_from_state(struct whisper_state * state, int, int i_token) {
+    return state->result[(size_t) i_token].p;
+}
+
+int64_t whisper_full_get_segment_t0_from_state(struct whisper_state *, int) {
+    return 0;
+}
+
+float whisper_full_get_segment_no_speech_prob_from_state(struct whisper_state * state, int) {
+    return state->no_speech_prob;
+}
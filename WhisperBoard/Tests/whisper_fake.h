@@ -0,0 +1,55 @@
+//
+//  whisper_fake.h
+//  WhisperBoard
+//
+//  Stand-in for libwhisper in the native tests: implements the whisper.h calls
+//  wb_decoder, wb_logits and wb_pipeline make, with logits from a scorer over
+//  the decoded history. whisper_decode_with_state keeps whisper.cpp's semantics:
+//  the KV cache is cut to n_past, and only the last fed token's logits row is
+//  written (rows for the other tokens keep whatever they held before).
+//  whisper_full_with_state decodes greedily with the same scorer, after an
+//  "encoder" that sleeps in proportion to audio_ctx and polls the abort hooks.
+//
+
+#ifndef whisper_fake_h
+#define whisper_fake_h
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fills `logits` (whisper_n_vocab entries) with the scores of the token after `history`
+// (every token from position 0, prompt included)
+typedef void (*wb_fake_scorer)(const whisper_token * history, int n_history, float * logits, void * user_data);
+
+// `n_text_tokens` text tokens (ids 0 ...), then EOT and the special tokens. Free with whisper_free.
+struct whisper_context * wb_fake_context_create(int n_text_tokens, wb_fake_scorer scorer, void * user_data);
+
+// Replaces a text token's bytes (default " w<id>"); may be part of a UTF-8 character
+void wb_fake_set_token_text(struct whisper_context * ctx, whisper_token token, const char * text);
+
+// whisper_decode_with_state calls made on `state`
+int wb_fake_decode_calls(const struct whisper_state * state);
+
+// Encoder time per audio_ctx position in whisper_full_with_state (default 0: instant).
+// audio_ctx 0 means the full 1500 positions, as in whisper.cpp.
+void wb_fake_set_encoder_cost(struct whisper_context * ctx, int us_per_position);
+
+// Probability whisper_full_with_state gives every token it decodes (default 0.9), and the
+// no-speech probability it reports for its segment (default 0)
+void wb_fake_set_decode_quality(struct whisper_context * ctx, float token_p, float no_speech_prob);
+
+// Samples the last whisper_pcm_to_mel_with_state on `ctx` was given, with their count and
+// sum (read during the call)
+const float * wb_fake_mel_samples(const struct whisper_context * ctx, int * n_samples, double * sum);
+
+// Text tokens decoder `decoder` produced in the last whisper_full_with_state on `ctx`
+int wb_fake_full_tokens(const struct whisper_context * ctx, int decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* whisper_fake_h */
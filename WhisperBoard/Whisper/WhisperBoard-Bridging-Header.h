@@ -233,4 +233,15 @@ const char * whisper_token_to_str(struct whisper_context * ctx, int token);
 }
 #endif
 
+// WhisperBoard native core (WhisperBoard/Native must be in Header Search Paths)
+#include "wb_dir_index.h"
+#include "wb_journal.h"
+#include "wb_shared_state.h"
+#include "wb_pcm_view.h"
+#include "wb_cancel.h"
+#include "wb_pool.h"
+#include "wb_pipeline.h"
+#include "wb_session.h"
+#include "wb_text_post.h"
+
 #endif /* WhisperBoard_Bridging_Header_h */